@@ -0,0 +1,114 @@
+/*
+ * BNG Blaster (BBL) - Checksum Benchmark
+ *
+ * Compare the previous 16 bit checksum loop with the
+ * generic, SSE2 and AVX2 checksum kernels for payloads
+ * from 64 to 1500 bytes.
+ *
+ * Usage: bench-checksum [rounds]
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <bbl.h>
+
+bool g_interactive = false;
+char *g_log_file = NULL;
+
+#define BENCH_KERNELS 4
+
+static const uint16_t bench_sizes[] = {64, 128, 256, 512, 1024, 1500};
+
+/*
+ * Previous checksum function as used in bbl_protocols.c.
+ */
+static uint16_t
+bench_legacy_checksum (uint16_t *buf, uint16_t len)
+{
+    uint32_t sum = 0;
+
+    while (len > 1) {
+        sum += *buf++;
+        len -= 2;
+    }
+    if(len > 0) {
+        sum += ((*buf) & htobe16(0xFF00));
+    }
+    while (sum>>16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ~sum;
+}
+
+static double
+bench_elapsed (struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Returns nanoseconds per checksum or zero if
+ * the kernel is not supported by this CPU.
+ */
+static double
+bench_checksum (checksum_kernel_t kernel, uint8_t *buf, uint16_t len, uint rounds, uint16_t *result)
+{
+    struct timespec start;
+    uint16_t csum = 0;
+    uint i;
+
+    if(kernel && !checksum_kernel_set(kernel)) {
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < rounds; i++) {
+        if(kernel) {
+            csum = checksum((uint16_t*)buf, len);
+        } else {
+            csum = bench_legacy_checksum((uint16_t*)buf, len);
+        }
+        __asm__ volatile("" : "+g"(csum) : : "memory");
+    }
+    *result = csum;
+    return bench_elapsed(&start) * 1e9 / rounds;
+}
+
+int
+main (int argc, char *argv[])
+{
+    double ns[BENCH_KERNELS];
+    uint16_t result[BENCH_KERNELS];
+    uint8_t buf[1536];
+    uint rounds = 10000000;
+    uint i, k;
+
+    if (argc > 1) rounds = strtoul(argv[1], NULL, 10);
+    if (!rounds) {
+        fprintf(stderr, "Usage: %s [rounds]\n", argv[0]);
+        return 1;
+    }
+    srandom(1);
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = random();
+    }
+
+    printf("%u rounds, ns per checksum\n\n", rounds);
+    printf("Payload (bytes)      %15s %15s %15s %15s\n", "Previous", "Generic", "SSE2", "AVX2");
+    for (i = 0; i < sizeof(bench_sizes)/sizeof(bench_sizes[0]); i++) {
+        for (k = 0; k < BENCH_KERNELS; k++) {
+            /* Kernel 0 is the previous checksum function. */
+            ns[k] = bench_checksum((checksum_kernel_t)k, buf, bench_sizes[i], rounds, &result[k]);
+            if(ns[k] && result[k] != result[0]) {
+                fprintf(stderr, "Checksum mismatch\n");
+                return 1;
+            }
+        }
+        printf("%-20u %15.1f %15.1f %15.1f %15.1f\n", bench_sizes[i], ns[0], ns[1], ns[2], ns[3]);
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * BNG Blaster (BBL) - Classify Benchmark
+ *
+ * Compare the full protocol decoder (decode_ethernet) with
+ * the RX fast path classifier (classify_bbl) for received
+ * BBL test traffic and report decoded packets per second
+ * on a single core.
+ *
+ * Usage: bench-classify [packets]
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <bbl.h>
+
+bool g_interactive = false;
+char *g_log_file = NULL;
+
+#define BENCH_FRAMES 5
+
+typedef struct bench_frame_ {
+    const char *name;
+    uint8_t buf[256];
+    uint16_t len;
+} bench_frame_s;
+
+static uint8_t mac_client[ETH_ADDR_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static uint8_t mac_server[ETH_ADDR_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+static uint8_t ipv6_client[IPV6_ADDR_LEN] = {0xfc, 0x66, 0x10, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01};
+static uint8_t ipv6_network[IPV6_ADDR_LEN] = {0xfc, 0x66, 0x20, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01};
+
+static double
+bench_elapsed (struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Session traffic frames as sent by bbl_stream_encode
+ * and a non BBL frame which must miss the fast path.
+ */
+static bool
+bench_frame (bench_frame_s *frame, uint i)
+{
+    bbl_ethernet_header_t eth = {0};
+    bbl_pppoe_session_t pppoe = {0};
+    bbl_ipv4_t ipv4 = {0};
+    bbl_ipv6_t ipv6 = {0};
+    bbl_udp_t udp = {0};
+    bbl_bbl_t bbl = {0};
+    bbl_arp_t arp = {0};
+
+    bbl.type = BBL_TYPE_UNICAST_SESSION;
+    bbl.sub_type = BBL_SUB_TYPE_IPV4;
+    bbl.ifindex = 2;
+    bbl.outer_vlan_id = 128;
+    bbl.inner_vlan_id = 7;
+    bbl.flow_id = 1;
+    bbl.flow_seq = 1;
+    udp.src = BBL_UDP_PORT;
+    udp.dst = BBL_UDP_PORT;
+    udp.protocol = UDP_PROTOCOL_BBL;
+    udp.next = &bbl;
+    ipv4.src = htobe32(0x0a000001);
+    ipv4.dst = htobe32(0x0a640001);
+    ipv4.ttl = 64;
+    ipv4.protocol = PROTOCOL_IPV4_UDP;
+    ipv4.next = &udp;
+    ipv6.src = ipv6_network;
+    ipv6.dst = ipv6_client;
+    ipv6.ttl = 64;
+    ipv6.protocol = IPV6_NEXT_HEADER_UDP;
+    ipv6.next = &udp;
+    eth.dst = mac_server;
+    eth.src = mac_client;
+
+    switch(i) {
+        case 0:
+            frame->name = "PPPoE IPv4 (QinQ)";
+            bbl.direction = BBL_DIRECTION_UP;
+            eth.vlan_outer = 128;
+            eth.vlan_inner = 7;
+            eth.type = ETH_TYPE_PPPOE_SESSION;
+            eth.next = &pppoe;
+            pppoe.session_id = 1;
+            pppoe.protocol = PROTOCOL_IPV4;
+            pppoe.next = &ipv4;
+            break;
+        case 1:
+            frame->name = "IPoE IPv4 (QinQ)";
+            bbl.direction = BBL_DIRECTION_UP;
+            eth.vlan_outer = 128;
+            eth.vlan_inner = 7;
+            eth.type = ETH_TYPE_IPV4;
+            eth.next = &ipv4;
+            break;
+        case 2:
+            frame->name = "Network IPv4";
+            bbl.direction = BBL_DIRECTION_DOWN;
+            eth.type = ETH_TYPE_IPV4;
+            eth.next = &ipv4;
+            break;
+        case 3:
+            frame->name = "Network IPv6";
+            bbl.direction = BBL_DIRECTION_DOWN;
+            bbl.sub_type = BBL_SUB_TYPE_IPV6;
+            eth.type = ETH_TYPE_IPV6;
+            eth.next = &ipv6;
+            break;
+        default:
+            frame->name = "ARP (miss)";
+            eth.dst = NULL;
+            eth.type = ETH_TYPE_ARP;
+            eth.next = &arp;
+            arp.code = ARP_REQUEST;
+            arp.sender = mac_client;
+            arp.sender_ip = ipv4.src;
+            arp.target_ip = ipv4.dst;
+            break;
+    }
+    frame->len = 0;
+    return encode_ethernet(frame->buf, &frame->len, &eth) == PROTOCOL_SUCCESS;
+}
+
+static double
+bench_decode (bench_frame_s *frame, uint packets)
+{
+    bbl_ethernet_header_t *eth;
+    uint8_t sp[SCRATCHPAD_LEN];
+    struct timespec start;
+    uint i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < packets; i++) {
+        decode_ethernet(frame->buf, frame->len, sp, SCRATCHPAD_LEN, &eth);
+        __asm__ volatile("" : : "g"(eth) : "memory");
+    }
+    return packets / bench_elapsed(&start) / 1e6;
+}
+
+static double
+bench_classify (bench_frame_s *frame, uint packets, bool *hit)
+{
+    bbl_classify_t classify;
+    struct timespec start;
+    uint i;
+
+    *hit = classify_bbl(frame->buf, frame->len, &classify) == PROTOCOL_SUCCESS;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < packets; i++) {
+        classify_bbl(frame->buf, frame->len, &classify);
+        __asm__ volatile("" : : "g"(&classify) : "memory");
+    }
+    return packets / bench_elapsed(&start) / 1e6;
+}
+
+int
+main (int argc, char *argv[])
+{
+    bench_frame_s frames[BENCH_FRAMES];
+    uint packets = 10000000;
+    double decode, classify;
+    bool hit;
+    uint i;
+
+    if (argc > 1) packets = strtoul(argv[1], NULL, 10);
+    if (!packets) {
+        fprintf(stderr, "Usage: %s [packets]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%u packets per frame type\n\n", packets);
+    printf("                     %15s %15s %15s %15s\n", "Length", "Decode (Mpps)", "Classify (Mpps)", "Fast Path");
+    for (i = 0; i < BENCH_FRAMES; i++) {
+        if(!bench_frame(&frames[i], i)) {
+            fprintf(stderr, "Failed to encode frame %u\n", i);
+            return 1;
+        }
+        decode = bench_decode(&frames[i], packets);
+        classify = bench_classify(&frames[i], packets, &hit);
+        if(hit == (i == BENCH_FRAMES - 1)) {
+            fprintf(stderr, "Unexpected classification of %s\n", frames[i].name);
+            return 1;
+        }
+        printf("%-20s %15u %15.2f %15.2f %15s\n", frames[i].name, frames[i].len,
+               decode, classify, hit ? "hit" : "miss");
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+/*
+ * BNG Blaster (BBL) - I/O Thread Data Plane Benchmark
+ *
+ * Send session traffic with one I/O thread per interface like
+ * bbl_io_data_tx() does and report the aggregate packet rate
+ * for 1 up to the given number of threads (interfaces). The
+ * flows are started by the main thread using the data queue
+ * like the control thread does on session state changes.
+ *
+ * The TX ringbuffer is plain memory which is handed back
+ * immediately after each run instead of being sent by the
+ * kernel, such that the packet rate is limited by the data
+ * plane only. The rate scales with the number of threads as
+ * long as there are enough CPUs.
+ *
+ * Usage: bench-io-thread [threads] [flows] [seconds]
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#define _GNU_SOURCE
+#include <bbl.h>
+
+bool g_interactive = false;
+char *g_log_file = NULL;
+
+#define BENCH_TEMPLATE_LEN  128
+#define BENCH_FRAMES        1024
+#define BENCH_FRAME_SIZE    2048
+#define BENCH_INTERVAL      1000000 /* 1ms per flow */
+
+typedef struct bench_worker_ {
+    bbl_interface_s interface;
+    bbl_io_thread_s io_thread;
+    bbl_interface_stats_s stats;
+    bbl_session_s *sessions;
+    bbl_session_flow_s *flows;
+    pthread_t thread;
+    int cpu;
+} bench_worker_s;
+
+static atomic_bool bench_stop;
+
+/*
+ * Hand all frames sent back to the ring, like
+ * the kernel does after sending them.
+ */
+static void
+bench_ring_release (bbl_io_thread_s *io_thread, uint *cursor)
+{
+    struct tpacket2_hdr *tphdr;
+
+    while(true) {
+        tphdr = (struct tpacket2_hdr*)(io_thread->data.ring + (*cursor * io_thread->data.req.tp_frame_size));
+        if(tphdr->tp_status != TP_STATUS_SEND_REQUEST) {
+            break;
+        }
+        tphdr->tp_status = TP_STATUS_AVAILABLE;
+        *cursor = (*cursor + 1) % io_thread->data.req.tp_frame_nr;
+    }
+}
+
+static void *
+bench_worker_main (void *arg)
+{
+    bench_worker_s *worker = arg;
+    bbl_io_thread_s *io_thread = &worker->io_thread;
+    cpu_set_t cpuset;
+    uint cursor = 0;
+
+    if(worker->cpu >= 0) {
+        CPU_ZERO(&cpuset);
+        CPU_SET(worker->cpu, &cpuset);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    }
+    while(!atomic_load_explicit(&bench_stop, memory_order_relaxed)) {
+        bbl_io_data_tx(io_thread);
+        bench_ring_release(io_thread, &cursor);
+    }
+    return NULL;
+}
+
+static void
+bench_worker_init (bench_worker_s *worker, bbl_ctx_s *ctx, uint flows)
+{
+    bbl_io_thread_s *io_thread = &worker->io_thread;
+    bbl_interface_s *interface = &worker->interface;
+    uint i;
+
+    memset(worker, 0x0, sizeof(bench_worker_s));
+    interface->name = "bench";
+    interface->ctx = ctx;
+    interface->io_data = true;
+    interface->io_thread = io_thread;
+    interface->traffic_calendar = bbl_calendar_new(BBL_CALENDAR_TICK_NSEC, bbl_calendar_now());
+
+    io_thread->interface = interface;
+    io_thread->tx = true;
+    io_thread->data.queue = bbl_spsc_new(BBL_IO_DATA_QUEUE_SLOTS, sizeof(bbl_io_data_msg_s));
+    io_thread->data.stats = &worker->stats;
+    io_thread->data.fd = -1; /* no kernel, each kick fails fast */
+    io_thread->data.req.tp_frame_size = BENCH_FRAME_SIZE;
+    io_thread->data.req.tp_frame_nr = BENCH_FRAMES;
+    io_thread->data.ring = calloc(BENCH_FRAMES, BENCH_FRAME_SIZE);
+    io_thread->data.flush_threshold = 64;
+
+    worker->sessions = calloc(flows, sizeof(bbl_session_s));
+    worker->flows = calloc(flows, sizeof(bbl_session_flow_s));
+    for(i = 0; i < flows; i++) {
+        worker->flows[i].session = &worker->sessions[i];
+        worker->flows[i].type = BBL_SESSION_FLOW_ACCESS_IPV4;
+    }
+}
+
+/*
+ * Start all flows of the worker like the control
+ * thread does if the sessions become established.
+ */
+static void
+bench_worker_start (bench_worker_s *worker, uint flows)
+{
+    bbl_io_data_msg_s msg;
+    uint i;
+
+    for(i = 0; i < flows; i++) {
+        memset(&msg, 0x0, sizeof(msg));
+        msg.type = BBL_IO_DATA_FLOW;
+        msg.seq_reset = true;
+        msg.len = BENCH_TEMPLATE_LEN;
+        msg.interval = BENCH_INTERVAL;
+        msg.object = &worker->flows[i];
+        msg.template = calloc(1, BENCH_TEMPLATE_LEN);
+        bbl_io_thread_data_update(&worker->interface, &msg);
+    }
+}
+
+static void
+bench_worker_free (bench_worker_s *worker, uint flows)
+{
+    bbl_io_data_msg_s *msg;
+    uint i;
+
+    while((msg = (bbl_io_data_msg_s*)bbl_spsc_peek(worker->io_thread.data.queue))) {
+        free(msg->template);
+        bbl_spsc_release(worker->io_thread.data.queue);
+    }
+    for(i = 0; i < flows; i++) {
+        free(worker->flows[i].io_template);
+    }
+    free(worker->flows);
+    free(worker->sessions);
+    free(worker->io_thread.data.ring);
+    bbl_spsc_free(worker->io_thread.data.queue);
+    bbl_calendar_free(worker->interface.traffic_calendar);
+}
+
+/*
+ * Minimal version of bbl_io_thread_data_update() which
+ * is part of the I/O thread and not linked here.
+ */
+void
+bbl_io_thread_data_update (bbl_interface_s *interface, bbl_io_data_msg_s *msg)
+{
+    uint8_t *slot;
+
+    while(!(slot = bbl_spsc_reserve(interface->io_thread->data.queue))) {
+        sched_yield();
+    }
+    memcpy(slot, msg, sizeof(bbl_io_data_msg_s));
+    bbl_spsc_commit(interface->io_thread->data.queue);
+}
+
+static double
+bench_run (bbl_ctx_s *ctx, uint threads, uint flows, uint seconds, int cpus)
+{
+    bench_worker_s *workers;
+    uint64_t packets = 0;
+    struct timespec start, stop;
+    double elapsed;
+    uint i;
+
+    workers = calloc(threads, sizeof(bench_worker_s));
+    atomic_store(&bench_stop, false);
+    for(i = 0; i < threads; i++) {
+        bench_worker_init(&workers[i], ctx, flows);
+        workers[i].cpu = cpus > 1 ? (int)(i % cpus) : -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i = 0; i < threads; i++) {
+        pthread_create(&workers[i].thread, NULL, bench_worker_main, &workers[i]);
+        bench_worker_start(&workers[i], flows);
+    }
+    sleep(seconds);
+    atomic_store(&bench_stop, true);
+    for(i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    elapsed = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    for(i = 0; i < threads; i++) {
+        packets += workers[i].stats.packets_tx;
+        bench_worker_free(&workers[i], flows);
+    }
+    free(workers);
+    return packets / elapsed;
+}
+
+int
+main (int argc, char *argv[])
+{
+    bbl_ctx_s *ctx;
+    uint threads = 4;
+    uint flows = 100000;
+    uint seconds = 3;
+    int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    double pps, base = 0;
+    uint t;
+
+    if (argc > 1) threads = strtoul(argv[1], NULL, 10);
+    if (argc > 2) flows = strtoul(argv[2], NULL, 10);
+    if (argc > 3) seconds = strtoul(argv[3], NULL, 10);
+    if (!threads || !flows || !seconds) {
+        fprintf(stderr, "Usage: %s [threads] [flows] [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    ctx = calloc(1, sizeof(bbl_ctx_s));
+    printf("%u flows per thread at %llu pps each, %u seconds, %d CPUs\n\n",
+           flows, BBL_CALENDAR_NSEC_PER_SEC / BENCH_INTERVAL, seconds, cpus);
+    printf("Threads       Packets/s     Speedup\n");
+    for(t = 1; t <= threads; t++) {
+        pps = bench_run(ctx, t, flows, seconds, cpus);
+        if(t == 1) base = pps;
+        printf("%7u %15.0f %11.2f\n", t, pps, base ? pps / base : 0);
+    }
+    free(ctx);
+    return 0;
+}
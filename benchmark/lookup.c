@@ -0,0 +1,243 @@
+/*
+ * BNG Blaster (BBL) - Session Lookup Benchmark
+ *
+ * Compare the session dictionary using the previous hash
+ * function and fixed size with the sized dictionary and
+ * the direct VLAN table used for received traffic.
+ *
+ * Usage: bench-lookup [sessions] [rounds]
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <bbl.h>
+
+bool g_interactive = false;
+char *g_log_file = NULL;
+
+#define BENCH_LEGACY_BUCKETS 32771
+
+/*
+ * Session dictionary compare and hash functions as used in bbl.c.
+ */
+static int
+bench_compare_session (void *key1, void *key2)
+{
+    const uint64_t a = *(const uint64_t*)key1;
+    const uint64_t b = *(const uint64_t*)key2;
+    return (a > b) - (a < b);
+}
+
+static uint
+bench_session_hash (const void* k)
+{
+    return bbl_dict_mix64(*(const uint64_t*)k);
+}
+
+static uint
+bench_legacy_session_hash (const void* k)
+{
+    uint hash = 2166136261U;
+
+    hash ^= *(uint32_t *)k;
+    hash ^= *(uint16_t *)(k+4) << 12;
+    hash ^= *(uint16_t *)(k+6);
+
+    return hash;
+}
+
+typedef struct bench_result_ {
+    double add;
+    double seq;
+    double rnd;
+    double miss;
+    bbl_dict_stats_s stats;
+} bench_result_s;
+
+static session_key_t *keys;
+static uint32_t *order;
+static uint8_t *sessions;
+
+static double
+bench_elapsed (struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static uint64_t
+bench_dict (bbl_dict_s *d, uint count, uint rounds, bench_result_s *res)
+{
+    dict_insert_result result;
+    session_key_t key;
+    struct timespec start;
+    uint64_t found = 0;
+    uint i, r;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; i++) {
+        bbl_dict_reserve(d);
+        result = dict_insert(d->dict, &keys[i]);
+        *result.datum_ptr = sessions + i * 64;
+    }
+    res->add = bench_elapsed(&start) * 1e9 / count;
+
+    /* Sequential lookups like session traffic received in order. */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            key = keys[i];
+            if (dict_search(d->dict, &key)) found++;
+        }
+    }
+    res->seq = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+
+    /* Random lookups like traffic from many subscribers. */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            key = keys[order[i]];
+            if (dict_search(d->dict, &key)) found++;
+        }
+    }
+    res->rnd = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+
+    /* Unknown sessions (wrong inner VLAN). */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            key = keys[order[i]];
+            key.inner_vlan_id = 4095;
+            if (dict_search(d->dict, &key)) found++;
+        }
+    }
+    res->miss = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+
+    bbl_dict_get_stats(d, &res->stats);
+    bbl_dict_free(d);
+    return found;
+}
+
+static uint64_t
+bench_table (uint count, uint rounds, bench_result_s *res)
+{
+    bbl_session_table_s table = {0};
+    session_key_t key;
+    struct timespec start;
+    uint64_t found = 0;
+    uint i, r;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; i++) {
+        bbl_session_table_add(&table, keys[i].outer_vlan_id, keys[i].inner_vlan_id,
+                              (bbl_session_s*)(sessions + i * 64));
+    }
+    res->add = bench_elapsed(&start) * 1e9 / count;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            key = keys[i];
+            if (bbl_session_table_get(&table, key.outer_vlan_id, key.inner_vlan_id)) found++;
+        }
+    }
+    res->seq = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            key = keys[order[i]];
+            if (bbl_session_table_get(&table, key.outer_vlan_id, key.inner_vlan_id)) found++;
+        }
+    }
+    res->rnd = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            key = keys[order[i]];
+            key.inner_vlan_id = 4095;
+            if (bbl_session_table_get(&table, key.outer_vlan_id, key.inner_vlan_id)) found++;
+        }
+    }
+    res->miss = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+
+    res->stats.entries = table.stats.sessions;
+    res->stats.buckets = (table.stats.inner_tables + 1) * BBL_SESSION_TABLE_VLANS;
+    res->stats.max_chain = 1;
+    res->stats.load_factor = (double)res->stats.entries / res->stats.buckets;
+    bbl_session_table_free(&table);
+    return found;
+}
+
+int
+main (int argc, char *argv[])
+{
+    bbl_dict_s legacy = {0};
+    bbl_dict_s sized = {0};
+    bench_result_s res[3];
+    uint count = 1000000;
+    uint rounds = 10;
+    uint i, j, tmp;
+
+    if (argc > 1) count = strtoul(argv[1], NULL, 10);
+    if (argc > 2) rounds = strtoul(argv[2], NULL, 10);
+    if (!count || !rounds || count > 4094 * 4094) {
+        fprintf(stderr, "Usage: %s [sessions] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    /*
+     * Keys are assigned like the default access configuration,
+     * iterating the inner VLAN first (1-4094) and then the outer VLAN.
+     */
+    keys = calloc(count, sizeof(session_key_t));
+    order = calloc(count, sizeof(uint32_t));
+    sessions = calloc(count, 64);
+    for (i = 0; i < count; i++) {
+        keys[i].ifindex = 2;
+        keys[i].outer_vlan_id = 1 + i / 4094;
+        keys[i].inner_vlan_id = 1 + i % 4094;
+        order[i] = i;
+    }
+    srandom(1);
+    for (i = count - 1; i > 0; i--) {
+        j = random() % (i + 1);
+        tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    /* Previous fixed size dictionary which does not grow. */
+    legacy.name = "legacy";
+    legacy.compare = (dict_compare_func)bench_compare_session;
+    legacy.hash = bench_legacy_session_hash;
+    legacy.buckets = BENCH_LEGACY_BUCKETS;
+    legacy.dict = hashtable2_dict_new(legacy.compare, legacy.hash, legacy.buckets);
+    bbl_dict_init(&sized, "sessions", (dict_compare_func)bench_compare_session,
+                  bench_session_hash, count, true);
+
+    memset(res, 0x0, sizeof(res));
+    if (bench_dict(&legacy, count, rounds, &res[0]) != (uint64_t)count * rounds * 2 ||
+        bench_dict(&sized, count, rounds, &res[1]) != (uint64_t)count * rounds * 2 ||
+        bench_table(count, rounds, &res[2]) != (uint64_t)count * rounds * 2) {
+        fprintf(stderr, "Lookup mismatch\n");
+        return 1;
+    }
+
+    printf("%u sessions, %u rounds\n\n", count, rounds);
+    printf("                     %15s %15s %15s\n", "Dict (previous)", "Dict (sized)", "VLAN Table");
+    printf("Buckets              %15u %15u %15u\n", res[0].stats.buckets, res[1].stats.buckets, res[2].stats.buckets);
+    printf("Load Factor          %15.2f %15.2f %15.2f\n",
+           res[0].stats.load_factor, res[1].stats.load_factor, res[2].stats.load_factor);
+    printf("Max Chain Length     %15u %15u %15u\n", res[0].stats.max_chain, res[1].stats.max_chain, res[2].stats.max_chain);
+    printf("Add (ns/session)     %15.1f %15.1f %15.1f\n", res[0].add, res[1].add, res[2].add);
+    printf("Sequential (ns)      %15.1f %15.1f %15.1f\n", res[0].seq, res[1].seq, res[2].seq);
+    printf("Random (ns)          %15.1f %15.1f %15.1f\n", res[0].rnd, res[1].rnd, res[2].rnd);
+    printf("Unknown (ns)         %15.1f %15.1f %15.1f\n", res[0].miss, res[1].miss, res[2].miss);
+    return 0;
+}
@@ -0,0 +1,312 @@
+/*
+ * BNG Blaster (BBL) - Session Layout Benchmark
+ *
+ * Compare session traffic processing on the hot session
+ * structure with the previous layout where control plane
+ * data was stored inline between the traffic fields.
+ *
+ * Usage: bench-session [sessions] [rounds]
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <bbl.h>
+#include <stddef.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+bool g_interactive = false;
+char *g_log_file = NULL;
+
+#define BENCH_TEMPLATE_LEN 64
+
+/*
+ * Previous session layout reduced to the fields used for
+ * session traffic. Fields are placed at their previous offsets
+ * (x86_64), the padding holds the control plane data like
+ * credentials, DUIDs, PPP options and IGMP groups.
+ */
+typedef struct legacy_session_ {
+    uint8_t pad0[8];
+    session_state_t session_state;          /* 8 */
+    uint8_t pad1[112-9];
+    uint8_t *write_buf;                     /* 112 */
+    uint8_t pad2[523-120];
+    ppp_state_t ipcp_state;                 /* 523 */
+    uint8_t pad3[595-524];
+    ppp_state_t ip6cp_state;                /* 595 */
+    uint8_t pad4[1992-596];
+    bool session_traffic;                   /* 1992 */
+    uint8_t pad5[2008-1993];
+    uint64_t access_ipv4_tx_seq;            /* 2008 */
+    uint8_t *access_ipv4_tx_packet_template;/* 2016 */
+    uint8_t access_ipv4_tx_packet_len;      /* 2024 */
+    uint64_t access_ipv4_rx_first_seq;      /* 2032 */
+    uint64_t access_ipv4_rx_last_seq;       /* 2040 */
+    uint8_t pad6[2352-2048];
+    struct {
+        uint64_t access_ipv4_rx;            /* 2352 */
+        uint64_t access_ipv4_tx;            /* 2360 */
+        uint64_t access_ipv4_loss;          /* 2368 */
+    } stats;
+    uint8_t pad7[2504-2376];
+} legacy_session_s;
+
+#define BENCH_LEGACY_SIZE ((sizeof(legacy_session_s) + BBL_SESSION_ALIGN - 1) & ~(BBL_SESSION_ALIGN - 1))
+
+static int
+bench_perf_open ()
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0x0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void
+bench_perf_start (int fd)
+{
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static int64_t
+bench_perf_stop (int fd)
+{
+    uint64_t count;
+
+    if (fd < 0) {
+        return -1;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return -1;
+    }
+    return count;
+}
+
+static double
+bench_elapsed (struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * The TX walk follows the session list in order like the TX job
+ * encoding session traffic. The RX walk visits sessions in random
+ * order like packets received from the network interface.
+ */
+#define BENCH_TX(_s, _buf) \
+    if ((_s)->session_state == BBL_ESTABLISHED && (_s)->ipcp_state == BBL_PPP_OPENED && \
+        (_s)->session_traffic) { \
+        (_s)->write_buf = (_buf); \
+        memcpy((_buf), (_s)->access_ipv4_tx_packet_template, (_s)->access_ipv4_tx_packet_len); \
+        *(uint64_t*)((_buf) + BENCH_TEMPLATE_LEN - 8) = (_s)->access_ipv4_tx_seq++; \
+        (_s)->stats.access_ipv4_tx++; \
+    }
+
+#define BENCH_RX(_s, _seq) \
+    if ((_s)->session_state == BBL_ESTABLISHED) { \
+        (_s)->stats.access_ipv4_rx++; \
+        if ((_s)->access_ipv4_rx_first_seq) { \
+            if ((_seq) > (_s)->access_ipv4_rx_last_seq + 1) { \
+                (_s)->stats.access_ipv4_loss += (_seq) - ((_s)->access_ipv4_rx_last_seq + 1); \
+            } \
+        } else { \
+            (_s)->access_ipv4_rx_first_seq = (_seq); \
+        } \
+        (_s)->access_ipv4_rx_last_seq = (_seq); \
+    }
+
+typedef struct bench_result_ {
+    double tx_ns;
+    double rx_ns;
+    int64_t tx_misses;
+    int64_t rx_misses;
+    double mapped_mb;
+} bench_result_s;
+
+static uint8_t **templates;
+static uint32_t *order;
+
+static void
+bench_legacy (uint count, uint rounds, int perf_fd, bench_result_s *result)
+{
+    bbl_arena_s arena;
+    legacy_session_s **sessions;
+    legacy_session_s *session;
+    uint8_t buf[BENCH_TEMPLATE_LEN];
+    struct timespec start;
+    uint i, r;
+
+    bbl_arena_init(&arena, "legacy", (size_t)count * BENCH_LEGACY_SIZE + BBL_SESSION_ALIGN, false);
+    sessions = calloc(count, sizeof(legacy_session_s*));
+    for (i = 0; i < count; i++) {
+        session = bbl_arena_alloc(&arena, sizeof(legacy_session_s), BBL_SESSION_ALIGN);
+        session->session_state = BBL_ESTABLISHED;
+        session->ipcp_state = BBL_PPP_OPENED;
+        session->session_traffic = true;
+        session->access_ipv4_tx_packet_template = templates[i];
+        session->access_ipv4_tx_packet_len = BENCH_TEMPLATE_LEN;
+        sessions[i] = session;
+    }
+    result->mapped_mb = arena.stats.mapped / (1024.0 * 1024.0);
+
+    bench_perf_start(perf_fd);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            session = sessions[i];
+            BENCH_TX(session, buf);
+        }
+    }
+    result->tx_ns = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+    result->tx_misses = bench_perf_stop(perf_fd);
+
+    bench_perf_start(perf_fd);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            session = sessions[order[i]];
+            BENCH_RX(session, r + 1);
+        }
+    }
+    result->rx_ns = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+    result->rx_misses = bench_perf_stop(perf_fd);
+
+    free(sessions);
+    bbl_arena_free(&arena);
+}
+
+static void
+bench_split (uint count, uint rounds, int perf_fd, bench_result_s *result)
+{
+    bbl_arena_s arena, cold_arena;
+    bbl_session_s **sessions;
+    bbl_session_s *session;
+    uint8_t buf[BENCH_TEMPLATE_LEN];
+    struct timespec start;
+    uint i, r;
+
+    bbl_arena_init(&arena, "sessions", (size_t)count * BBL_SESSION_SIZE + BBL_SESSION_ALIGN, false);
+    bbl_arena_init(&cold_arena, "sessions-cold",
+                   (size_t)count * sizeof(bbl_session_cold_s) + BBL_SESSION_ALIGN, false);
+    sessions = calloc(count, sizeof(bbl_session_s*));
+    for (i = 0; i < count; i++) {
+        session = bbl_arena_alloc(&arena, sizeof(bbl_session_s), BBL_SESSION_ALIGN);
+        session->cold = bbl_arena_alloc(&cold_arena, sizeof(bbl_session_cold_s), 0);
+        session->session_state = BBL_ESTABLISHED;
+        session->ipcp_state = BBL_PPP_OPENED;
+        session->session_traffic = true;
+        session->access_ipv4_tx_packet_template = templates[i];
+        session->access_ipv4_tx_packet_len = BENCH_TEMPLATE_LEN;
+        sessions[i] = session;
+    }
+    result->mapped_mb = (arena.stats.mapped + cold_arena.stats.mapped) / (1024.0 * 1024.0);
+
+    bench_perf_start(perf_fd);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            session = sessions[i];
+            BENCH_TX(session, buf);
+        }
+    }
+    result->tx_ns = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+    result->tx_misses = bench_perf_stop(perf_fd);
+
+    bench_perf_start(perf_fd);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            session = sessions[order[i]];
+            BENCH_RX(session, r + 1);
+        }
+    }
+    result->rx_ns = bench_elapsed(&start) * 1e9 / ((double)count * rounds);
+    result->rx_misses = bench_perf_stop(perf_fd);
+
+    free(sessions);
+    bbl_arena_free(&arena);
+    bbl_arena_free(&cold_arena);
+}
+
+static void
+bench_print_misses (const char *name, int64_t legacy, int64_t split, uint64_t ops)
+{
+    if (legacy < 0 || split < 0) {
+        printf("%-20s %15s %15s\n", name, "n/a", "n/a");
+        return;
+    }
+    printf("%-20s %15.2f %15.2f\n", name, (double)legacy / ops, (double)split / ops);
+}
+
+int
+main (int argc, char *argv[])
+{
+    bbl_arena_s template_arena;
+    bench_result_s legacy = {0};
+    bench_result_s split = {0};
+    uint count = 1000000;
+    uint rounds = 10;
+    uint i, j, tmp;
+    int perf_fd, perf_errno;
+
+    if (argc > 1) count = strtoul(argv[1], NULL, 10);
+    if (argc > 2) rounds = strtoul(argv[2], NULL, 10);
+    if (!count || !rounds) {
+        fprintf(stderr, "Usage: %s [sessions] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    /* Templates are shared by both layouts. */
+    bbl_arena_init(&template_arena, "templates", BBL_ARENA_CHUNK_SIZE, false);
+    templates = calloc(count, sizeof(uint8_t*));
+    order = calloc(count, sizeof(uint32_t));
+    srandom(1);
+    for (i = 0; i < count; i++) {
+        templates[i] = bbl_arena_alloc(&template_arena, BENCH_TEMPLATE_LEN, 0);
+        memset(templates[i], i, BENCH_TEMPLATE_LEN);
+        order[i] = i;
+    }
+    for (i = count - 1; i > 0; i--) {
+        j = random() % (i + 1);
+        tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    perf_fd = bench_perf_open();
+    perf_errno = errno;
+    bench_legacy(count, rounds, perf_fd, &legacy);
+    bench_split(count, rounds, perf_fd, &split);
+
+    printf("%u sessions, %u rounds, session %zu bytes (hot) + %zu bytes (cold), previous %zu bytes\n\n",
+           count, rounds, sizeof(bbl_session_s), sizeof(bbl_session_cold_s), sizeof(legacy_session_s));
+    printf("%-20s %15s %15s\n", "", "Previous", "Hot/Cold");
+    printf("%-20s %15.1f %15.1f\n", "Mapped (MB)", legacy.mapped_mb, split.mapped_mb);
+    printf("%-20s %15.1f %15.1f\n", "TX (ns/session)", legacy.tx_ns, split.tx_ns);
+    bench_print_misses("TX (misses/session)", legacy.tx_misses, split.tx_misses, (uint64_t)count * rounds);
+    printf("%-20s %15.1f %15.1f\n", "RX (ns/session)", legacy.rx_ns, split.rx_ns);
+    bench_print_misses("RX (misses/session)", legacy.rx_misses, split.rx_misses, (uint64_t)count * rounds);
+    if (perf_fd < 0) {
+        printf("\nCache misses not available (perf_event_open: %s)\n", strerror(perf_errno));
+    } else {
+        close(perf_fd);
+    }
+    bbl_arena_free(&template_arena);
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+ * BNG Blaster (BBL) - Timer Benchmark
+ *
+ * Compare the timer buckets with the previous implementation,
+ * which searched the bucket list linearly for each insertion
+ * and restarted periodic timers relative to the timer walk.
+ *
+ * Usage: bench-timer [timers] [intervals] [seconds]
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <bbl.h>
+
+bool g_interactive = false;
+char *g_log_file = NULL;
+
+/*
+ * Previous timer implementation reduced to the parts relevant
+ * for the benchmark. Timers are grouped into buckets of like
+ * intervals, insertion searches the bucket list and periodic
+ * timers are restarted from now.
+ */
+typedef struct legacy_timer_ {
+    CIRCLEQ_ENTRY(legacy_timer_) timer_qnode;
+    CIRCLEQ_ENTRY(legacy_timer_) timer_change_qnode;
+    struct legacy_bucket_ *bucket;
+    char name[16];
+    void *data;
+    struct legacy_timer_ **ptimer;
+    void (*cb)(struct legacy_timer_ *);
+    struct timespec expire;
+    uint expired:1,
+    periodic:1,
+    on_change_list:1;
+} legacy_timer_s;
+
+typedef struct legacy_bucket_ {
+    CIRCLEQ_HEAD(legacy_timer_head_, legacy_timer_) timer_qhead;
+    CIRCLEQ_ENTRY(legacy_bucket_) bucket_qnode;
+    time_t sec;
+    long nsec;
+    uint timers;
+} legacy_bucket_s;
+
+typedef struct legacy_root_ {
+    CIRCLEQ_HEAD(legacy_bucket_head_, legacy_bucket_) bucket_qhead;
+    CIRCLEQ_HEAD(legacy_change_head_, legacy_timer_) change_qhead;
+} legacy_root_s;
+
+static void
+legacy_set_expire (legacy_timer_s *timer, time_t sec, long nsec)
+{
+    clock_gettime(CLOCK_MONOTONIC, &timer->expire);
+    timer->expire.tv_sec += sec;
+    timer->expire.tv_nsec += nsec;
+    if (timer->expire.tv_nsec >= 1e9) {
+        timer->expire.tv_nsec -= 1e9;
+        timer->expire.tv_sec++;
+    }
+    timer->expired = false;
+}
+
+static void
+legacy_enqueue_bucket (legacy_root_s *root, legacy_timer_s *timer, time_t sec, long nsec)
+{
+    legacy_bucket_s *bucket;
+
+    CIRCLEQ_FOREACH(bucket, &root->bucket_qhead, bucket_qnode) {
+        if (bucket->sec == sec && bucket->nsec == nsec) {
+            goto insert;
+        }
+    }
+    bucket = calloc(1, sizeof(legacy_bucket_s));
+    CIRCLEQ_INIT(&bucket->timer_qhead);
+    bucket->sec = sec;
+    bucket->nsec = nsec;
+    CIRCLEQ_INSERT_TAIL(&root->bucket_qhead, bucket, bucket_qnode);
+insert:
+    timer->bucket = bucket;
+    CIRCLEQ_INSERT_TAIL(&bucket->timer_qhead, timer, timer_qnode);
+    bucket->timers++;
+}
+
+static void
+legacy_timer_add_periodic (legacy_root_s *root, legacy_timer_s **ptimer, char *name,
+                           time_t sec, long nsec, void *data, void (*cb)(legacy_timer_s *))
+{
+    legacy_timer_s *timer;
+
+    timer = calloc(1, sizeof(legacy_timer_s));
+    snprintf(timer->name, sizeof(timer->name), "%s", name);
+    timer->data = data;
+    timer->cb = cb;
+    timer->periodic = true;
+    legacy_set_expire(timer, sec, nsec);
+    timer->ptimer = ptimer;
+    *ptimer = timer;
+    legacy_enqueue_bucket(root, timer, sec, nsec);
+}
+
+static void
+legacy_timer_walk_once (legacy_root_s *root, struct timespec *sleep)
+{
+    legacy_bucket_s *bucket;
+    legacy_timer_s *timer;
+    struct timespec now, min = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    CIRCLEQ_FOREACH(bucket, &root->bucket_qhead, bucket_qnode) {
+        CIRCLEQ_FOREACH(timer, &bucket->timer_qhead, timer_qnode) {
+            if (timespec_compare(&timer->expire, &now) == 1) {
+                break;
+            }
+            timer->expired = true;
+            LOG(TIMER_DETAIL, "  Firing %s timer\n", timer->name);
+            (*timer->cb)(timer);
+            if (!timer->on_change_list) {
+                CIRCLEQ_INSERT_TAIL(&root->change_qhead, timer, timer_change_qnode);
+                timer->on_change_list = true;
+            }
+        }
+    }
+    while (!CIRCLEQ_EMPTY(&root->change_qhead)) {
+        timer = CIRCLEQ_FIRST(&root->change_qhead);
+        CIRCLEQ_REMOVE(&root->change_qhead, timer, timer_change_qnode);
+        timer->on_change_list = false;
+        bucket = timer->bucket;
+        legacy_set_expire(timer, bucket->sec, bucket->nsec);
+        CIRCLEQ_REMOVE(&bucket->timer_qhead, timer, timer_qnode);
+        CIRCLEQ_INSERT_TAIL(&bucket->timer_qhead, timer, timer_qnode);
+        LOG(TIMER_DETAIL, "  Reset %s timer, expire in %lu.%06lus\n", timer->name, bucket->sec, bucket->nsec/1000);
+    }
+    CIRCLEQ_FOREACH(bucket, &root->bucket_qhead, bucket_qnode) {
+        CIRCLEQ_FOREACH(timer, &bucket->timer_qhead, timer_qnode) {
+            if ((min.tv_sec == 0 && min.tv_nsec == 0) ||
+                timespec_compare(&timer->expire, &min) == -1) {
+                min = timer->expire;
+            }
+            if (timespec_compare(&timer->expire, &now) == 1) {
+                break;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_compare(&now, &min) == -1) {
+        timespec_sub(sleep, &min, &now);
+    } else {
+        sleep->tv_sec = 0;
+        sleep->tv_nsec = 1 * MSEC;
+    }
+}
+
+static uint64_t fired;
+
+static void
+bench_timer_cb (timer_s *timer)
+{
+    UNUSED(timer);
+    fired++;
+}
+
+static void
+bench_legacy_cb (legacy_timer_s *timer)
+{
+    UNUSED(timer);
+    fired++;
+}
+
+static double
+bench_elapsed (struct timespec *start, clockid_t clock)
+{
+    struct timespec now, diff;
+
+    clock_gettime(clock, &now);
+    timespec_sub(&diff, &now, start);
+    return diff.tv_sec + diff.tv_nsec / 1e9;
+}
+
+/*
+ * Timer intervals from 100ms to ~2s with some
+ * sub-millisecond intervals like session traffic.
+ */
+static void
+bench_interval (uint i, uint intervals, time_t *sec, long *nsec)
+{
+    uint64_t interval;
+
+    i = i % intervals;
+    if (i % 4 == 3) {
+        interval = 1000000000ULL / (1000 * (i + 1)); /* (i+1) * 1000 pps */
+    } else {
+        interval = 100 * MSEC + (uint64_t)i * (1900 * MSEC / intervals);
+    }
+    *sec = interval / 1000000000ULL;
+    *nsec = interval % 1000000000ULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+    timer_root_s *root;
+    timer_s **timers;
+    legacy_root_s legacy_root;
+    legacy_timer_s **legacy_timers;
+    struct timespec start, cpu, sleep;
+    uint count = 100000;
+    uint intervals = 16;
+    uint seconds = 3;
+    uint i;
+    time_t sec;
+    long nsec;
+    double add_timer, add_legacy, cpu_timer, cpu_legacy;
+    uint64_t fired_timer, fired_legacy;
+    double expected = 0;
+
+    if (argc > 1) count = strtoul(argv[1], NULL, 10);
+    if (argc > 2) intervals = strtoul(argv[2], NULL, 10);
+    if (argc > 3) seconds = strtoul(argv[3], NULL, 10);
+    if (!count || !intervals) {
+        fprintf(stderr, "Usage: %s [timers] [intervals] [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    /*
+     * Timer buckets.
+     */
+    root = calloc(1, sizeof(timer_root_s));
+    timers = calloc(count, sizeof(timer_s*));
+    timer_init_root(root);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; i++) {
+        bench_interval(i, intervals, &sec, &nsec);
+        timer_add_periodic(root, &timers[i], "bench", sec, nsec, NULL, bench_timer_cb);
+        expected += seconds * 1e9 / (sec * 1e9 + nsec);
+    }
+    add_timer = bench_elapsed(&start, CLOCK_MONOTONIC);
+
+    fired = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    while (bench_elapsed(&start, CLOCK_MONOTONIC) < seconds) {
+        timer_walk_once(root, &sleep);
+        nanosleep(&sleep, NULL);
+    }
+    cpu_timer = bench_elapsed(&cpu, CLOCK_PROCESS_CPUTIME_ID);
+    fired_timer = fired;
+    timer_flush_root(root);
+
+    /*
+     * Previous bucket list.
+     */
+    legacy_timers = calloc(count, sizeof(legacy_timer_s*));
+    CIRCLEQ_INIT(&legacy_root.bucket_qhead);
+    CIRCLEQ_INIT(&legacy_root.change_qhead);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; i++) {
+        bench_interval(i, intervals, &sec, &nsec);
+        legacy_timer_add_periodic(&legacy_root, &legacy_timers[i], "bench", sec, nsec, NULL, bench_legacy_cb);
+    }
+    add_legacy = bench_elapsed(&start, CLOCK_MONOTONIC);
+
+    fired = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    while (bench_elapsed(&start, CLOCK_MONOTONIC) < seconds) {
+        legacy_timer_walk_once(&legacy_root, &sleep);
+        nanosleep(&sleep, NULL);
+    }
+    cpu_legacy = bench_elapsed(&cpu, CLOCK_PROCESS_CPUTIME_ID);
+    fired_legacy = fired;
+
+    printf("%u periodic timers, %u intervals, %u seconds\n\n", count, intervals, seconds);
+    printf("                 %15s %15s\n", "Timer Buckets", "Previous");
+    printf("Add (ns/timer)   %15.1f %15.1f\n", add_timer * 1e9 / count, add_legacy * 1e9 / count);
+    printf("Expected         %15.0f %15.0f\n", expected, expected);
+    printf("Fired            %15lu %15lu\n", fired_timer, fired_legacy);
+    printf("CPU (s)          %15.3f %15.3f\n", cpu_timer, cpu_legacy);
+    printf("CPU (ns/fired)   %15.1f %15.1f\n",
+           fired_timer ? cpu_timer * 1e9 / fired_timer : 0,
+           fired_legacy ? cpu_legacy * 1e9 / fired_legacy : 0);
+    return 0;
+}
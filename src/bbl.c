@@ -16,6 +16,11 @@
 
 #include "bbl_logging.h"
 
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <linux/ethtool.h>
+#include <fcntl.h>
+
 /* Global Variables */
 bool g_interactive = false; // interactive mode using ncurses
 char *g_log_file = NULL;
@@ -50,14 +55,23 @@ teardown_handler (int sig)
     g_teardown_request_count++;
 }
 
+/*
+ * Queue the session for transmission of its send requests. Keepalive
+ * requests are queued separately, such that they are not delayed by
+ * sessions waiting to send control protocol frames.
+ */
 void
 bbl_session_tx_qnode_insert (bbl_session_s *session)
 {
     bbl_interface_s *interface = session->interface;
-    if(CIRCLEQ_NEXT(session, session_tx_qnode)) {
-        return;
+    if(session->send_requests & BBL_SEND_KEEPALIVE &&
+       !CIRCLEQ_NEXT(session, session_keepalive_qnode)) {
+        CIRCLEQ_INSERT_TAIL(&interface->session_keepalive_qhead, session, session_keepalive_qnode);
+    }
+    if(session->send_requests & ~BBL_SEND_KEEPALIVE &&
+       !CIRCLEQ_NEXT(session, session_tx_qnode)) {
+        CIRCLEQ_INSERT_TAIL(&interface->session_tx_qhead, session, session_tx_qnode);
     }
-    CIRCLEQ_INSERT_TAIL(&interface->session_tx_qhead, session, session_tx_qnode);
 }
 
 void
@@ -70,26 +84,12 @@ bbl_session_tx_qnode_remove (bbl_session_s *session)
 }
 
 void
-bbl_session_network_tx_qnode_insert (bbl_session_s *session)
+bbl_session_keepalive_qnode_remove (bbl_session_s *session)
 {
-    bbl_interface_s *interface = session->interface->ctx->op.network_if;
-    if(CIRCLEQ_NEXT(session, session_network_tx_qnode)) {
-        return;
-    }
-    if(interface) {
-        CIRCLEQ_INSERT_TAIL(&interface->session_tx_qhead, session, session_network_tx_qnode);
-    }
-}
-
-void
-bbl_session_network_tx_qnode_remove (bbl_session_s *session)
-{
-    bbl_interface_s *interface = session->interface->ctx->op.network_if;
-    if(interface) {
-        CIRCLEQ_REMOVE(&interface->session_tx_qhead, session, session_network_tx_qnode);
-        CIRCLEQ_NEXT(session, session_network_tx_qnode) = NULL;
-        CIRCLEQ_PREV(session, session_network_tx_qnode) = NULL;
-    }
+    bbl_interface_s *interface = session->interface;
+    CIRCLEQ_REMOVE(&interface->session_keepalive_qhead, session, session_keepalive_qnode);
+    CIRCLEQ_NEXT(session, session_keepalive_qnode) = NULL;
+    CIRCLEQ_PREV(session, session_keepalive_qnode) = NULL;
 }
 
 void
@@ -97,13 +97,14 @@ bbl_session_update_state(bbl_ctx_s *ctx, bbl_session_s *session, session_state_t
 {
     if(session->session_state != state) {
         /* State has changed ... */
+        bbl_stream_reset(session);
         if(session->session_state == BBL_ESTABLISHED && ctx->sessions_established) {
             /* Decrement sessions established if old state is established. */
             ctx->sessions_established--;
-            if(session->dhcpv6_received) {
+            if(session->cold->dhcpv6_received) {
                 ctx->dhcpv6_established--;
             }
-            if(session->dhcpv6_requested) {
+            if(session->cold->dhcpv6_requested) {
                 ctx->dhcpv6_requested--;
             }
         } else if(state == BBL_ESTABLISHED) {
@@ -119,27 +120,27 @@ bbl_session_update_state(bbl_ctx_s *ctx, bbl_session_s *session, session_state_t
         }
         if(state == BBL_TERMINATED) {
             /* Stop all session tiemrs */
-            timer_del(session->timer_arp);
-            timer_del(session->timer_padi);
-            timer_del(session->timer_padr);
-            timer_del(session->timer_lcp);
-            timer_del(session->timer_lcp_echo);
-            timer_del(session->timer_auth);
-            timer_del(session->timer_ipcp);
-            timer_del(session->timer_ip6cp);
-            timer_del(session->timer_dhcpv6);
-            timer_del(session->timer_igmp);
-            timer_del(session->timer_zapping);
-            timer_del(session->timer_icmpv6);
-            timer_del(session->timer_session);
-            timer_del(session->timer_session_traffic_ipv4);
-            timer_del(session->timer_session_traffic_ipv6);
-            timer_del(session->timer_session_traffic_ipv6pd);
+            timer_del(session->cold->timer_arp);
+            timer_del(session->cold->timer_padi);
+            timer_del(session->cold->timer_padr);
+            timer_del(session->cold->timer_lcp);
+            timer_del(session->cold->timer_lcp_echo);
+            timer_del(session->cold->timer_auth);
+            timer_del(session->cold->timer_ipcp);
+            timer_del(session->cold->timer_ip6cp);
+            timer_del(session->cold->timer_dhcpv6);
+            timer_del(session->cold->timer_igmp);
+            timer_del(session->cold->timer_zapping);
+            timer_del(session->cold->timer_icmpv6);
+            timer_del(session->cold->timer_session);
+            /* Session traffic flows are removed from the
+             * traffic calendar with their next send attempt. */
 
             /* Reset all states */
             session->lcp_state = BBL_PPP_CLOSED;
             session->ipcp_state = BBL_PPP_CLOSED;
             session->ip6cp_state = BBL_PPP_CLOSED;
+            bbl_tx_template_reset(session);
 
             /* Increment sessions terminated if new state is terminated. */
             if(g_teardown) {
@@ -148,41 +149,41 @@ bbl_session_update_state(bbl_ctx_s *ctx, bbl_session_s *session, session_state_t
                 if(session->access_type == ACCESS_TYPE_PPPOE) {
                     if(ctx->config.pppoe_reconnect) {
                         state = BBL_IDLE;
-                        CIRCLEQ_INSERT_TAIL(&ctx->sessions_idle_qhead, session, session_idle_qnode);
+                        CIRCLEQ_INSERT_TAIL(&ctx->sessions_idle_qhead, session->cold, session_idle_qnode);
                         memset(&session->server_mac, 0xff, ETH_ADDR_LEN); // init with broadcast MAC
                         session->pppoe_session_id = 0;
-                        if(session->pppoe_ac_cookie) {
-                            free(session->pppoe_ac_cookie);
-                            session->pppoe_ac_cookie = NULL;
+                        if(session->cold->pppoe_ac_cookie) {
+                            free(session->cold->pppoe_ac_cookie);
+                            session->cold->pppoe_ac_cookie = NULL;
                         }
-                        session->pppoe_ac_cookie_len = 0;
+                        session->cold->pppoe_ac_cookie_len = 0;
                         if(!session->interface->ctx->config.pppoe_service_name) {
-                            if(session->pppoe_service_name) {
-                                free(session->pppoe_service_name);
-                                session->pppoe_service_name = NULL;
+                            if(session->cold->pppoe_service_name) {
+                                free(session->cold->pppoe_service_name);
+                                session->cold->pppoe_service_name = NULL;
                             }
-                            session->pppoe_service_name_len = 0;
+                            session->cold->pppoe_service_name_len = 0;
                         }
                         session->ip_address = 0;
                         session->peer_ip_address = 0;
-                        session->dns1 = 0;
-                        session->dns2 = 0;
+                        session->cold->dns1 = 0;
+                        session->cold->dns2 = 0;
                         session->ipv6_prefix.len = 0;
                         session->delegated_ipv6_prefix.len = 0;
                         session->icmpv6_ra_received = false;
-                        memset(session->ipv6_dns1, 0x0, IPV6_ADDR_LEN);
-                        memset(session->ipv6_dns2, 0x0, IPV6_ADDR_LEN);
-                        session->dhcpv6_requested = false;
-                        session->dhcpv6_received = false;
-                        session->dhcpv6_type = DHCPV6_MESSAGE_SOLICIT;
-                        session->dhcpv6_ia_pd_option_len = 0;
-                        memset(session->dhcpv6_dns1, 0x0, IPV6_ADDR_LEN);
-                        memset(session->dhcpv6_dns2, 0x0, IPV6_ADDR_LEN);
-                        session->zapping_joined_group = NULL;
-                        session->zapping_leaved_group = NULL;
-                        session->zapping_count = 0;
-                        session->zapping_view_start_time.tv_sec = 0;
-                        session->zapping_view_start_time.tv_nsec = 0;
+                        memset(session->cold->ipv6_dns1, 0x0, IPV6_ADDR_LEN);
+                        memset(session->cold->ipv6_dns2, 0x0, IPV6_ADDR_LEN);
+                        session->cold->dhcpv6_requested = false;
+                        session->cold->dhcpv6_received = false;
+                        session->cold->dhcpv6_type = DHCPV6_MESSAGE_SOLICIT;
+                        session->cold->dhcpv6_ia_pd_option_len = 0;
+                        memset(session->cold->dhcpv6_dns1, 0x0, IPV6_ADDR_LEN);
+                        memset(session->cold->dhcpv6_dns2, 0x0, IPV6_ADDR_LEN);
+                        session->cold->zapping_joined_group = NULL;
+                        session->cold->zapping_leaved_group = NULL;
+                        session->cold->zapping_count = 0;
+                        session->cold->zapping_view_start_time.tv_sec = 0;
+                        session->cold->zapping_view_start_time.tv_nsec = 0;
                         session->stats.flapped++;
                         ctx->sessions_flapped++;
                     } else {
@@ -195,81 +196,296 @@ bbl_session_update_state(bbl_ctx_s *ctx, bbl_session_s *session, session_state_t
             }
         }
         session->session_state = state;
+        bbl_session_io_update(ctx, session);
     }
 }
 
-bool
-bbl_add_multicast_packets (bbl_ctx_s *ctx, bbl_interface_s *interface)
+/*
+ * Pass the session state to the data plane of the I/O threads,
+ * called with every change of the session, its NCP states,
+ * addresses or traffic templates (control thread). Only state
+ * changes are sent to the I/O threads.
+ */
+void
+bbl_session_io_update(bbl_ctx_s *ctx, bbl_session_s *session)
 {
-    bbl_ethernet_header_t eth = {0};
-    bbl_ipv4_t ip = {0};
-    bbl_udp_t udp = {0};
-    bbl_bbl_t bbl = {0};
-    uint8_t mac[ETH_ADDR_LEN] = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0x00 };
-    uint8_t *buf;
+    __atomic_store_n(&session->io_rx_active,
+                     session->session_state != BBL_IDLE && session->session_state != BBL_TERMINATED,
+                     __ATOMIC_RELAXED);
+    bbl_session_traffic_io_update(ctx, session);
+    bbl_stream_io_update(ctx, session);
+}
 
-    uint32_t group;
-    uint32_t source;
+void
+bbl_session_io_update_all(bbl_ctx_s *ctx)
+{
+    struct dict_itor *itor;
+    bbl_session_s *session;
+
+    itor = dict_itor_new(ctx->session_dict.dict);
+    dict_itor_first(itor);
+    for (; dict_itor_valid(itor); dict_itor_next(itor)) {
+        session = (bbl_session_s*)*dict_itor_datum(itor);
+        if(session) {
+            bbl_session_io_update(ctx, session);
+        }
+    }
+    dict_itor_free(itor);
+}
+
+/*
+ * Compute the TPACKET_V2 ring geometry for the requested number of frames.
+ * Frames must not cross block boundaries, therefore the default block size
+ * is the smallest multiple of the page size which is also a multiple of the
+ * frame size. The frame count is rounded up to fill the last block.
+ */
+static void
+bbl_interface_ring_geometry (struct tpacket_req *req, bbl_interface_config_s *interface_config, uint32_t frames)
+{
+    uint32_t page_size = sysconf(_SC_PAGESIZE);
+    uint32_t frames_per_block;
+
+    req->tp_frame_size = interface_config->frame_size;
+    req->tp_block_size = interface_config->block_size;
+    if(!req->tp_block_size) {
+        req->tp_block_size = page_size;
+        while(req->tp_block_size % req->tp_frame_size) {
+            req->tp_block_size += page_size;
+        }
+    }
+    frames_per_block = req->tp_block_size / req->tp_frame_size;
+    req->tp_block_nr = (frames + frames_per_block - 1) / frames_per_block;
+    req->tp_frame_nr = req->tp_block_nr * frames_per_block;
+}
+
+/*
+ * Map a TX or RX ring into user space. Locked rings are populated
+ * and pinned upfront, such that the first packets do not take page
+ * faults and the ring is never swapped out.
+ */
+static u_char *
+bbl_interface_ring_mmap (bbl_interface_s *interface, int fd, size_t ring_size, bool locked)
+{
+    u_char *ring;
+    int flags = MAP_SHARED;
+
+    if(locked) {
+        flags |= MAP_LOCKED|MAP_POPULATE;
+    }
+    ring = mmap(0, ring_size, PROT_READ|PROT_WRITE, flags, fd, 0);
+    if(ring == MAP_FAILED) {
+        LOG(ERROR, "Mapping ringbuffer with %lu bytes error %s (%d) for interface %s%s\n",
+            ring_size, strerror(errno), errno, interface->name,
+            (locked && errno == EAGAIN) ? " (check RLIMIT_MEMLOCK)" : "");
+        return NULL;
+    }
+    return ring;
+}
+
+/*
+ * Setup the TX socket and ringbuffer of the data plane served by the
+ * I/O thread of the first RX ring, see bbl_io_data.c. The socket is
+ * bound to protocol 0, such that it does not receive any packets.
+ */
+static bool
+bbl_interface_data_tx (bbl_ctx_s *ctx, bbl_interface_s *interface, bbl_interface_config_s *interface_config)
+{
+    bbl_io_thread_s *io_thread = interface->io_thread;
+    struct sockaddr_ll addr = interface->addr;
+    size_t ring_size;
+    int version = TPACKET_V2;
+    int qdisc_bypass = 1;
+
+    io_thread->data.fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (io_thread->data.fd == -1) {
+        LOG(ERROR, "socket() data TX error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+    if ((setsockopt(io_thread->data.fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version))) == -1) {
+        LOG(ERROR, "setsockopt() data TX error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+    addr.sll_protocol = 0;
+    if (bind(io_thread->data.fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        LOG(ERROR, "bind() data TX error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+    if(ctx->config.qdisc_bypass) {
+        if (setsockopt(io_thread->data.fd, SOL_PACKET, PACKET_QDISC_BYPASS, &qdisc_bypass, sizeof(qdisc_bypass)) == -1) {
+            LOG(ERROR, "Setting qdisc bypass error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+            return false;
+        }
+    }
+    bbl_interface_ring_geometry(&io_thread->data.req, interface_config, interface_config->tx_frames);
+    if (setsockopt(io_thread->data.fd, SOL_PACKET, PACKET_TX_RING, &io_thread->data.req, sizeof(io_thread->data.req)) == -1) {
+        LOG(ERROR, "Allocating data TX ringbuffer error %s (%d) for interface %s\n",
+            strerror(errno), errno, interface->name);
+        return false;
+    }
+    ring_size = io_thread->data.req.tp_block_nr * io_thread->data.req.tp_block_size;
+    io_thread->data.ring = bbl_interface_ring_mmap(interface, io_thread->data.fd, ring_size, interface_config->ring_locked);
+    if(!io_thread->data.ring) {
+        return false;
+    }
+    io_thread->data.flush_threshold = interface->tx_flush_threshold;
+    return true;
+}
+
+#define BBL_PHC_CLOCKID(fd)     ((~(clockid_t)(fd) << 3) | 3)
+#define BBL_PHC_SYNC_SAMPLES    5
+
+/*
+ * Open the PTP hardware clock (PHC) of the NIC, which is the clock
+ * of the raw hardware timestamps. Returns -1 if there is none.
+ */
+static int
+bbl_interface_phc_open (bbl_interface_s *interface)
+{
+    struct ethtool_ts_info ts_info;
+    struct ifreq ifr;
+    char phc_name[32];
 
+    memset(&ts_info, 0, sizeof(ts_info));
+    ts_info.cmd = ETHTOOL_GET_TS_INFO;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface->name);
+    ifr.ifr_data = (void*)&ts_info;
+    if (ioctl(interface->fd_tx, SIOCETHTOOL, &ifr) == -1 || ts_info.phc_index < 0) {
+        return -1;
+    }
+    snprintf(phc_name, sizeof(phc_name), "/dev/ptp%d", ts_info.phc_index);
+    return open(phc_name, O_RDONLY);
+}
+
+/*
+ * Measure the offset between CLOCK_REALTIME and the PHC. The PHC is read
+ * between two realtime readings, the sample with the shortest window wins.
+ */
+static bool
+bbl_interface_phc_sync (bbl_interface_s *interface)
+{
+    struct timespec before, phc, after;
+    int64_t window, best_window = INT64_MAX;
+    int64_t offset = 0;
     int i;
-    uint16_t len = 0;
 
-    if(ctx->config.send_multicast_traffic && ctx->config.igmp_group_count) {
-        interface->mc_packets = malloc(ctx->config.igmp_group_count * 1500);
-        buf = interface->mc_packets;
+    for(i = 0; i < BBL_PHC_SYNC_SAMPLES; i++) {
+        clock_gettime(CLOCK_REALTIME, &before);
+        if(clock_gettime(BBL_PHC_CLOCKID(interface->phc_fd), &phc) == -1) {
+            return false;
+        }
+        clock_gettime(CLOCK_REALTIME, &after);
+        window = (after.tv_sec - before.tv_sec) * 1000000000LL + (after.tv_nsec - before.tv_nsec);
+        if(window < best_window) {
+            best_window = window;
+            offset = (before.tv_sec - phc.tv_sec) * 1000000000LL + (before.tv_nsec - phc.tv_nsec) + window / 2;
+        }
+    }
+    __atomic_store_n(&interface->phc_offset, offset, __ATOMIC_RELAXED);
+    return true;
+}
 
-        for(i = 0; i < ctx->config.igmp_group_count; i++) {
-            len = 0;
-            bbl.flow_id = ctx->flow_id++;
+/*
+ * Follow the drift between CLOCK_REALTIME and the PHC.
+ */
+static void
+bbl_interface_phc_job (timer_s *timer)
+{
+    bbl_interface_s *interface = timer->data;
 
-            group = be32toh(ctx->config.igmp_group) + i * be32toh(ctx->config.igmp_group_iter);
-            if(ctx->config.igmp_source) {
-                source = ctx->config.igmp_source;
-            } else {
-                source = interface->ip;
-            }
-            /* Generate destination MAC */
-            *(uint32_t*)&mac[2] = group & 0x7FDDDF; mac[2] = 0x5e;
-
-            eth.src = interface->mac;
-            eth.dst = mac;
-            eth.vlan_outer = ctx->config.network_vlan;
-            eth.type = ETH_TYPE_IPV4;
-            eth.next = &ip;
-            ip.src = source;
-            ip.dst = htobe32(group);
-            ip.ttl = 64;
-            ip.protocol = PROTOCOL_IPV4_UDP;
-            ip.next = &udp;
-            udp.src = BBL_UDP_PORT;
-            udp.dst = BBL_UDP_PORT;
-            udp.protocol = UDP_PROTOCOL_BBL;
-            udp.next = &bbl;
-            bbl.type = BBL_TYPE_MULTICAST;
-            bbl.direction = BBL_DIRECTION_DOWN;
-            bbl.mc_source = ip.src;
-            bbl.mc_group = ip.dst ;
-            if(encode_ethernet(buf, &len, &eth) != PROTOCOL_SUCCESS) {
-                return false;
+    if(!bbl_interface_phc_sync(interface)) {
+        LOG(ERROR, "Reading PTP hardware clock error %s (%d) for interface %s\n",
+            strerror(errno), errno, interface->name);
+    }
+}
+
+/*
+ * Enable kernel or hardware timestamps (SO_TIMESTAMPING) for the RX and TX
+ * rings. The kernel stores the timestamps in tp_sec/tp_nsec of the ring frames,
+ * for TX frames after completion together with a TP_STATUS_TS_* flag.
+ * Failures are not fatal, the interface keeps the default timestamps.
+ */
+static void
+bbl_interface_timestamping (bbl_interface_s *interface, bbl_interface_config_s *interface_config)
+{
+    struct hwtstamp_config hwconfig;
+    struct ifreq ifr;
+    bbl_timestamping_t timestamping = interface_config->timestamping;
+    int flags, source;
+    uint8_t i;
+
+    if(timestamping == BBL_TIMESTAMPING_HARDWARE) {
+        memset(&hwconfig, 0, sizeof(hwconfig));
+        hwconfig.tx_type = HWTSTAMP_TX_ON;
+        hwconfig.rx_filter = HWTSTAMP_FILTER_ALL;
+        memset(&ifr, 0, sizeof(ifr));
+        snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface->name);
+        ifr.ifr_data = (void*)&hwconfig;
+        if (ioctl(interface->fd_tx, SIOCSHWTSTAMP, &ifr) == -1) {
+            LOG(ERROR, "Enabling hardware timestamps error %s (%d) for interface %s, using software timestamps\n",
+                strerror(errno), errno, interface->name);
+            timestamping = BBL_TIMESTAMPING_SOFTWARE;
+        }
+    }
+    if(timestamping == BBL_TIMESTAMPING_HARDWARE) {
+        /* Raw hardware timestamps are taken from the PHC, which
+         * is translated into CLOCK_REALTIME for latency. */
+        interface->phc_fd = bbl_interface_phc_open(interface);
+        if(interface->phc_fd == -1 || !bbl_interface_phc_sync(interface)) {
+            LOG(ERROR, "No PTP hardware clock for interface %s, using software timestamps\n", interface->name);
+            if(interface->phc_fd != -1) {
+                close(interface->phc_fd);
+                interface->phc_fd = -1;
             }
-            buf = buf + len;
+            timestamping = BBL_TIMESTAMPING_SOFTWARE;
         }
     }
-    interface->mc_packet_len = len;
-    return true;
+
+    if(timestamping == BBL_TIMESTAMPING_HARDWARE) {
+        flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        source = SOF_TIMESTAMPING_RAW_HARDWARE;
+    } else {
+        flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        source = SOF_TIMESTAMPING_SOFTWARE;
+    }
+
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        if (setsockopt(interface->rx_ring[i].fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == -1 ||
+            setsockopt(interface->rx_ring[i].fd, SOL_PACKET, PACKET_TIMESTAMP, &source, sizeof(source)) == -1) {
+            LOG(ERROR, "Enabling RX timestamps error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+            return;
+        }
+    }
+    if (setsockopt(interface->fd_tx, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == -1 ||
+        setsockopt(interface->fd_tx, SOL_PACKET, PACKET_TIMESTAMP, &source, sizeof(source)) == -1) {
+        LOG(ERROR, "Enabling TX timestamps error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return;
+    }
+
+    interface->tx_slot_timestamp = calloc(interface->req_tx.tp_frame_nr, sizeof(uint64_t));
+    if(!interface->tx_slot_timestamp) {
+        return;
+    }
+    interface->timestamping = timestamping;
+    LOG(NORMAL, "Enabled %s timestamps for interface %s\n",
+        timestamping == BBL_TIMESTAMPING_HARDWARE ? "hardware" : "software", interface->name);
 }
 
 /*
  * Allocate an interface and setup Tx and Rx rings.
  */
 bbl_interface_s *
-bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
+bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, bbl_interface_config_s *interface_config)
 {
     bbl_interface_s *interface;
+    bbl_rx_ring_s *rx_ring;
     char timer_name[16];
     struct ifreq ifr;
     size_t ring_size;
-    int version, qdisc_bypass;
+    socklen_t ring_req_len;
+    int version, qdisc_bypass, fanout_arg;
+    uint tx_slots;
+    uint8_t i;
 
     interface = calloc(1, sizeof(bbl_interface_s));
     if (!interface) {
@@ -278,6 +494,21 @@ bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
     }
 
     interface->name = strdup(interface_name);
+    interface->phc_fd = -1;
+    interface->io_mode = interface_config->io_mode;
+    if(interface->io_mode == BBL_IO_AF_XDP) {
+        /* The AF_PACKET socket is used for interface ioctls only. */
+        interface->io_ops = &bbl_io_xdp_ops;
+        interface->rx_ring_count = 0;
+    } else {
+        interface->io_ops = &bbl_io_packet_mmap_ops;
+        interface->rx_ring_count = interface_config->fanout;
+        if(interface->rx_ring_count < 1) {
+            interface->rx_ring_count = 1;
+        } else if(interface->rx_ring_count > BBL_MAX_FANOUT) {
+            interface->rx_ring_count = BBL_MAX_FANOUT;
+        }
+    }
 
     /*
      * Open RAW socket for all Ethertypes.
@@ -289,14 +520,24 @@ bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
         return NULL;
     }
 
-    interface->fd_rx = socket(AF_PACKET, SOCK_RAW, htobe16(ETH_P_ALL));
-    if (interface->fd_rx == -1) {
-        LOG(ERROR, "socket() RX error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
-        return NULL;
+    /*
+     * Open one RX socket per RX ring.
+     */
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        rx_ring = &interface->rx_ring[i];
+        rx_ring->interface = interface;
+        rx_ring->id = i;
+        rx_ring->fd = socket(AF_PACKET, SOCK_RAW, htobe16(ETH_P_ALL));
+        if (rx_ring->fd == -1) {
+            LOG(ERROR, "socket() RX error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+            return NULL;
+        }
     }
 
     /*
      * Use API version 2 which is good enough for what we're doing.
+     * The RX ring can optionally use API version 3 which hands over
+     * whole blocks of packets to user space instead of single frames.
      */
     version = TPACKET_V2;
     if ((setsockopt(interface->fd_tx, SOL_PACKET, PACKET_VERSION, &version, sizeof(version))) == -1) {
@@ -304,9 +545,16 @@ bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
         return NULL;
     }
 
-    if ((setsockopt(interface->fd_rx, SOL_PACKET, PACKET_VERSION, &version, sizeof(version))) == -1) {
-        LOG(ERROR, "setsockopt() RX error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
-        return NULL;
+    if(ctx->config.rx_tpacket_v3 && interface->io_mode == BBL_IO_PACKET_MMAP) {
+        interface->rx_tpacket_v3 = true;
+        interface->io_ops = &bbl_io_packet_mmap_v3_ops;
+        version = TPACKET_V3;
+    }
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        if ((setsockopt(interface->rx_ring[i].fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version))) == -1) {
+            LOG(ERROR, "setsockopt() RX error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+            return NULL;
+        }
     }
 
     /*
@@ -330,10 +578,38 @@ bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
         return NULL;
     }
 
-    if (bind(interface->fd_rx, (struct sockaddr*)&interface->addr, sizeof(interface->addr)) == -1) {
-        LOG(ERROR, "bind() RX error %s (%d) for interface %s\n",
-        strerror(errno), errno, interface->name);
-        return NULL;
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        if (bind(interface->rx_ring[i].fd, (struct sockaddr*)&interface->addr, sizeof(interface->addr)) == -1) {
+            LOG(ERROR, "bind() RX error %s (%d) for interface %s\n",
+            strerror(errno), errno, interface->name);
+            return NULL;
+        }
+    }
+
+    /*
+     * Join all RX sockets to a PACKET_FANOUT group such that the kernel
+     * spreads received packets over all RX rings. The group ID must be
+     * unique per interface. Rollover is not used as this would move the
+     * packets of a flow to another RX ring and reorder them.
+     */
+    if(interface->rx_ring_count > 1) {
+        fanout_arg = ((getpid() ^ ifr.ifr_ifindex) & 0xffff) | (interface_config->fanout_type << 16);
+        for(i = 0; i < interface->rx_ring_count; i++) {
+            if (setsockopt(interface->rx_ring[i].fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) == -1) {
+                LOG(ERROR, "Setting fanout error %s (%d) for interface %s\n",
+                strerror(errno), errno, interface->name);
+                return NULL;
+            }
+        }
+    }
+
+    /*
+     * Let the kernel busy poll the device queue for the RX sockets.
+     */
+    if(ctx->config.busy_poll) {
+        for(i = 0; i < interface->rx_ring_count; i++) {
+            bbl_event_busy_poll_socket(ctx, interface->rx_ring[i].fd, interface->name);
+        }
     }
 
     /*
@@ -341,7 +617,7 @@ bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
      */
     memset(&ifr, 0, sizeof(ifr));
     snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface_name);
-    if (ioctl(interface->fd_rx, SIOCGIFHWADDR, &ifr) == -1) {
+    if (ioctl(interface->fd_tx, SIOCGIFHWADDR, &ifr) == -1) {
         LOG(ERROR, "Getting MAC address error %s (%d) for interface %s\n",
         strerror(errno), errno, interface->name);
         return NULL;
@@ -352,18 +628,18 @@ bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
 	interface->mac[3], interface->mac[4], interface->mac[5], interface->name);
 
     /*
-     * Set the interface to promiscuous mode. Only for the RX FD.
+     * Set the interface to promiscuous mode.
      */
     memset(&ifr, 0, sizeof(ifr));
     snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface_name);
-    if (ioctl(interface->fd_rx, SIOCGIFFLAGS, &ifr) == -1) {
+    if (ioctl(interface->fd_tx, SIOCGIFFLAGS, &ifr) == -1) {
         LOG(ERROR, "Getting socket flags error %s (%d) when setting promiscuous mode for interface %s\n",
         strerror(errno), errno, interface->name);
         return NULL;
     }
 
     ifr.ifr_flags |= IFF_PROMISC;
-    if (ioctl(interface->fd_rx, SIOCSIFFLAGS, ifr) == -1){
+    if (ioctl(interface->fd_tx, SIOCSIFFLAGS, ifr) == -1){
         LOG(ERROR, "Setting socket flags error %s (%d) when setting promiscuous mode for interface %s\n",
         strerror(errno), errno, interface->name);
         return NULL;
@@ -392,62 +668,172 @@ bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
         }
     }
 
+    if(interface->io_mode == BBL_IO_AF_XDP) {
+        /*
+         * Setup AF_XDP socket with UMEM and rings.
+         */
+        if(!bbl_xdp_add(ctx, interface, interface_config)) {
+            return NULL;
+        }
+    } else {
+        /*
+         * Setup TX ringbuffer.
+         */
+        memset(&interface->req_tx, 0, sizeof(interface->req_tx));
+        bbl_interface_ring_geometry(&interface->req_tx, interface_config, interface_config->tx_frames);
+        if (setsockopt(interface->fd_tx, SOL_PACKET, PACKET_TX_RING, &interface->req_tx, sizeof(interface->req_tx)) == -1) {
+            LOG(ERROR, "Allocating TX ringbuffer error %s (%d) for interface %s\n",
+            strerror(errno), errno, interface->name);
+            return NULL;
+        }
+
+        /*
+         * Open the shared memory TX window between kernel and userspace.
+         */
+        ring_size = interface->req_tx.tp_block_nr * interface->req_tx.tp_block_size;
+        interface->ring_tx = bbl_interface_ring_mmap(interface, interface->fd_tx, ring_size, interface_config->ring_locked);
+        if(!interface->ring_tx) {
+            return NULL;
+        }
+    }
+
     /*
-     * Setup TX ringbuffer.
+     * Kick the kernel early once a quarter of the TX ring is pending
+     * instead of waiting for the end of the TX job.
      */
-    memset(&interface->req_tx, 0, sizeof(interface->req_tx));
-    interface->req_tx.tp_block_size = sysconf(_SC_PAGESIZE); /* 4096 */
-    interface->req_tx.tp_frame_size = interface->req_tx.tp_block_size/2; /* 2048 */
-    interface->req_tx.tp_block_nr = slots/2;
-    interface->req_tx.tp_frame_nr = slots;
-    if (setsockopt(interface->fd_tx, SOL_PACKET, PACKET_TX_RING, &interface->req_tx, sizeof(interface->req_tx)) == -1) {
-        LOG(ERROR, "Allocating TX ringbuffer error %s (%d) for interface %s\n",
-        strerror(errno), errno, interface->name);
-        return NULL;
+    if(interface->io_mode == BBL_IO_AF_XDP) {
+        tx_slots = BBL_XDP_RING_SIZE;
+    } else {
+        tx_slots = interface->req_tx.tp_frame_nr;
+    }
+    interface->tx_flush_threshold = ctx->config.tx_flush_threshold;
+    if(!interface->tx_flush_threshold) {
+        interface->tx_flush_threshold = tx_slots / 4;
     }
 
     /*
-     * Open the shared memory TX window between kernel and userspace.
+     * Share of TX ring slots each TX class may fill per TX job.
      */
-    ring_size = interface->req_tx.tp_block_nr * interface->req_tx.tp_block_size;
-    interface->ring_tx = mmap(0, ring_size, PROT_READ|PROT_WRITE, MAP_SHARED, interface->fd_tx, 0);
+    for(i = 0; i < BBL_TX_CLASS_MAX; i++) {
+        interface->tx_class_slots[i] = (tx_slots * ctx->config.tx_share[i]) / 100;
+        if(!interface->tx_class_slots[i]) {
+            interface->tx_class_slots[i] = 1;
+        }
+    }
 
     /*
-     * Setup RX ringbuffer. Double the slots, such that we do not miss any packets.
+     * Setup RX ringbuffer.
      */
-    slots <<= 1;
-    memset(&interface->req_rx, 0, sizeof(interface->req_rx));
-    interface->req_rx.tp_block_size = sysconf(_SC_PAGESIZE); /* 4096 */
-    interface->req_rx.tp_frame_size = interface->req_rx.tp_block_size/2; /* 2048 */
-    interface->req_rx.tp_block_nr = slots/2;
-    interface->req_rx.tp_frame_nr = slots;
-    if (setsockopt(interface->fd_rx, SOL_PACKET, PACKET_RX_RING, &interface->req_rx, sizeof(interface->req_rx)) == -1) {
-        LOG(ERROR, "Allocating RX ringbuffer error %s (%d) for interface %s\n",
-        strerror(errno), errno, interface->name);
-        return NULL;
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        rx_ring = &interface->rx_ring[i];
+        memset(&rx_ring->req, 0, sizeof(rx_ring->req));
+        if(interface->rx_tpacket_v3) {
+            /*
+             * TPACKET_V3 blocks are filled with variable sized frames and
+             * handed over to user space if full or if the retire timeout
+             * has expired. The ring has the same size as with TPACKET_V2.
+             */
+            rx_ring->req.tp_block_size = interface_config->block_size;
+            if(!rx_ring->req.tp_block_size) {
+                rx_ring->req.tp_block_size = ctx->config.rx_block_size;
+            }
+            rx_ring->req.tp_frame_size = interface_config->frame_size;
+            rx_ring->req.tp_block_nr = (interface_config->rx_frames * rx_ring->req.tp_frame_size) / rx_ring->req.tp_block_size;
+            if(rx_ring->req.tp_block_nr < 2) {
+                rx_ring->req.tp_block_nr = 2;
+            }
+            rx_ring->req.tp_frame_nr = (rx_ring->req.tp_block_size / rx_ring->req.tp_frame_size) *
+                                       rx_ring->req.tp_block_nr;
+            rx_ring->req.tp_retire_blk_tov = ctx->config.rx_block_timeout;
+            if(!rx_ring->req.tp_retire_blk_tov) {
+                rx_ring->req.tp_retire_blk_tov = ctx->config.rx_interval;
+            }
+            ring_req_len = sizeof(struct tpacket_req3);
+        } else {
+            bbl_interface_ring_geometry((struct tpacket_req*)&rx_ring->req, interface_config, interface_config->rx_frames);
+            ring_req_len = sizeof(struct tpacket_req);
+        }
+        if (setsockopt(rx_ring->fd, SOL_PACKET, PACKET_RX_RING, &rx_ring->req, ring_req_len) == -1) {
+            LOG(ERROR, "Allocating RX ringbuffer error %s (%d) for interface %s\n",
+            strerror(errno), errno, interface->name);
+            return NULL;
+        }
+
+        /*
+         * Open the shared memory RX window between kernel and userspace.
+         */
+        ring_size = rx_ring->req.tp_block_nr * rx_ring->req.tp_block_size;
+        rx_ring->ring = bbl_interface_ring_mmap(interface, rx_ring->fd, ring_size, interface_config->ring_locked);
+        if(!rx_ring->ring) {
+            return NULL;
+        }
+    }
+
+    if(interface_config->timestamping) {
+        bbl_interface_timestamping(interface, interface_config);
+    }
+
+    if(interface->io_mode == BBL_IO_AF_XDP) {
+        LOG(NORMAL, "Add interface %s (AF_XDP %s mode queue %u)\n", interface->name,
+            interface_config->xdp_native ? "native" : "skb", interface_config->xdp_queue);
+    } else if(interface->rx_tpacket_v3) {
+        LOG(NORMAL, "Add interface %s (%u TPACKET_V3 RX rings with %u blocks of %u bytes)\n", interface->name,
+            interface->rx_ring_count, interface->rx_ring[0].req.tp_block_nr, interface->rx_ring[0].req.tp_block_size);
+    } else {
+        LOG(NORMAL, "Add interface %s (%u RX rings with %u frames of %u bytes)\n", interface->name,
+            interface->rx_ring_count, interface->rx_ring[0].req.tp_frame_nr, interface->rx_ring[0].req.tp_frame_size);
     }
 
     /*
-     * Open the shared memory RX window between kernel and userspace.
+     * Serve the ringbuffers by I/O threads, one per RX ring. Those
+     * are always used with fanout as otherwise all RX rings would
+     * be served sequentially by the main thread.
      */
-    ring_size = interface->req_rx.tp_block_nr * interface->req_rx.tp_block_size;
-    interface->ring_rx = mmap(0, ring_size, PROT_READ|PROT_WRITE, MAP_SHARED, interface->fd_rx, 0);
-
-    LOG(NORMAL, "Add interface %s\n", interface->name);
+    if((ctx->config.io_threads || interface->rx_ring_count > 1) && interface->io_mode == BBL_IO_PACKET_MMAP) {
+        /*
+         * The I/O threads also serve the data plane unless BBL traffic
+         * must be captured or may be received by multiple RX rings.
+         */
+        interface->io_data = ctx->config.rx_fast_path &&
+                             !(ctx->pcap.filename && (ctx->config.pcap_traffic & PCAPNG_TRAFFIC_BBL)) &&
+                             (interface->rx_ring_count == 1 || interface_config->fanout_type == PACKET_FANOUT_HASH);
+        if(!bbl_io_thread_add(ctx, interface, interface_config->io_cpu)) {
+            LOG(ERROR, "Failed to add I/O threads for interface %s\n", interface->name);
+            return NULL;
+        }
+        if(interface->io_data && !bbl_interface_data_tx(ctx, interface, interface_config)) {
+            return NULL;
+        }
+    }
 
     /*
      * Add an periodic timer for polling I/O.
      */
     snprintf(timer_name, sizeof(timer_name), "%s TX", interface_name);
     timer_add_periodic(&ctx->timer_root, &interface->tx_job, timer_name, 0, ctx->config.tx_interval * MSEC, interface, bbl_tx_job);
-    snprintf(timer_name, sizeof(timer_name), "%s RX", interface_name);
-    timer_add_periodic(&ctx->timer_root, &interface->rx_job, timer_name, 0, ctx->config.rx_interval * MSEC, interface, bbl_rx_job);
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        if(ctx->event_loop && !interface->io_thread) {
+            /* RX ring is served as soon as it becomes readable. */
+            if(!bbl_event_add(ctx, &interface->rx_ring[i].rx_event, interface->rx_ring[i].fd,
+                              bbl_rx_event, bbl_rx_poll, &interface->rx_ring[i])) {
+                return NULL;
+            }
+            continue;
+        }
+        snprintf(timer_name, sizeof(timer_name), "%s RX%u", interface_name, i);
+        timer_add_periodic(&ctx->timer_root, &interface->rx_ring[i].rx_job, timer_name, 0, ctx->config.rx_interval * MSEC,
+                           &interface->rx_ring[i], bbl_rx_job);
+    }
 
     /*
      * Timer to compute periodic rates.
      */
     timer_add_periodic(&ctx->timer_root, &interface->rate_job, "Rate Computation", 1, 0, interface,
 		               bbl_compute_interface_rate_job);
+    if(interface->timestamping == BBL_TIMESTAMPING_HARDWARE) {
+        timer_add_periodic(&ctx->timer_root, &interface->phc_job, "PHC Sync", 1, 0, interface,
+                           bbl_interface_phc_job);
+    }
 
     /*
      * Add to context interface list.
@@ -462,6 +848,7 @@ bbl_add_interface (bbl_ctx_s *ctx, char *interface_name, int slots)
      * List for sessions who want to transmit.
      */
     CIRCLEQ_INIT(&interface->session_tx_qhead);
+    CIRCLEQ_INIT(&interface->session_keepalive_qhead);
     CIRCLEQ_INIT(&interface->l2tp_tx_qhead);
     return interface;
 }
@@ -482,7 +869,7 @@ bbl_add_access_interfaces (bbl_ctx_s *ctx) {
                 }
             }
         }
-        access_if = bbl_add_interface(ctx, access_config->interface, 1024);
+        access_if = bbl_add_interface(ctx, access_config->interface, &access_config->interface_config);
         if (!access_if) {
             LOG(ERROR, "Failed to add access interface %s\n", access_config->interface);
             return false;
@@ -490,6 +877,9 @@ bbl_add_access_interfaces (bbl_ctx_s *ctx) {
         access_if->access = true;
         access_config->access_if = access_if;
         ctx->op.access_if[ctx->op.access_if_count++] = access_if;
+        if(!ctx->op.access_if_map[access_if->addr.sll_ifindex & (BBL_ACCESS_IF_MAP-1)]) {
+            ctx->op.access_if_map[access_if->addr.sll_ifindex & (BBL_ACCESS_IF_MAP-1)] = access_if;
+        }
 Next:
         access_config = access_config->next;
     }
@@ -566,28 +956,9 @@ bbl_print_usage (void)
  * Called by hashtable destructor.
  */
 void
-bbl_free_session (void *key __attribute__((unused)), void *s)
+bbl_free_session (void *key __attribute__((unused)), void *s __attribute__((unused)))
 {
-    bbl_session_s *session = s; 
-    if(session->access_ipv4_tx_packet_template) {
-        free(session->access_ipv4_tx_packet_template);
-    }
-    if(session->network_ipv4_tx_packet_template) {
-        free(session->network_ipv4_tx_packet_template);
-    }
-    if(session->access_ipv6_tx_packet_template) {
-        free(session->access_ipv6_tx_packet_template);
-    }
-    if(session->network_ipv6_tx_packet_template) {
-        free(session->network_ipv6_tx_packet_template);
-    }
-    if(session->access_ipv6pd_tx_packet_template) {
-        free(session->access_ipv6pd_tx_packet_template);
-    }
-    if(session->network_ipv6pd_tx_packet_template) {
-        free(session->network_ipv6pd_tx_packet_template);
-    }
-    free(session);
+    /* Session, traffic and control packet templates are freed with the arenas. */
 }
 #endif
 
@@ -613,21 +984,64 @@ bbl_compare_l2tp_session (void *key1, void *key2)
 uint
 bbl_session_hash (const void* k)
 {
-    uint hash = 2166136261U;
+    return bbl_dict_mix64(*(const uint64_t*)k);
+}
 
-    hash ^= *(uint32_t *)k;
-    hash ^= *(uint16_t *)(k+4) << 12;
-    hash ^= *(uint16_t *)(k+6);
+/*
+ * Stream flow identifiers are 64-Bit counters,
+ * compared and hashed by value.
+ */
+int
+bbl_compare_stream_flow (void *key1, void *key2)
+{
+    const uint64_t a = *(const uint64_t*)key1;
+    const uint64_t b = *(const uint64_t*)key2;
+    return (a > b) - (a < b);
+}
 
-    return hash;
+uint
+bbl_stream_flow_hash (const void* k)
+{
+    return bbl_dict_mix64(*(const uint64_t*)k);
 }
 
 uint
 bbl_l2tp_session_hash (const void* k)
 {
-    uint hash = 2166136261U;
-    hash ^= *(uint32_t *)k;
-    return hash;
+    return bbl_dict_mix32(*(const uint32_t*)k);
+}
+
+/*
+ * Initialize session DB sized for the configured number
+ * of sessions. All dictionaries grow at runtime if required.
+ */
+bool
+bbl_init_dicts (bbl_ctx_s *ctx)
+{
+    if(!bbl_dict_init(&ctx->session_dict, "sessions",
+                      (dict_compare_func)bbl_compare_session,
+                      bbl_session_hash, ctx->config.sessions, true)) {
+        return false;
+    }
+    if(!bbl_dict_init(&ctx->l2tp_session_dict, "l2tp-sessions",
+                      (dict_compare_func)bbl_compare_l2tp_session,
+                      bbl_l2tp_session_hash, ctx->config.sessions, true)) {
+        return false;
+    }
+    if(!bbl_dict_init(&ctx->li_flow_dict, "li-flows",
+                      (dict_compare_func)bbl_compare_l2tp_session,
+                      bbl_l2tp_session_hash, 0, true)) {
+        return false;
+    }
+    if(!bbl_dict_init(&ctx->stream_flow_dict, "stream-flows",
+                      (dict_compare_func)bbl_compare_stream_flow,
+                      bbl_stream_flow_hash, ctx->config.stream_config ? ctx->config.sessions : 0, true)) {
+        return false;
+    }
+    LOG(DEBUG, "Session dictionaries with %u, %u, %u and %u buckets\n",
+        ctx->session_dict.buckets, ctx->l2tp_session_dict.buckets, ctx->li_flow_dict.buckets,
+        ctx->stream_flow_dict.buckets);
+    return true;
 }
 
 /*
@@ -657,21 +1071,6 @@ bbl_add_ctx (void)
     CIRCLEQ_INIT(&ctx->interface_qhead);
 
     ctx->flow_id = 1;
-    /*
-     * Initialize session DB.
-     */
-    ctx->session_dict = hashtable2_dict_new((dict_compare_func)bbl_compare_session,
-                                            bbl_session_hash,
-                                            BBL_SESSION_HASHTABLE_SIZE);
-
-    ctx->l2tp_session_dict = hashtable2_dict_new((dict_compare_func)bbl_compare_l2tp_session,
-                                                 bbl_l2tp_session_hash,
-                                                 BBL_SESSION_HASHTABLE_SIZE);
-
-    ctx->li_flow_dict = hashtable2_dict_new((dict_compare_func)bbl_compare_l2tp_session,
-                                            bbl_l2tp_session_hash,
-                                            BBL_SESSION_HASHTABLE_SIZE);
-
     return ctx;
 }
 
@@ -679,6 +1078,7 @@ void
 bbl_del_ctx (bbl_ctx_s *ctx) {
     bbl_access_config_s *access_config = ctx->config.access_config;
     void *p = NULL;
+    int i;
 
     /* Free access configuration memory. */
     while(access_config) {
@@ -696,6 +1096,25 @@ bbl_del_ctx (bbl_ctx_s *ctx) {
 
     pcapng_free(ctx);
     timer_flush_root(&ctx->timer_root);
+    bbl_event_close(ctx);
+    for(i = 0; i < ctx->op.access_if_count; i++) {
+        bbl_session_table_free(&ctx->op.access_if[i]->session_table);
+        bbl_stream_free(ctx->op.access_if[i]);
+        bbl_session_traffic_free(ctx->op.access_if[i]);
+    }
+    if(ctx->op.network_if) {
+        bbl_multicast_free(ctx->op.network_if);
+        bbl_stream_free(ctx->op.network_if);
+        bbl_session_traffic_free(ctx->op.network_if);
+    }
+    bbl_dict_free(&ctx->session_dict);
+    bbl_dict_free(&ctx->l2tp_session_dict);
+    bbl_dict_free(&ctx->li_flow_dict);
+    bbl_dict_free(&ctx->stream_flow_dict);
+    bbl_arena_free(&ctx->session_arena);
+    bbl_arena_free(&ctx->session_cold_arena);
+    bbl_arena_free(&ctx->template_arena);
+    bbl_arena_free(&ctx->stream_arena);
     free(ctx);
     return;
 }
@@ -706,10 +1125,15 @@ bbl_add_session (bbl_ctx_s *ctx, bbl_interface_s *interface, bbl_session_s *sess
     bbl_session_s *session;
     dict_insert_result result;
 
-    session = calloc(1, sizeof(bbl_session_s));
+    session = bbl_arena_alloc(&ctx->session_arena, sizeof(bbl_session_s), BBL_SESSION_ALIGN);
     if (!session) {
         return NULL;
     }
+    session->cold = bbl_arena_alloc(&ctx->session_cold_arena, sizeof(bbl_session_cold_s), 0);
+    if (!session->cold) {
+        return NULL;
+    }
+    session->cold->session = session;
 
     /*
      * Copy key data.
@@ -721,31 +1145,31 @@ bbl_add_session (bbl_ctx_s *ctx, bbl_interface_s *interface, bbl_session_s *sess
      */
     session->access_type = session_template->access_type;
     session->access_third_vlan = access_config->access_third_vlan;
-    session->access_config = access_config;
+    session->cold->access_config = access_config;
     memcpy(session->server_mac, session_template->server_mac, ETH_ADDR_LEN);
     memcpy(session->client_mac, session_template->client_mac, ETH_ADDR_LEN);
-    session->mru = session_template->mru;
-    session->magic_number = session_template->magic_number;
-    session->username = session_template->username;
-    session->password = session_template->password;
-    session->agent_circuit_id = session_template->agent_circuit_id;
-    session->agent_remote_id = session_template->agent_remote_id;
-    session->rate_up = session_template->rate_up;
-    session->rate_down = session_template->rate_down;
-    session->duid[1] = 3;
-    session->duid[3] = 1;
-    memcpy(&session->duid[4], session_template->client_mac, ETH_ADDR_LEN);
-    session->igmp_autostart = access_config->igmp_autostart;
-    session->igmp_version = access_config->igmp_version;
-    session->igmp_robustness = 2; /* init robustness with 2 */
-    session->zapping_group_max = be32toh(ctx->config.igmp_group) + ((ctx->config.igmp_group_count - 1) * be32toh(ctx->config.igmp_group_iter));
+    session->cold->mru = session_template->cold->mru;
+    session->cold->magic_number = session_template->cold->magic_number;
+    session->cold->username = session_template->cold->username;
+    session->cold->password = session_template->cold->password;
+    session->cold->agent_circuit_id = session_template->cold->agent_circuit_id;
+    session->cold->agent_remote_id = session_template->cold->agent_remote_id;
+    session->cold->rate_up = session_template->cold->rate_up;
+    session->cold->rate_down = session_template->cold->rate_down;
+    session->cold->duid[1] = 3;
+    session->cold->duid[3] = 1;
+    memcpy(&session->cold->duid[4], session_template->client_mac, ETH_ADDR_LEN);
+    session->cold->igmp_autostart = access_config->igmp_autostart;
+    session->cold->igmp_version = access_config->igmp_version;
+    session->cold->igmp_robustness = 2; /* init robustness with 2 */
+    session->cold->zapping_group_max = be32toh(ctx->config.igmp_group) + ((ctx->config.igmp_group_count - 1) * be32toh(ctx->config.igmp_group_iter));
     session->session_traffic = access_config->session_traffic_autostart;
     if(session->access_type == ACCESS_TYPE_PPPOE) {
         if(ctx->config.pppoe_service_name) {
-            session->pppoe_service_name = (uint8_t*)ctx->config.pppoe_service_name;
-            session->pppoe_service_name_len = strlen(ctx->config.pppoe_service_name);
+            session->cold->pppoe_service_name = (uint8_t*)ctx->config.pppoe_service_name;
+            session->cold->pppoe_service_name_len = strlen(ctx->config.pppoe_service_name);
         }
-        session->pppoe_host_uniq = session_template->pppoe_host_uniq;
+        session->cold->pppoe_host_uniq = session_template->cold->pppoe_host_uniq;
     } else if(session->access_type == ACCESS_TYPE_IPOE) {
         if(access_config->static_ip && access_config->static_gateway) {
             session->ip_address = access_config->static_ip;
@@ -758,19 +1182,37 @@ bbl_add_session (bbl_ctx_s *ctx, bbl_interface_s *interface, bbl_session_s *sess
     /*
      * Insert session into session dictionary hanging off a context.
      */
-    result = dict_insert(ctx->session_dict, &session->key);
+    bbl_dict_reserve(&ctx->session_dict);
+    result = dict_insert(ctx->session_dict.dict, &session->key);
     if (!result.inserted) {
-        free(session);
+        /* The memory stays in the session arena. */
         return NULL;
     }
     *result.datum_ptr = session;
 
+    /*
+     * Insert session into the VLAN table of the access interface
+     * used for the lookup of received traffic.
+     */
+    if(!bbl_session_table_add(&interface->session_table, session->key.outer_vlan_id,
+                              session->key.inner_vlan_id, session)) {
+        dict_remove(ctx->session_dict.dict, &session->key);
+        return NULL;
+    }
+
     /*
      * Store parent.
      */
     session->interface = interface;
+
+    /*
+     * Add the traffic streams of the session.
+     */
+    if(!bbl_stream_add_session(ctx, session)) {
+        return NULL;
+    }
     session->session_state = BBL_IDLE;
-    CIRCLEQ_INSERT_TAIL(&ctx->sessions_idle_qhead, session, session_idle_qnode);
+    CIRCLEQ_INSERT_TAIL(&ctx->sessions_idle_qhead, session->cold, session_idle_qnode);
     ctx->sessions++;
     if(session->access_type == ACCESS_TYPE_PPPOE) {
         ctx->sessions_pppoe++;
@@ -784,7 +1226,9 @@ bool
 bbl_init_sessions (bbl_ctx_s *ctx)
 {
     bbl_session_s session_template;
+    bbl_session_cold_s session_template_cold;
     bbl_access_config_s *access_config;
+    bbl_interface_s *access_if;
         
     uint32_t i = 1;
     char *s;
@@ -797,6 +1241,19 @@ bbl_init_sessions (bbl_ctx_s *ctx)
      * is still zero after processing last access profile means 
      * that all VLAN ranges are exhausted. */
     int t = 0;
+
+    /*
+     * Map memory for all sessions at once, including
+     * room for the arena chunk header.
+     */
+    bbl_arena_init(&ctx->session_arena, "sessions",
+                   (size_t)ctx->config.sessions * BBL_SESSION_SIZE + BBL_SESSION_ALIGN,
+                   ctx->config.sessions_hugepages);
+    bbl_arena_init(&ctx->session_cold_arena, "sessions-cold",
+                   (size_t)ctx->config.sessions * sizeof(bbl_session_cold_s) + BBL_SESSION_ALIGN,
+                   ctx->config.sessions_hugepages);
+    bbl_arena_init(&ctx->template_arena, "templates", BBL_ARENA_CHUNK_SIZE, ctx->config.sessions_hugepages);
+    bbl_arena_init(&ctx->stream_arena, "streams", BBL_ARENA_CHUNK_SIZE, ctx->config.sessions_hugepages);
     
     access_config = ctx->config.access_config;
 
@@ -839,6 +1296,8 @@ bbl_init_sessions (bbl_ctx_s *ctx)
         t++;
         access_config->sessions++;
         memset(&session_template, 0, sizeof(session_template));
+        memset(&session_template_cold, 0, sizeof(session_template_cold));
+        session_template.cold = &session_template_cold;
         memset(&session_template.server_mac, 0xff, ETH_ADDR_LEN); // init with broadcast MAC
         session_template.key.outer_vlan_id= access_config->access_outer_vlan;
         session_template.key.inner_vlan_id = access_config->access_inner_vlan;
@@ -846,14 +1305,14 @@ bbl_init_sessions (bbl_ctx_s *ctx)
         session_template.client_mac[0] = 0x02; //
         session_template.client_mac[1] = 0x00; // set client OUI ro locally administered
         session_template.client_mac[2] = 0x00; //
-        session_template.mru = ctx->config.ppp_mru;
+        session_template.cold->mru = ctx->config.ppp_mru;
         session_template.access_type = access_config->access_type;
         session_template.client_mac[3] = i>>16;
         session_template.client_mac[4] = i>>8;
         session_template.client_mac[5] = i;
-        session_template.magic_number = htobe32(i);
+        session_template.cold->magic_number = htobe32(i);
         if(ctx->config.pppoe_host_uniq) {
-            session_template.pppoe_host_uniq = htobe64(i);
+            session_template.cold->pppoe_host_uniq = htobe64(i);
         }
         /* Populate session identifiaction attributes */
         snprintf(snum1, 6, "%d", i);
@@ -861,31 +1320,31 @@ bbl_init_sessions (bbl_ctx_s *ctx)
     
         /* Update username */
         s = replace_substring(access_config->username, "{session-global}", snum1);
-        session_template.username = s;
-        s = replace_substring(session_template.username, "{session}", snum2);
-        session_template.username = strdup(s);
+        session_template.cold->username = s;
+        s = replace_substring(session_template.cold->username, "{session}", snum2);
+        session_template.cold->username = strdup(s);
 
         /* Update password */
         s = replace_substring(access_config->password, "{session-global}", snum1);
-        session_template.password = s;
-        s = replace_substring(session_template.password, "{session}", snum2);
-        session_template.password = strdup(s);
+        session_template.cold->password = s;
+        s = replace_substring(session_template.cold->password, "{session}", snum2);
+        session_template.cold->password = strdup(s);
 
         /* Update ACI */
         s = replace_substring(access_config->agent_circuit_id, "{session-global}", snum1);
-        session_template.agent_circuit_id = s;
-        s = replace_substring(session_template.agent_circuit_id, "{session}", snum2);
-        session_template.agent_circuit_id = strdup(s);
+        session_template.cold->agent_circuit_id = s;
+        s = replace_substring(session_template.cold->agent_circuit_id, "{session}", snum2);
+        session_template.cold->agent_circuit_id = strdup(s);
 
         /* Update ARI */
         s = replace_substring(access_config->agent_remote_id, "{session-global}", snum1);
-        session_template.agent_remote_id = s;
-        s = replace_substring(session_template.agent_remote_id, "{session}", snum2);
-        session_template.agent_remote_id = strdup(s);
+        session_template.cold->agent_remote_id = s;
+        s = replace_substring(session_template.cold->agent_remote_id, "{session}", snum2);
+        session_template.cold->agent_remote_id = strdup(s);
         
         /* Update rates ... */
-        session_template.rate_up = access_config->rate_up;
-        session_template.rate_down = access_config->rate_down;
+        session_template.cold->rate_up = access_config->rate_up;
+        session_template.cold->rate_down = access_config->rate_down;
         if(bbl_add_session(ctx, access_config->access_if, &session_template, access_config) == NULL) {
             LOG(ERROR, "Failed to create session (%s Q-in-Q %u:%u)\n", access_config->interface, access_config->access_outer_vlan, access_config->access_inner_vlan);
             return false;
@@ -907,9 +1366,54 @@ Next:
 
         }
     }
+    LOG(NORMAL, "Allocated %lu sessions in %lu KB + %lu KB control plane data (%u of %u chunks hugetlb)\n",
+        ctx->session_arena.stats.allocs, ctx->session_arena.stats.mapped / 1024,
+        ctx->session_cold_arena.stats.mapped / 1024,
+        ctx->session_arena.stats.chunks_hugetlb + ctx->session_cold_arena.stats.chunks_hugetlb,
+        ctx->session_arena.stats.chunks + ctx->session_cold_arena.stats.chunks);
+    if(ctx->stats.stream_flows) {
+        LOG(NORMAL, "Allocated %u traffic streams in %lu KB\n",
+            ctx->stats.stream_flows, ctx->stream_arena.stats.mapped / 1024);
+    }
+    for(t = 0; t < ctx->op.access_if_count; t++) {
+        access_if = ctx->op.access_if[t];
+        LOG(DEBUG, "Session VLAN table on interface %s with %u sessions in %u inner tables (%lu KB)\n",
+            access_if->name, access_if->session_table.stats.sessions,
+            access_if->session_table.stats.inner_tables,
+            (access_if->session_table.stats.inner_tables + 1) * BBL_SESSION_TABLE_VLANS * sizeof(void*) / 1024);
+    }
     return true;
 }
 
+/*
+ * Search session by key using the VLAN table of
+ * the access interface with matching ifindex.
+ *
+ * The access interface is found directly by ifindex, only
+ * interfaces whose ifindex collides in the map are searched.
+ */
+bbl_session_s *
+bbl_session_get (bbl_ctx_s *ctx, session_key_t *key)
+{
+    bbl_interface_s *access_if;
+    int i;
+
+    access_if = ctx->op.access_if_map[key->ifindex & (BBL_ACCESS_IF_MAP-1)];
+    if(!access_if) {
+        return NULL;
+    }
+    if(access_if->addr.sll_ifindex == (int)key->ifindex) {
+        return bbl_session_table_get(&access_if->session_table, key->outer_vlan_id, key->inner_vlan_id);
+    }
+    for(i = 0; i < ctx->op.access_if_count; i++) {
+        access_if = ctx->op.access_if[i];
+        if(access_if->addr.sll_ifindex == (int)key->ifindex) {
+            return bbl_session_table_get(&access_if->session_table, key->outer_vlan_id, key->inner_vlan_id);
+        }
+    }
+    return NULL;
+}
+
 /*
  * performance test code
  */
@@ -928,7 +1432,7 @@ bbl_test_lookup_session(bbl_ctx_s *ctx)
                 key.ifindex = ifindex;
                 key.outer_vlan_id = outer_vlan_id;
                 key.inner_vlan_id = inner_vlan_id;
-                search = dict_search(ctx->session_dict, &key);
+                search = dict_search(ctx->session_dict.dict, &key);
                 if (search) {
                     session_found++;
                 }
@@ -958,8 +1462,8 @@ bbl_session_clear(bbl_ctx_s *ctx, bbl_session_s *session)
             case BBL_ESTABLISHED:
             case BBL_PPP_TERMINATING:
                 bbl_session_update_state(ctx, session, BBL_PPP_TERMINATING);
-                session->lcp_request_code = PPP_CODE_TERM_REQUEST;
-                session->lcp_options_len = 0;
+                session->cold->lcp_request_code = PPP_CODE_TERM_REQUEST;
+                session->cold->lcp_options_len = 0;
                 session->send_requests |= BBL_SEND_LCP_REQUEST;
                 bbl_session_tx_qnode_insert(session);
                 break;
@@ -996,6 +1500,10 @@ bbl_ctrl_job (timer_s *timer)
 
     if(ctx->sessions_outstanding) ctx->sessions_outstanding--;
 
+    /* Grow tables which are filled on the packet path. */
+    bbl_dict_maintain(&ctx->l2tp_session_dict);
+    bbl_dict_maintain(&ctx->li_flow_dict);
+
     if(ctx->sessions) { 
         if(ctx->sessions_terminated >= ctx->sessions) {
             /* Now close all L2TP tunnels ... */
@@ -1025,13 +1533,13 @@ bbl_ctrl_job (timer_s *timer)
         /* Teardown phase ... */
         if(g_teardown_request) {
             /* Put all sessions on the teardown list. */
-            itor = dict_itor_new(ctx->session_dict);
+            itor = dict_itor_new(ctx->session_dict.dict);
             dict_itor_first(itor);
             for (; dict_itor_valid(itor); dict_itor_next(itor)) {
                 session = (bbl_session_s*)*dict_itor_datum(itor);
-                if(!CIRCLEQ_NEXT(session, session_teardown_qnode)) {
+                if(!CIRCLEQ_NEXT(session->cold, session_teardown_qnode)) {
                     /* Add only if not already on teardown list. */
-                    CIRCLEQ_INSERT_TAIL(&ctx->sessions_teardown_qhead, session, session_teardown_qnode);
+                    CIRCLEQ_INSERT_TAIL(&ctx->sessions_teardown_qhead, session->cold, session_teardown_qnode);
                 }
             }
             dict_itor_free(itor);
@@ -1040,14 +1548,14 @@ bbl_ctrl_job (timer_s *timer)
             /* Process teardown list in chunks. */
             rate = ctx->config.sessions_stop_rate;
             while (!CIRCLEQ_EMPTY(&ctx->sessions_teardown_qhead)) {
-                session = CIRCLEQ_FIRST(&ctx->sessions_teardown_qhead);
+                session = CIRCLEQ_FIRST(&ctx->sessions_teardown_qhead)->session;
                 if(rate > 0) {
                     if(session->session_state != BBL_IDLE) rate--;
                     bbl_session_clear(ctx, session);
                     /* Remove from teardown queue. */
-                    CIRCLEQ_REMOVE(&ctx->sessions_teardown_qhead, session, session_teardown_qnode);
-                    CIRCLEQ_NEXT(session, session_teardown_qnode) = NULL;
-                    CIRCLEQ_PREV(session, session_teardown_qnode) = NULL;
+                    CIRCLEQ_REMOVE(&ctx->sessions_teardown_qhead, session->cold, session_teardown_qnode);
+                    CIRCLEQ_NEXT(session->cold, session_teardown_qnode) = NULL;
+                    CIRCLEQ_PREV(session->cold, session_teardown_qnode) = NULL;
                 } else {
                     break;
                 }
@@ -1062,7 +1570,7 @@ bbl_ctrl_job (timer_s *timer)
         bbl_stats_update_cps(ctx);
         rate = ctx->config.sessions_start_rate;
         while (!CIRCLEQ_EMPTY(&ctx->sessions_idle_qhead)) {
-            session = CIRCLEQ_FIRST(&ctx->sessions_idle_qhead);
+            session = CIRCLEQ_FIRST(&ctx->sessions_idle_qhead)->session;
             if(rate > 0) {
                 if(ctx->sessions_outstanding < ctx->config.sessions_max_outstanding) {
                     ctx->sessions_outstanding++;
@@ -1077,8 +1585,8 @@ bbl_ctrl_job (timer_s *timer)
                             /* IP over Ethernet (IPoE) */
                             session->session_state = BBL_IPOE_SETUP;
                             session->send_requests = 0;
-                            if(session->access_config->ipv4_enable) {
-                                if(session->access_config->dhcp_enable) {
+                            if(session->cold->access_config->ipv4_enable) {
+                                if(session->cold->access_config->dhcp_enable) {
                                     /* Start IPoE session by sending DHCP discovery if enabled. */
                                     session->send_requests |= BBL_SEND_DHCPREQUEST;
                                 } else if (session->ip_address && session->peer_ip_address) {
@@ -1087,17 +1595,18 @@ bbl_ctrl_job (timer_s *timer)
                                     session->send_requests |= BBL_SEND_ARP_REQUEST;
                                 }
                             }
-                            if(session->access_config->ipv6_enable) {
+                            if(session->cold->access_config->ipv6_enable) {
                                 /* Start IPoE session by sending RS. */
                                 session->send_requests |= BBL_SEND_ICMPV6_RS;
                             }
                             break;
                     }
+                    bbl_session_io_update(ctx, session);
                     bbl_session_tx_qnode_insert(session);
                     /* Remove from idle queue */
-                    CIRCLEQ_REMOVE(&ctx->sessions_idle_qhead, session, session_idle_qnode);
-                    CIRCLEQ_NEXT(session, session_idle_qnode) = NULL;
-                    CIRCLEQ_PREV(session, session_idle_qnode) = NULL;
+                    CIRCLEQ_REMOVE(&ctx->sessions_idle_qhead, session->cold, session_idle_qnode);
+                    CIRCLEQ_NEXT(session->cold, session_idle_qnode) = NULL;
+                    CIRCLEQ_PREV(session->cold, session_idle_qnode) = NULL;
                 } else {
                     break;
                 }
@@ -1243,6 +1752,11 @@ main (int argc, char *argv[])
     if(igmp_group_count) ctx->config.igmp_group_count = atoi(igmp_group_count);
     if(igmp_zap_interval) ctx->config.igmp_zap_interval = atoi(igmp_zap_interval);
 
+    if(!bbl_init_dicts(ctx)) {
+        fprintf(stderr, "Error: Failed to init session dictionaries\n");
+        exit(1);
+    }
+
     /*
      * Start curses.
      */
@@ -1250,6 +1764,17 @@ main (int argc, char *argv[])
         bbl_init_curses(ctx);
     }
 
+    /*
+     * Setup event loop. Busy poll mode is part of the event loop.
+     */
+    if(ctx->config.event_loop || ctx->config.busy_poll) {
+        if(!bbl_event_init(ctx)) {
+            if (interactive) endwin();
+            fprintf(stderr, "Error: Failed to init event loop\n");
+            exit(1);
+        }
+    }
+
     /*
      * Add access interfaces.
      */
@@ -1263,7 +1788,7 @@ main (int argc, char *argv[])
      * Add network interface.
      */
     if (strlen(ctx->config.network_if)) {
-        ctx->op.network_if = bbl_add_interface(ctx, ctx->config.network_if, 1024);
+        ctx->op.network_if = bbl_add_interface(ctx, ctx->config.network_if, &ctx->config.network_interface_config);
         if (!ctx->op.network_if) {
             if (interactive) endwin();
             fprintf(stderr, "Error: Failed to add network interface\n");
@@ -1278,7 +1803,7 @@ main (int argc, char *argv[])
                 ctx->op.network_if->send_requests |= BBL_IF_SEND_ARP_REQUEST;
             }
             /* Add Multicast traffic */
-            if(!bbl_add_multicast_packets(ctx, ctx->op.network_if)) {
+            if(!bbl_multicast_init(ctx, ctx->op.network_if)) {
                 if (interactive) endwin();
                 fprintf(stderr, "Error: Failed to add multicast traffic\n");
                 exit(1);
@@ -1296,7 +1821,11 @@ main (int argc, char *argv[])
     /*
      * Setup resources in case PCAP dumping is desired.
      */
-    pcapng_init(ctx);
+    if(!pcapng_init(ctx)) {
+        if (interactive) endwin();
+        fprintf(stderr, "Error: Failed to init packet capture\n");
+        exit(1);
+    }
 
     /*
      * Setup test.
@@ -1329,17 +1858,28 @@ main (int argc, char *argv[])
      */
     timer_add_periodic(&ctx->timer_root, &ctx->smear_timer, "Timer Smearing", 45, 12345678, ctx, bbl_smear_job);
 
+    /*
+     * Start I/O threads.
+     */
+    if(!bbl_io_thread_start_all(ctx)) {
+        if (interactive) endwin();
+        fprintf(stderr, "Error: Failed to start I/O threads\n");
+        exit(1);
+    }
+
     /*
      * Start event loop.
      */
     log_open();
     clock_gettime(CLOCK_REALTIME, &ctx->timestamp_start);
     signal(SIGINT, teardown_handler);
-    timer_walk(&ctx->timer_root);
+    bbl_event_walk(ctx);
     while(ctx->sessions_terminated < ctx->sessions && g_teardown_request_count < 10) {
-        timer_walk(&ctx->timer_root);
+        bbl_event_walk(ctx);
     }
     clock_gettime(CLOCK_REALTIME, &ctx->timestamp_stop);
+    bbl_io_thread_stop_all(ctx);
+    pcapng_stop(ctx);
 
     /*
      * Stop curses. Do this before the final reports.
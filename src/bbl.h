@@ -39,6 +39,16 @@
 #include "libdict/dict.h"
 #include "bbl_logging.h"
 #include "bbl_timer.h"
+#include "bbl_event.h"
+#include "bbl_arena.h"
+#include "bbl_dict.h"
+#include "bbl_session_table.h"
+#include "bbl_io.h"
+#include "bbl_io_thread.h"
+#include "bbl_xdp.h"
+#include "bbl_calendar.h"
+#include "bbl_latency.h"
+#include "bbl_multicast.h"
 #include "bbl_protocols.h"
 #include "bbl_utils.h"
 #include "bbl_rx.h"
@@ -46,6 +56,8 @@
 #include "bbl_l2tp.h"
 #include "bbl_l2tp_avp.h"
 #include "bbl_li.h"
+#include "bbl_stream.h"
+#include "bbl_bpf.h"
 
 #define WRITE_BUF_LEN               1514
 #define SCRATCHPAD_LEN              1514
@@ -65,15 +77,18 @@
 #define BBL_SEND_DHCPV6_REQUEST     0x00000400
 #define BBL_SEND_IGMP               0x00000800
 #define BBL_SEND_ICMP_REPLY         0x00001000
-#define BBL_SEND_SESSION_IPV4       0x00002000
-#define BBL_SEND_SESSION_IPV6       0x00004000
-#define BBL_SEND_SESSION_IPV6PD     0x00008000
 #define BBL_SEND_ARP_REQUEST        0x00010000
 #define BBL_SEND_ARP_REPLY          0x00020000
 #define BBL_SEND_DHCPREQUEST        0x00040000
 #define BBL_SEND_ICMPV6_REPLY       0x00080000
 #define BBL_SEND_ICMPV6_NS          0x00100000
 #define BBL_SEND_ICMPV6_NA          0x00200000
+#define BBL_SEND_LCP_ECHO_REQUEST   0x00400000
+#define BBL_SEND_LCP_ECHO_REPLY     0x00800000
+
+/* Send requests of the keepalive TX class. */
+#define BBL_SEND_KEEPALIVE          (BBL_SEND_LCP_ECHO_REQUEST|BBL_SEND_LCP_ECHO_REPLY|\
+                                     BBL_SEND_ARP_REQUEST|BBL_SEND_ARP_REPLY)
 
 /* Network Interface */
 #define BBL_IF_SEND_ARP_REQUEST     0x00000001
@@ -87,9 +102,14 @@
 #define DHCPV6_BUFFER               64
 
 #define BBL_MAX_ACCESS_INTERFACES   64
+#define BBL_ACCESS_IF_MAP           256 /* access interfaces by ifindex, power of 2 */
+#define BBL_MAX_FANOUT              16
 #define BBL_AVG_SAMPLES             5
 #define DATA_TRAFFIC_MAX_LEN        1500
 
+#define BBL_SESSION_ALIGN           64 /* cache line */
+#define BBL_SESSION_SIZE            ((sizeof(bbl_session_s) + BBL_SESSION_ALIGN - 1) & ~(BBL_SESSION_ALIGN - 1))
+
 #define UNUSED(x)    (void)x
 
 
@@ -125,6 +145,10 @@ typedef struct bbl_igmp_group_
     uint32_t source[IGMP_MAX_SOURCES];
     uint64_t packets;
     uint64_t loss;
+    struct {
+        uint64_t flow_id; /* 0 if unused */
+        uint64_t last_seq;
+    } mc_flow[IGMP_MAX_MC_FLOWS]; /* sequence numbers are per multicast stream */
     struct timespec join_tx_time;
     struct timespec first_mc_rx_time;
     struct timespec leave_tx_time;
@@ -138,6 +162,179 @@ typedef struct bbl_secondary_ip_
     void *next;
 } bbl_secondary_ip_s;
 
+/*
+ * RX socket with its own ringbuffer. An interface
+ * has multiple RX rings if PACKET_FANOUT is used.
+ */
+typedef struct bbl_rx_ring_
+{
+    struct bbl_interface_ *interface; /* parent */
+    uint8_t id;
+
+    int fd;
+    struct tpacket_req3 req; /* TPACKET_V2 uses the tpacket_req subset */
+    u_char *ring; /* ringbuffer */
+    uint cursor; /* slot # inside the ringbuffer (block # for TPACKET_V3) */
+
+    struct timer_ *rx_job;
+    bbl_event_s rx_event; /* used instead of rx_job with event loop */
+
+    /* I/O thread, see bbl_io_thread.h */
+    struct bbl_io_thread_ *io_thread;
+    bbl_spsc_s *io_queue; /* received packets, I/O thread -> control thread */
+    bbl_io_rx_release_s *io_release; /* FIFO of claimed frames (blocks) in ring order */
+    uint32_t io_release_head; /* FIFO index of the next claimed frame (block) */
+    uint32_t io_release_tail; /* FIFO index of the oldest frame (block) not yet returned to the kernel */
+    struct tpacket3_hdr *io_tphdr3; /* TPACKET_V3 next packet of the current block */
+    uint32_t io_block_pkts; /* TPACKET_V3 packets left in the current block */
+    struct {
+        _Atomic uint64_t packets_rx;
+        _Atomic uint64_t rx_blocks;
+        _Atomic uint64_t rx_block_packets;
+        _Atomic uint32_t rx_block_packets_max;
+        _Atomic uint64_t queue_full;
+    } io_stats; /* written by the I/O thread */
+
+    /* Per ring stats, also accounted in the interface stats. */
+    struct {
+        uint64_t packets_rx;
+        uint64_t poll_rx;
+        uint64_t rx_blocks;
+        uint64_t kernel_packets; /* PACKET_STATISTICS tp_packets */
+        uint64_t kernel_drops; /* PACKET_STATISTICS tp_drops */
+    } stats;
+} bbl_rx_ring_s;
+
+/*
+ * Interface stats. The data plane counters of interfaces served by
+ * I/O threads are counted per thread and merged by the control thread,
+ * see bbl_io_thread_stats().
+ */
+typedef struct bbl_interface_stats_
+{
+    uint64_t packets_tx;
+    uint64_t packets_rx;
+    bbl_rate_s rate_packets_tx;
+    bbl_rate_s rate_packets_rx;
+    uint64_t packets_rx_drop_unknown;
+    uint64_t packets_rx_drop_decode_error;
+    uint64_t packets_rx_fast_path; /* BBL traffic handled without decode_ethernet */
+    uint64_t sendto_failed;
+    uint64_t no_tx_buffer;
+    uint64_t tx_kicks; /* sendto() calls to start transmission */
+    uint64_t tx_kicks_early; /* kicks because of the flush threshold */
+    uint64_t tx_kicks_skipped; /* flushes without pending frames */
+    uint64_t tx_kicks_again; /* kicks returned EAGAIN or ENOBUFS */
+    bbl_tx_class_stats_s tx_class[BBL_TX_CLASS_MAX];
+    uint32_t tx_inflight_max; /* max frames owned by the kernel */
+    uint64_t poll_tx;
+    uint64_t poll_rx;
+    uint64_t encode_errors;
+
+    uint64_t rx_blocks; /* TPACKET_V3 blocks processed */
+    uint64_t rx_block_packets; /* TPACKET_V3 packets received via blocks */
+    uint32_t rx_block_packets_max; /* TPACKET_V3 max packets per block */
+
+    uint64_t rx_kernel_packets; /* packets seen by the kernel RX rings */
+    uint64_t rx_kernel_drops; /* packets dropped because of full RX rings */
+    uint64_t rx_kernel_freeze; /* TPACKET_V3 RX ring freezes */
+
+    uint64_t io_rx_queue_full; /* I/O thread RX queue full */
+    uint64_t io_data_queue_full; /* I/O thread data queue full */
+    uint64_t io_loops; /* I/O thread loops */
+    uint64_t io_empty_loops; /* I/O thread loops without work */
+
+    bbl_latency_s tx_delay; /* TX ring write to kernel TX timestamp */
+    bbl_latency_s session_latency; /* session traffic received */
+    bbl_latency_histogram_s session_latency_histogram;
+    bbl_latency_histogram_s session_jitter_histogram; /* delay variation per flow */
+
+    uint64_t mc_tx;
+    bbl_rate_s rate_mc_tx;
+    uint64_t mc_rx;
+    bbl_rate_s rate_mc_rx;
+    uint64_t mc_loss;
+
+    uint64_t stream_tx;
+    bbl_rate_s rate_stream_tx;
+    uint64_t stream_rx;
+    bbl_rate_s rate_stream_rx;
+    uint64_t stream_loss;
+
+    /* Packet Stats */
+    uint32_t arp_tx;
+    uint32_t arp_rx;
+    uint32_t padi_tx;
+    uint32_t pado_rx;
+    uint32_t padr_tx;
+    uint32_t pads_rx;
+    uint32_t padt_tx;
+    uint32_t padt_rx;
+    uint32_t lcp_tx;
+    uint32_t lcp_rx;
+    uint32_t lcp_timeout;
+    uint32_t lcp_echo_timeout;
+    uint32_t pap_tx;
+    uint32_t pap_rx;
+    uint32_t pap_timeout;
+    uint32_t chap_tx;
+    uint32_t chap_rx;
+    uint32_t chap_timeout;
+    uint32_t ipcp_tx;
+    uint32_t ipcp_rx;
+    uint32_t ipcp_timeout;
+    uint32_t ip6cp_tx;
+    uint32_t ip6cp_rx;
+    uint32_t ip6cp_timeout;
+    uint32_t igmp_rx;
+    uint32_t igmp_tx;
+    uint32_t icmp_tx;
+    uint32_t icmp_rx;
+    uint32_t icmpv6_tx;
+    uint32_t icmpv6_rx;
+    uint32_t icmpv6_rs_timeout;
+
+    uint32_t dhcpv6_tx;
+    uint32_t dhcpv6_rx;
+    uint32_t dhcpv6_timeout;
+
+    uint64_t session_ipv4_tx;
+    bbl_rate_s rate_session_ipv4_tx;
+    uint64_t session_ipv4_rx;
+    bbl_rate_s rate_session_ipv4_rx;
+    uint64_t session_ipv4_loss;
+
+    uint64_t session_ipv6_tx;
+    bbl_rate_s rate_session_ipv6_tx;
+    uint64_t session_ipv6_rx;
+    bbl_rate_s rate_session_ipv6_rx;
+    uint64_t session_ipv6_loss;
+
+    uint64_t session_ipv6pd_tx;
+    bbl_rate_s rate_session_ipv6pd_tx;
+    uint64_t session_ipv6pd_rx;
+    bbl_rate_s rate_session_ipv6pd_rx;
+    uint64_t session_ipv6pd_loss;
+
+    uint64_t session_ipv4_wrong_session;
+    uint64_t session_ipv6_wrong_session;
+    uint64_t session_ipv6pd_wrong_session;
+
+    uint32_t l2tp_control_rx;
+    uint32_t l2tp_control_rx_dup; /* duplicate */
+    uint32_t l2tp_control_rx_ooo; /* out of order */
+    uint32_t l2tp_control_rx_nf;  /* session not found */
+    uint32_t l2tp_control_tx;
+    uint32_t l2tp_control_retry;
+    uint64_t l2tp_data_rx;
+    uint64_t l2tp_data_tx;
+    bbl_rate_s rate_l2tp_data_rx;
+    bbl_rate_s rate_l2tp_data_tx;
+
+    uint64_t li_rx;
+    bbl_rate_s rate_li_rx;
+} bbl_interface_stats_s;
+
 typedef struct bbl_interface_
 {
     CIRCLEQ_ENTRY(bbl_interface_) interface_qnode;
@@ -150,15 +347,34 @@ typedef struct bbl_interface_
     struct timer_ *timer_nd;
 
     int fd_tx;
-    int fd_rx;
     struct tpacket_req req_tx;
-    struct tpacket_req req_rx;
     struct sockaddr_ll addr;
 
     u_char *ring_tx; /* ringbuffer */
-    u_char *ring_rx; /* ringbuffer */
     uint cursor_tx; /* slot # inside the ringbuffer */
-    uint cursor_rx; /* slot # inside the ringbuffer */
+    uint cursor_tx_done; /* oldest slot owned by the kernel */
+    uint tx_inflight; /* frames owned by the kernel */
+    uint tx_pending; /* frames written since the last kick */
+    uint tx_flush_threshold; /* kick the kernel early with this number of frames pending */
+    bool tx_kick_retry; /* last kick returned EAGAIN */
+    uint tx_class_slots[BBL_TX_CLASS_MAX]; /* ring slots per TX job and class */
+    uint tx_class_budget[BBL_TX_CLASS_MAX]; /* ring slots left in this TX job */
+
+    bool rx_tpacket_v3; /* block based RX rings */
+    uint8_t rx_ring_count; /* > 1 with PACKET_FANOUT */
+    bbl_rx_ring_s rx_ring[BBL_MAX_FANOUT];
+
+    bbl_io_mode_t io_mode;
+    bool io_data; /* data plane served by the I/O threads, see bbl_io_data.c */
+    bbl_timestamping_t timestamping;
+    uint64_t *tx_slot_timestamp; /* TX ring frame write times (timestamping only) */
+    int phc_fd; /* PTP hardware clock of the NIC (hardware timestamping only) */
+    int64_t phc_offset; /* CLOCK_REALTIME minus PHC time in nanoseconds */
+    const bbl_io_ops_s *io_ops; /* TX backend */
+    struct bbl_io_thread_ *io_thread; /* optional I/O thread of the first RX ring, also serving TX */
+    struct bbl_xdp_ *xdp; /* AF_XDP socket and rings */
+
+    bbl_session_table_s session_table; /* access sessions by VLAN */
 
     uint32_t pcap_index; /* interface index for packet captures */
 
@@ -174,110 +390,25 @@ typedef struct bbl_interface_
     ipv6_prefix ip6;
     ipv6_prefix gateway6;
 
-    uint8_t *mc_packets;
-    uint     mc_packet_len;
-    uint64_t mc_packet_seq;
+    bbl_mc_stream_s *mc_streams;
+    uint32_t mc_stream_count;
+    bbl_calendar_s *mc_calendar;
 
-    struct {
-        uint64_t packets_tx;
-        uint64_t packets_rx;
-        bbl_rate_s rate_packets_tx;
-        bbl_rate_s rate_packets_rx;
-        uint64_t packets_rx_drop_unknown;
-        uint64_t packets_rx_drop_decode_error;
-        uint64_t sendto_failed;
-        uint64_t no_tx_buffer;
-        uint64_t poll_tx;
-        uint64_t poll_rx;
-        uint64_t encode_errors;
-
-        uint64_t mc_tx;
-        bbl_rate_s rate_mc_tx;
-        uint64_t mc_rx;
-        bbl_rate_s rate_mc_rx;
-        uint64_t mc_loss;
-
-        /* Packet Stats */
-        uint32_t arp_tx;
-        uint32_t arp_rx;
-        uint32_t padi_tx;
-        uint32_t pado_rx;
-        uint32_t padr_tx;
-        uint32_t pads_rx;
-        uint32_t padt_tx;
-        uint32_t padt_rx;
-        uint32_t lcp_tx;
-        uint32_t lcp_rx;
-        uint32_t lcp_timeout;
-        uint32_t lcp_echo_timeout;
-        uint32_t pap_tx;
-        uint32_t pap_rx;
-        uint32_t pap_timeout;
-        uint32_t chap_tx;
-        uint32_t chap_rx;
-        uint32_t chap_timeout;
-        uint32_t ipcp_tx;
-        uint32_t ipcp_rx;
-        uint32_t ipcp_timeout;
-        uint32_t ip6cp_tx;
-        uint32_t ip6cp_rx;
-        uint32_t ip6cp_timeout;
-        uint32_t igmp_rx;
-        uint32_t igmp_tx;
-        uint32_t icmp_tx;
-        uint32_t icmp_rx;
-        uint32_t icmpv6_tx;
-        uint32_t icmpv6_rx;
-        uint32_t icmpv6_rs_timeout;
-
-        uint32_t dhcpv6_tx;
-        uint32_t dhcpv6_rx;
-        uint32_t dhcpv6_timeout;
-
-        uint64_t session_ipv4_tx;
-        bbl_rate_s rate_session_ipv4_tx;
-        uint64_t session_ipv4_rx;
-        bbl_rate_s rate_session_ipv4_rx;
-        uint64_t session_ipv4_loss;
-
-        uint64_t session_ipv6_tx;
-        bbl_rate_s rate_session_ipv6_tx;
-        uint64_t session_ipv6_rx;
-        bbl_rate_s rate_session_ipv6_rx;
-        uint64_t session_ipv6_loss;
-
-        uint64_t session_ipv6pd_tx;
-        bbl_rate_s rate_session_ipv6pd_tx;
-        uint64_t session_ipv6pd_rx;
-        bbl_rate_s rate_session_ipv6pd_rx;
-        uint64_t session_ipv6pd_loss;
-
-        uint64_t session_ipv4_wrong_session;
-        uint64_t session_ipv6_wrong_session;
-        uint64_t session_ipv6pd_wrong_session;
-
-        uint32_t l2tp_control_rx;
-        uint32_t l2tp_control_rx_dup; /* duplicate */
-        uint32_t l2tp_control_rx_ooo; /* out of order */
-        uint32_t l2tp_control_rx_nf;  /* session not found */
-        uint32_t l2tp_control_tx;
-        uint32_t l2tp_control_retry;
-        uint64_t l2tp_data_rx;
-        uint64_t l2tp_data_tx;
-        bbl_rate_s rate_l2tp_data_rx;
-        bbl_rate_s rate_l2tp_data_tx;
-
-        uint64_t li_rx;
-        bbl_rate_s rate_li_rx;
-    } stats;
+    bbl_calendar_s *stream_calendar; /* streams sent on this interface */
+    uint32_t stream_count;
+
+    bbl_calendar_s *traffic_calendar; /* session traffic flows sent on this interface */
+    uint32_t traffic_flows;
+
+    bbl_interface_stats_s stats;
 
     struct timer_ *tx_job;
-    struct timer_ *rx_job;
     struct timer_ *rate_job;
+    struct timer_ *phc_job;
 
     struct timespec tx_timestamp; /* user space timestamps */
-    struct timespec rx_timestamp; /* user space timestamps */
     CIRCLEQ_HEAD(bbl_interface__, bbl_session_ ) session_tx_qhead; /* list of sessions that want to transmit */
+    CIRCLEQ_HEAD(bbl_interface____, bbl_session_ ) session_keepalive_qhead; /* list of sessions that want to transmit keepalives */
     CIRCLEQ_HEAD(bbl_interface___, bbl_l2tp_queue_ ) l2tp_tx_qhead; /* list of messages that want to transmit */
 } bbl_interface_s;
 
@@ -299,6 +430,8 @@ typedef struct bbl_access_config_
         uint16_t access_inner_vlan_max;
         uint16_t access_third_vlan;
 
+        bbl_interface_config_s interface_config;
+
         /* Static */
         uint32_t static_ip;
         uint32_t static_ip_iter;
@@ -326,6 +459,7 @@ typedef struct bbl_access_config_
         bool igmp_autostart;
         uint8_t igmp_version;
         bool session_traffic_autostart;
+        uint16_t stream_group_id;
 
         void *next; /* pointer to next access config element */
 } bbl_access_config_s;
@@ -365,13 +499,19 @@ typedef struct bbl_ctx_
     uint32_t l2tp_tunnels_established;
     uint32_t l2tp_tunnels_established_max;
 
-    CIRCLEQ_HEAD(bbl_ctx_idle_, bbl_session_ ) sessions_idle_qhead;
-    CIRCLEQ_HEAD(bbl_ctx_teardown_, bbl_session_ ) sessions_teardown_qhead;
+    CIRCLEQ_HEAD(bbl_ctx_idle_, bbl_session_cold_ ) sessions_idle_qhead;
+    CIRCLEQ_HEAD(bbl_ctx_teardown_, bbl_session_cold_ ) sessions_teardown_qhead;
     CIRCLEQ_HEAD(bbl_ctx__, bbl_interface_ ) interface_qhead; /* list of interfaces */
 
-    dict *session_dict; /* hashtable for sessions */
-    dict *l2tp_session_dict; /* hashtable for L2TP sessions */
-    dict *li_flow_dict; /* hashtable for LI flows */
+    bbl_arena_s session_arena; /* all sessions in one contiguous mapping */
+    bbl_arena_s session_cold_arena; /* control plane data of all sessions */
+    bbl_arena_s template_arena; /* session traffic templates */
+    bbl_arena_s stream_arena; /* streams and their templates */
+
+    bbl_dict_s session_dict; /* hashtable for sessions */
+    bbl_dict_s l2tp_session_dict; /* hashtable for L2TP sessions */
+    bbl_dict_s li_flow_dict; /* hashtable for LI flows */
+    bbl_dict_s stream_flow_dict; /* hashtable for streams by flow identifier */
 
     uint16_t next_tunnel_id;
 
@@ -379,11 +519,15 @@ typedef struct bbl_ctx_
 
     int ctrl_socket;
     char *ctrl_socket_path;
+    bbl_event_s ctrl_socket_event;
+
+    bbl_event_loop_s *event_loop; /* NULL if not enabled */
 
     /* Operational state */
     struct {
         uint8_t access_if_count;
         struct bbl_interface_ *access_if[BBL_MAX_ACCESS_INTERFACES];
+        struct bbl_interface_ *access_if_map[BBL_ACCESS_IF_MAP]; /* indexed by ifindex */
         struct bbl_interface_ *network_if;
     } op;
 
@@ -395,10 +539,27 @@ typedef struct bbl_ctx_
     struct {
         int fd;
         char *filename;
-        uint8_t *write_buf;
+        bool enabled;
+        uint8_t *write_buf; /* current capture buffer */
         uint write_idx;
-        bool wrote_header;
+        uint32_t write_packets;
+        uint8_t *header; /* section and interface headers */
+        uint header_len;
         uint32_t index; /* next to be allocated interface index */
+        bool filter; /* capture filter configured */
+        bool *capture; /* capture enabled per interface index */
+        uint32_t sample_count;
+        bbl_spsc_s *queue; /* capture buffers passed to the writer thread */
+        pthread_t thread;
+        atomic_bool stop;
+        uint64_t packets;
+        uint64_t packets_dropped; /* no free capture buffer */
+        uint64_t packets_filtered; /* not matching the capture filter */
+        _Atomic uint64_t packets_written;
+        _Atomic uint64_t packets_write_dropped; /* buffer not written */
+        _Atomic uint32_t opened; /* set by the writer thread */
+        uint32_t opened_logged;
+        atomic_int write_error; /* last errno of the writer thread */
     } pcap;
 
     /* Global Stats */
@@ -415,6 +576,8 @@ typedef struct bbl_ctx_
         uint32_t sessions_established_max;
         uint32_t session_traffic_flows;
         uint32_t session_traffic_flows_verified;
+        uint32_t stream_flows;
+        uint32_t stream_flows_verified;
     } stats;
 
     bool multicast_traffic;
@@ -423,8 +586,20 @@ typedef struct bbl_ctx_
     struct {
         uint16_t tx_interval;
         uint16_t rx_interval;
+        uint16_t tx_flush_threshold;
+        uint8_t tx_share[BBL_TX_CLASS_MAX]; /* percent of TX ring slots per TX job */
         
         bool qdisc_bypass;
+        bool rx_fast_path;
+
+        bool rx_tpacket_v3;
+        uint32_t rx_block_size;
+        uint16_t rx_block_timeout;
+
+        bool io_threads;
+        bool event_loop;
+        bool busy_poll;
+        uint16_t busy_poll_usec;
 
         char *json_report_filename;
 
@@ -435,6 +610,7 @@ typedef struct bbl_ctx_
         ipv6_prefix network_ip6;
         ipv6_prefix network_gateway6;
         uint16_t network_vlan;
+        bbl_interface_config_s network_interface_config;
 
         bbl_secondary_ip_s *secondary_ip_addresses;
 
@@ -447,6 +623,7 @@ typedef struct bbl_ctx_
         uint16_t sessions_start_rate;
         uint16_t sessions_stop_rate;
         bool iterate_outer_vlan;
+        bool sessions_hugepages;
 
         /* Static */
         uint32_t static_ip;
@@ -528,12 +705,28 @@ typedef struct bbl_ctx_
 
         /* Multicast Traffic */
         bool send_multicast_traffic;
+        uint32_t multicast_traffic_pps;
+        uint16_t multicast_traffic_len;
+        bbl_mc_traffic_config_s *multicast_traffic_config;
 
         /* Session Traffic */
         bool session_traffic_autostart;
         uint16_t session_traffic_ipv4_pps;
         uint16_t session_traffic_ipv6_pps;
         uint16_t session_traffic_ipv6pd_pps;
+        bool session_traffic_histogram;
+
+        /* Packet Capture */
+        char **pcap_interfaces; /* NULL for all interfaces */
+        uint8_t pcap_interfaces_count;
+        uint8_t pcap_direction;
+        uint8_t pcap_traffic;
+        uint32_t pcap_snaplen;
+        uint32_t pcap_sample;
+        bbl_bpf_s *pcap_bpf;
+
+        /* Traffic Streams */
+        bbl_stream_config_s *stream_config;
 
         /* L2TP Server Config (LNS) */
         bbl_l2tp_server_t *l2tp_server;
@@ -580,35 +773,81 @@ typedef struct session_key_ {
     uint16_t inner_vlan_id;
 } __attribute__ ((__packed__)) session_key_t;
 
-#define BBL_SESSION_HASHTABLE_SIZE 32771 /* is a prime number */
+/*
+ * Prebuilt control packets which are sent repeatedly
+ * (retries and keepalives) with at most the PPP
+ * identifier changed.
+ */
+typedef enum {
+    BBL_TX_TEMPLATE_PADI = 0,
+    BBL_TX_TEMPLATE_PADR,
+    BBL_TX_TEMPLATE_LCP_CONF_REQUEST,
+    BBL_TX_TEMPLATE_LCP_ECHO_REQUEST,
+    BBL_TX_TEMPLATE_LCP_ECHO_REPLY,
+    BBL_TX_TEMPLATE_ARP_REQUEST,
+    BBL_TX_TEMPLATE_MAX
+} __attribute__ ((__packed__)) bbl_tx_template_t;
+
+typedef struct bbl_tx_template_ {
+    uint16_t len; /* 0 if invalid */
+    uint16_t size; /* allocated data bytes */
+    uint16_t identifier_offset; /* 0 if there is nothing to patch */
+    uint8_t data[];
+} bbl_tx_template_s;
 
 /*
- * Client Session to a BNG device.
+ * Session traffic flows, the access flow of each
+ * address family is followed by the network flow.
  */
-typedef struct bbl_session_
-{
-    uint64_t session_id; // internal session identifier */
-    session_state_t session_state;
-    uint32_t send_requests;
-    uint32_t network_send_requests;
+typedef enum {
+    BBL_SESSION_FLOW_ACCESS_IPV4 = 0,
+    BBL_SESSION_FLOW_NETWORK_IPV4,
+    BBL_SESSION_FLOW_ACCESS_IPV6,
+    BBL_SESSION_FLOW_NETWORK_IPV6,
+    BBL_SESSION_FLOW_ACCESS_IPV6PD,
+    BBL_SESSION_FLOW_NETWORK_IPV6PD,
+    BBL_SESSION_FLOW_MAX
+} __attribute__ ((__packed__)) bbl_session_flow_t;
 
-    CIRCLEQ_ENTRY(bbl_session_) session_tx_qnode;
-    CIRCLEQ_ENTRY(bbl_session_) session_idle_qnode;
-    CIRCLEQ_ENTRY(bbl_session_) session_teardown_qnode;
-    CIRCLEQ_ENTRY(bbl_session_) session_network_tx_qnode;
+/*
+ * Session traffic flow scheduled by the traffic
+ * calendar of the sending interface.
+ */
+typedef struct bbl_session_flow_ {
+    bbl_calendar_entry_s entry; /* must be first */
+    struct bbl_session_ *session;
+    bbl_session_flow_t type;
+    bool scheduled;
+    bbl_latency_s latency; /* measured at the receiver of this flow */
+    bbl_latency_histogram_s *latency_histogram; /* optional */
+    bbl_latency_histogram_s *jitter_histogram; /* optional */
+
+    /* Flow state passed to the sending I/O thread (control thread). */
+    bool io_started; /* started with bbl_session_traffic_start() */
+    bool io_active; /* template passed to the I/O thread */
+    uint64_t io_interval;
+    uint64_t io_flow_id; /* flow identifier of the template passed */
+
+    /* Private to the sending I/O thread. */
+    uint8_t *io_template;
+    uint16_t io_len; /* 0 if stopped */
+    uint64_t io_seq;
+} bbl_session_flow_s;
 
-    /* Key in the hashtable */
-    struct {
-        uint32_t ifindex;
-        uint16_t outer_vlan_id;
-        uint16_t inner_vlan_id;
-    } key;
+/*
+ * Control plane data of a session which is not
+ * needed to send and receive session traffic.
+ */
+typedef struct bbl_session_cold_
+{
+    struct bbl_session_ *session; /* back pointer */
 
-    struct bbl_interface_ *interface; /* where this session is attached to */
-    struct bbl_access_config_ *access_config;
+    CIRCLEQ_ENTRY(bbl_session_cold_) session_idle_qnode;
+    CIRCLEQ_ENTRY(bbl_session_cold_) session_teardown_qnode;
 
-    uint8_t *write_buf; /* pointer to the slot in the tx_ring */
-    uint16_t write_idx;
+    struct bbl_access_config_ *access_config;
+    bbl_tx_template_s *tx_template[BBL_TX_TEMPLATE_MAX];
+    uint16_t tx_packet_size[BBL_SESSION_FLOW_MAX]; /* allocated bytes of the session traffic templates */
 
     /* Session timer */
     struct timer_ *timer_arp;
@@ -624,49 +863,13 @@ typedef struct bbl_session_
     struct timer_ *timer_zapping;
     struct timer_ *timer_icmpv6;
     struct timer_ *timer_session;
-    struct timer_ *timer_session_traffic_ipv4;
-    struct timer_ *timer_session_traffic_ipv6;
-    struct timer_ *timer_session_traffic_ipv6pd;
-
-    bbl_access_type_t access_type;
-    uint16_t access_third_vlan;
-    
-    /* Set to true if session is tunnelled via L2TP. */
-    bool l2tp;
-
-    /* Authentication */
-    char *username;
-    char *password;
-
-    uint8_t chap_identifier;
-    uint8_t chap_response[CHALLENGE_LEN];
-
-    /* Access Line */
-    char *agent_circuit_id;
-    char *agent_remote_id;
-    uint32_t rate_up;
-    uint32_t rate_down;
-
-    /* Ethernet */
-    uint8_t server_mac[ETH_ADDR_LEN];
-    uint8_t client_mac[ETH_ADDR_LEN];
-
-    /* PPPoE */
-    uint16_t pppoe_session_id;
-    uint8_t *pppoe_ac_cookie;
-    uint16_t pppoe_ac_cookie_len;
-    uint8_t *pppoe_service_name;
-    uint16_t pppoe_service_name_len;
-    uint64_t pppoe_host_uniq;
 
     /* LCP */
-    ppp_state_t lcp_state;
     uint8_t     lcp_response_code;
     uint8_t     lcp_request_code;
-    uint8_t     lcp_options[PPP_OPTIONS_BUFFER];
-    uint16_t    lcp_options_len;
     uint8_t     lcp_identifier;
     uint8_t     lcp_peer_identifier;
+    uint8_t     lcp_echo_peer_identifier;
     uint8_t     lcp_retries;
     uint32_t    magic_number;
     uint32_t    peer_magic_number;
@@ -676,52 +879,65 @@ typedef struct bbl_session_
     uint8_t     auth_retries;
 
     /* IPCP */
-    ppp_state_t ipcp_state;
     uint8_t     ipcp_response_code;
     uint8_t     ipcp_request_code;
-    uint8_t     ipcp_options[PPP_OPTIONS_BUFFER];
-    uint16_t    ipcp_options_len;
     uint8_t     ipcp_identifier;
     uint8_t     ipcp_peer_identifier;
     uint8_t     ipcp_retries;
 
     /* IP6CP */
-    ppp_state_t ip6cp_state;
     uint8_t     ip6cp_response_code;
     uint8_t     ip6cp_request_code;
-    uint8_t     ip6cp_options[PPP_OPTIONS_BUFFER];
-    uint16_t    ip6cp_options_len;
     uint8_t     ip6cp_identifier;
     uint8_t     ip6cp_peer_identifier;
     uint8_t     ip6cp_retries;
     uint64_t    ip6cp_ipv6_identifier;
     uint64_t    ip6cp_ipv6_peer_identifier;
 
-    /* IPv4 */
-    bool        arp_resolved;
-    uint32_t    ip_address;
-    uint32_t    peer_ip_address;
+    /* Authentication */
+    char *username;
+    char *password;
+
+    uint8_t chap_identifier;
+    uint8_t chap_response[CHALLENGE_LEN];
+
+    /* Access Line */
+    char *agent_circuit_id;
+    char *agent_remote_id;
+    uint32_t rate_up;
+    uint32_t rate_down;
+
+    /* PPPoE */
+    uint8_t *pppoe_ac_cookie;
+    uint16_t pppoe_ac_cookie_len;
+    uint8_t *pppoe_service_name;
+    uint16_t pppoe_service_name_len;
+    uint64_t pppoe_host_uniq;
+
+    /* PPP options */
+    uint8_t     lcp_options[PPP_OPTIONS_BUFFER];
+    uint16_t    lcp_options_len;
+    uint8_t     ipcp_options[PPP_OPTIONS_BUFFER];
+    uint16_t    ipcp_options_len;
+    uint8_t     ip6cp_options[PPP_OPTIONS_BUFFER];
+    uint16_t    ip6cp_options_len;
+
+    /* DNS */
     uint32_t    dns1;
     uint32_t    dns2;
+    ipv6addr_t  ipv6_dns1; /* DNS learned via RA */
+    ipv6addr_t  ipv6_dns2; /* DNS learned via RA */
 
     /* IPv6 */
-    bool        icmpv6_nd_resolved;
-    bool        icmpv6_ra_received;
     ipv6addr_t  link_local_ipv6_address;
-    ipv6_prefix ipv6_prefix;
-    ipv6addr_t  ipv6_address;
-    ipv6addr_t  ipv6_dns1; /* DNS learned via RA */
-    ipv6addr_t  ipv6_dns2; /* DNS learned via RA */
 
     /* DHCPv6 */
-    ipv6_prefix delegated_ipv6_prefix;
-    ipv6addr_t  delegated_ipv6_address;
-    uint8_t     duid[DUID_LEN];
-    uint8_t     server_duid[DHCPV6_BUFFER];
-    uint8_t     server_duid_len;
     bool        dhcpv6_requested;
     bool        dhcpv6_received;
     uint8_t     dhcpv6_type;
+    uint8_t     duid[DUID_LEN];
+    uint8_t     server_duid[DHCPV6_BUFFER];
+    uint8_t     server_duid_len;
     uint8_t     dhcpv6_ia_pd_option[DHCPV6_BUFFER];
     uint8_t     dhcpv6_ia_pd_option_len;
     ipv6addr_t  dhcpv6_dns1;
@@ -750,54 +966,120 @@ typedef struct bbl_session_
     uint8_t  icmp_reply_data[ICMP_DATA_BUFFER];
     uint16_t icmp_reply_data_len;
 
-    /* Multicast Traffic */
-    uint64_t mc_rx_last_seq;
+    /* Traffic Streams */
+    struct bbl_stream_ *streams;
+} bbl_session_cold_s;
+
+/*
+ * Client Session to a BNG device.
+ *
+ * All fields used by the TX job and the RX handlers for session
+ * traffic are grouped at the start of the session, followed by
+ * the addresses. Protocol negotiation state, timers and control
+ * packet templates are stored out-of-line in the cold part of
+ * the session.
+ */
+typedef struct bbl_session_
+{
+    uint64_t session_id; // internal session identifier */
+    session_state_t session_state;
+    uint32_t send_requests;
+
+    CIRCLEQ_ENTRY(bbl_session_) session_tx_qnode;
+    CIRCLEQ_ENTRY(bbl_session_) session_keepalive_qnode;
+
+    /* Key in the hashtable */
+    struct {
+        uint32_t ifindex;
+        uint16_t outer_vlan_id;
+        uint16_t inner_vlan_id;
+    } key;
+
+    struct bbl_interface_ *interface; /* where this session is attached to */
+
+    uint8_t *write_buf; /* pointer to the slot in the tx_ring */
+    uint16_t write_idx;
+
+    bbl_access_type_t access_type;
+    uint16_t access_third_vlan;
+
+    /* Set to true if session is tunnelled via L2TP. */
+    bool l2tp;
+
+    /* PPP states, checked for each session traffic packet */
+    ppp_state_t lcp_state;
+    ppp_state_t ipcp_state;
+    ppp_state_t ip6cp_state;
 
     /* Session Traffic */
     bool session_traffic;
-    uint64_t access_ipv4_tx_flow_id;
-    uint64_t access_ipv4_tx_seq;
+    bool io_rx_active; /* accounted by the I/O threads (atomic) */
     uint8_t *access_ipv4_tx_packet_template;
-    uint8_t  access_ipv4_tx_packet_len;
+    uint16_t access_ipv4_tx_packet_len;
+    uint16_t network_ipv4_tx_packet_len;
+    uint16_t access_ipv6_tx_packet_len;
+    uint16_t network_ipv6_tx_packet_len;
+    uint16_t access_ipv6pd_tx_packet_len;
+    uint16_t network_ipv6pd_tx_packet_len;
+    uint8_t *network_ipv4_tx_packet_template;
+    uint8_t *access_ipv6_tx_packet_template;
+    uint8_t *network_ipv6_tx_packet_template;
+    uint8_t *access_ipv6pd_tx_packet_template;
+    uint8_t *network_ipv6pd_tx_packet_template;
+    bbl_session_flow_s *traffic_flows; /* BBL_SESSION_FLOW_MAX flows */
+
+    uint64_t access_ipv4_tx_seq;
     uint64_t access_ipv4_rx_first_seq;
     uint64_t access_ipv4_rx_last_seq;
-
-    uint64_t network_ipv4_tx_flow_id;
     uint64_t network_ipv4_tx_seq;
-    uint8_t *network_ipv4_tx_packet_template;
-    uint8_t  network_ipv4_tx_packet_len;
     uint64_t network_ipv4_rx_first_seq;
     uint64_t network_ipv4_rx_last_seq;
 
-    uint64_t access_ipv6_tx_flow_id;
     uint64_t access_ipv6_tx_seq;
-    uint8_t *access_ipv6_tx_packet_template;
-    uint8_t  access_ipv6_tx_packet_len;
     uint64_t access_ipv6_rx_first_seq;
     uint64_t access_ipv6_rx_last_seq;
-
-    uint64_t network_ipv6_tx_flow_id;
     uint64_t network_ipv6_tx_seq;
-    uint8_t *network_ipv6_tx_packet_template;
-    uint8_t  network_ipv6_tx_packet_len;
     uint64_t network_ipv6_rx_first_seq;
     uint64_t network_ipv6_rx_last_seq;
 
-    uint64_t access_ipv6pd_tx_flow_id;
     uint64_t access_ipv6pd_tx_seq;
-    uint8_t *access_ipv6pd_tx_packet_template;
-    uint8_t  access_ipv6pd_tx_packet_len;
     uint64_t access_ipv6pd_rx_first_seq;
     uint64_t access_ipv6pd_rx_last_seq;
-
-    uint64_t network_ipv6pd_tx_flow_id;
     uint64_t network_ipv6pd_tx_seq;
-    uint8_t *network_ipv6pd_tx_packet_template;
-    uint8_t  network_ipv6pd_tx_packet_len;
     uint64_t network_ipv6pd_rx_first_seq;
     uint64_t network_ipv6pd_rx_last_seq;
 
+    uint64_t access_ipv4_tx_flow_id;
+    uint64_t network_ipv4_tx_flow_id;
+    uint64_t access_ipv6_tx_flow_id;
+    uint64_t network_ipv6_tx_flow_id;
+    uint64_t access_ipv6pd_tx_flow_id;
+    uint64_t network_ipv6pd_tx_flow_id;
+
+    /* Multicast Traffic */
+
     struct {
+        uint64_t access_ipv4_rx;
+        uint64_t access_ipv4_tx;
+        uint64_t access_ipv4_loss;
+        uint64_t network_ipv4_rx;
+        uint64_t network_ipv4_tx;
+        uint64_t network_ipv4_loss;
+
+        uint64_t access_ipv6_rx;
+        uint64_t access_ipv6_tx;
+        uint64_t access_ipv6_loss;
+        uint64_t network_ipv6_rx;
+        uint64_t network_ipv6_tx;
+        uint64_t network_ipv6_loss;
+
+        uint64_t access_ipv6pd_rx;
+        uint64_t access_ipv6pd_tx;
+        uint64_t access_ipv6pd_loss;
+        uint64_t network_ipv6pd_rx;
+        uint64_t network_ipv6pd_tx;
+        uint64_t network_ipv6pd_loss;
+
         uint32_t igmp_rx;
         uint32_t igmp_tx;
 
@@ -821,39 +1103,42 @@ typedef struct bbl_session_
         uint32_t icmpv6_rx;
         uint32_t icmpv6_tx;
 
-        uint64_t access_ipv4_rx;
-        uint64_t access_ipv4_tx;
-        uint64_t access_ipv4_loss;
-        uint64_t network_ipv4_rx;
-        uint64_t network_ipv4_tx;
-        uint64_t network_ipv4_loss;
+        uint32_t flapped; // flap counter
+    } stats;
 
-        uint64_t access_ipv6_rx;
-        uint64_t access_ipv6_tx;
-        uint64_t access_ipv6_loss;
-        uint64_t network_ipv6_rx;
-        uint64_t network_ipv6_tx;
-        uint64_t network_ipv6_loss;
+    /* Ethernet */
+    uint8_t server_mac[ETH_ADDR_LEN];
+    uint8_t client_mac[ETH_ADDR_LEN];
 
-        uint64_t access_ipv6pd_rx;
-        uint64_t access_ipv6pd_tx;
-        uint64_t access_ipv6pd_loss;
-        uint64_t network_ipv6pd_rx;
-        uint64_t network_ipv6pd_tx;
-        uint64_t network_ipv6pd_loss;
+    /* PPPoE */
+    uint16_t pppoe_session_id;
 
-        uint32_t flapped; // flap counter
-    } stats;
+    /* IPv4 */
+    bool        arp_resolved;
+    uint32_t    ip_address;
+    uint32_t    peer_ip_address;
 
+    /* IPv6 */
+    bool        icmpv6_nd_resolved;
+    bool        icmpv6_ra_received;
+    ipv6_prefix ipv6_prefix;
+    ipv6addr_t  ipv6_address;
+
+    /* DHCPv6 */
+    ipv6_prefix delegated_ipv6_prefix;
+    ipv6addr_t  delegated_ipv6_address;
 
+    bbl_session_cold_s *cold; /* control plane data */
 } bbl_session_s;
 
 void bbl_session_tx_qnode_insert(struct bbl_session_ *session);
 void bbl_session_tx_qnode_remove(struct bbl_session_ *session);
-void bbl_session_network_tx_qnode_insert(struct bbl_session_ *session);
-void bbl_session_network_tx_qnode_remove(struct bbl_session_ *session);
+void bbl_session_keepalive_qnode_remove(struct bbl_session_ *session);
 void bbl_session_update_state(bbl_ctx_s *ctx, bbl_session_s *session, session_state_t state);
 void bbl_session_clear(bbl_ctx_s *ctx, bbl_session_s *session);
+void bbl_session_io_update(bbl_ctx_s *ctx, bbl_session_s *session);
+void bbl_session_io_update_all(bbl_ctx_s *ctx);
+bbl_session_s *bbl_session_get(bbl_ctx_s *ctx, session_key_t *key);
 bbl_ctx_s * bbl_add_ctx (void);
 
 WINDOW *log_win;
@@ -0,0 +1,122 @@
+/*
+ * BNG Blaster (BBL) - Memory Arena
+ *
+ * Objects are carved sequentially out of large anonymous mappings,
+ * which can be backed by hugepages. There is no way to free single
+ * objects, all memory is returned at once with bbl_arena_free().
+ * Compared to one malloc per object this avoids the per allocation
+ * overhead and places objects allocated in sequence next to each
+ * other in memory.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include "bbl_arena.h"
+
+#define BBL_ARENA_ALIGN(_x, _a) (((_x) + ((_a) - 1)) & ~((_a) - 1))
+
+void
+bbl_arena_init (bbl_arena_s *arena, const char *name, size_t chunk_size, bool hugepages)
+{
+    bbl_arena_free(arena);
+    arena->name = name;
+    arena->chunk_size = chunk_size;
+    arena->hugepages = hugepages;
+}
+
+static bbl_arena_chunk_s *
+bbl_arena_chunk_new (bbl_arena_s *arena, size_t size)
+{
+    bbl_arena_chunk_s *chunk = MAP_FAILED;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    bool hugetlb = false;
+
+    if(size < arena->chunk_size) {
+        size = arena->chunk_size;
+    }
+
+    if(arena->hugepages) {
+        size = BBL_ARENA_ALIGN(size, BBL_ARENA_HUGEPAGE_SIZE);
+#ifdef MAP_HUGETLB
+        chunk = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+        hugetlb = (chunk != MAP_FAILED);
+#endif
+    } else {
+        size = BBL_ARENA_ALIGN(size, page_size);
+    }
+    if(chunk == MAP_FAILED) {
+        chunk = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if(chunk == MAP_FAILED) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        if(arena->hugepages) {
+            /* No reserved hugepages, ask for transparent hugepages instead. */
+            madvise(chunk, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    /* Anonymous mappings are zero filled. */
+    chunk->next = arena->chunk;
+    chunk->size = size;
+    chunk->used = sizeof(bbl_arena_chunk_s);
+    arena->chunk = chunk;
+    arena->stats.chunks++;
+    arena->stats.mapped += size;
+    if(hugetlb) {
+        arena->stats.chunks_hugetlb++;
+    }
+    return chunk;
+}
+
+/*
+ * Allocate zeroed memory. The alignment must be a power of two.
+ */
+void *
+bbl_arena_alloc (bbl_arena_s *arena, size_t size, size_t align)
+{
+    bbl_arena_chunk_s *chunk = arena->chunk;
+    size_t offset;
+
+    if(!align) {
+        align = sizeof(void*);
+    }
+    if(chunk) {
+        offset = BBL_ARENA_ALIGN(chunk->used, align);
+        if(offset + size <= chunk->size) {
+            goto Alloc;
+        }
+    }
+    chunk = bbl_arena_chunk_new(arena, BBL_ARENA_ALIGN(sizeof(bbl_arena_chunk_s), align) + size);
+    if(!chunk) {
+        return NULL;
+    }
+    offset = BBL_ARENA_ALIGN(chunk->used, align);
+Alloc:
+    chunk->used = offset + size;
+    arena->stats.allocs++;
+    arena->stats.bytes += size;
+    return (uint8_t*)chunk + offset;
+}
+
+void
+bbl_arena_free (bbl_arena_s *arena)
+{
+    bbl_arena_chunk_s *chunk;
+
+    while(arena->chunk) {
+        chunk = arena->chunk;
+        arena->chunk = chunk->next;
+        munmap(chunk, chunk->size);
+    }
+    arena->stats.allocs = 0;
+    arena->stats.bytes = 0;
+    arena->stats.mapped = 0;
+    arena->stats.chunks = 0;
+    arena->stats.chunks_hugetlb = 0;
+}
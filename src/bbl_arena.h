@@ -0,0 +1,53 @@
+/*
+ * BNG Blaster (BBL) - Memory Arena
+ *
+ * Bump allocator for objects which live until the end of
+ * the test like sessions and their traffic templates.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_ARENA_H__
+#define __BBL_ARENA_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BBL_ARENA_CHUNK_SIZE    (2*1024*1024)
+#define BBL_ARENA_HUGEPAGE_SIZE (2*1024*1024)
+
+/*
+ * Arena memory is mapped in chunks. The chunk header
+ * is stored at the start of each mapping.
+ */
+typedef struct bbl_arena_chunk_
+{
+    struct bbl_arena_chunk_ *next;
+    size_t size; /* size of the mapping */
+    size_t used; /* including this header */
+} bbl_arena_chunk_s;
+
+typedef struct bbl_arena_
+{
+    const char *name;
+    size_t chunk_size;
+    bool hugepages; /* try MAP_HUGETLB, fallback to transparent hugepages */
+    bbl_arena_chunk_s *chunk; /* current chunk */
+
+    struct {
+        uint64_t allocs;
+        uint64_t bytes;
+        uint64_t mapped;
+        uint32_t chunks;
+        uint32_t chunks_hugetlb;
+    } stats;
+} bbl_arena_s;
+
+void bbl_arena_init(bbl_arena_s *arena, const char *name, size_t chunk_size, bool hugepages);
+void *bbl_arena_alloc(bbl_arena_s *arena, size_t size, size_t align);
+void bbl_arena_free(bbl_arena_s *arena);
+
+#endif
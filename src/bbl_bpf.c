@@ -0,0 +1,324 @@
+/*
+ * BNG Blaster (BBL) - Classic BPF
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "bbl_bpf.h"
+
+/*
+ * Read the next number of a program, numbers are
+ * separated by white space or comma.
+ */
+static bool
+bbl_bpf_number (const char **cursor, uint32_t *number)
+{
+    const char *s = *cursor;
+    char *end;
+    unsigned long value;
+
+    while(*s == ',' || isspace((unsigned char)*s)) {
+        s++;
+    }
+    if(!isdigit((unsigned char)*s)) {
+        return false;
+    }
+    value = strtoul(s, &end, 10);
+    if(value > UINT32_MAX) {
+        return false;
+    }
+    *number = value;
+    *cursor = end;
+    return true;
+}
+
+/*
+ * Parse and validate a compiled program in the format
+ * printed by tcpdump -ddd, with the number of instructions
+ * followed by code, jt, jf and k of each instruction, e.g.
+ * "4,40 0 0 12,21 0 1 2048,6 0 0 262144,6 0 0 0".
+ * Returns NULL if the program is invalid.
+ */
+bbl_bpf_s *
+bbl_bpf_new (const char *program)
+{
+    bbl_bpf_s *bpf;
+    uint32_t len, i;
+    uint32_t code, jt, jf, k;
+
+    if(!bbl_bpf_number(&program, &len) || !len || len > BPF_MAXINSNS) {
+        return NULL;
+    }
+    bpf = calloc(1, sizeof(bbl_bpf_s));
+    if(!bpf) {
+        return NULL;
+    }
+    bpf->len = len;
+    bpf->insns = calloc(len, sizeof(struct sock_filter));
+    if(!bpf->insns) {
+        free(bpf);
+        return NULL;
+    }
+    for(i = 0; i < len; i++) {
+        if(!(bbl_bpf_number(&program, &code) &&
+             bbl_bpf_number(&program, &jt) &&
+             bbl_bpf_number(&program, &jf) &&
+             bbl_bpf_number(&program, &k)) ||
+           code > UINT16_MAX || jt > UINT8_MAX || jf > UINT8_MAX) {
+            bbl_bpf_free(bpf);
+            return NULL;
+        }
+        bpf->insns[i].code = code;
+        bpf->insns[i].jt = jt;
+        bpf->insns[i].jf = jf;
+        bpf->insns[i].k = k;
+    }
+    while(*program == ',' || isspace((unsigned char)*program)) {
+        program++;
+    }
+    if(*program || !bbl_bpf_validate(bpf->insns, bpf->len)) {
+        bbl_bpf_free(bpf);
+        return NULL;
+    }
+    return bpf;
+}
+
+void
+bbl_bpf_free (bbl_bpf_s *bpf)
+{
+    if(bpf) {
+        free(bpf->insns);
+        free(bpf);
+    }
+}
+
+/*
+ * Check that all instructions are known, all jumps stay
+ * within the program, memory accesses are in bounds and
+ * the program ends with a return. This allows the
+ * interpreter to run without further checks except for
+ * the packet bounds and division by register X.
+ */
+bool
+bbl_bpf_validate (struct sock_filter *insns, uint16_t len)
+{
+    struct sock_filter *insn;
+    uint32_t i;
+
+    if(!len || len > BPF_MAXINSNS) {
+        return false;
+    }
+    for(i = 0; i < len; i++) {
+        insn = &insns[i];
+        switch(insn->code) {
+            case BPF_LD|BPF_W|BPF_ABS:
+            case BPF_LD|BPF_H|BPF_ABS:
+            case BPF_LD|BPF_B|BPF_ABS:
+            case BPF_LD|BPF_W|BPF_IND:
+            case BPF_LD|BPF_H|BPF_IND:
+            case BPF_LD|BPF_B|BPF_IND:
+            case BPF_LD|BPF_W|BPF_LEN:
+            case BPF_LD|BPF_IMM:
+            case BPF_LDX|BPF_W|BPF_LEN:
+            case BPF_LDX|BPF_B|BPF_MSH:
+            case BPF_LDX|BPF_IMM:
+            case BPF_ALU|BPF_ADD|BPF_K:
+            case BPF_ALU|BPF_ADD|BPF_X:
+            case BPF_ALU|BPF_SUB|BPF_K:
+            case BPF_ALU|BPF_SUB|BPF_X:
+            case BPF_ALU|BPF_MUL|BPF_K:
+            case BPF_ALU|BPF_MUL|BPF_X:
+            case BPF_ALU|BPF_DIV|BPF_X:
+            case BPF_ALU|BPF_MOD|BPF_X:
+            case BPF_ALU|BPF_AND|BPF_K:
+            case BPF_ALU|BPF_AND|BPF_X:
+            case BPF_ALU|BPF_OR|BPF_K:
+            case BPF_ALU|BPF_OR|BPF_X:
+            case BPF_ALU|BPF_XOR|BPF_K:
+            case BPF_ALU|BPF_XOR|BPF_X:
+            case BPF_ALU|BPF_LSH|BPF_X:
+            case BPF_ALU|BPF_RSH|BPF_X:
+            case BPF_ALU|BPF_NEG:
+            case BPF_RET|BPF_K:
+            case BPF_RET|BPF_X:
+            case BPF_RET|BPF_A:
+            case BPF_MISC|BPF_TAX:
+            case BPF_MISC|BPF_TXA:
+                break;
+            case BPF_LD|BPF_MEM:
+            case BPF_LDX|BPF_MEM:
+            case BPF_ST:
+            case BPF_STX:
+                if(insn->k >= BPF_MEMWORDS) {
+                    return false;
+                }
+                break;
+            case BPF_ALU|BPF_DIV|BPF_K:
+            case BPF_ALU|BPF_MOD|BPF_K:
+                if(!insn->k) {
+                    return false;
+                }
+                break;
+            case BPF_ALU|BPF_LSH|BPF_K:
+            case BPF_ALU|BPF_RSH|BPF_K:
+                if(insn->k >= 32) {
+                    return false;
+                }
+                break;
+            case BPF_JMP|BPF_JA:
+                if(insn->k >= (uint32_t)(len - i - 1)) {
+                    return false;
+                }
+                break;
+            case BPF_JMP|BPF_JEQ|BPF_K:
+            case BPF_JMP|BPF_JEQ|BPF_X:
+            case BPF_JMP|BPF_JGT|BPF_K:
+            case BPF_JMP|BPF_JGT|BPF_X:
+            case BPF_JMP|BPF_JGE|BPF_K:
+            case BPF_JMP|BPF_JGE|BPF_X:
+            case BPF_JMP|BPF_JSET|BPF_K:
+            case BPF_JMP|BPF_JSET|BPF_X:
+                if(i + 1 + insn->jt >= len || i + 1 + insn->jf >= len) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+    return BPF_CLASS(insns[len-1].code) == BPF_RET;
+}
+
+static inline bool
+bbl_bpf_load (const uint8_t *pkt, uint32_t len, uint64_t offset, uint32_t size, uint32_t *value)
+{
+    if(offset + size > len) {
+        return false;
+    }
+    pkt += offset;
+    switch(size) {
+        case 4:
+            *value = (uint32_t)pkt[0] << 24 | (uint32_t)pkt[1] << 16 | (uint32_t)pkt[2] << 8 | pkt[3];
+            break;
+        case 2:
+            *value = (uint32_t)pkt[0] << 8 | pkt[1];
+            break;
+        default:
+            *value = pkt[0];
+            break;
+    }
+    return true;
+}
+
+/*
+ * Run a validated program. Loads beyond the end
+ * of the packet and division by zero do not match.
+ */
+uint32_t
+bbl_bpf_filter (bbl_bpf_s *bpf, const uint8_t *pkt, uint32_t len)
+{
+    struct sock_filter *pc = bpf->insns;
+    uint32_t mem[BPF_MEMWORDS] = {0};
+    uint32_t a = 0;
+    uint32_t x = 0;
+
+    for(;; pc++) {
+        switch(pc->code) {
+            case BPF_LD|BPF_W|BPF_ABS:
+                if(!bbl_bpf_load(pkt, len, pc->k, 4, &a)) return 0;
+                break;
+            case BPF_LD|BPF_H|BPF_ABS:
+                if(!bbl_bpf_load(pkt, len, pc->k, 2, &a)) return 0;
+                break;
+            case BPF_LD|BPF_B|BPF_ABS:
+                if(!bbl_bpf_load(pkt, len, pc->k, 1, &a)) return 0;
+                break;
+            case BPF_LD|BPF_W|BPF_IND:
+                if(!bbl_bpf_load(pkt, len, (uint64_t)pc->k + x, 4, &a)) return 0;
+                break;
+            case BPF_LD|BPF_H|BPF_IND:
+                if(!bbl_bpf_load(pkt, len, (uint64_t)pc->k + x, 2, &a)) return 0;
+                break;
+            case BPF_LD|BPF_B|BPF_IND:
+                if(!bbl_bpf_load(pkt, len, (uint64_t)pc->k + x, 1, &a)) return 0;
+                break;
+            case BPF_LD|BPF_W|BPF_LEN:
+                a = len;
+                break;
+            case BPF_LD|BPF_IMM:
+                a = pc->k;
+                break;
+            case BPF_LD|BPF_MEM:
+                a = mem[pc->k];
+                break;
+            case BPF_LDX|BPF_W|BPF_LEN:
+                x = len;
+                break;
+            case BPF_LDX|BPF_B|BPF_MSH:
+                if(!bbl_bpf_load(pkt, len, pc->k, 1, &x)) return 0;
+                x = (x & 0xf) << 2;
+                break;
+            case BPF_LDX|BPF_IMM:
+                x = pc->k;
+                break;
+            case BPF_LDX|BPF_MEM:
+                x = mem[pc->k];
+                break;
+            case BPF_ST:
+                mem[pc->k] = a;
+                break;
+            case BPF_STX:
+                mem[pc->k] = x;
+                break;
+            case BPF_ALU|BPF_ADD|BPF_K: a += pc->k; break;
+            case BPF_ALU|BPF_ADD|BPF_X: a += x; break;
+            case BPF_ALU|BPF_SUB|BPF_K: a -= pc->k; break;
+            case BPF_ALU|BPF_SUB|BPF_X: a -= x; break;
+            case BPF_ALU|BPF_MUL|BPF_K: a *= pc->k; break;
+            case BPF_ALU|BPF_MUL|BPF_X: a *= x; break;
+            case BPF_ALU|BPF_DIV|BPF_K: a /= pc->k; break;
+            case BPF_ALU|BPF_DIV|BPF_X:
+                if(!x) return 0;
+                a /= x;
+                break;
+            case BPF_ALU|BPF_MOD|BPF_K: a %= pc->k; break;
+            case BPF_ALU|BPF_MOD|BPF_X:
+                if(!x) return 0;
+                a %= x;
+                break;
+            case BPF_ALU|BPF_AND|BPF_K: a &= pc->k; break;
+            case BPF_ALU|BPF_AND|BPF_X: a &= x; break;
+            case BPF_ALU|BPF_OR|BPF_K: a |= pc->k; break;
+            case BPF_ALU|BPF_OR|BPF_X: a |= x; break;
+            case BPF_ALU|BPF_XOR|BPF_K: a ^= pc->k; break;
+            case BPF_ALU|BPF_XOR|BPF_X: a ^= x; break;
+            case BPF_ALU|BPF_LSH|BPF_K: a <<= pc->k; break;
+            case BPF_ALU|BPF_LSH|BPF_X: a = x < 32 ? a << x : 0; break;
+            case BPF_ALU|BPF_RSH|BPF_K: a >>= pc->k; break;
+            case BPF_ALU|BPF_RSH|BPF_X: a = x < 32 ? a >> x : 0; break;
+            case BPF_ALU|BPF_NEG: a = -a; break;
+            case BPF_JMP|BPF_JA: pc += pc->k; break;
+            case BPF_JMP|BPF_JEQ|BPF_K: pc += (a == pc->k) ? pc->jt : pc->jf; break;
+            case BPF_JMP|BPF_JEQ|BPF_X: pc += (a == x) ? pc->jt : pc->jf; break;
+            case BPF_JMP|BPF_JGT|BPF_K: pc += (a > pc->k) ? pc->jt : pc->jf; break;
+            case BPF_JMP|BPF_JGT|BPF_X: pc += (a > x) ? pc->jt : pc->jf; break;
+            case BPF_JMP|BPF_JGE|BPF_K: pc += (a >= pc->k) ? pc->jt : pc->jf; break;
+            case BPF_JMP|BPF_JGE|BPF_X: pc += (a >= x) ? pc->jt : pc->jf; break;
+            case BPF_JMP|BPF_JSET|BPF_K: pc += (a & pc->k) ? pc->jt : pc->jf; break;
+            case BPF_JMP|BPF_JSET|BPF_X: pc += (a & x) ? pc->jt : pc->jf; break;
+            case BPF_RET|BPF_K: return pc->k;
+            case BPF_RET|BPF_X: return x;
+            case BPF_RET|BPF_A: return a;
+            case BPF_MISC|BPF_TAX: x = a; break;
+            case BPF_MISC|BPF_TXA: a = x; break;
+            default:
+                /* Not reached for validated programs. */
+                return 0;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+/*
+ * BNG Blaster (BBL) - Classic BPF
+ *
+ * Userspace interpreter for compiled classic BPF
+ * programs as printed by tcpdump -ddd.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_BPF_H__
+#define __BBL_BPF_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <linux/filter.h>
+
+typedef struct bbl_bpf_
+{
+    uint16_t len;
+    struct sock_filter *insns;
+} bbl_bpf_s;
+
+bbl_bpf_s *bbl_bpf_new(const char *program);
+void bbl_bpf_free(bbl_bpf_s *bpf);
+
+bool bbl_bpf_validate(struct sock_filter *insns, uint16_t len);
+
+/*
+ * Run the program against a packet. Returns the number of bytes
+ * to be captured or zero if the packet does not match.
+ */
+uint32_t bbl_bpf_filter(bbl_bpf_s *bpf, const uint8_t *pkt, uint32_t len);
+
+#endif
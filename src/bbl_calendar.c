@@ -0,0 +1,159 @@
+/*
+ * BNG Blaster (BBL) - Calendar Queue
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <stdlib.h>
+#include "bbl_calendar.h"
+
+static inline uint32_t
+bbl_calendar_slot (bbl_calendar_s *calendar, uint64_t time)
+{
+    return (time / calendar->tick) & (BBL_CALENDAR_SLOTS-1);
+}
+
+bbl_calendar_s *
+bbl_calendar_new (uint64_t tick, uint64_t now)
+{
+    bbl_calendar_s *calendar;
+
+    calendar = calloc(1, sizeof(bbl_calendar_s));
+    if(!calendar) {
+        return NULL;
+    }
+    calendar->tick = tick ? tick : BBL_CALENDAR_TICK_NSEC;
+    calendar->cursor = now - (now % calendar->tick);
+    return calendar;
+}
+
+/*
+ * Append the entry to the slot of its expire time. Entries
+ * which have already expired are added to the current slot.
+ */
+void
+bbl_calendar_add (bbl_calendar_s *calendar, bbl_calendar_entry_s *entry)
+{
+    uint32_t slot;
+
+    if(entry->expire < calendar->cursor) {
+        slot = bbl_calendar_slot(calendar, calendar->cursor);
+    } else {
+        slot = bbl_calendar_slot(calendar, entry->expire);
+    }
+    entry->next = NULL;
+    if(calendar->tail[slot]) {
+        calendar->tail[slot]->next = entry;
+    } else {
+        calendar->head[slot] = entry;
+    }
+    calendar->tail[slot] = entry;
+    calendar->entries++;
+}
+
+/*
+ * Put back the not processed entries in front of
+ * the slot, such that they are served first next time.
+ */
+static void
+bbl_calendar_prepend (bbl_calendar_s *calendar, uint32_t slot, bbl_calendar_entry_s *entry)
+{
+    bbl_calendar_entry_s *last = entry;
+
+    /* Only the first entry was taken out of the count. */
+    calendar->entries++;
+    while(last->next) {
+        last = last->next;
+    }
+    last->next = calendar->head[slot];
+    if(!calendar->head[slot]) {
+        calendar->tail[slot] = last;
+    }
+    calendar->head[slot] = entry;
+}
+
+/*
+ * Send all entries which are due until now. Entries are rescheduled
+ * after every sent or skipped entry, except if the send callback has
+ * reset the interval to zero to remove the entry. The run stops if the
+ * send callback defers, leaving the remaining entries due for the next run.
+ * Entries which fall behind more than the calendar horizon are rephased
+ * instead of sending the whole backlog at once.
+ *
+ * Returns the number of entries sent.
+ */
+uint32_t
+bbl_calendar_run (bbl_calendar_s *calendar, uint64_t now, bbl_calendar_send_fn send, void *arg)
+{
+    bbl_calendar_entry_s *entry, *next;
+    uint64_t horizon = calendar->tick * BBL_CALENDAR_SLOTS;
+    uint64_t slot_end;
+    uint32_t slot, slots = 0, sent = 0;
+    bbl_calendar_result_t result;
+    bool progress;
+
+    while(true) {
+        slot = bbl_calendar_slot(calendar, calendar->cursor);
+        slot_end = calendar->cursor + calendar->tick;
+        do {
+            /* Entries which are still due after being sent are added
+             * to the end of this slot and served in the next pass. */
+            progress = false;
+            entry = calendar->head[slot];
+            calendar->head[slot] = NULL;
+            calendar->tail[slot] = NULL;
+            while(entry) {
+                next = entry->next;
+                calendar->entries--;
+                if(entry->expire >= slot_end || entry->expire > now) {
+                    /* Not yet due or due in a later rotation. */
+                    bbl_calendar_add(calendar, entry);
+                } else if((result = send(entry, arg)) != BBL_CALENDAR_DEFERRED) {
+                    if(!entry->interval) {
+                        /* Removed by the send callback. */
+                        entry = next;
+                        continue;
+                    }
+                    if(result == BBL_CALENDAR_SENT) {
+                        sent++;
+                    } else {
+                        calendar->stats.skipped++;
+                    }
+                    progress = true;
+                    entry->expire += entry->interval;
+                    if(entry->expire + horizon <= now) {
+                        entry->expire = now + entry->interval;
+                        calendar->stats.late++;
+                    }
+                    bbl_calendar_add(calendar, entry);
+                } else {
+                    bbl_calendar_prepend(calendar, slot, entry);
+                    calendar->stats.deferred++;
+                    calendar->stats.sent += sent;
+                    return sent;
+                }
+                entry = next;
+            }
+        } while(progress);
+
+        if(slot_end > now) {
+            break;
+        }
+        calendar->cursor = slot_end;
+        if(++slots >= BBL_CALENDAR_SLOTS) {
+            /* All slots visited, skip the remaining idle time. */
+            calendar->cursor = now - (now % calendar->tick);
+            slots = 0;
+        }
+    }
+    calendar->stats.sent += sent;
+    return sent;
+}
+
+void
+bbl_calendar_free (bbl_calendar_s *calendar)
+{
+    free(calendar);
+}
@@ -0,0 +1,97 @@
+/*
+ * BNG Blaster (BBL) - Calendar Queue
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_CALENDAR_H__
+#define __BBL_CALENDAR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define BBL_CALENDAR_SLOTS          4096 /* power of 2 */
+#define BBL_CALENDAR_TICK_NSEC      10000 /* 10us */
+#define BBL_CALENDAR_NSEC_PER_SEC   1000000000ULL
+
+/*
+ * Periodic entry which is embedded into the object to be scheduled,
+ * e.g. a multicast stream. The entry is due at expire and rescheduled
+ * every interval nanoseconds after the send callback succeeded.
+ */
+typedef struct bbl_calendar_entry_
+{
+    struct bbl_calendar_entry_ *next;
+    uint64_t expire; /* monotonic nanoseconds */
+    uint64_t interval; /* nanoseconds */
+} bbl_calendar_entry_s;
+
+/*
+ * Send callback result. DEFERRED if the entry could not be sent
+ * (e.g. no TX buffer) which stops the calendar run. SKIPPED if the
+ * entry is not ready to send (e.g. session not established) which
+ * reschedules the entry without accounting it as sent. The callback
+ * removes the entry from the calendar by setting its interval to
+ * zero and returning SKIPPED.
+ */
+typedef enum {
+    BBL_CALENDAR_DEFERRED = 0,
+    BBL_CALENDAR_SENT,
+    BBL_CALENDAR_SKIPPED,
+} __attribute__ ((__packed__)) bbl_calendar_result_t;
+
+typedef bbl_calendar_result_t (*bbl_calendar_send_fn)(bbl_calendar_entry_s *entry, void *arg);
+
+/*
+ * Calendar queue with a ring of fixed width time slots, used to schedule
+ * a large number of periodic entries without one timer per entry. Entries
+ * are appended to the slot of their expire time. Entries expiring beyond
+ * the calendar horizon (slots * tick) stay in their slot and are skipped
+ * until the calendar wraps around to their rotation. Due entries of the
+ * same slot are interleaved, such that packets of different streams are
+ * spread evenly instead of being sent stream by stream.
+ */
+typedef struct bbl_calendar_
+{
+    bbl_calendar_entry_s *head[BBL_CALENDAR_SLOTS];
+    bbl_calendar_entry_s *tail[BBL_CALENDAR_SLOTS];
+    uint64_t tick; /* slot width in nanoseconds */
+    uint64_t cursor; /* start time of the current slot */
+    uint32_t entries;
+
+    struct {
+        uint64_t sent; /* entries sent */
+        uint64_t skipped; /* entries not ready to send */
+        uint64_t deferred; /* runs stopped by the send callback */
+        uint64_t late; /* entries rephased after falling behind */
+    } stats;
+} bbl_calendar_s;
+
+/*
+ * Calendar time in monotonic nanoseconds.
+ */
+static inline uint64_t
+bbl_calendar_now (void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * BBL_CALENDAR_NSEC_PER_SEC + now.tv_nsec;
+}
+
+bbl_calendar_s *
+bbl_calendar_new(uint64_t tick, uint64_t now);
+
+void
+bbl_calendar_add(bbl_calendar_s *calendar, bbl_calendar_entry_s *entry);
+
+uint32_t
+bbl_calendar_run(bbl_calendar_s *calendar, uint64_t now, bbl_calendar_send_fn send, void *arg);
+
+void
+bbl_calendar_free(bbl_calendar_s *calendar);
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "bbl.h"
 #include "bbl_config.h"
+#include "bbl_pcap.h"
 #include <jansson.h>
 #include <sys/stat.h>
 
@@ -17,6 +18,162 @@ const char g_default_pass[] = "test";
 const char g_default_ari[] = "DEU.RTBRICK.{session-global}";
 const char g_default_aci[] = "0.0.0.0/0.0.0.0 eth 0:{session-global}";
 
+/*
+ * Parse the share of TX ring slots (percent)
+ * of a TX class if present.
+ */
+static bool
+json_parse_tx_share (json_t *section, const char *key, uint8_t *share) {
+    json_t *value = NULL;
+    int number;
+
+    value = json_object_get(section, key);
+    if (json_is_number(value)) {
+        number = json_number_value(value);
+        if(number < 1 || number > 100) {
+            fprintf(stderr, "JSON config error: Invalid value for interfaces->%s (1 - 100)\n", key);
+            return false;
+        }
+        *share = number;
+    }
+    return true;
+}
+
+/*
+ * Parse per interface options which are
+ * supported for network and access interfaces.
+ */
+static bool
+json_parse_interface_config (json_t *interface, bbl_interface_config_s *interface_config) {
+    json_t *value = NULL;
+    const char *s = NULL;
+
+    interface_config->io_mode = BBL_IO_PACKET_MMAP;
+    interface_config->io_cpu = -1;
+    interface_config->fanout = 1;
+    interface_config->fanout_type = PACKET_FANOUT_HASH;
+    interface_config->tx_frames = BBL_IO_TX_FRAMES;
+    interface_config->rx_frames = BBL_IO_RX_FRAMES;
+    interface_config->frame_size = BBL_IO_FRAME_SIZE;
+
+    if (json_unpack(interface, "{s:s}", "io-mode", &s) == 0) {
+        if (strcmp(s, "packet-mmap") == 0) {
+            interface_config->io_mode = BBL_IO_PACKET_MMAP;
+        } else if (strcmp(s, "af-xdp") == 0) {
+            interface_config->io_mode = BBL_IO_AF_XDP;
+        } else {
+            fprintf(stderr, "JSON config error: Invalid value for io-mode\n");
+            return false;
+        }
+    }
+    value = json_object_get(interface, "io-cpu");
+    if (json_is_number(value)) {
+        interface_config->io_cpu = json_number_value(value);
+    }
+    value = json_object_get(interface, "fanout");
+    if (json_is_number(value)) {
+        if(json_number_value(value) < 1 || json_number_value(value) > BBL_MAX_FANOUT) {
+            fprintf(stderr, "JSON config error: Invalid value for fanout (1 - %u)\n", BBL_MAX_FANOUT);
+            return false;
+        }
+        interface_config->fanout = json_number_value(value);
+    }
+    if (json_unpack(interface, "{s:s}", "fanout-mode", &s) == 0) {
+        if (strcmp(s, "hash") == 0) {
+            interface_config->fanout_type = PACKET_FANOUT_HASH;
+        } else if (strcmp(s, "cpu") == 0) {
+            interface_config->fanout_type = PACKET_FANOUT_CPU;
+        } else {
+            fprintf(stderr, "JSON config error: Invalid value for fanout-mode\n");
+            return false;
+        }
+    }
+    if (json_unpack(interface, "{s:s}", "xdp-mode", &s) == 0) {
+        if (strcmp(s, "skb") == 0) {
+            interface_config->xdp_native = false;
+        } else if (strcmp(s, "native") == 0) {
+            interface_config->xdp_native = true;
+        } else {
+            fprintf(stderr, "JSON config error: Invalid value for xdp-mode\n");
+            return false;
+        }
+    }
+    value = json_object_get(interface, "xdp-queue");
+    if (json_is_number(value)) {
+        interface_config->xdp_queue = json_number_value(value);
+    }
+    value = json_object_get(interface, "tx-frames");
+    if (json_is_number(value)) {
+        if(json_number_value(value) < 16) {
+            fprintf(stderr, "JSON config error: Invalid value for tx-frames (at least 16)\n");
+            return false;
+        }
+        interface_config->tx_frames = json_number_value(value);
+    }
+    value = json_object_get(interface, "rx-frames");
+    if (json_is_number(value)) {
+        if(json_number_value(value) < 16) {
+            fprintf(stderr, "JSON config error: Invalid value for rx-frames (at least 16)\n");
+            return false;
+        }
+        interface_config->rx_frames = json_number_value(value);
+    }
+    value = json_object_get(interface, "frame-size");
+    if (json_is_number(value)) {
+        interface_config->frame_size = json_number_value(value);
+        if(interface_config->frame_size < BBL_IO_FRAME_SIZE || interface_config->frame_size % TPACKET_ALIGNMENT) {
+            fprintf(stderr, "JSON config error: Invalid value for frame-size (at least %u and multiple of %u required)\n",
+                    BBL_IO_FRAME_SIZE, TPACKET_ALIGNMENT);
+            return false;
+        }
+    }
+    value = json_object_get(interface, "block-size");
+    if (json_is_number(value)) {
+        interface_config->block_size = json_number_value(value);
+        if(!interface_config->block_size || interface_config->block_size % sysconf(_SC_PAGESIZE)) {
+            fprintf(stderr, "JSON config error: Invalid value for block-size (multiple of page size required)\n");
+            return false;
+        }
+    }
+    if(interface_config->block_size && interface_config->block_size % interface_config->frame_size) {
+        fprintf(stderr, "JSON config error: Option block-size must be a multiple of frame-size\n");
+        return false;
+    }
+    value = json_object_get(interface, "ring-locked");
+    if (json_is_boolean(value)) {
+        interface_config->ring_locked = json_boolean_value(value);
+    }
+    value = json_object_get(interface, "ring-hugepages");
+    if (json_is_boolean(value)) {
+        interface_config->ring_hugepages = json_boolean_value(value);
+    }
+    if(interface_config->io_mode != BBL_IO_AF_XDP && interface_config->ring_hugepages) {
+        fprintf(stderr, "JSON config error: Option ring-hugepages is only supported with io-mode af-xdp\n");
+        return false;
+    }
+    if (json_unpack(interface, "{s:s}", "timestamping", &s) == 0) {
+        if (strcmp(s, "off") == 0) {
+            interface_config->timestamping = BBL_TIMESTAMPING_OFF;
+        } else if (strcmp(s, "software") == 0) {
+            interface_config->timestamping = BBL_TIMESTAMPING_SOFTWARE;
+        } else if (strcmp(s, "hardware") == 0) {
+            interface_config->timestamping = BBL_TIMESTAMPING_HARDWARE;
+        } else {
+            fprintf(stderr, "JSON config error: Invalid value for timestamping\n");
+            return false;
+        }
+    }
+    if(interface_config->io_mode == BBL_IO_AF_XDP && interface_config->timestamping) {
+        fprintf(stderr, "JSON config error: Option timestamping is not supported with io-mode af-xdp\n");
+        return false;
+    }
+    if(interface_config->io_mode == BBL_IO_AF_XDP && interface_config->fanout > 1) {
+        fprintf(stderr, "JSON config error: Option fanout is not supported with io-mode af-xdp\n");
+        return false;
+    }
+    return true;
+}
+
 static bool
 json_parse_access_interface (bbl_ctx_s *ctx, json_t *access_interface, bbl_access_config_s *access_config) {
     json_t *value = NULL;
@@ -70,6 +227,9 @@ json_parse_access_interface (bbl_ctx_s *ctx, json_t *access_interface, bbl_acces
         access_config->access_third_vlan = json_number_value(value);
         access_config->access_third_vlan &= 4095;
     }
+    if(!json_parse_interface_config(access_interface, &access_config->interface_config)) {
+        return false;
+    }
 
     if (json_unpack(access_interface, "{s:s}", "address", &s) == 0) {
         if(!inet_pton(AF_INET, s, &ipv4)) {
@@ -213,6 +373,291 @@ json_parse_access_interface (bbl_ctx_s *ctx, json_t *access_interface, bbl_acces
     } else {
         access_config->session_traffic_autostart = ctx->config.session_traffic_autostart;
     }
+    value = json_object_get(access_interface, "stream-group-id");
+    if (json_is_number(value)) {
+        access_config->stream_group_id = json_number_value(value);
+    }
+    return true;
+}
+
+static bool
+json_parse_multicast_traffic (json_t *multicast_traffic, bbl_mc_traffic_config_s *mc_config) {
+    json_t *value, *sub = NULL;
+    const char *s = NULL;
+    uint32_t ipv4;
+    int i, size;
+
+    mc_config->group_iter = htobe32(1);
+    mc_config->group_count = 1;
+
+    if (json_unpack(multicast_traffic, "{s:s}", "group", &s) == 0) {
+        if(!inet_pton(AF_INET, s, &ipv4)) {
+            fprintf(stderr, "JSON config error: Invalid value for multicast-traffic->group\n");
+            return false;
+        }
+        mc_config->group = ipv4;
+    } else {
+        fprintf(stderr, "JSON config error: Missing value for multicast-traffic->group\n");
+        return false;
+    }
+    if (json_unpack(multicast_traffic, "{s:s}", "group-iter", &s) == 0) {
+        if(!inet_pton(AF_INET, s, &ipv4)) {
+            fprintf(stderr, "JSON config error: Invalid value for multicast-traffic->group-iter\n");
+            return false;
+        }
+        mc_config->group_iter = ipv4;
+    }
+    value = json_object_get(multicast_traffic, "group-count");
+    if (json_is_number(value)) {
+        mc_config->group_count = json_number_value(value);
+    }
+    sub = json_object_get(multicast_traffic, "source");
+    if (json_is_string(sub)) {
+        if(!inet_pton(AF_INET, json_string_value(sub), &ipv4)) {
+            fprintf(stderr, "JSON config error: Invalid value for multicast-traffic->source\n");
+            return false;
+        }
+        mc_config->source[0] = ipv4;
+        mc_config->source_count = 1;
+    } else if (json_is_array(sub)) {
+        size = json_array_size(sub);
+        if(size > BBL_MC_MAX_SOURCES) {
+            fprintf(stderr, "JSON config error: Too many values for multicast-traffic->source (max %u)\n", BBL_MC_MAX_SOURCES);
+            return false;
+        }
+        for (i = 0; i < size; i++) {
+            value = json_array_get(sub, i);
+            if(!json_is_string(value) || !inet_pton(AF_INET, json_string_value(value), &ipv4)) {
+                fprintf(stderr, "JSON config error: Invalid value for multicast-traffic->source\n");
+                return false;
+            }
+            mc_config->source[mc_config->source_count++] = ipv4;
+        }
+    }
+    value = json_object_get(multicast_traffic, "pps");
+    if (json_is_number(value)) {
+        mc_config->pps = json_number_value(value);
+    }
+    value = json_object_get(multicast_traffic, "length");
+    if (json_is_number(value)) {
+        if(json_number_value(value) > BBL_MC_MAX_LEN) {
+            fprintf(stderr, "JSON config error: Invalid value for multicast-traffic->length (max %u)\n", BBL_MC_MAX_LEN);
+            return false;
+        }
+        mc_config->len = json_number_value(value);
+    }
+    return true;
+}
+
+/*
+ * Add secondary IP address of the network
+ * interface to be served by ARP.
+ */
+static void
+json_add_secondary_ip (bbl_ctx_s *ctx, uint32_t ipv4) {
+    bbl_secondary_ip_s *secondary_ip;
+
+    if(ipv4 == ctx->config.network_ip) {
+        return;
+    }
+    secondary_ip = ctx->config.secondary_ip_addresses;
+    if(secondary_ip) {
+        while(secondary_ip) {
+            if(secondary_ip->ip == ipv4) {
+                /* Address is already known ... */
+                break;
+            }
+            if(secondary_ip->next) {
+                /* Check next address ... */
+                secondary_ip = secondary_ip->next;
+            } else {
+                /* Append secondary address ... */
+                secondary_ip->next = malloc(sizeof(bbl_secondary_ip_s));
+                memset(secondary_ip->next, 0x0, sizeof(bbl_secondary_ip_s));
+                secondary_ip = secondary_ip->next;
+                secondary_ip->ip = ipv4;
+                break;
+            }
+        }
+    } else {
+        /* Add first secondary address */
+        ctx->config.secondary_ip_addresses = malloc(sizeof(bbl_secondary_ip_s));
+        memset(ctx->config.secondary_ip_addresses, 0x0, sizeof(bbl_secondary_ip_s));
+        ctx->config.secondary_ip_addresses->ip = ipv4;
+    }
+}
+
+static bool
+json_parse_pcap (bbl_ctx_s *ctx, json_t *pcap) {
+    json_t *sub, *value = NULL;
+    const char *s = NULL;
+    int i, size;
+
+    sub = json_object_get(pcap, "interfaces");
+    if (json_is_array(sub)) {
+        size = json_array_size(sub);
+        if(!size || size > BBL_MAX_ACCESS_INTERFACES + 1) {
+            fprintf(stderr, "JSON config error: Invalid value for pcap->interfaces\n");
+            return false;
+        }
+        ctx->config.pcap_interfaces = calloc(size, sizeof(char*));
+        for (i = 0; i < size; i++) {
+            s = json_string_value(json_array_get(sub, i));
+            if(!s) {
+                fprintf(stderr, "JSON config error: Invalid value for pcap->interfaces\n");
+                return false;
+            }
+            ctx->config.pcap_interfaces[i] = strdup(s);
+        }
+        ctx->config.pcap_interfaces_count = size;
+    }
+    if (json_unpack(pcap, "{s:s}", "direction", &s) == 0) {
+        if (strcmp(s, "rx") == 0) {
+            ctx->config.pcap_direction = PCAPNG_EPB_FLAGS_INBOUND;
+        } else if (strcmp(s, "tx") == 0) {
+            ctx->config.pcap_direction = PCAPNG_EPB_FLAGS_OUTBOUND;
+        } else if (strcmp(s, "both") == 0) {
+            ctx->config.pcap_direction = PCAPNG_EPB_FLAGS_BOTH;
+        } else {
+            fprintf(stderr, "JSON config error: Invalid value for pcap->direction\n");
+            return false;
+        }
+    }
+    sub = json_object_get(pcap, "traffic");
+    if (json_is_array(sub)) {
+        ctx->config.pcap_traffic = 0;
+        size = json_array_size(sub);
+        for (i = 0; i < size; i++) {
+            s = json_string_value(json_array_get(sub, i));
+            if (s && strcmp(s, "control") == 0) {
+                ctx->config.pcap_traffic |= PCAPNG_TRAFFIC_CONTROL;
+            } else if (s && strcmp(s, "data") == 0) {
+                ctx->config.pcap_traffic |= PCAPNG_TRAFFIC_DATA;
+            } else if (s && strcmp(s, "bbl") == 0) {
+                ctx->config.pcap_traffic |= PCAPNG_TRAFFIC_BBL;
+            } else {
+                fprintf(stderr, "JSON config error: Invalid value for pcap->traffic\n");
+                return false;
+            }
+        }
+        if(!ctx->config.pcap_traffic) {
+            fprintf(stderr, "JSON config error: Invalid value for pcap->traffic\n");
+            return false;
+        }
+    }
+    value = json_object_get(pcap, "snaplen");
+    if (json_is_number(value)) {
+        if(json_number_value(value) < 14 || json_number_value(value) > PCAPNG_SNAPLEN) {
+            fprintf(stderr, "JSON config error: Invalid value for pcap->snaplen (14 - %u)\n", PCAPNG_SNAPLEN);
+            return false;
+        }
+        ctx->config.pcap_snaplen = json_number_value(value);
+    }
+    value = json_object_get(pcap, "sample");
+    if (json_is_number(value)) {
+        if(json_number_value(value) < 1) {
+            fprintf(stderr, "JSON config error: Invalid value for pcap->sample\n");
+            return false;
+        }
+        ctx->config.pcap_sample = json_number_value(value);
+    }
+    if (json_unpack(pcap, "{s:s}", "bpf", &s) == 0) {
+        ctx->config.pcap_bpf = bbl_bpf_new(s);
+        if(!ctx->config.pcap_bpf) {
+            fprintf(stderr, "JSON config error: Invalid value for pcap->bpf (tcpdump -ddd format expected)\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+json_parse_stream (bbl_ctx_s *ctx, json_t *stream, bbl_stream_config_s *stream_config) {
+    json_t *value = NULL;
+    const char *s = NULL;
+    uint32_t ipv4;
+
+    stream_config->type = BBL_SUB_TYPE_IPV4;
+    stream_config->direction = BBL_STREAM_DIRECTION_BOTH;
+    stream_config->pps = 1;
+
+    if (json_unpack(stream, "{s:s}", "name", &s) == 0) {
+        stream_config->name = strdup(s);
+    } else {
+        fprintf(stderr, "JSON config error: Missing value for streams->name\n");
+        return false;
+    }
+    value = json_object_get(stream, "stream-group-id");
+    if (json_is_number(value)) {
+        stream_config->stream_group_id = json_number_value(value);
+    }
+    if(!stream_config->stream_group_id) {
+        fprintf(stderr, "JSON config error: Missing or invalid value for streams->stream-group-id\n");
+        return false;
+    }
+    if (json_unpack(stream, "{s:s}", "type", &s) == 0) {
+        if (strcmp(s, "ipv4") == 0) {
+            stream_config->type = BBL_SUB_TYPE_IPV4;
+        } else if (strcmp(s, "ipv6") == 0) {
+            stream_config->type = BBL_SUB_TYPE_IPV6;
+        } else if (strcmp(s, "ipv6pd") == 0) {
+            stream_config->type = BBL_SUB_TYPE_IPV6PD;
+        } else {
+            fprintf(stderr, "JSON config error: Invalid value for streams->type\n");
+            return false;
+        }
+    }
+    if (json_unpack(stream, "{s:s}", "direction", &s) == 0) {
+        if (strcmp(s, "upstream") == 0) {
+            stream_config->direction = BBL_STREAM_DIRECTION_UP;
+        } else if (strcmp(s, "downstream") == 0) {
+            stream_config->direction = BBL_STREAM_DIRECTION_DOWN;
+        } else if (strcmp(s, "both") == 0) {
+            stream_config->direction = BBL_STREAM_DIRECTION_BOTH;
+        } else {
+            fprintf(stderr, "JSON config error: Invalid value for streams->direction\n");
+            return false;
+        }
+    }
+    value = json_object_get(stream, "priority");
+    if (json_is_number(value)) {
+        if(json_number_value(value) > 255) {
+            fprintf(stderr, "JSON config error: Invalid value for streams->priority (max 255)\n");
+            return false;
+        }
+        stream_config->priority = json_number_value(value);
+    }
+    value = json_object_get(stream, "length");
+    if (json_is_number(value)) {
+        if(json_number_value(value) > BBL_STREAM_MAX_LEN) {
+            fprintf(stderr, "JSON config error: Invalid value for streams->length (max %u)\n", BBL_STREAM_MAX_LEN);
+            return false;
+        }
+        stream_config->length = json_number_value(value);
+    }
+    value = json_object_get(stream, "pps");
+    if (json_is_number(value)) {
+        /* The calendar interval in nanoseconds must not be zero. */
+        if(json_number_value(value) < 1 || json_number_value(value) > BBL_CALENDAR_NSEC_PER_SEC) {
+            fprintf(stderr, "JSON config error: Invalid value for streams->pps (1 - %llu)\n", BBL_CALENDAR_NSEC_PER_SEC);
+            return false;
+        }
+        stream_config->pps = json_number_value(value);
+    }
+    if (json_unpack(stream, "{s:s}", "network-ipv4-address", &s) == 0) {
+        if(!inet_pton(AF_INET, s, &ipv4)) {
+            fprintf(stderr, "JSON config error: Invalid value for streams->network-ipv4-address\n");
+            return false;
+        }
+        stream_config->ipv4_network_address = ipv4;
+        json_add_secondary_ip(ctx, ipv4);
+    }
+    if (json_unpack(stream, "{s:s}", "network-ipv6-address", &s) == 0) {
+        if(!inet_pton(AF_INET6, s, &stream_config->ipv6_network_address)) {
+            fprintf(stderr, "JSON config error: Invalid value for streams->network-ipv6-address\n");
+            return false;
+        }
+    }
     return true;
 }
 
@@ -223,9 +668,12 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
     const char *s;
     uint32_t ipv4;
     int i, size;
+    int tx_share_headroom;
+    uint8_t tx_share_data = 0; /* remaining share if not configured */
     bbl_access_config_s *access_config = NULL;
     bbl_l2tp_server_t *l2tp_server = NULL;
-    bbl_secondary_ip_s *secondary_ip;
+    bbl_mc_traffic_config_s *mc_config = NULL;
+    bbl_stream_config_s *stream_config = NULL;
 
     if(json_typeof(root) != JSON_OBJECT) {
         fprintf(stderr, "JSON config error: Configuration root element must object\n");
@@ -255,6 +703,10 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
         if (json_is_boolean(value)) {
             ctx->config.iterate_outer_vlan = json_boolean_value(value);
         }
+        value = json_object_get(section, "hugepages");
+        if (json_is_boolean(value)) {
+            ctx->config.sessions_hugepages = json_boolean_value(value);
+        }
     }
 
     /* IPoE Configuration */
@@ -511,6 +963,36 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
         if (json_is_boolean(value)) {
             ctx->config.send_multicast_traffic = json_boolean_value(value);
         }
+        value = json_object_get(section, "multicast-traffic-pps");
+        if (json_is_number(value)) {
+            ctx->config.multicast_traffic_pps = json_number_value(value);
+        }
+        value = json_object_get(section, "multicast-traffic-length");
+        if (json_is_number(value)) {
+            if(json_number_value(value) > BBL_MC_MAX_LEN) {
+                fprintf(stderr, "JSON config error: Invalid value for igmp->multicast-traffic-length (max %u)\n", BBL_MC_MAX_LEN);
+                return false;
+            }
+            ctx->config.multicast_traffic_len = json_number_value(value);
+        }
+    }
+
+    /* Multicast Traffic Configuration */
+    section = json_object_get(root, "multicast-traffic");
+    if (json_is_array(section)) {
+        size = json_array_size(section);
+        for (i = 0; i < size; i++) {
+            if(!mc_config) {
+                ctx->config.multicast_traffic_config = calloc(1, sizeof(bbl_mc_traffic_config_s));
+                mc_config = ctx->config.multicast_traffic_config;
+            } else {
+                mc_config->next = calloc(1, sizeof(bbl_mc_traffic_config_s));
+                mc_config = mc_config->next;
+            }
+            if(!json_parse_multicast_traffic(json_array_get(section, i), mc_config)) {
+                return false;
+            }
+        }
     }
 
     /* Access Line Configuration */
@@ -551,6 +1033,18 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
         if (json_is_number(value)) {
             ctx->config.session_traffic_ipv6pd_pps = json_number_value(value);
         }
+        value = json_object_get(section, "latency-histogram");
+        if (json_is_boolean(value)) {
+            ctx->config.session_traffic_histogram = json_boolean_value(value);
+        }
+    }
+
+    /* Packet Capture Configuration */
+    section = json_object_get(root, "pcap");
+    if (json_is_object(section)) {
+        if(!json_parse_pcap(ctx, section)) {
+            return false;
+        }
     }
 
 
@@ -565,10 +1059,55 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
         if (json_is_number(value)) {
             ctx->config.rx_interval = json_number_value(value);
         }
+        value = json_object_get(section, "tx-flush-threshold");
+        if (json_is_number(value)) {
+            ctx->config.tx_flush_threshold = json_number_value(value);
+        }
+        if(!json_parse_tx_share(section, "tx-share-control", &ctx->config.tx_share[BBL_TX_CLASS_CONTROL]) ||
+           !json_parse_tx_share(section, "tx-share-keepalive", &ctx->config.tx_share[BBL_TX_CLASS_KEEPALIVE]) ||
+           !json_parse_tx_share(section, "tx-share-data", &tx_share_data)) {
+            return false;
+        }
         value = json_object_get(section, "qdisc-bypass");
         if (json_is_boolean(value)) {
             ctx->config.qdisc_bypass = json_boolean_value(value);
         }
+        value = json_object_get(section, "rx-fast-path");
+        if (json_is_boolean(value)) {
+            ctx->config.rx_fast_path = json_boolean_value(value);
+        }
+        value = json_object_get(section, "rx-tpacket-v3");
+        if (json_is_boolean(value)) {
+            ctx->config.rx_tpacket_v3 = json_boolean_value(value);
+        }
+        value = json_object_get(section, "rx-block-size");
+        if (json_is_number(value)) {
+            ctx->config.rx_block_size = json_number_value(value);
+            if(!ctx->config.rx_block_size || ctx->config.rx_block_size % sysconf(_SC_PAGESIZE)) {
+                fprintf(stderr, "JSON config error: Invalid value for interfaces->rx-block-size (multiple of page size required)\n");
+                return false;
+            }
+        }
+        value = json_object_get(section, "rx-block-timeout");
+        if (json_is_number(value)) {
+            ctx->config.rx_block_timeout = json_number_value(value);
+        }
+        value = json_object_get(section, "io-threads");
+        if (json_is_boolean(value)) {
+            ctx->config.io_threads = json_boolean_value(value);
+        }
+        value = json_object_get(section, "event-loop");
+        if (json_is_boolean(value)) {
+            ctx->config.event_loop = json_boolean_value(value);
+        }
+        value = json_object_get(section, "busy-poll");
+        if (json_is_boolean(value)) {
+            ctx->config.busy_poll = json_boolean_value(value);
+        }
+        value = json_object_get(section, "busy-poll-usec");
+        if (json_is_number(value)) {
+            ctx->config.busy_poll_usec = json_number_value(value);
+        }
         sub = json_object_get(section, "network");
         if (json_is_object(sub)) {
             if (json_unpack(sub, "{s:s}", "interface", &s) == 0) {
@@ -607,6 +1146,9 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
                 ctx->config.network_vlan = json_number_value(value);
                 ctx->config.network_vlan &= 4095;
             }
+            if(!json_parse_interface_config(sub, &ctx->config.network_interface_config)) {
+                return false;
+            }
         }
         sub = json_object_get(section, "access");
         if (json_is_array(sub)) {
@@ -641,6 +1183,23 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
         return false;
     }
 
+    /* Traffic must leave headroom for control and keepalive
+     * frames, otherwise a TX ring filled with traffic delays
+     * control protocols until the kernel has sent it. */
+    tx_share_headroom = 100 - ctx->config.tx_share[BBL_TX_CLASS_CONTROL] - ctx->config.tx_share[BBL_TX_CLASS_KEEPALIVE];
+    if(tx_share_headroom < 1) {
+        fprintf(stderr, "JSON config error: Invalid value for interfaces->tx-share-control and tx-share-keepalive (sum must be below 100)\n");
+        return false;
+    }
+    if(!tx_share_data) {
+        ctx->config.tx_share[BBL_TX_CLASS_DATA] = tx_share_headroom;
+    } else if(tx_share_data > tx_share_headroom) {
+        fprintf(stderr, "JSON config error: Invalid value for interfaces->tx-share-data (1 - %d)\n", tx_share_headroom);
+        return false;
+    } else {
+        ctx->config.tx_share[BBL_TX_CLASS_DATA] = tx_share_data;
+    }
+
     /* L2TP Server Configuration (LNS) */
     section = json_object_get(root, "l2tp-server");
     if (json_is_array(section)) {
@@ -676,34 +1235,7 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
                 l2tp_server->ip = ipv4;
                 CIRCLEQ_INIT(&l2tp_server->tunnel_qhead);
 
-                if(ipv4 != ctx->config.network_ip) {
-                    /* Add secondary IP address to be served by ARP */
-                    secondary_ip = ctx->config.secondary_ip_addresses;
-                    if(secondary_ip) {
-                        while(secondary_ip) {
-                            if(secondary_ip->ip == ipv4) {
-                                /* Address is already known ... */
-                                break;
-                            }
-                            if(secondary_ip->next) {
-                                /* Check next address ... */
-                                secondary_ip = secondary_ip->next;
-                            } else {
-                                /* Append secondary address ... */
-                                secondary_ip->next = malloc(sizeof(bbl_secondary_ip_s));
-                                memset(secondary_ip->next, 0x0, sizeof(bbl_secondary_ip_s));
-                                secondary_ip = secondary_ip->next;
-                                secondary_ip->ip = ipv4;
-                                break;
-                            }
-                        }                        
-                    } else {
-                        /* Add first secondary address */
-                        ctx->config.secondary_ip_addresses = malloc(sizeof(bbl_secondary_ip_s));
-                        memset(ctx->config.secondary_ip_addresses, 0x0, sizeof(bbl_secondary_ip_s));
-                        ctx->config.secondary_ip_addresses->ip = ipv4;
-                    }
-                }
+                json_add_secondary_ip(ctx, ipv4);
             } else {
                 fprintf(stderr, "JSON config error: Missing value for l2tp-server->address\n");
             }
@@ -750,6 +1282,27 @@ json_parse_config (json_t *root, bbl_ctx_s *ctx) {
         fprintf(stderr, "JSON config error: List expected in L2TP server configuration but dictionary found\n");
     }
 
+    /* Traffic Streams Configuration */
+    section = json_object_get(root, "streams");
+    if (json_is_array(section)) {
+        size = json_array_size(section);
+        for (i = 0; i < size; i++) {
+            if(!stream_config) {
+                ctx->config.stream_config = calloc(1, sizeof(bbl_stream_config_s));
+                stream_config = ctx->config.stream_config;
+            } else {
+                stream_config->next = calloc(1, sizeof(bbl_stream_config_s));
+                stream_config = stream_config->next;
+            }
+            if(!json_parse_stream(ctx, json_array_get(section, i), stream_config)) {
+                return false;
+            }
+        }
+    } else if (json_is_object(section)) {
+        fprintf(stderr, "JSON config error: List expected in streams configuration but dictionary found\n");
+        return false;
+    }
+
     return true;
 }
 
@@ -789,7 +1342,19 @@ bbl_config_init_defaults (bbl_ctx_s *ctx) {
     ctx->config.agent_circuit_id = (char *)g_default_aci;
     ctx->config.tx_interval = 5;
     ctx->config.rx_interval = 5;
+    ctx->config.tx_share[BBL_TX_CLASS_CONTROL] = 20;
+    ctx->config.tx_share[BBL_TX_CLASS_KEEPALIVE] = 10;
+    ctx->config.tx_share[BBL_TX_CLASS_DATA] = 100 - ctx->config.tx_share[BBL_TX_CLASS_CONTROL] -
+                                              ctx->config.tx_share[BBL_TX_CLASS_KEEPALIVE];
+    ctx->config.busy_poll_usec = 50;
     ctx->config.qdisc_bypass = true;
+    ctx->config.rx_fast_path = true;
+    ctx->config.rx_block_size = 131072;
+    ctx->config.network_interface_config.io_cpu = -1;
+    ctx->config.network_interface_config.fanout = 1;
+    ctx->config.network_interface_config.tx_frames = BBL_IO_TX_FRAMES;
+    ctx->config.network_interface_config.rx_frames = BBL_IO_RX_FRAMES;
+    ctx->config.network_interface_config.frame_size = BBL_IO_FRAME_SIZE;
     ctx->config.sessions = 1;
     ctx->config.sessions_max_outstanding = 800;
     ctx->config.sessions_start_rate = 400,
@@ -825,4 +1390,8 @@ bbl_config_init_defaults (bbl_ctx_s *ctx) {
     ctx->config.igmp_group_count = 1;
     ctx->config.igmp_zap_wait = true;
     ctx->config.session_traffic_autostart = true;
+    ctx->config.pcap_direction = PCAPNG_EPB_FLAGS_BOTH;
+    ctx->config.pcap_traffic = PCAPNG_TRAFFIC_ALL;
+    ctx->config.pcap_snaplen = PCAPNG_SNAPLEN;
+    ctx->config.pcap_sample = 1;
 }
@@ -23,6 +23,7 @@
 #include "bbl.h"
 #include "bbl_ctrl.h"
 #include "bbl_logging.h"
+#include "bbl_stats.h"
 
 #define BACKLOG 4
 #define INPUT_BUFFER 1024
@@ -86,13 +87,14 @@ bbl_ctrl_status(int fd, const char *status, uint32_t code, const char *message)
 
 ssize_t
 bbl_ctrl_multicast_traffic_start(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute__((unused)), json_t* arguments __attribute__((unused))) {
-    ctx->multicast_traffic = true;
+    /* Also read by the I/O threads. */
+    __atomic_store_n(&ctx->multicast_traffic, true, __ATOMIC_RELAXED);
     return bbl_ctrl_status(fd, "ok", 200, NULL);
 }
 
 ssize_t
 bbl_ctrl_multicast_traffic_stop(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute__((unused)), json_t* arguments __attribute__((unused))) {
-    ctx->multicast_traffic = false;
+    __atomic_store_n(&ctx->multicast_traffic, false, __ATOMIC_RELAXED);
     return bbl_ctrl_status(fd, "ok", 200, NULL);
 }
 
@@ -102,22 +104,24 @@ bbl_ctrl_session_traffic(int fd, bbl_ctx_s *ctx, session_key_t *key, bool status
     bbl_session_s *session;
     void **search;
     if(key->outer_vlan_id || key->inner_vlan_id) {
-        search = dict_search(ctx->session_dict, key);
+        search = dict_search(ctx->session_dict.dict, key);
         if(search) {
             session = *search;
             session->session_traffic = status;
+            bbl_session_io_update(ctx, session);
             return bbl_ctrl_status(fd, "ok", 200, NULL);
         } else {
             return bbl_ctrl_status(fd, "warning", 404, "session not found");
         }
     } else {
         /* Iterate over all sessions */
-        itor = dict_itor_new(ctx->session_dict);
+        itor = dict_itor_new(ctx->session_dict.dict);
         dict_itor_first(itor);
         for (; dict_itor_valid(itor); dict_itor_next(itor)) {
             session = (bbl_session_s*)*dict_itor_datum(itor);
             if(session) {
                 session->session_traffic = status;
+                bbl_session_io_update(ctx, session);
             }
         }
         return bbl_ctrl_status(fd, "ok", 200, NULL);
@@ -172,21 +176,21 @@ bbl_ctrl_igmp_join(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* arguments
     }
 
     /* Search session */
-    search = dict_search(ctx->session_dict, key);
+    search = dict_search(ctx->session_dict.dict, key);
     if(search) {
         session = *search;
         /* Search for free slot ... */
         for(i=0; i < IGMP_MAX_GROUPS; i++) {
-            if(!session->igmp_groups[i].zapping) {
-                if (session->igmp_groups[i].group == group_address) {
-                    group = &session->igmp_groups[i];
+            if(!session->cold->igmp_groups[i].zapping) {
+                if (session->cold->igmp_groups[i].group == group_address) {
+                    group = &session->cold->igmp_groups[i];
                     if(group->state == IGMP_GROUP_IDLE) {
                         break;
                     } else {
                         return bbl_ctrl_status(fd, "error", 409, "group already exists");
                     }
-                } else if(session->igmp_groups[i].state == IGMP_GROUP_IDLE) {
-                    group = &session->igmp_groups[i];
+                } else if(session->cold->igmp_groups[i].state == IGMP_GROUP_IDLE) {
+                    group = &session->cold->igmp_groups[i];
                 }
             }
         }
@@ -200,7 +204,7 @@ bbl_ctrl_igmp_join(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* arguments
         if(source2) group->source[1] = source2;
         if(source3) group->source[2] = source3;
         group->state = IGMP_GROUP_JOINING;
-        group->robustness_count = session->igmp_robustness;
+        group->robustness_count = session->cold->igmp_robustness;
         group->send = true;
         session->send_requests |= BBL_SEND_IGMP;
         bbl_session_tx_qnode_insert(session);
@@ -238,13 +242,13 @@ bbl_ctrl_igmp_leave(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* argument
         return bbl_ctrl_status(fd, "error", 400, "missing group address");
     }
 
-    search = dict_search(ctx->session_dict, key);
+    search = dict_search(ctx->session_dict.dict, key);
     if(search) {
         session = *search;
         /* Search for group ... */
         for(i=0; i < IGMP_MAX_GROUPS; i++) {
-            if (session->igmp_groups[i].group == group_address) {
-                group = &session->igmp_groups[i];
+            if (session->cold->igmp_groups[i].group == group_address) {
+                group = &session->cold->igmp_groups[i];
                 break;
             }
         }
@@ -258,7 +262,7 @@ bbl_ctrl_igmp_leave(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* argument
             return bbl_ctrl_status(fd, "ok", 200, NULL);
         }
         group->state = IGMP_GROUP_LEAVING;
-        group->robustness_count = session->igmp_robustness;
+        group->robustness_count = session->cold->igmp_robustness;
         group->send = true;
         group->leave_tx_time.tv_sec = 0;
         group->leave_tx_time.tv_nsec = 0;
@@ -288,13 +292,13 @@ bbl_ctrl_igmp_info(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* arguments
     uint32_t delay = 0;
     struct timespec time_diff;
     int ms, i, i2;
-    search = dict_search(ctx->session_dict, key);
+    search = dict_search(ctx->session_dict.dict, key);
     if(search) {
         session = *search;
         groups = json_array();
         /* Add group informations */
         for(i=0; i < IGMP_MAX_GROUPS; i++) {
-            group = &session->igmp_groups[i];
+            group = &session->cold->igmp_groups[i];
             if(group->group) {
                 sources = json_array();
                 for(i2=0; i2 < IGMP_MAX_SOURCES; i2++) {
@@ -362,17 +366,90 @@ bbl_ctrl_igmp_info(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* arguments
     }
 }
 
+ssize_t
+bbl_ctrl_session_streams(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* arguments __attribute__((unused))) {
+    ssize_t result = 0;
+    json_t *root, *streams, *record;
+    bbl_session_s *session = NULL;
+    bbl_stream_s *stream;
+    void **search;
+    search = dict_search(ctx->session_dict.dict, key);
+    if(search) {
+        session = *search;
+        streams = json_array();
+        for(stream = session->cold->streams; stream; stream = stream->session_next) {
+            record = json_pack("{ss ss sI si si si sI sI sI sI}",
+                               "name", stream->config->name,
+                               "direction", stream->direction == BBL_STREAM_DIRECTION_UP ? "upstream" : "downstream",
+                               "flow-id", (json_int_t)stream->flow_id,
+                               "priority", stream->config->priority,
+                               "length", stream->tx_len ? stream->tx_len : stream->config->length,
+                               "pps", stream->config->pps,
+                               "tx-packets", (json_int_t)stream->stats.packets_tx,
+                               "rx-packets", (json_int_t)stream->stats.packets_rx,
+                               "rx-loss", (json_int_t)stream->stats.loss,
+                               "rx-first-seq", (json_int_t)stream->rx_first_seq);
+            json_array_append_new(streams, record);
+        }
+        root = json_pack("{ss si so}",
+                        "status", "ok",
+                        "code", 200,
+                        "session-streams", streams);
+        if(root) {
+            result = json_dumpfd(root, fd, 0);
+            json_decref(root);
+        } else {
+            result = bbl_ctrl_status(fd, "error", 500, "internal error");
+            json_decref(streams);
+        }
+        return result;
+    } else {
+        return bbl_ctrl_status(fd, "warning", 404, "session not found");
+    }
+}
+
+/*
+ * Session traffic latency and jitter percentiles, upstream
+ * received on the network interface and downstream received
+ * on all access interfaces.
+ */
+static void
+bbl_ctrl_session_counters_latency(bbl_ctx_s *ctx, json_t *counters) {
+    bbl_latency_histogram_s latency;
+    bbl_latency_histogram_s jitter;
+    int i;
+
+    if(ctx->op.network_if) {
+        bbl_stats_latency_histogram_json(&ctx->op.network_if->stats.session_latency_histogram, "upstream-latency", counters);
+        bbl_stats_latency_histogram_json(&ctx->op.network_if->stats.session_jitter_histogram, "upstream-jitter", counters);
+    }
+    memset(&latency, 0x0, sizeof(latency));
+    memset(&jitter, 0x0, sizeof(jitter));
+    for(i = 0; i < ctx->op.access_if_count; i++) {
+        bbl_latency_histogram_merge(&latency, &ctx->op.access_if[i]->stats.session_latency_histogram);
+        bbl_latency_histogram_merge(&jitter, &ctx->op.access_if[i]->stats.session_jitter_histogram);
+    }
+    bbl_stats_latency_histogram_json(&latency, "downstream-latency", counters);
+    bbl_stats_latency_histogram_json(&jitter, "downstream-jitter", counters);
+}
+
 ssize_t
 bbl_ctrl_session_counters(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute__((unused)), json_t* arguments __attribute__((unused))) {
     ssize_t result = 0;
-    json_t *root = json_pack("{ss si s{si si si si}}", 
-                             "status", "ok", 
-                             "code", 200,
-                             "session-counters",
-                             "sessions", ctx->config.sessions,
-                             "sessions-established", ctx->sessions_established_max,
-                             "sessions-flapped", ctx->sessions_flapped,
-                             "dhcpv6-sessions-established", ctx->dhcpv6_established_max);
+    json_t *counters = json_pack("{si si si si}",
+                                 "sessions", ctx->config.sessions,
+                                 "sessions-established", ctx->sessions_established_max,
+                                 "sessions-flapped", ctx->sessions_flapped,
+                                 "dhcpv6-sessions-established", ctx->dhcpv6_established_max);
+    json_t *root;
+
+    if(counters) {
+        bbl_ctrl_session_counters_latency(ctx, counters);
+    }
+    root = json_pack("{ss si so*}",
+                     "status", "ok",
+                     "code", 200,
+                     "session-counters", counters);
     if(root) {
         result = json_dumpfd(root, fd, 0);
         json_decref(root);
@@ -380,6 +457,85 @@ bbl_ctrl_session_counters(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute
     return result;
 }
 
+static json_t *
+bbl_ctrl_hash_table(bbl_dict_s *d) {
+    bbl_dict_stats_s stats;
+
+    bbl_dict_get_stats(d, &stats);
+    return json_pack("{ss sI si si sf si si si}",
+                     "name", d->name,
+                     "entries", (json_int_t)stats.entries,
+                     "buckets", stats.buckets,
+                     "buckets-used", stats.buckets_used,
+                     "load-factor", stats.load_factor,
+                     "max-chain-length", stats.max_chain,
+                     "resizes", d->stats.resizes,
+                     "resize-failed", d->stats.resize_failed);
+}
+
+ssize_t
+bbl_ctrl_hash_tables(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute__((unused)), json_t* arguments __attribute__((unused))) {
+    ssize_t result = 0;
+    json_t *root, *tables;
+
+    tables = json_array();
+    json_array_append_new(tables, bbl_ctrl_hash_table(&ctx->session_dict));
+    json_array_append_new(tables, bbl_ctrl_hash_table(&ctx->l2tp_session_dict));
+    json_array_append_new(tables, bbl_ctrl_hash_table(&ctx->li_flow_dict));
+    json_array_append_new(tables, bbl_ctrl_hash_table(&ctx->stream_flow_dict));
+
+    root = json_pack("{ss si so}",
+                     "status", "ok",
+                     "code", 200,
+                     "hash-tables", tables);
+    if(root) {
+        result = json_dumpfd(root, fd, 0);
+        json_decref(root);
+    } else {
+        result = bbl_ctrl_status(fd, "error", 500, "internal error");
+        json_decref(tables);
+    }
+    return result;
+}
+
+/*
+ * One-way latency of the session traffic flows in nanoseconds,
+ * named after the interface receiving the flow.
+ */
+static void
+bbl_ctrl_session_latency(bbl_session_s *session, json_t *session_traffic) {
+    static const char *prefix[BBL_SESSION_FLOW_MAX] = {
+        "network-rx-session",
+        "access-rx-session",
+        "network-rx-session-ipv6",
+        "access-rx-session-ipv6",
+        "network-rx-session-ipv6pd",
+        "access-rx-session-ipv6pd"
+    };
+    bbl_session_flow_s *flow;
+    char key[64];
+    int type;
+
+    for(type = 0; type < BBL_SESSION_FLOW_MAX; type++) {
+        flow = &session->traffic_flows[type];
+        if(!flow->latency.count) continue;
+        snprintf(key, sizeof(key), "%s-latency-min-ns", prefix[type]);
+        json_object_set_new(session_traffic, key, json_integer(flow->latency.min));
+        snprintf(key, sizeof(key), "%s-latency-avg-ns", prefix[type]);
+        json_object_set_new(session_traffic, key, json_integer(bbl_latency_avg(&flow->latency)));
+        snprintf(key, sizeof(key), "%s-latency-max-ns", prefix[type]);
+        json_object_set_new(session_traffic, key, json_integer(flow->latency.max));
+        snprintf(key, sizeof(key), "%s-jitter-ns", prefix[type]);
+        json_object_set_new(session_traffic, key, json_integer(flow->latency.jitter));
+        if(flow->latency_histogram) {
+            snprintf(key, sizeof(key), "%s-latency", prefix[type]);
+            bbl_stats_latency_histogram_json(flow->latency_histogram, key, session_traffic);
+            snprintf(key, sizeof(key), "%s-jitter", prefix[type]);
+            bbl_stats_latency_histogram_json(flow->jitter_histogram, key, session_traffic);
+        }
+    }
+}
+
 ssize_t
 bbl_ctrl_session_info(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* arguments __attribute__((unused))) {
     ssize_t result = 0;
@@ -404,17 +560,17 @@ bbl_ctrl_session_info(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* argume
     const char *ipcp = NULL;
     const char *ip6cp = NULL;
 
-    search = dict_search(ctx->session_dict, key);
+    search = dict_search(ctx->session_dict.dict, key);
     if(search) {
         session = *search;
         if(session->ip_address) {
             ipv4 = format_ipv4_address(&session->ip_address);
         }
-        if(session->dns1) {
-            dns1 = format_ipv4_address(&session->dns1);
+        if(session->cold->dns1) {
+            dns1 = format_ipv4_address(&session->cold->dns1);
         }
-        if(session->dns2) {
-            dns2 = format_ipv4_address(&session->dns2);
+        if(session->cold->dns2) {
+            dns2 = format_ipv4_address(&session->cold->dns2);
         }
         if(session->ipv6_prefix.len) {
             ipv6 = format_ipv6_prefix(&session->ipv6_prefix);
@@ -422,22 +578,22 @@ bbl_ctrl_session_info(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* argume
         if(session->delegated_ipv6_prefix.len) {
             ipv6pd = format_ipv6_prefix(&session->delegated_ipv6_prefix);
         }
-        if(*(uint64_t*)session->ipv6_dns1) {
-            ipv6_dns1 = format_ipv6_address(&session->ipv6_dns1);
+        if(*(uint64_t*)session->cold->ipv6_dns1) {
+            ipv6_dns1 = format_ipv6_address(&session->cold->ipv6_dns1);
         }
-        if(*(uint64_t*)session->ipv6_dns2) {
-            ipv6_dns2 = format_ipv6_address(&session->ipv6_dns2);
+        if(*(uint64_t*)session->cold->ipv6_dns2) {
+            ipv6_dns2 = format_ipv6_address(&session->cold->ipv6_dns2);
         }
-        if(*(uint64_t*)session->dhcpv6_dns1) {
-            dhcpv6_dns1 = format_ipv6_address(&session->dhcpv6_dns1);
+        if(*(uint64_t*)session->cold->dhcpv6_dns1) {
+            dhcpv6_dns1 = format_ipv6_address(&session->cold->dhcpv6_dns1);
         }
-        if(*(uint64_t*)session->dhcpv6_dns2) {
-            dhcpv6_dns2 = format_ipv6_address(&session->dhcpv6_dns2);
+        if(*(uint64_t*)session->cold->dhcpv6_dns2) {
+            dhcpv6_dns2 = format_ipv6_address(&session->cold->dhcpv6_dns2);
         }
 
         if(session->access_type == ACCESS_TYPE_PPPOE) {
             type = "pppoe";
-            username = session->username;
+            username = session->cold->username;
             lcp = ppp_state_string(session->lcp_state);
             ipcp = ppp_state_string(session->ipcp_state);
             ip6cp = ppp_state_string(session->ip6cp_state);
@@ -472,14 +628,17 @@ bbl_ctrl_session_info(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* argume
                         "network-rx-session-packets-ipv6pd", session->stats.network_ipv6pd_rx,
                         "network-rx-session-packets-ipv6pd-loss", session->stats.network_ipv6pd_loss);
         }
+        if(session_traffic && session->traffic_flows) {
+            bbl_ctrl_session_latency(session, session_traffic);
+        }
         root = json_pack("{ss si s{ss ss* ss ss ss ss* ss* ss* ss* ss* ss* ss* ss* ss* ss* ss* ss* so*}}", 
                         "status", "ok", 
                         "code", 200,
                         "session-information",
                         "type", type,
                         "username", username,
-                        "agent-circuit-id", session->agent_circuit_id,
-                        "agent-remote-id", session->agent_remote_id,
+                        "agent-circuit-id", session->cold->agent_circuit_id,
+                        "agent-remote-id", session->cold->agent_remote_id,
                         "session-state", session_state_string(session->session_state),
                         "lcp-state", lcp,
                         "ipcp-state", ipcp,
@@ -546,7 +705,7 @@ bbl_ctrl_session_terminate(int fd, bbl_ctx_s *ctx, session_key_t *key, json_t* a
     void **search;
     if(key->outer_vlan_id || key->inner_vlan_id) {
         /* Terminate single matching session ... */
-        search = dict_search(ctx->session_dict, key);
+        search = dict_search(ctx->session_dict.dict, key);
         if(search) {
             session = *search;
             bbl_session_clear(ctx, session);
@@ -571,7 +730,7 @@ bbl_ctrl_session_ncp_open(bbl_session_s *session, bool ipcp) {
         if(ipcp) {
             if(session->ipcp_state == BBL_PPP_CLOSED) {
                 session->ipcp_state = BBL_PPP_INIT;
-                session->ipcp_request_code = PPP_CODE_CONF_REQUEST;
+                session->cold->ipcp_request_code = PPP_CODE_CONF_REQUEST;
                 session->send_requests |= BBL_SEND_IPCP_REQUEST;
                 bbl_session_tx_qnode_insert(session);
             }
@@ -579,7 +738,7 @@ bbl_ctrl_session_ncp_open(bbl_session_s *session, bool ipcp) {
             /* ip6cp */
             if(session->ip6cp_state == BBL_PPP_CLOSED) {
                 session->ip6cp_state = BBL_PPP_INIT;
-                session->ip6cp_request_code = PPP_CODE_CONF_REQUEST;
+                session->cold->ip6cp_request_code = PPP_CODE_CONF_REQUEST;
                 session->send_requests |= BBL_SEND_IP6CP_REQUEST;
                 bbl_session_tx_qnode_insert(session);
             }
@@ -594,36 +753,37 @@ bbl_ctrl_session_ncp_close(bbl_ctx_s *ctx, bbl_session_s *session, bool ipcp) {
         if(ipcp) {
             if(session->ipcp_state == BBL_PPP_OPENED) {
                 session->ipcp_state = BBL_PPP_TERMINATE;
-                session->ipcp_request_code = PPP_CODE_TERM_REQUEST;
+                session->cold->ipcp_request_code = PPP_CODE_TERM_REQUEST;
                 session->send_requests |= BBL_SEND_IPCP_REQUEST;
                 session->ip_address = 0;
                 session->peer_ip_address = 0;
-                session->dns1 = 0;
-                session->dns2 = 0;
+                session->cold->dns1 = 0;
+                session->cold->dns2 = 0;
                 bbl_session_tx_qnode_insert(session);
             }
         } else {
             /* ip6cp */
             if(session->ip6cp_state == BBL_PPP_OPENED) {
                 session->ip6cp_state = BBL_PPP_TERMINATE;
-                session->ip6cp_request_code = PPP_CODE_TERM_REQUEST;
+                session->cold->ip6cp_request_code = PPP_CODE_TERM_REQUEST;
                 session->send_requests |= BBL_SEND_IP6CP_REQUEST;
                 session->ipv6_prefix.len = 0;
                 session->delegated_ipv6_prefix.len = 0;
                 session->icmpv6_ra_received = false;
-                session->dhcpv6_type = DHCPV6_MESSAGE_SOLICIT;
-                session->dhcpv6_ia_pd_option_len = 0;
-                if(session->dhcpv6_received) {
+                session->cold->dhcpv6_type = DHCPV6_MESSAGE_SOLICIT;
+                session->cold->dhcpv6_ia_pd_option_len = 0;
+                if(session->cold->dhcpv6_received) {
                     ctx->dhcpv6_established--;
                 }
-                session->dhcpv6_received = false;
-                if(session->dhcpv6_requested) {
+                session->cold->dhcpv6_received = false;
+                if(session->cold->dhcpv6_requested) {
                     ctx->dhcpv6_requested--;
                 }
-                session->dhcpv6_requested = false;
+                session->cold->dhcpv6_requested = false;
                 bbl_session_tx_qnode_insert(session);
             }
         }
+        bbl_session_io_update(ctx, session);
     }
 }
 
@@ -633,7 +793,7 @@ bbl_ctrl_session_ncp_open_close(int fd, bbl_ctx_s *ctx, session_key_t *key, bool
     bbl_session_s *session;
     void **search;
     if(key->outer_vlan_id || key->inner_vlan_id) {
-        search = dict_search(ctx->session_dict, key);
+        search = dict_search(ctx->session_dict.dict, key);
         if(search) {
             session = *search;
             if(session->access_type == ACCESS_TYPE_PPPOE) {
@@ -651,7 +811,7 @@ bbl_ctrl_session_ncp_open_close(int fd, bbl_ctx_s *ctx, session_key_t *key, bool
         }
     } else {
         /* Iterate over all sessions */
-        itor = dict_itor_new(ctx->session_dict);
+        itor = dict_itor_new(ctx->session_dict.dict);
         dict_itor_first(itor);
         for (; dict_itor_valid(itor); dict_itor_next(itor)) {
             session = (bbl_session_s*)*dict_itor_datum(itor);
@@ -698,7 +858,7 @@ bbl_ctrl_li_flows(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute__((unus
     struct dict_itor *itor;
 
     flows = json_array();
-    itor = dict_itor_new(ctx->li_flow_dict);
+    itor = dict_itor_new(ctx->li_flow_dict.dict);
     dict_itor_first(itor);
     for (; dict_itor_valid(itor); dict_itor_next(itor)) {
         li_flow = (bbl_li_flow_t*)*dict_itor_datum(itor);
@@ -824,7 +984,7 @@ bbl_ctrl_l2tp_sessions(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute__(
     if(tunnel_id && session_id) {
         l2tp_key.tunnel_id = tunnel_id;
         l2tp_key.session_id = session_id;
-        search = dict_search(ctx->l2tp_session_dict, &l2tp_key);
+        search = dict_search(ctx->l2tp_session_dict.dict, &l2tp_key);
         if(search) {
             l2tp_session = *search;
             json_array_append(sessions, l2tp_session_json(l2tp_session));
@@ -835,7 +995,7 @@ bbl_ctrl_l2tp_sessions(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute__(
         }
     } else if (tunnel_id) {
         l2tp_key.tunnel_id = tunnel_id;
-        search = dict_search(ctx->l2tp_session_dict, &l2tp_key);
+        search = dict_search(ctx->l2tp_session_dict.dict, &l2tp_key);
         if(search) {
             l2tp_session = *search;
             l2tp_tunnel = l2tp_session->tunnel;
@@ -891,7 +1051,7 @@ bbl_ctrl_l2tp_csurq(int fd, bbl_ctx_s *ctx, session_key_t *key __attribute__((un
         return bbl_ctrl_status(fd, "error", 400, "missing tunnel-id");
     }
     l2tp_key.tunnel_id = tunnel_id;
-    search = dict_search(ctx->l2tp_session_dict, &l2tp_key);
+    search = dict_search(ctx->l2tp_session_dict.dict, &l2tp_key);
     if(search) {
         l2tp_session = *search;
         l2tp_tunnel = l2tp_session->tunnel;
@@ -933,11 +1093,13 @@ struct action actions[] = {
     {"ip6cp-open", bbl_ctrl_session_ip6cp_open},
     {"ip6cp-close", bbl_ctrl_session_ip6cp_close},
     {"session-counters", bbl_ctrl_session_counters},
+    {"hash-tables", bbl_ctrl_hash_tables},
     {"session-info", bbl_ctrl_session_info},
     {"session-traffic-enabled", bbl_ctrl_session_traffic_start},
     {"session-traffic-start", bbl_ctrl_session_traffic_start},
     {"session-traffic-disabled", bbl_ctrl_session_traffic_stop},
     {"session-traffic-stop", bbl_ctrl_session_traffic_stop},
+    {"session-streams", bbl_ctrl_session_streams},
     {"multicast-traffic-start", bbl_ctrl_multicast_traffic_start},
     {"multicast-traffic-stop", bbl_ctrl_multicast_traffic_stop},
     {"igmp-join", bbl_ctrl_igmp_join},
@@ -950,10 +1112,8 @@ struct action actions[] = {
     {NULL, NULL},
 };
 
-void
-bbl_ctrl_socket_job (timer_s *timer) {
-    bbl_ctx_s *ctx = timer->data;
-
+static void
+bbl_ctrl_socket_accept (bbl_ctx_s *ctx) {
     session_key_t key = {0};
 
     char buf[INPUT_BUFFER];
@@ -1052,6 +1212,19 @@ Close:
     }
 }
 
+void
+bbl_ctrl_socket_job (timer_s *timer) {
+    bbl_ctrl_socket_accept(timer->data);
+}
+
+/*
+ * Control socket has become readable (event loop).
+ */
+static void
+bbl_ctrl_socket_event (void *arg) {
+    bbl_ctrl_socket_accept(arg);
+}
+
 bool
 bbl_ctrl_socket_open (bbl_ctx_s *ctx) {
     struct sockaddr_un addr = {0};
@@ -1077,7 +1250,14 @@ bbl_ctrl_socket_open (bbl_ctx_s *ctx) {
     /* Change socket to non-blocking */
     fcntl(ctx->ctrl_socket, F_SETFL, O_NONBLOCK);
 
-    timer_add_periodic(&ctx->timer_root, &ctx->ctrl_socket_timer, "CTRL Socket Timer", 0, 100 * MSEC, ctx, bbl_ctrl_socket_job);
+    if(ctx->event_loop) {
+        if(!bbl_event_add(ctx, &ctx->ctrl_socket_event, ctx->ctrl_socket, bbl_ctrl_socket_event, NULL, ctx)) {
+            fprintf(stderr, "Error: Failed to add ctrl socket to event loop\n");
+            return false;
+        }
+    } else {
+        timer_add_periodic(&ctx->timer_root, &ctx->ctrl_socket_timer, "CTRL Socket Timer", 0, 100 * MSEC, ctx, bbl_ctrl_socket_job);
+    }
 
     LOG(NORMAL, "Opened control socket %s\n", ctx->ctrl_socket_path);
     return true;
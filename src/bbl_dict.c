@@ -0,0 +1,216 @@
+/*
+ * BNG Blaster (BBL) - Dictionary Sizing
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <stdlib.h>
+#include "bbl_dict.h"
+
+static bool
+bbl_dict_is_prime (uint64_t n)
+{
+    uint64_t i;
+
+    if(n < 2) return false;
+    if(n % 2 == 0) return n == 2;
+    for(i = 3; i * i <= n; i += 2) {
+        if(n % i == 0) return false;
+    }
+    return true;
+}
+
+/*
+ * Number of buckets to keep the given
+ * entries below the load threshold.
+ */
+static uint32_t
+bbl_dict_buckets (uint64_t entries)
+{
+    uint64_t buckets = entries * 100 / BBL_DICT_LOAD_PERCENT + 1;
+
+    if(buckets < BBL_DICT_MIN_BUCKETS) {
+        buckets = BBL_DICT_MIN_BUCKETS;
+    }
+    while(!bbl_dict_is_prime(buckets)) {
+        buckets++;
+    }
+    if(buckets > UINT32_MAX) {
+        buckets = UINT32_MAX;
+    }
+    return buckets;
+}
+
+/*
+ * Create a hashtable sized for the expected number of entries.
+ */
+bool
+bbl_dict_init (bbl_dict_s *d, const char *name, dict_compare_func compare, dict_hash_func hash, uint64_t entries, bool grow)
+{
+    d->name = name;
+    d->compare = compare;
+    d->hash = hash;
+    d->grow = grow;
+    d->buckets = bbl_dict_buckets(entries);
+    d->resize_pending = false;
+    d->stats.resizes = 0;
+    d->stats.resize_failed = 0;
+    d->dict = hashtable2_dict_new(compare, hash, d->buckets);
+    return d->dict != NULL;
+}
+
+/*
+ * Rebuild the table with twice the number of buckets needed
+ * for the given entries. The table is kept as it is if this
+ * fails, including any failed insert into the new table.
+ */
+static bool
+bbl_dict_resize (bbl_dict_s *d, uint64_t entries)
+{
+    dict *new;
+    dict_itor *itor;
+    dict_insert_result result;
+    uint32_t buckets;
+
+    buckets = bbl_dict_buckets(entries * 2);
+    new = hashtable2_dict_new(d->compare, d->hash, buckets);
+    if(!new) {
+        d->stats.resize_failed++;
+        return false;
+    }
+    itor = dict_itor_new(d->dict);
+    if(!itor) {
+        dict_free(new, NULL);
+        d->stats.resize_failed++;
+        return false;
+    }
+    dict_itor_first(itor);
+    for (; dict_itor_valid(itor); dict_itor_next(itor)) {
+        result = dict_insert(new, (void*)dict_itor_key(itor));
+        if(!result.inserted || !result.datum_ptr) {
+            dict_itor_free(itor);
+            dict_free(new, NULL);
+            d->stats.resize_failed++;
+            return false;
+        }
+        *result.datum_ptr = *dict_itor_datum(itor);
+    }
+    dict_itor_free(itor);
+    dict_free(d->dict, NULL);
+    d->dict = new;
+    d->buckets = buckets;
+    d->stats.resizes++;
+    return true;
+}
+
+static bool
+bbl_dict_overloaded (bbl_dict_s *d, uint64_t entries)
+{
+    return entries * 100 > (uint64_t)d->buckets * BBL_DICT_LOAD_PERCENT;
+}
+
+/*
+ * Make room for one more entry, this must be called before
+ * dict_insert(). Tables which are allowed to grow are rebuilt
+ * with twice the number of buckets if the load would exceed
+ * the threshold. This rebuilds the whole table and must not
+ * be used on the packet path, see bbl_dict_reserve_deferred().
+ * The keys must not be stored in memory which is reused
+ * like packet buffers.
+ */
+void
+bbl_dict_reserve (bbl_dict_s *d)
+{
+    uint64_t entries;
+
+    if(!d->grow) {
+        return;
+    }
+    entries = dict_count(d->dict) + 1;
+    if(bbl_dict_overloaded(d, entries)) {
+        bbl_dict_resize(d, entries);
+    }
+}
+
+/*
+ * Same as bbl_dict_reserve() for tables filled on the packet
+ * path. The table is only marked to be rebuilt later by
+ * bbl_dict_maintain(), until then the load may exceed the
+ * threshold.
+ */
+void
+bbl_dict_reserve_deferred (bbl_dict_s *d)
+{
+    if(!d->grow || d->resize_pending) {
+        return;
+    }
+    if(bbl_dict_overloaded(d, dict_count(d->dict) + 1)) {
+        d->resize_pending = true;
+    }
+}
+
+/*
+ * Grow tables marked by bbl_dict_reserve_deferred(),
+ * called periodically outside of the packet path.
+ */
+void
+bbl_dict_maintain (bbl_dict_s *d)
+{
+    uint64_t entries;
+
+    if(!d->resize_pending) {
+        return;
+    }
+    d->resize_pending = false;
+    entries = dict_count(d->dict);
+    if(bbl_dict_overloaded(d, entries)) {
+        bbl_dict_resize(d, entries);
+    }
+}
+
+/*
+ * Count the entries per home bucket. The longest chain
+ * shows how well the hash function spreads the keys.
+ */
+void
+bbl_dict_get_stats (bbl_dict_s *d, bbl_dict_stats_s *stats)
+{
+    dict_itor *itor;
+    uint32_t *chain;
+    uint32_t bucket;
+
+    stats->entries = dict_count(d->dict);
+    stats->buckets = d->buckets;
+    stats->buckets_used = 0;
+    stats->max_chain = 0;
+    stats->load_factor = (double)stats->entries / d->buckets;
+
+    chain = calloc(d->buckets, sizeof(uint32_t));
+    if(!chain) {
+        return;
+    }
+    itor = dict_itor_new(d->dict);
+    dict_itor_first(itor);
+    for (; dict_itor_valid(itor); dict_itor_next(itor)) {
+        bucket = d->hash(dict_itor_key(itor)) % d->buckets;
+        if(!chain[bucket]++) {
+            stats->buckets_used++;
+        }
+        if(chain[bucket] > stats->max_chain) {
+            stats->max_chain = chain[bucket];
+        }
+    }
+    dict_itor_free(itor);
+    free(chain);
+}
+
+void
+bbl_dict_free (bbl_dict_s *d)
+{
+    if(d->dict) {
+        dict_free(d->dict, NULL);
+        d->dict = NULL;
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ * BNG Blaster (BBL) - Dictionary Sizing
+ *
+ * Size hashtables from the expected number of entries,
+ * grow them at runtime and report their load.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_DICT_H__
+#define __BBL_DICT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "libdict/dict.h"
+
+#define BBL_DICT_MIN_BUCKETS    1021 /* is a prime number */
+#define BBL_DICT_LOAD_PERCENT   75   /* grow above this load */
+
+typedef struct bbl_dict_
+{
+    dict *dict;
+    const char *name;
+    dict_compare_func compare;
+    dict_hash_func hash;
+    uint32_t buckets;
+    bool grow; /* grow at runtime */
+    bool resize_pending; /* grow from bbl_dict_maintain() */
+
+    struct {
+        uint32_t resizes;
+        uint32_t resize_failed;
+    } stats;
+} bbl_dict_s;
+
+typedef struct bbl_dict_stats_
+{
+    uint64_t entries;
+    uint32_t buckets;
+    uint32_t buckets_used;
+    uint32_t max_chain;
+    double load_factor;
+} bbl_dict_stats_s;
+
+/*
+ * Murmur3 finalizers which spread sequential keys
+ * like VLAN or tunnel and session identifiers.
+ */
+static inline uint32_t
+bbl_dict_mix32 (uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline uint64_t
+bbl_dict_mix64 (uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bool bbl_dict_init(bbl_dict_s *d, const char *name, dict_compare_func compare, dict_hash_func hash, uint64_t entries, bool grow);
+void bbl_dict_reserve(bbl_dict_s *d);
+void bbl_dict_reserve_deferred(bbl_dict_s *d);
+void bbl_dict_maintain(bbl_dict_s *d);
+void bbl_dict_get_stats(bbl_dict_s *d, bbl_dict_stats_s *stats);
+void bbl_dict_free(bbl_dict_s *d);
+
+#endif
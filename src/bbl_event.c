@@ -0,0 +1,243 @@
+/*
+ * BNG Blaster (BBL) - Event Loop
+ *
+ * Optional event driven main loop. Instead of sleeping until the
+ * next timer expires and polling the RX ringbuffers periodically,
+ * the control thread blocks in epoll_wait() on all RX ringbuffers,
+ * the control socket and a timerfd armed for the next timer deadline.
+ * Received packets are processed as soon as the kernel signals them.
+ *
+ * In busy poll mode, the control thread never blocks but spins on the
+ * RX ringbuffer status words and the TX queues, trading one CPU core
+ * for lower and more predictable latency.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "bbl.h"
+#include "bbl_event.h"
+
+extern volatile uint8_t g_teardown_request_count;
+
+/*
+ * The timerfd has expired, consume the expiration
+ * counter such that the fd is not readable anymore.
+ */
+static void
+bbl_event_timer (void *arg)
+{
+    bbl_event_loop_s *loop = arg;
+    uint64_t expirations;
+
+    if(read(loop->timer_event.fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+        loop->stats.timer_wakeups++;
+    }
+}
+
+bool
+bbl_event_init (bbl_ctx_s *ctx)
+{
+    bbl_event_loop_s *loop;
+    int fd;
+
+    loop = calloc(1, sizeof(bbl_event_loop_s));
+    if(!loop) {
+        return false;
+    }
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(loop->epoll_fd == -1) {
+        LOG(ERROR, "Failed to create epoll instance %s (%d)\n", strerror(errno), errno);
+        free(loop);
+        return false;
+    }
+    loop->busy_poll = ctx->config.busy_poll;
+    CIRCLEQ_INIT(&loop->poll_qhead);
+    ctx->event_loop = loop;
+
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+    if(fd == -1) {
+        LOG(ERROR, "Failed to create timerfd %s (%d)\n", strerror(errno), errno);
+        bbl_event_close(ctx);
+        return false;
+    }
+    if(!bbl_event_add(ctx, &loop->timer_event, fd, bbl_event_timer, NULL, loop)) {
+        close(fd);
+        bbl_event_close(ctx);
+        return false;
+    }
+    LOG(NORMAL, "Event loop enabled%s\n", loop->busy_poll ? " (busy poll)" : "");
+    return true;
+}
+
+/*
+ * Register a file descriptor. The event is owned by the caller
+ * and must stay valid until the event loop is closed.
+ */
+bool
+bbl_event_add (bbl_ctx_s *ctx, bbl_event_s *event, int fd, void (*cb)(void *arg), bool (*poll)(void *arg), void *arg)
+{
+    struct epoll_event ev = {0};
+
+    if(!ctx->event_loop) {
+        return false;
+    }
+    event->fd = fd;
+    event->cb = cb;
+    event->poll = poll;
+    event->arg = arg;
+    if(poll && ctx->event_loop->busy_poll) {
+        CIRCLEQ_INSERT_TAIL(&ctx->event_loop->poll_qhead, event, event_qnode);
+        return true;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = event;
+    if(epoll_ctl(ctx->event_loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        LOG(ERROR, "Failed to add fd %d to event loop %s (%d)\n", fd, strerror(errno), errno);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Enable kernel busy polling of the device queue for
+ * a socket. This is supported by some drivers only.
+ */
+void
+bbl_event_busy_poll_socket (bbl_ctx_s *ctx, int fd, const char *name)
+{
+    int value = ctx->config.busy_poll_usec;
+
+    if(setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) == -1) {
+        LOG(NORMAL, "Setting SO_BUSY_POLL error %s (%d) for interface %s\n", strerror(errno), errno, name);
+        return;
+    }
+#ifdef SO_PREFER_BUSY_POLL
+    value = 1;
+    if(setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &value, sizeof(value)) == -1) {
+        LOG(NORMAL, "Setting SO_PREFER_BUSY_POLL error %s (%d) for interface %s\n", strerror(errno), errno, name);
+    }
+#endif
+}
+
+/*
+ * Spin over all polled events, the TX queues and the timers.
+ * All other events like the control socket are checked
+ * without blocking every BBL_EVENT_BUSY_POLL_EPOLL_MASK+1 loops.
+ */
+static void
+bbl_event_busy_poll_walk (bbl_ctx_s *ctx)
+{
+    bbl_event_loop_s *loop = ctx->event_loop;
+    struct epoll_event events[BBL_EVENT_MAX];
+    struct timespec sleep;
+    bbl_interface_s *interface;
+    bbl_event_s *event;
+    uint8_t teardown_request_count = g_teardown_request_count;
+    bool work;
+    int nfds, i;
+
+    while(timer_walk_once(&ctx->timer_root, &sleep)) {
+        work = false;
+        CIRCLEQ_FOREACH(event, &loop->poll_qhead, event_qnode) {
+            if((*event->poll)(event->arg)) {
+                work = true;
+            }
+        }
+        CIRCLEQ_FOREACH(interface, &ctx->interface_qhead, interface_qnode) {
+            if(bbl_tx_poll(interface)) {
+                work = true;
+            }
+        }
+        loop->stats.busy_poll_loops++;
+        if(!work) {
+            loop->stats.busy_poll_empty++;
+        }
+
+        if((loop->stats.busy_poll_loops & BBL_EVENT_BUSY_POLL_EPOLL_MASK) == 0) {
+            if(teardown_request_count != g_teardown_request_count) {
+                /* Return to the caller to check for teardown. */
+                return;
+            }
+            nfds = epoll_wait(loop->epoll_fd, events, BBL_EVENT_MAX, 0);
+            for(i = 0; i < nfds; i++) {
+                event = events[i].data.ptr;
+                (*event->cb)(event->arg);
+            }
+        }
+    }
+}
+
+/*
+ * Run timers and I/O events until the timer root is empty.
+ * Falls back to timer_walk() if the event loop is not enabled.
+ */
+void
+bbl_event_walk (bbl_ctx_s *ctx)
+{
+    bbl_event_loop_s *loop = ctx->event_loop;
+    struct epoll_event events[BBL_EVENT_MAX];
+    struct itimerspec deadline = {0};
+    struct timespec sleep;
+    bbl_event_s *event;
+    int nfds, i;
+
+    if(!loop) {
+        timer_walk(&ctx->timer_root);
+        return;
+    }
+    if(loop->busy_poll) {
+        bbl_event_busy_poll_walk(ctx);
+        return;
+    }
+
+    while(timer_walk_once(&ctx->timer_root, &sleep)) {
+        /*
+         * Arm the timerfd for the next timer deadline. A zero
+         * value would disarm the timer, therefore wait at least 1ns.
+         */
+        deadline.it_value = sleep;
+        if(!(deadline.it_value.tv_sec || deadline.it_value.tv_nsec)) {
+            deadline.it_value.tv_nsec = 1;
+        }
+        if(timerfd_settime(loop->timer_event.fd, 0, &deadline, NULL) == -1) {
+            LOG(ERROR, "timerfd_settime() error %s (%d)\n", strerror(errno), errno);
+            return;
+        }
+
+        nfds = epoll_wait(loop->epoll_fd, events, BBL_EVENT_MAX, -1);
+        if(nfds == -1) {
+            if(errno == EINTR) {
+                /* Return to the caller to check for teardown. */
+                return;
+            }
+            LOG(ERROR, "epoll_wait() error %s (%d)\n", strerror(errno), errno);
+            return;
+        }
+        loop->stats.wakeups++;
+        loop->stats.events += nfds;
+        for(i = 0; i < nfds; i++) {
+            event = events[i].data.ptr;
+            (*event->cb)(event->arg);
+        }
+    }
+}
+
+void
+bbl_event_close (bbl_ctx_s *ctx)
+{
+    bbl_event_loop_s *loop = ctx->event_loop;
+
+    if(!loop) {
+        return;
+    }
+    if(loop->timer_event.fd > 0) {
+        close(loop->timer_event.fd);
+    }
+    close(loop->epoll_fd);
+    free(loop);
+    ctx->event_loop = NULL;
+}
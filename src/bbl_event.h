@@ -0,0 +1,60 @@
+/*
+ * BNG Blaster (BBL) - Event Loop
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_EVENT_H__
+#define __BBL_EVENT_H__
+
+#define BBL_EVENT_MAX 64 /* events per epoll_wait() */
+#define BBL_EVENT_BUSY_POLL_EPOLL_MASK 0x3ff /* check epoll every 1024 busy poll loops */
+
+typedef struct bbl_ctx_ bbl_ctx_s;
+
+/*
+ * File descriptor registered with the event loop.
+ * The callback is invoked if the file descriptor
+ * becomes readable. Events with an optional poll
+ * function are polled directly in busy poll mode,
+ * which returns true if some work has been done.
+ */
+typedef struct bbl_event_
+{
+    int fd;
+    void *arg;
+    void (*cb)(void *arg);
+    bool (*poll)(void *arg);
+    CIRCLEQ_ENTRY(bbl_event_) event_qnode;
+} bbl_event_s;
+
+/*
+ * Event loop using epoll for all registered file descriptors
+ * and a timerfd for the next timer deadline.
+ */
+typedef struct bbl_event_loop_
+{
+    int epoll_fd;
+    bbl_event_s timer_event; /* timerfd */
+
+    bool busy_poll;
+    CIRCLEQ_HEAD(bbl_event_poll_head_, bbl_event_) poll_qhead; /* busy polled events */
+
+    struct {
+        uint64_t wakeups;
+        uint64_t events;
+        uint64_t timer_wakeups;
+        uint64_t busy_poll_loops;
+        uint64_t busy_poll_empty;
+    } stats;
+} bbl_event_loop_s;
+
+bool bbl_event_init(bbl_ctx_s *ctx);
+bool bbl_event_add(bbl_ctx_s *ctx, bbl_event_s *event, int fd, void (*cb)(void *arg), bool (*poll)(void *arg), void *arg);
+void bbl_event_busy_poll_socket(bbl_ctx_s *ctx, int fd, const char *name);
+void bbl_event_walk(bbl_ctx_s *ctx);
+void bbl_event_close(bbl_ctx_s *ctx);
+
+#endif
@@ -31,12 +31,13 @@ enable_disable_session_traffic(bbl_ctx_s *ctx, bool status)
     bbl_session_s *session;
 
     /* Iterate over all sessions */
-    itor = dict_itor_new(ctx->session_dict);
+    itor = dict_itor_new(ctx->session_dict.dict);
     dict_itor_first(itor);
     for (; dict_itor_valid(itor); dict_itor_next(itor)) {
         session = (bbl_session_s*)*dict_itor_datum(itor);
         if(session) {
             session->session_traffic = status;
+            bbl_session_io_update(ctx, session);
         }
     }
 }
@@ -178,9 +179,9 @@ bbl_stats_job (timer_s *timer)
     }
     
     if (ctx->op.network_if) {
-        if(dict_count(ctx->li_flow_dict)) {
+        if(dict_count(ctx->li_flow_dict.dict)) {
             wprintw(stats_win, "\nLI Statistics\n");
-            wprintw(stats_win, "  Flows                     %10lu\n", dict_count(ctx->li_flow_dict));
+            wprintw(stats_win, "  Flows                     %10lu\n", dict_count(ctx->li_flow_dict.dict));
             wprintw(stats_win, "  Rx Packets                %10lu (%7lu PPS)\n",  
                 ctx->op.network_if->stats.li_rx, ctx->op.network_if->stats.rate_li_rx.avg);
         }
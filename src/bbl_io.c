@@ -0,0 +1,197 @@
+/*
+ * BNG Blaster (BBL) - I/O Backends
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include "bbl.h"
+#include "bbl_io.h"
+
+const char *
+bbl_io_mode_string (bbl_io_mode_t mode) {
+    switch(mode) {
+        case BBL_IO_PACKET_MMAP: return "packet-mmap";
+        case BBL_IO_AF_XDP: return "af-xdp";
+        default: return "N/A";
+    }
+}
+
+/*
+ * AF_PACKET TPACKET_V2 TX ringbuffer.
+ */
+static u_char *
+bbl_io_packet_mmap_tx_frame_get (bbl_interface_s *interface)
+{
+    struct tpacket2_hdr* tphdr;
+    u_char *frame_ptr;
+
+    frame_ptr = interface->ring_tx + (interface->cursor_tx * interface->req_tx.tp_frame_size);
+    tphdr = (struct tpacket2_hdr *)frame_ptr;
+    /* Check if this slot available for writing. */
+    if ((tphdr->tp_status & ~BBL_IO_TP_STATUS_TS) != TP_STATUS_AVAILABLE) {
+        interface->stats.no_tx_buffer++;
+        return NULL;
+    }
+    return frame_ptr;
+}
+
+/*
+ * Advance over frames which have been sent by the kernel.
+ */
+static void
+bbl_io_packet_mmap_tx_reclaim (bbl_interface_s *interface)
+{
+    struct tpacket2_hdr* tphdr;
+    uint64_t sent, written;
+    uint32_t sec, nsec;
+
+    while(interface->tx_inflight) {
+        tphdr = (struct tpacket2_hdr *)(interface->ring_tx + (interface->cursor_tx_done * interface->req_tx.tp_frame_size));
+        if(tphdr->tp_status == TP_STATUS_SEND_REQUEST || tphdr->tp_status == TP_STATUS_SENDING) {
+            break;
+        }
+        if(tphdr->tp_status & BBL_IO_TP_STATUS_TS) {
+            /* Kernel or hardware TX timestamp of the frame. */
+            sec = tphdr->tp_sec;
+            nsec = tphdr->tp_nsec;
+            if(tphdr->tp_status & TP_STATUS_TS_RAW_HARDWARE) {
+                bbl_io_phc_timestamp(&interface->phc_offset, &sec, &nsec);
+            }
+            sent = (uint64_t)sec * BBL_LATENCY_NSEC_PER_SEC + nsec;
+            written = interface->tx_slot_timestamp[interface->cursor_tx_done];
+            if(written && sent >= written) {
+                bbl_latency_add(&interface->stats.tx_delay, sent - written);
+            }
+        }
+        interface->cursor_tx_done = (interface->cursor_tx_done + 1) % interface->req_tx.tp_frame_nr;
+        interface->tx_inflight--;
+    }
+}
+
+/*
+ * Notify kernel. Without MSG_DONTWAIT the kernel would
+ * also wait for the completion of all frames sent.
+ */
+static void
+bbl_io_packet_mmap_tx_kick (bbl_interface_s *interface)
+{
+    bbl_io_packet_mmap_tx_reclaim(interface);
+    if(interface->tx_inflight > interface->stats.tx_inflight_max) {
+        interface->stats.tx_inflight_max = interface->tx_inflight;
+    }
+    interface->tx_pending = 0;
+    interface->tx_kick_retry = false;
+    interface->stats.tx_kicks++;
+    if (sendto(interface->fd_tx, NULL, 0 , MSG_DONTWAIT, NULL, 0) == -1) {
+        if(errno == EAGAIN || errno == ENOBUFS) {
+            /* Frames stay in the ring and are sent with the next kick. */
+            interface->stats.tx_kicks_again++;
+            interface->tx_kick_retry = true;
+        } else {
+            LOG(IO, "Sendto failed with errno: %i\n", errno);
+            interface->stats.sendto_failed++;
+        }
+    }
+}
+
+static void
+bbl_io_packet_mmap_tx_frame_commit (bbl_interface_s *interface)
+{
+    if(interface->tx_slot_timestamp) {
+        interface->tx_slot_timestamp[interface->cursor_tx] =
+            (uint64_t)interface->tx_timestamp.tv_sec * BBL_LATENCY_NSEC_PER_SEC + interface->tx_timestamp.tv_nsec;
+    }
+    interface->cursor_tx = (interface->cursor_tx + 1) % interface->req_tx.tp_frame_nr;
+    interface->tx_inflight++;
+    if(++interface->tx_pending >= interface->tx_flush_threshold) {
+        interface->stats.tx_kicks_early++;
+        bbl_io_packet_mmap_tx_kick(interface);
+    }
+}
+
+static void
+bbl_io_packet_mmap_tx_flush (bbl_interface_s *interface)
+{
+    if(interface->tx_pending || interface->tx_kick_retry) {
+        bbl_io_packet_mmap_tx_kick(interface);
+    } else {
+        interface->stats.tx_kicks_skipped++;
+    }
+}
+
+const bbl_io_ops_s bbl_io_packet_mmap_ops = {
+    .name = "packet-mmap",
+    .tx_frame_get = bbl_io_packet_mmap_tx_frame_get,
+    .tx_frame_commit = bbl_io_packet_mmap_tx_frame_commit,
+    .tx_flush = bbl_io_packet_mmap_tx_flush,
+    .rx = bbl_rx_packet_mmap,
+    .rx_ready = bbl_rx_packet_mmap_ready,
+};
+
+/*
+ * TPACKET_V3 block based RX ringbuffer, TX is the same.
+ */
+const bbl_io_ops_s bbl_io_packet_mmap_v3_ops = {
+    .name = "packet-mmap-v3",
+    .tx_frame_get = bbl_io_packet_mmap_tx_frame_get,
+    .tx_frame_commit = bbl_io_packet_mmap_tx_frame_commit,
+    .tx_flush = bbl_io_packet_mmap_tx_flush,
+    .rx = bbl_rx_packet_mmap_v3,
+    .rx_ready = bbl_rx_packet_mmap_v3_ready,
+};
+
+/*
+ * I/O thread. The control thread writes directly to the TX ringbuffer
+ * and the I/O thread notifies the kernel about committed frames.
+ */
+static void
+bbl_io_thread_tx_publish (bbl_interface_s *interface)
+{
+    bbl_io_thread_s *io_thread = interface->io_thread;
+
+    atomic_store_explicit(&io_thread->tx_committed,
+                          atomic_load_explicit(&io_thread->tx_committed, memory_order_relaxed) + interface->tx_pending,
+                          memory_order_release);
+    interface->tx_pending = 0;
+    bbl_io_thread_wakeup(io_thread);
+}
+
+static void
+bbl_io_thread_tx_frame_commit (bbl_interface_s *interface)
+{
+    if(interface->tx_slot_timestamp) {
+        interface->tx_slot_timestamp[interface->cursor_tx] =
+            (uint64_t)interface->tx_timestamp.tv_sec * BBL_LATENCY_NSEC_PER_SEC + interface->tx_timestamp.tv_nsec;
+    }
+    interface->cursor_tx = (interface->cursor_tx + 1) % interface->req_tx.tp_frame_nr;
+    interface->tx_inflight++;
+    if(++interface->tx_pending >= interface->tx_flush_threshold) {
+        interface->stats.tx_kicks_early++;
+        bbl_io_thread_tx_publish(interface);
+    }
+}
+
+static void
+bbl_io_thread_tx_flush (bbl_interface_s *interface)
+{
+    bbl_io_packet_mmap_tx_reclaim(interface);
+    if(interface->tx_inflight > interface->stats.tx_inflight_max) {
+        interface->stats.tx_inflight_max = interface->tx_inflight;
+    }
+    if(interface->tx_pending) {
+        bbl_io_thread_tx_publish(interface);
+    } else {
+        interface->stats.tx_kicks_skipped++;
+    }
+}
+
+const bbl_io_ops_s bbl_io_thread_ops = {
+    .name = "io-thread",
+    .tx_frame_get = bbl_io_packet_mmap_tx_frame_get,
+    .tx_frame_commit = bbl_io_thread_tx_frame_commit,
+    .tx_flush = bbl_io_thread_tx_flush,
+    .rx = bbl_rx_io_thread,
+    .rx_ready = bbl_rx_io_thread_ready,
+};
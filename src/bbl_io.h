@@ -0,0 +1,99 @@
+/*
+ * BNG Blaster (BBL) - I/O Backends
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_IO_H__
+#define __BBL_IO_H__
+
+typedef struct bbl_interface_ bbl_interface_s;
+typedef struct bbl_rx_ring_ bbl_rx_ring_s;
+
+#define BBL_IO_TX_FRAMES        1024
+#define BBL_IO_RX_FRAMES        2048
+#define BBL_IO_FRAME_SIZE       2048
+
+/* TX frames returned with SO_TIMESTAMPING carry a timestamp flag besides TP_STATUS_AVAILABLE. */
+#define BBL_IO_TP_STATUS_TS     (TP_STATUS_TS_SOFTWARE | TP_STATUS_TS_SYS_HARDWARE | TP_STATUS_TS_RAW_HARDWARE)
+
+/*
+ * Translate a raw hardware timestamp, taken from the PTP hardware
+ * clock (PHC) of the NIC, into CLOCK_REALTIME using the last measured
+ * clock offset, such that it compares with user space timestamps.
+ */
+static inline void
+bbl_io_phc_timestamp (int64_t *phc_offset, uint32_t *sec, uint32_t *nsec)
+{
+    int64_t ts = (int64_t)*sec * 1000000000LL + *nsec + __atomic_load_n(phc_offset, __ATOMIC_RELAXED);
+
+    *sec = ts / 1000000000LL;
+    *nsec = ts % 1000000000LL;
+}
+
+typedef enum {
+    BBL_IO_PACKET_MMAP = 0, /* AF_PACKET with mmapped TX/RX rings */
+    BBL_IO_AF_XDP           /* AF_XDP with UMEM and fill/completion rings */
+} __attribute__ ((__packed__)) bbl_io_mode_t;
+
+typedef enum {
+    BBL_TIMESTAMPING_OFF = 0,   /* one clock_gettime per I/O job */
+    BBL_TIMESTAMPING_SOFTWARE,  /* kernel software timestamps (SO_TIMESTAMPING) */
+    BBL_TIMESTAMPING_HARDWARE   /* NIC hardware timestamps (SO_TIMESTAMPING) */
+} __attribute__ ((__packed__)) bbl_timestamping_t;
+
+/*
+ * Per interface configuration.
+ */
+typedef struct bbl_interface_config_
+{
+    bbl_io_mode_t io_mode;
+    int io_cpu; /* I/O thread CPU (-1 not pinned) */
+    uint8_t fanout; /* number of RX rings */
+    uint16_t fanout_type; /* PACKET_FANOUT_HASH or PACKET_FANOUT_CPU */
+    bool xdp_native; /* native (driver) instead of generic (skb) XDP mode */
+    uint32_t xdp_queue; /* NIC queue bound to the AF_XDP socket */
+    uint32_t tx_frames; /* TX ring frames */
+    uint32_t rx_frames; /* RX ring frames (per RX ring) */
+    uint32_t frame_size; /* ring frame size in bytes */
+    uint32_t block_size; /* ring block size in bytes (0 = default) */
+    bool ring_locked; /* lock ring memory (MAP_LOCKED) */
+    bool ring_hugepages; /* back AF_XDP UMEM with huge pages (MAP_HUGETLB) */
+    bbl_timestamping_t timestamping; /* RX/TX packet timestamp source */
+} bbl_interface_config_s;
+
+/*
+ * I/O backend operations.
+ *
+ * The TX job writes all frames through those operations. The frame
+ * returned by tx_frame_get() has the layout of a TPACKET_V2 frame,
+ * such that all encode functions work unchanged with every backend.
+ *
+ * The RX job, event and busy poll callbacks of each RX ring call
+ * rx() and rx_ready(). AF_XDP uses the first RX ring for its socket.
+ */
+typedef struct bbl_io_ops_
+{
+    const char *name;
+    /* Return the next free TX frame or NULL if none available. */
+    u_char *(*tx_frame_get)(bbl_interface_s *interface);
+    /* Hand over the frame returned by tx_frame_get(). */
+    void (*tx_frame_commit)(bbl_interface_s *interface);
+    /* Notify the kernel about committed frames. */
+    void (*tx_flush)(bbl_interface_s *interface);
+    /* Process all packets received on the RX ring. */
+    void (*rx)(bbl_rx_ring_s *rx_ring);
+    /* Return true if there are packets to process (busy poll). */
+    bool (*rx_ready)(bbl_rx_ring_s *rx_ring);
+} bbl_io_ops_s;
+
+extern const bbl_io_ops_s bbl_io_packet_mmap_ops;
+extern const bbl_io_ops_s bbl_io_packet_mmap_v3_ops;
+extern const bbl_io_ops_s bbl_io_thread_ops;
+extern const bbl_io_ops_s bbl_io_xdp_ops;
+
+const char *bbl_io_mode_string(bbl_io_mode_t mode);
+
+#endif
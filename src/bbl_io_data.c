@@ -0,0 +1,257 @@
+/*
+ * BNG Blaster (BBL) - I/O Thread Data Plane
+ *
+ * Session traffic, streams and multicast traffic sent by the
+ * I/O thread of the first RX ring of an interface. The calendars
+ * of the interface are owned by this I/O thread once started, the
+ * control thread passes flow and stream state changes together
+ * with a copy of the packet template using the data queue.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include "bbl.h"
+#include "bbl_io_data.h"
+
+/*
+ * Apply all flow and stream updates passed by the control thread.
+ */
+static uint
+bbl_io_data_update (bbl_io_thread_s *io_thread, uint64_t now)
+{
+    bbl_interface_s *interface = io_thread->interface;
+    bbl_io_data_msg_s *msg;
+    bbl_session_flow_s *flow;
+    bbl_stream_s *stream;
+    uint work = 0;
+
+    while((msg = (bbl_io_data_msg_s*)bbl_spsc_peek(io_thread->data.queue))) {
+        if(msg->type == BBL_IO_DATA_FLOW) {
+            flow = msg->object;
+            free(flow->io_template);
+            flow->io_template = msg->template;
+            flow->io_len = msg->len;
+            if(msg->seq_reset) {
+                flow->io_seq = 1;
+            }
+            if(msg->len) {
+                flow->entry.interval = msg->interval;
+                if(!flow->scheduled) {
+                    /* Spread the flows of an interface over their interval. */
+                    flow->entry.expire = now + (flow->entry.interval * (interface->traffic_flows & 0xff)) / 256;
+                    bbl_calendar_add(interface->traffic_calendar, &flow->entry);
+                    flow->scheduled = true;
+                    interface->traffic_flows++;
+                }
+            }
+        } else {
+            stream = msg->object;
+            free(stream->io_buf);
+            stream->io_buf = msg->template;
+            stream->io_len = msg->len;
+            stream->io_seq_offset = msg->seq_offset;
+        }
+        bbl_spsc_release(io_thread->data.queue);
+        work++;
+    }
+    return work;
+}
+
+static void
+bbl_io_data_kick (bbl_io_thread_s *io_thread)
+{
+    bbl_interface_stats_s *stats = io_thread->data.stats;
+
+    io_thread->data.pending = 0;
+    io_thread->data.kick_retry = false;
+    stats->tx_kicks++;
+    if(sendto(io_thread->data.fd, NULL, 0, MSG_DONTWAIT, NULL, 0) == -1) {
+        if(errno == EAGAIN || errno == ENOBUFS) {
+            /* Retry after the next poll instead of spinning. */
+            stats->tx_kicks_again++;
+            io_thread->data.kick_retry = true;
+        } else {
+            stats->sendto_failed++;
+        }
+    }
+}
+
+static u_char *
+bbl_io_data_frame_get (bbl_io_thread_s *io_thread)
+{
+    u_char *frame_ptr;
+    struct tpacket2_hdr *tphdr;
+
+    frame_ptr = io_thread->data.ring + (io_thread->data.cursor * io_thread->data.req.tp_frame_size);
+    tphdr = (struct tpacket2_hdr*)frame_ptr;
+    if(__atomic_load_n(&tphdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+        io_thread->data.stats->tx_class[BBL_TX_CLASS_DATA].ring_full++;
+        return NULL;
+    }
+    return frame_ptr;
+}
+
+static void
+bbl_io_data_frame_commit (bbl_io_thread_s *io_thread, u_char *frame_ptr, uint16_t len)
+{
+    bbl_interface_stats_s *stats = io_thread->data.stats;
+    struct tpacket2_hdr *tphdr = (struct tpacket2_hdr*)frame_ptr;
+
+    tphdr->tp_len = len;
+    __atomic_store_n(&tphdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    io_thread->data.cursor = (io_thread->data.cursor + 1) % io_thread->data.req.tp_frame_nr;
+    stats->packets_tx++;
+    stats->tx_class[BBL_TX_CLASS_DATA].packets++;
+    if(++io_thread->data.pending >= io_thread->data.flush_threshold) {
+        bbl_io_data_kick(io_thread);
+    }
+}
+
+/*
+ * Calendar send callback for session traffic flows. Flows
+ * stopped by the control thread are removed from the calendar.
+ */
+static bbl_calendar_result_t
+bbl_io_data_flow_send (bbl_calendar_entry_s *entry, void *arg)
+{
+    bbl_io_thread_s *io_thread = arg;
+    bbl_interface_stats_s *stats = io_thread->data.stats;
+    bbl_session_flow_s *flow = (bbl_session_flow_s*)entry;
+    bbl_session_s *session = flow->session;
+    uint16_t len = flow->io_len;
+    u_char *frame_ptr;
+    uint8_t *buf;
+
+    if(!len) {
+        flow->scheduled = false;
+        entry->interval = 0;
+        io_thread->interface->traffic_flows--;
+        return BBL_CALENDAR_SKIPPED;
+    }
+    frame_ptr = bbl_io_data_frame_get(io_thread);
+    if(!frame_ptr) {
+        return BBL_CALENDAR_DEFERRED;
+    }
+    buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    memcpy(buf, flow->io_template, len);
+    *(uint64_t*)(buf + (len - 16)) = flow->io_seq++;
+    *(uint32_t*)(buf + (len - 8)) = io_thread->data.timestamp.tv_sec;
+    *(uint32_t*)(buf + (len - 4)) = io_thread->data.timestamp.tv_nsec;
+    switch(flow->type) {
+        case BBL_SESSION_FLOW_ACCESS_IPV4:
+            session->stats.access_ipv4_tx++;
+            stats->session_ipv4_tx++;
+            break;
+        case BBL_SESSION_FLOW_NETWORK_IPV4:
+            session->stats.network_ipv4_tx++;
+            stats->session_ipv4_tx++;
+            break;
+        case BBL_SESSION_FLOW_ACCESS_IPV6:
+            session->stats.access_ipv6_tx++;
+            stats->session_ipv6_tx++;
+            break;
+        case BBL_SESSION_FLOW_NETWORK_IPV6:
+            session->stats.network_ipv6_tx++;
+            stats->session_ipv6_tx++;
+            break;
+        case BBL_SESSION_FLOW_ACCESS_IPV6PD:
+            session->stats.access_ipv6pd_tx++;
+            stats->session_ipv6pd_tx++;
+            break;
+        case BBL_SESSION_FLOW_NETWORK_IPV6PD:
+            session->stats.network_ipv6pd_tx++;
+            stats->session_ipv6pd_tx++;
+            break;
+        default:
+            break;
+    }
+    bbl_io_data_frame_commit(io_thread, frame_ptr, len);
+    return BBL_CALENDAR_SENT;
+}
+
+/*
+ * Calendar send callback for streams. Streams not ready to send
+ * stay scheduled, such that traffic starts as soon as the control
+ * thread passes the template.
+ */
+static bbl_calendar_result_t
+bbl_io_data_stream_send (bbl_calendar_entry_s *entry, void *arg)
+{
+    bbl_io_thread_s *io_thread = arg;
+    bbl_stream_s *stream = (bbl_stream_s*)entry;
+    u_char *frame_ptr;
+    uint8_t *buf;
+
+    if(!stream->io_len) {
+        return BBL_CALENDAR_SKIPPED;
+    }
+    frame_ptr = bbl_io_data_frame_get(io_thread);
+    if(!frame_ptr) {
+        return BBL_CALENDAR_DEFERRED;
+    }
+    buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    memcpy(buf, stream->io_buf, stream->io_len);
+    *(uint64_t*)(buf + stream->io_seq_offset) = ++stream->flow_seq;
+    *(uint32_t*)(buf + stream->io_seq_offset + 8) = io_thread->data.timestamp.tv_sec;
+    *(uint32_t*)(buf + stream->io_seq_offset + 12) = io_thread->data.timestamp.tv_nsec;
+    io_thread->data.stats->stream_tx++;
+    stream->stats.packets_tx++;
+    bbl_io_data_frame_commit(io_thread, frame_ptr, stream->io_len);
+    return BBL_CALENDAR_SENT;
+}
+
+static bbl_calendar_result_t
+bbl_io_data_multicast_send (bbl_calendar_entry_s *entry, void *arg)
+{
+    bbl_io_thread_s *io_thread = arg;
+    bbl_mc_stream_s *stream = (bbl_mc_stream_s*)entry;
+    u_char *frame_ptr;
+    uint8_t *buf;
+
+    frame_ptr = bbl_io_data_frame_get(io_thread);
+    if(!frame_ptr) {
+        return BBL_CALENDAR_DEFERRED;
+    }
+    buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    memcpy(buf, stream->packet, stream->len);
+    *(uint64_t*)(buf + stream->seq_offset) = ++stream->seq;
+    *(uint32_t*)(buf + stream->seq_offset + 8) = io_thread->data.timestamp.tv_sec;
+    *(uint32_t*)(buf + stream->seq_offset + 12) = io_thread->data.timestamp.tv_nsec;
+    io_thread->data.stats->mc_tx++;
+    stream->packets_tx++;
+    bbl_io_data_frame_commit(io_thread, frame_ptr, stream->len);
+    return BBL_CALENDAR_SENT;
+}
+
+/*
+ * Send all data traffic of the interface which is due
+ * (I/O thread). Returns the number of updates and packets.
+ */
+uint
+bbl_io_data_tx (bbl_io_thread_s *io_thread)
+{
+    bbl_interface_s *interface = io_thread->interface;
+    uint64_t now = bbl_calendar_now();
+    uint work;
+
+    work = bbl_io_data_update(io_thread, now);
+    clock_gettime(CLOCK_REALTIME, &io_thread->data.timestamp);
+
+    if(interface->mc_calendar && __atomic_load_n(&interface->ctx->multicast_traffic, __ATOMIC_RELAXED)) {
+        work += bbl_calendar_run(interface->mc_calendar, now, bbl_io_data_multicast_send, io_thread);
+    }
+    if(interface->traffic_calendar) {
+        work += bbl_calendar_run(interface->traffic_calendar, now, bbl_io_data_flow_send, io_thread);
+    }
+    if(interface->stream_calendar) {
+        work += bbl_calendar_run(interface->stream_calendar, now, bbl_io_data_stream_send, io_thread);
+    }
+
+    /* Notify kernel. */
+    if(io_thread->data.pending || io_thread->data.kick_retry) {
+        bbl_io_data_kick(io_thread);
+    }
+    return work;
+}
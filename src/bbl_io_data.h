@@ -0,0 +1,44 @@
+/*
+ * BNG Blaster (BBL) - I/O Thread Data Plane
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_IO_DATA_H__
+#define __BBL_IO_DATA_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BBL_IO_DATA_QUEUE_SLOTS     4096
+
+typedef struct bbl_io_thread_ bbl_io_thread_s;
+typedef struct bbl_interface_stats_ bbl_interface_stats_s;
+
+typedef enum {
+    BBL_IO_DATA_FLOW = 0, /* session traffic flow */
+    BBL_IO_DATA_STREAM
+} __attribute__ ((__packed__)) bbl_io_data_msg_type_t;
+
+/*
+ * State change of a session traffic flow or stream as passed from the
+ * control thread to the I/O thread sending it. The message carries a
+ * private copy of the packet template which is owned by the I/O thread
+ * from then on, the I/O thread frees the template it replaces.
+ */
+typedef struct bbl_io_data_msg_
+{
+    bbl_io_data_msg_type_t type;
+    bool seq_reset; /* flows only, template of a new flow identifier */
+    uint16_t len; /* template length, 0 stops the flow or stream */
+    uint16_t seq_offset; /* streams only, offset of the BBL flow sequence */
+    uint64_t interval; /* flows only, nanoseconds */
+    void *object; /* bbl_session_flow_s or bbl_stream_s */
+    uint8_t *template;
+} bbl_io_data_msg_s;
+
+uint bbl_io_data_tx(bbl_io_thread_s *io_thread);
+
+#endif
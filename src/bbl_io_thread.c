@@ -0,0 +1,614 @@
+/*
+ * BNG Blaster (BBL) - I/O Threads
+ *
+ * Optional per interface I/O threads moving all ringbuffer
+ * polling, packet decoding and kernel interactions out of
+ * the control thread, optionally together with the data
+ * plane (see bbl_io_data.c).
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/eventfd.h>
+#include "bbl.h"
+#include "bbl_io_thread.h"
+
+#define BBL_IO_THREAD_SLOT_SIZE \
+    ((sizeof(bbl_io_rx_slot_s) + SCRATCHPAD_LEN + BBL_SPSC_CACHELINE - 1) & ~(BBL_SPSC_CACHELINE - 1))
+
+/*
+ * Counters are written by the I/O thread only, such
+ * that a relaxed load and store is sufficient.
+ */
+static inline void
+bbl_io_thread_count (_Atomic uint64_t *counter, uint64_t n)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+/*
+ * Number of release FIFO entries, one per frame (block with
+ * TPACKET_V3) plus one to tell a full from an empty FIFO.
+ */
+static inline uint32_t
+bbl_io_thread_rx_release_size (bbl_rx_ring_s *rx_ring)
+{
+    if(rx_ring->interface->rx_tpacket_v3) {
+        return rx_ring->req.tp_block_nr + 1;
+    }
+    return rx_ring->req.tp_frame_nr + 1;
+}
+
+/*
+ * Claim a frame (block) processed by the I/O thread, which is
+ * returned to the kernel once the control thread has released
+ * all RX queue slots committed so far.
+ */
+static inline void
+bbl_io_thread_rx_claim (bbl_rx_ring_s *rx_ring, uint32_t *status)
+{
+    bbl_io_rx_release_s *release = &rx_ring->io_release[rx_ring->io_release_head];
+
+    release->status = status;
+    release->queue_pos = bbl_spsc_produced(rx_ring->io_queue);
+    rx_ring->io_release_head = (rx_ring->io_release_head + 1) % bbl_io_thread_rx_release_size(rx_ring);
+}
+
+/*
+ * Return all claimed frames (blocks) to the kernel in ring order,
+ * which are no longer referenced by RX queue slots. Returns the
+ * number of frames (blocks) returned.
+ */
+static uint
+bbl_io_thread_rx_release (bbl_rx_ring_s *rx_ring)
+{
+    bbl_io_rx_release_s *release;
+    uint32_t consumed;
+    uint work = 0;
+
+    if(rx_ring->io_release_tail == rx_ring->io_release_head) {
+        return 0;
+    }
+    consumed = bbl_spsc_consumed(rx_ring->io_queue);
+    while(rx_ring->io_release_tail != rx_ring->io_release_head) {
+        release = &rx_ring->io_release[rx_ring->io_release_tail];
+        if((int32_t)(consumed - release->queue_pos) < 0) {
+            break;
+        }
+        __atomic_store_n(release->status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        rx_ring->io_release_tail = (rx_ring->io_release_tail + 1) % bbl_io_thread_rx_release_size(rx_ring);
+        work++;
+    }
+    return work;
+}
+
+/*
+ * Classify or decode a received packet into the RX queue slot.
+ * BBL traffic accounted by the data plane of the I/O thread is
+ * not passed to the control thread. Returns true if the slot
+ * must be committed.
+ */
+static bool
+bbl_io_thread_rx_decode (bbl_io_thread_s *io_thread, bbl_io_rx_slot_s *slot)
+{
+    bbl_interface_s *interface = io_thread->interface;
+
+    slot->classified = false;
+    slot->eth = NULL;
+    if(interface->ctx->config.rx_fast_path &&
+       classify_bbl(slot->eth_start, slot->eth_len, &slot->classify) == PROTOCOL_SUCCESS) {
+        if(interface->io_data &&
+           bbl_rx_fast_path(interface, io_thread, &slot->classify, slot->vlan_tci, slot->rx_sec, slot->rx_nsec)) {
+            io_thread->data.stats->packets_rx_fast_path++;
+            return false;
+        }
+        slot->classified = true;
+        return true;
+    }
+    slot->decode_result = bbl_rx_decode(slot->eth_start, slot->eth_len, slot->vlan_tci,
+                                        slot->rx_sec, slot->rx_nsec, slot->sp, &slot->eth);
+    return true;
+}
+
+/*
+ * Pass all new packets of an RX ringbuffer to the control thread.
+ * Returns the number of packets processed or zero if there are no
+ * new packets or the ringbuffer is blocked by packets not yet
+ * released by the control thread.
+ */
+static uint
+bbl_io_thread_rx (bbl_io_thread_s *io_thread, bbl_rx_ring_s *rx_ring)
+{
+    bbl_interface_s *interface = io_thread->interface;
+    bbl_io_rx_slot_s *slot;
+    struct tpacket2_hdr *tphdr;
+    struct tpacket_block_desc *block;
+    struct tpacket3_hdr *tphdr3;
+    uint32_t *status;
+    uint32_t nr;
+    uint32_t num_pkts;
+    uint work = 0;
+
+    nr = bbl_io_thread_rx_release_size(rx_ring);
+
+    while(true) {
+        slot = (bbl_io_rx_slot_s*)bbl_spsc_reserve(rx_ring->io_queue);
+        if(!slot) {
+            bbl_io_thread_count(&rx_ring->io_stats.queue_full, 1);
+            break;
+        }
+        if(interface->rx_tpacket_v3) {
+            block = (struct tpacket_block_desc*)(rx_ring->ring + (rx_ring->cursor * rx_ring->req.tp_block_size));
+            if(!rx_ring->io_block_pkts) {
+                /* Start the next block unless all blocks are claimed. */
+                if((rx_ring->io_release_head + 1) % nr == rx_ring->io_release_tail) {
+                    break;
+                }
+                if(!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+                    break;
+                }
+                num_pkts = block->hdr.bh1.num_pkts;
+                bbl_io_thread_count(&rx_ring->io_stats.packets_rx, num_pkts);
+                bbl_io_thread_count(&rx_ring->io_stats.rx_blocks, 1);
+                bbl_io_thread_count(&rx_ring->io_stats.rx_block_packets, num_pkts);
+                if(num_pkts > atomic_load_explicit(&rx_ring->io_stats.rx_block_packets_max, memory_order_relaxed)) {
+                    atomic_store_explicit(&rx_ring->io_stats.rx_block_packets_max, num_pkts, memory_order_relaxed);
+                }
+                if(!num_pkts) {
+                    /* Empty block, returned to the kernel in order. */
+                    bbl_io_thread_rx_claim(rx_ring, &block->hdr.bh1.block_status);
+                    rx_ring->cursor = (rx_ring->cursor + 1) % rx_ring->req.tp_block_nr;
+                    continue;
+                }
+                rx_ring->io_block_pkts = num_pkts;
+                rx_ring->io_tphdr3 = (struct tpacket3_hdr*)((uint8_t*)block + block->hdr.bh1.offset_to_first_pkt);
+            }
+            tphdr3 = rx_ring->io_tphdr3;
+            slot->eth_start = (uint8_t*)tphdr3 + tphdr3->tp_mac;
+            slot->eth_len = tphdr3->tp_snaplen;
+            slot->vlan_tci = tphdr3->hv1.tp_vlan_tci;
+            slot->rx_sec = tphdr3->tp_sec;
+            slot->rx_nsec = tphdr3->tp_nsec;
+            if(tphdr3->tp_status & TP_STATUS_TS_RAW_HARDWARE) {
+                bbl_io_phc_timestamp(&interface->phc_offset, &slot->rx_sec, &slot->rx_nsec);
+            }
+            rx_ring->io_tphdr3 = (struct tpacket3_hdr*)((uint8_t*)tphdr3 + tphdr3->tp_next_offset);
+            if(--rx_ring->io_block_pkts) {
+                status = NULL;
+            } else {
+                status = &block->hdr.bh1.block_status;
+                rx_ring->cursor = (rx_ring->cursor + 1) % rx_ring->req.tp_block_nr;
+            }
+        } else {
+            if((rx_ring->io_release_head + 1) % nr == rx_ring->io_release_tail) {
+                break;
+            }
+            tphdr = (struct tpacket2_hdr*)(rx_ring->ring + (rx_ring->cursor * rx_ring->req.tp_frame_size));
+            if(!(__atomic_load_n(&tphdr->tp_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+                break;
+            }
+            slot->eth_start = (uint8_t*)tphdr + tphdr->tp_mac;
+            slot->eth_len = tphdr->tp_len;
+            slot->vlan_tci = tphdr->tp_vlan_tci;
+            slot->rx_sec = tphdr->tp_sec;
+            slot->rx_nsec = tphdr->tp_nsec;
+            if(tphdr->tp_status & TP_STATUS_TS_RAW_HARDWARE) {
+                bbl_io_phc_timestamp(&interface->phc_offset, &slot->rx_sec, &slot->rx_nsec);
+            }
+            status = &tphdr->tp_status;
+            rx_ring->cursor = (rx_ring->cursor + 1) % rx_ring->req.tp_frame_nr;
+            bbl_io_thread_count(&rx_ring->io_stats.packets_rx, 1);
+        }
+        if(bbl_io_thread_rx_decode(io_thread, slot)) {
+            bbl_spsc_commit(rx_ring->io_queue);
+        }
+        if(status) {
+            bbl_io_thread_rx_claim(rx_ring, status);
+        }
+        work++;
+    }
+    return work;
+}
+
+/*
+ * Notify the kernel about the frames committed to the TX ringbuffer
+ * by the control thread. Returns true if the kernel was kicked.
+ */
+static bool
+bbl_io_thread_tx (bbl_io_thread_s *io_thread)
+{
+    bbl_interface_s *interface = io_thread->interface;
+    uint32_t committed;
+
+    committed = atomic_load_explicit(&io_thread->tx_committed, memory_order_acquire);
+    if(committed == io_thread->tx_kicked && !io_thread->tx_kick_retry) {
+        return false;
+    }
+    io_thread->tx_kicked = committed;
+    io_thread->tx_kick_retry = false;
+    bbl_io_thread_count(&io_thread->stats.tx_kicks, 1);
+    if (sendto(interface->fd_tx, NULL, 0 , MSG_DONTWAIT, NULL, 0) == -1) {
+        if(errno == EAGAIN || errno == ENOBUFS) {
+            /* Retry after the next poll instead of spinning. */
+            bbl_io_thread_count(&io_thread->stats.tx_kicks_again, 1);
+            io_thread->tx_kick_retry = true;
+        } else {
+            bbl_io_thread_count(&io_thread->stats.sendto_failed, 1);
+        }
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Wake up the I/O thread if it waits in poll().
+ */
+void
+bbl_io_thread_wakeup (bbl_io_thread_s *io_thread)
+{
+    uint64_t value = 1;
+
+    /* Order the preceding commit or release before checking
+     * the flag set by the I/O thread before it checks for work. */
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&io_thread->sleeping, memory_order_relaxed)) {
+        if(write(io_thread->wakeup_fd, &value, sizeof(value)) < 0) {
+            /* Counter overflow, the I/O thread is woken up anyway. */
+        }
+    }
+}
+
+/*
+ * Pass a flow or stream update to the I/O thread sending the data
+ * traffic of the interface (control thread). The message is copied,
+ * the template is owned by the I/O thread from now on.
+ */
+void
+bbl_io_thread_data_update (bbl_interface_s *interface, bbl_io_data_msg_s *msg)
+{
+    bbl_io_thread_s *io_thread = interface->io_thread;
+    uint8_t *slot;
+
+    while(!(slot = bbl_spsc_reserve(io_thread->data.queue))) {
+        if(!io_thread->thread) {
+            /* Not running, no way to drain the queue. */
+            free(msg->template);
+            return;
+        }
+        interface->stats.io_data_queue_full++;
+        bbl_io_thread_wakeup(io_thread);
+        sched_yield();
+    }
+    memcpy(slot, msg, sizeof(bbl_io_data_msg_s));
+    bbl_spsc_commit(io_thread->data.queue);
+    bbl_io_thread_wakeup(io_thread);
+}
+
+static void *
+bbl_io_thread_main (void *arg)
+{
+    bbl_io_thread_s *io_thread = arg;
+    bbl_interface_s *interface = io_thread->interface;
+    bbl_rx_ring_s *rx_ring = io_thread->rx_ring;
+    struct pollfd fds[2] = {0};
+    uint64_t value;
+    uint work;
+
+    fds[0].fd = rx_ring->fd;
+    fds[1].fd = io_thread->wakeup_fd;
+    fds[1].events = POLLIN;
+
+    while(!atomic_load_explicit(&io_thread->stop, memory_order_relaxed)) {
+        work = bbl_io_thread_rx_release(rx_ring);
+        work += bbl_io_thread_rx(io_thread, rx_ring);
+        if(io_thread->tx) {
+            if(interface->io_data) {
+                work += bbl_io_data_tx(io_thread);
+            }
+            work += bbl_io_thread_tx(io_thread);
+        }
+        bbl_io_thread_count(&io_thread->stats.loops, 1);
+        if(work) {
+            continue;
+        }
+        bbl_io_thread_count(&io_thread->stats.empty_loops, 1);
+        if(io_thread->busy_poll) {
+            continue;
+        }
+
+        /* Nothing to do, wait for RX, TX or the control thread. */
+        atomic_store(&io_thread->sleeping, true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if((io_thread->tx && atomic_load(&io_thread->tx_committed) != io_thread->tx_kicked) ||
+           (io_thread->data.queue && bbl_spsc_peek(io_thread->data.queue)) ||
+           bbl_io_thread_rx_release(rx_ring)) {
+            atomic_store(&io_thread->sleeping, false);
+            continue;
+        }
+        /* The kernel signals POLLIN as long as frames are not returned,
+         * wait for the control thread to release its slots instead. */
+        if(rx_ring->io_release_head == rx_ring->io_release_tail && !rx_ring->io_block_pkts) {
+            fds[0].events = POLLIN;
+        } else {
+            fds[0].events = 0;
+        }
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        poll(fds, 2, BBL_IO_THREAD_POLL_TIMEOUT);
+        atomic_store(&io_thread->sleeping, false);
+        bbl_io_thread_count(&io_thread->stats.poll, 1);
+        if(fds[1].revents & POLLIN) {
+            if(read(io_thread->wakeup_fd, &value, sizeof(value)) < 0) {
+                /* Already reset. */
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Add the increase of a data plane counter of the I/O
+ * thread since the last merge to the interface counter.
+ */
+static inline void
+bbl_io_thread_merge (uint64_t *interface, uint64_t *merged, uint64_t *counter)
+{
+    uint64_t value = __atomic_load_n(counter, __ATOMIC_RELAXED);
+
+    *interface += value - *merged;
+    *merged = value;
+}
+
+static void
+bbl_io_thread_merge_latency (bbl_latency_s *latency, bbl_latency_s *merged, bbl_latency_s *counter)
+{
+    uint64_t count = __atomic_load_n(&counter->count, __ATOMIC_RELAXED);
+    uint64_t min, max;
+
+    if(count == merged->count) {
+        return;
+    }
+    min = __atomic_load_n(&counter->min, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&counter->max, __ATOMIC_RELAXED);
+    if(!latency->count || min < latency->min) latency->min = min;
+    if(max > latency->max) latency->max = max;
+    latency->count += count - merged->count;
+    merged->count = count;
+    bbl_io_thread_merge(&latency->sum, &merged->sum, &counter->sum);
+    latency->last = __atomic_load_n(&counter->last, __ATOMIC_RELAXED);
+}
+
+static void
+bbl_io_thread_merge_histogram (bbl_latency_histogram_s *histogram, bbl_latency_histogram_s *merged,
+                               bbl_latency_histogram_s *counter)
+{
+    uint i;
+
+    if(__atomic_load_n(&counter->count, __ATOMIC_RELAXED) == merged->count) {
+        return;
+    }
+    for(i = 0; i < BBL_LATENCY_BUCKETS; i++) {
+        bbl_io_thread_merge(&histogram->bucket[i], &merged->bucket[i], &counter->bucket[i]);
+    }
+    bbl_io_thread_merge(&histogram->count, &merged->count, &counter->count);
+}
+
+/*
+ * Merge the data plane counters of an I/O thread into
+ * the interface stats (control thread).
+ */
+static void
+bbl_io_thread_stats_data (bbl_interface_s *interface, bbl_io_thread_s *io_thread)
+{
+    bbl_interface_stats_s *stats = &interface->stats;
+    bbl_interface_stats_s *merged = io_thread->data.merged;
+    bbl_interface_stats_s *counter = io_thread->data.stats;
+
+#define BBL_IO_THREAD_MERGE(_field) bbl_io_thread_merge(&stats->_field, &merged->_field, &counter->_field)
+    BBL_IO_THREAD_MERGE(packets_tx);
+    BBL_IO_THREAD_MERGE(packets_rx_fast_path);
+    BBL_IO_THREAD_MERGE(tx_class[BBL_TX_CLASS_DATA].packets);
+    BBL_IO_THREAD_MERGE(tx_class[BBL_TX_CLASS_DATA].ring_full);
+    BBL_IO_THREAD_MERGE(mc_tx);
+    BBL_IO_THREAD_MERGE(stream_tx);
+    BBL_IO_THREAD_MERGE(stream_rx);
+    BBL_IO_THREAD_MERGE(stream_loss);
+    BBL_IO_THREAD_MERGE(session_ipv4_tx);
+    BBL_IO_THREAD_MERGE(session_ipv4_rx);
+    BBL_IO_THREAD_MERGE(session_ipv4_loss);
+    BBL_IO_THREAD_MERGE(session_ipv4_wrong_session);
+    BBL_IO_THREAD_MERGE(session_ipv6_tx);
+    BBL_IO_THREAD_MERGE(session_ipv6_rx);
+    BBL_IO_THREAD_MERGE(session_ipv6_loss);
+    BBL_IO_THREAD_MERGE(session_ipv6_wrong_session);
+    BBL_IO_THREAD_MERGE(session_ipv6pd_tx);
+    BBL_IO_THREAD_MERGE(session_ipv6pd_rx);
+    BBL_IO_THREAD_MERGE(session_ipv6pd_loss);
+    BBL_IO_THREAD_MERGE(session_ipv6pd_wrong_session);
+#undef BBL_IO_THREAD_MERGE
+    bbl_io_thread_merge_latency(&stats->session_latency, &merged->session_latency, &counter->session_latency);
+    bbl_io_thread_merge_histogram(&stats->session_latency_histogram, &merged->session_latency_histogram,
+                                  &counter->session_latency_histogram);
+    bbl_io_thread_merge_histogram(&stats->session_jitter_histogram, &merged->session_jitter_histogram,
+                                  &counter->session_jitter_histogram);
+}
+
+/*
+ * Merge the I/O thread counters into the interface
+ * and RX ring stats (control thread).
+ */
+void
+bbl_io_thread_stats (bbl_interface_s *interface)
+{
+    bbl_io_thread_s *io_thread;
+    bbl_rx_ring_s *rx_ring;
+    uint32_t block_packets_max;
+    uint8_t i;
+
+    interface->stats.packets_rx = 0;
+    interface->stats.rx_blocks = 0;
+    interface->stats.rx_block_packets = 0;
+    interface->stats.io_rx_queue_full = 0;
+    interface->stats.poll_rx = 0;
+    interface->stats.io_loops = 0;
+    interface->stats.io_empty_loops = 0;
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        rx_ring = &interface->rx_ring[i];
+        io_thread = rx_ring->io_thread;
+        rx_ring->stats.packets_rx = atomic_load_explicit(&rx_ring->io_stats.packets_rx, memory_order_relaxed);
+        rx_ring->stats.rx_blocks = atomic_load_explicit(&rx_ring->io_stats.rx_blocks, memory_order_relaxed);
+        rx_ring->stats.poll_rx = atomic_load_explicit(&io_thread->stats.poll, memory_order_relaxed);
+        interface->stats.packets_rx += rx_ring->stats.packets_rx;
+        interface->stats.rx_blocks += rx_ring->stats.rx_blocks;
+        interface->stats.rx_block_packets += atomic_load_explicit(&rx_ring->io_stats.rx_block_packets, memory_order_relaxed);
+        block_packets_max = atomic_load_explicit(&rx_ring->io_stats.rx_block_packets_max, memory_order_relaxed);
+        if(block_packets_max > interface->stats.rx_block_packets_max) {
+            interface->stats.rx_block_packets_max = block_packets_max;
+        }
+        interface->stats.io_rx_queue_full += atomic_load_explicit(&rx_ring->io_stats.queue_full, memory_order_relaxed);
+        interface->stats.poll_rx += rx_ring->stats.poll_rx;
+        interface->stats.io_loops += atomic_load_explicit(&io_thread->stats.loops, memory_order_relaxed);
+        interface->stats.io_empty_loops += atomic_load_explicit(&io_thread->stats.empty_loops, memory_order_relaxed);
+        bbl_io_thread_stats_data(interface, io_thread);
+    }
+    /* Kicks of the TX ringbuffer and the data TX ringbuffer. */
+    io_thread = interface->io_thread;
+    interface->stats.tx_kicks = atomic_load_explicit(&io_thread->stats.tx_kicks, memory_order_relaxed) +
+                                __atomic_load_n(&io_thread->data.stats->tx_kicks, __ATOMIC_RELAXED);
+    interface->stats.tx_kicks_again = atomic_load_explicit(&io_thread->stats.tx_kicks_again, memory_order_relaxed) +
+                                      __atomic_load_n(&io_thread->data.stats->tx_kicks_again, __ATOMIC_RELAXED);
+    interface->stats.sendto_failed = atomic_load_explicit(&io_thread->stats.sendto_failed, memory_order_relaxed) +
+                                     __atomic_load_n(&io_thread->data.stats->sendto_failed, __ATOMIC_RELAXED);
+}
+
+/*
+ * Setup the I/O threads of an interface, one per RX ring. The
+ * threads are started later with bbl_io_thread_start_all() after
+ * all interfaces have been added. Those are pinned to consecutive
+ * CPUs starting with the given one. The data TX socket and ring
+ * are setup by the caller if the data plane is enabled.
+ */
+bool
+bbl_io_thread_add (bbl_ctx_s *ctx, bbl_interface_s *interface, int cpu)
+{
+    bbl_io_thread_s *io_thread;
+    bbl_rx_ring_s *rx_ring;
+    uint8_t i;
+
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        rx_ring = &interface->rx_ring[i];
+        io_thread = calloc(1, sizeof(bbl_io_thread_s));
+        if(!io_thread) {
+            return false;
+        }
+        io_thread->interface = interface;
+        io_thread->rx_ring = rx_ring;
+        io_thread->tx = (i == 0);
+        io_thread->cpu = cpu < 0 ? cpu : cpu + i;
+        io_thread->busy_poll = ctx->config.busy_poll;
+        atomic_init(&io_thread->stop, false);
+        atomic_init(&io_thread->sleeping, false);
+        io_thread->data.fd = -1;
+        io_thread->wakeup_fd = eventfd(0, EFD_NONBLOCK);
+        if(io_thread->wakeup_fd == -1) {
+            free(io_thread);
+            return false;
+        }
+        /* Owned by the interface from now on. */
+        rx_ring->io_thread = io_thread;
+        rx_ring->io_queue = bbl_spsc_new(BBL_IO_THREAD_QUEUE_SLOTS, BBL_IO_THREAD_SLOT_SIZE);
+        rx_ring->io_release = calloc(bbl_io_thread_rx_release_size(rx_ring), sizeof(bbl_io_rx_release_s));
+        io_thread->data.stats = calloc(1, sizeof(bbl_interface_stats_s));
+        io_thread->data.merged = calloc(1, sizeof(bbl_interface_stats_s));
+        if(!rx_ring->io_queue || !rx_ring->io_release || !io_thread->data.stats || !io_thread->data.merged) {
+            return false;
+        }
+        if(io_thread->tx && interface->io_data) {
+            io_thread->data.queue = bbl_spsc_new(BBL_IO_DATA_QUEUE_SLOTS, sizeof(bbl_io_data_msg_s));
+            if(!io_thread->data.queue) {
+                return false;
+            }
+        }
+    }
+    interface->io_thread = interface->rx_ring[0].io_thread;
+    interface->io_ops = &bbl_io_thread_ops;
+    return true;
+}
+
+bool
+bbl_io_thread_start_all (bbl_ctx_s *ctx)
+{
+    bbl_interface_s *interface;
+    bbl_io_thread_s *io_thread;
+    pthread_attr_t attr;
+    cpu_set_t cpuset;
+    uint8_t i;
+    int rc;
+
+    CIRCLEQ_FOREACH(interface, &ctx->interface_qhead, interface_qnode) {
+        if(!interface->io_thread) {
+            continue;
+        }
+        if(interface->io_data && !interface->traffic_calendar) {
+            /* Session traffic flows are added by the I/O thread. */
+            interface->traffic_calendar = bbl_calendar_new(BBL_CALENDAR_TICK_NSEC, bbl_calendar_now());
+            if(!interface->traffic_calendar) {
+                return false;
+            }
+        }
+        for(i = 0; i < interface->rx_ring_count; i++) {
+            io_thread = interface->rx_ring[i].io_thread;
+            pthread_attr_init(&attr);
+            if(io_thread->cpu >= 0) {
+                /* Pin before the thread starts, such that it
+                 * never runs and allocates memory elsewhere. */
+                CPU_ZERO(&cpuset);
+                CPU_SET(io_thread->cpu, &cpuset);
+                rc = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+                if(rc) {
+                    LOG(ERROR, "Failed to pin I/O thread %u for interface %s to CPU %d (%s)\n",
+                        i, interface->name, io_thread->cpu, strerror(rc));
+                    pthread_attr_destroy(&attr);
+                    return false;
+                }
+            }
+            rc = pthread_create(&io_thread->thread, &attr, bbl_io_thread_main, io_thread);
+            pthread_attr_destroy(&attr);
+            if(rc) {
+                LOG(ERROR, "Failed to start I/O thread %u for interface %s (%s)\n", i, interface->name, strerror(rc));
+                return false;
+            }
+            LOG(NORMAL, "Started I/O thread %u for interface %s (cpu %d)\n", i, interface->name, io_thread->cpu);
+        }
+    }
+    return true;
+}
+
+void
+bbl_io_thread_stop_all (bbl_ctx_s *ctx)
+{
+    bbl_interface_s *interface;
+    bbl_io_thread_s *io_thread;
+    uint8_t i;
+
+    CIRCLEQ_FOREACH(interface, &ctx->interface_qhead, interface_qnode) {
+        if(!interface->io_thread) {
+            continue;
+        }
+        for(i = 0; i < interface->rx_ring_count; i++) {
+            io_thread = interface->rx_ring[i].io_thread;
+            if(!io_thread->thread) {
+                continue;
+            }
+            atomic_store(&io_thread->stop, true);
+            bbl_io_thread_wakeup(io_thread);
+            pthread_join(io_thread->thread, NULL);
+            io_thread->thread = 0;
+        }
+        bbl_io_thread_stats(interface);
+    }
+}
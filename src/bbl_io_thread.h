@@ -0,0 +1,139 @@
+/*
+ * BNG Blaster (BBL) - I/O Threads
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_IO_THREAD_H__
+#define __BBL_IO_THREAD_H__
+
+#include <pthread.h>
+#include "bbl_spsc.h"
+#include "bbl_protocols.h"
+#include "bbl_io_data.h"
+
+#define BBL_IO_THREAD_QUEUE_SLOTS   4096
+#define BBL_IO_THREAD_POLL_TIMEOUT  1 /* milliseconds */
+
+typedef struct bbl_ctx_ bbl_ctx_s;
+typedef struct bbl_interface_ bbl_interface_s;
+typedef struct bbl_rx_ring_ bbl_rx_ring_s;
+
+/*
+ * Received packet as passed from the I/O thread to the control
+ * thread. The packet itself stays in the RX ringbuffer until the
+ * control thread has released the slot, the I/O thread returns the
+ * frame (block with TPACKET_V3) to the kernel afterwards.
+ *
+ * The I/O thread has already classified (fast path) or decoded
+ * the packet, using the scratchpad at the end of the slot.
+ */
+typedef struct bbl_io_rx_slot_
+{
+    uint8_t *eth_start; /* packet inside the RX ringbuffer */
+    uint16_t eth_len;
+    uint16_t vlan_tci;
+    uint32_t rx_sec;
+    uint32_t rx_nsec;
+    bool classified; /* classify_bbl() succeeded */
+    protocol_error_t decode_result; /* decode_ethernet() result if not classified */
+    bbl_classify_t classify;
+    bbl_ethernet_header_t *eth;
+    uint8_t sp[] __attribute__ ((aligned (8))); /* decode scratchpad */
+} bbl_io_rx_slot_s;
+
+/*
+ * RX frame (block with TPACKET_V3) claimed by the I/O thread, which
+ * is returned to the kernel as soon as the control thread has
+ * released all RX queue slots committed up to queue_pos.
+ */
+typedef struct bbl_io_rx_release_
+{
+    uint32_t *status; /* frame or block status */
+    uint32_t queue_pos; /* bbl_spsc_produced() after the last packet */
+} bbl_io_rx_release_s;
+
+/*
+ * Per RX ring I/O thread.
+ *
+ * Each RX ring of an interface (multiple with PACKET_FANOUT) is served
+ * by its own I/O thread, which polls the ring and classifies or decodes
+ * all received packets. The I/O thread of the first RX ring also kicks
+ * the kernel to send the frames written to the TX ringbuffer. Packets
+ * are not copied, the control thread processes them in place and also
+ * encodes directly into the TX ringbuffer. All session state is still
+ * owned by the control thread.
+ *
+ * With the data plane enabled for the interface (see bbl_io_data.c),
+ * BBL traffic is accounted by the I/O thread receiving it and never
+ * passed to the control thread. The I/O thread of the first RX ring
+ * also sends all session traffic, streams and multicast traffic of
+ * the interface using its own TX socket and ringbuffer. The control
+ * thread passes session state changes using the data queue.
+ *
+ * Fields written by the I/O thread are either private to it or
+ * atomic and are merged into the interface stats by the control
+ * thread using bbl_io_thread_stats().
+ */
+typedef struct bbl_io_thread_
+{
+    bbl_interface_s *interface;
+    bbl_rx_ring_s *rx_ring; /* RX ring served by this thread */
+    bool tx; /* also serves the TX ringbuffer */
+    pthread_t thread;
+    int cpu; /* -1 means not pinned */
+    bool busy_poll; /* spin instead of poll() if idle */
+    atomic_bool stop;
+    atomic_bool sleeping; /* I/O thread waits in poll() */
+    int wakeup_fd; /* eventfd to wake up the I/O thread */
+
+    /* TX frames committed by the control thread (monotonic). */
+    _Atomic uint32_t tx_committed;
+
+    /* Private to the I/O thread */
+    uint32_t tx_kicked __attribute__ ((aligned (BBL_SPSC_CACHELINE))); /* tx_committed at the last kick */
+    bool tx_kick_retry; /* last kick returned EAGAIN */
+
+    /* Data plane, see bbl_io_data.c */
+    struct {
+        bbl_spsc_s *queue; /* flow and stream updates, control thread -> I/O thread (TX only) */
+        bbl_interface_stats_s *stats; /* written by the I/O thread only */
+        bbl_interface_stats_s *merged; /* stats already merged (control thread) */
+        int fd; /* TX socket (TX only) */
+        struct tpacket_req req;
+        u_char *ring; /* TX ringbuffer */
+        uint cursor; /* slot # inside the TX ringbuffer */
+        uint pending; /* frames written since the last kick */
+        uint flush_threshold; /* kick the kernel early with this number of frames pending */
+        bool kick_retry; /* last kick returned EAGAIN */
+        struct timespec timestamp; /* TX timestamp of the current run */
+    } data;
+
+    struct {
+        _Atomic uint64_t loops;
+        _Atomic uint64_t empty_loops;
+        _Atomic uint64_t poll;
+        _Atomic uint64_t tx_kicks;
+        _Atomic uint64_t tx_kicks_again;
+        _Atomic uint64_t sendto_failed;
+    } stats;
+} bbl_io_thread_s;
+
+/*
+ * Interface stats to be updated by the calling thread, which are
+ * merged into the interface stats if called by an I/O thread.
+ */
+#define BBL_IO_STATS(_interface, _io_thread) \
+    ((_io_thread) ? (_io_thread)->data.stats : &(_interface)->stats)
+
+bool bbl_io_thread_add(bbl_ctx_s *ctx, bbl_interface_s *interface, int cpu);
+bool bbl_io_thread_start_all(bbl_ctx_s *ctx);
+void bbl_io_thread_stop_all(bbl_ctx_s *ctx);
+
+void bbl_io_thread_wakeup(bbl_io_thread_s *io_thread);
+void bbl_io_thread_data_update(bbl_interface_s *interface, bbl_io_data_msg_s *msg);
+void bbl_io_thread_stats(bbl_interface_s *interface);
+
+#endif
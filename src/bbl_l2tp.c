@@ -95,7 +95,7 @@ bbl_l2tp_session_delete(bbl_l2tp_session_t *l2tp_session) {
             CIRCLEQ_NEXT(l2tp_session, session_qnode) = NULL;
         }
         /* Remove session from dict */
-        dict_remove(ctx->l2tp_session_dict, &l2tp_session->key);
+        dict_remove(ctx->l2tp_session_dict.dict, &l2tp_session->key);
         /* Free tunnel memory */
         if(l2tp_session->proxy_auth_name) free(l2tp_session->proxy_auth_name);
         if(l2tp_session->proxy_auth_challenge) free(l2tp_session->proxy_auth_challenge);
@@ -567,7 +567,7 @@ bbl_l2tp_sccrq_rx(bbl_ethernet_header_t *eth, bbl_l2tp_t *l2tp, bbl_interface_s
             while(true) {
                 l2tp_session->key.tunnel_id = ctx->next_tunnel_id++;
                 if(l2tp_session->key.tunnel_id == 0) continue; /* skip tunnel 0 */
-                search = dict_search(ctx->l2tp_session_dict, &l2tp_session->key);
+                search = dict_search(ctx->l2tp_session_dict.dict, &l2tp_session->key);
                 if(search) {
                     /* Used, try next ... */
                     continue;
@@ -576,7 +576,8 @@ bbl_l2tp_sccrq_rx(bbl_ethernet_header_t *eth, bbl_l2tp_t *l2tp, bbl_interface_s
                 }
             }
             l2tp_tunnel->tunnel_id = l2tp_session->key.tunnel_id;
-            result = dict_insert(ctx->l2tp_session_dict, &l2tp_session->key);
+            bbl_dict_reserve_deferred(&ctx->l2tp_session_dict);
+            result = dict_insert(ctx->l2tp_session_dict.dict, &l2tp_session->key);
             if (!result.inserted) {
                 LOG(ERROR, "L2TP Error (%s) Failed to add tunnel session\n",
                             l2tp_tunnel->server->host_name); 
@@ -745,7 +746,7 @@ bbl_l2tp_icrq_rx(bbl_ethernet_header_t *eth, bbl_l2tp_t *l2tp, bbl_interface_s *
     while(true) {
         l2tp_session->key.session_id = l2tp_tunnel->next_session_id++;
         if(l2tp_session->key.session_id == 0) continue; /* skip tunnel 0 */
-        search = dict_search(ctx->l2tp_session_dict, &l2tp_session->key);
+        search = dict_search(ctx->l2tp_session_dict.dict, &l2tp_session->key);
         if(search) {
             /* Used, try next ... */
             continue;
@@ -753,7 +754,8 @@ bbl_l2tp_icrq_rx(bbl_ethernet_header_t *eth, bbl_l2tp_t *l2tp, bbl_interface_s *
             break;
         }
     }
-    result = dict_insert(ctx->l2tp_session_dict, &l2tp_session->key);
+    bbl_dict_reserve_deferred(&ctx->l2tp_session_dict);
+    result = dict_insert(ctx->l2tp_session_dict.dict, &l2tp_session->key);
     if (!result.inserted) {
         LOG(ERROR, "L2TP Error (%s) Failed to add session\n",
                     l2tp_tunnel->server->host_name); 
@@ -881,6 +883,10 @@ bbl_l2tp_data_rx(bbl_ethernet_header_t *eth, bbl_l2tp_t *l2tp, bbl_interface_s *
             ipcp_rx = (bbl_ipcp_t*)l2tp->next;
             memset(&ipcp_tx, 0x0, sizeof(bbl_ipcp_t));
             if(ipcp_rx->code == PPP_CODE_CONF_REQUEST) {
+                if(decode_ppp_ipcp_options(ipcp_rx) != PROTOCOL_SUCCESS) {
+                    interface->stats.packets_rx_drop_decode_error++;
+                    return;
+                }
                 ipcp_rx->options = NULL;
                 ipcp_rx->options_len = 0;
                 if(ipcp_rx->address == L2TP_IPCP_IP_REMOTE) {
@@ -989,14 +995,14 @@ bbl_l2tp_handler_rx(bbl_ethernet_header_t *eth, bbl_l2tp_t *l2tp, bbl_interface_
 
     key.tunnel_id = l2tp->tunnel_id;
     key.session_id = l2tp->session_id;
-    search = dict_search(ctx->l2tp_session_dict, &key);
+    search = dict_search(ctx->l2tp_session_dict.dict, &key);
     if(!search && l2tp->type && key.session_id != 0) {
         /* Try with session zero (tunnel session) in case
          * the corresponding session was already deleted.
          * This is required for reliable delivery of control
          * messages. */
         key.session_id = 0;
-        search = dict_search(ctx->l2tp_session_dict, &key);
+        search = dict_search(ctx->l2tp_session_dict.dict, &key);
     }
     if(search) {
         l2tp_session = *search;
@@ -620,7 +620,7 @@ bbl_l2tp_avp_decode_csun(bbl_l2tp_t *l2tp, bbl_l2tp_tunnel_t *l2tp_tunnel) {
                             return false;
                         }
                         key.session_id = be16toh(*(uint16_t*)(avp.value+2));
-                        search = dict_search(ctx->l2tp_session_dict, &key);
+                        search = dict_search(ctx->l2tp_session_dict.dict, &key);
                         if(search) {
                             l2tp_session = *search;
                             if(l2tp_session->connect_speed_update_enabled && l2tp_session->state == BBL_L2TP_SESSION_ESTABLISHED) {
@@ -0,0 +1,70 @@
+/*
+ * BNG Blaster (BBL) - Latency Measurement
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include "bbl_latency.h"
+
+/*
+ * Highest value counted in the bucket.
+ */
+static uint64_t
+bbl_latency_histogram_value (uint32_t index)
+{
+    uint32_t shift;
+
+    if(index < 2 * BBL_LATENCY_SUB_BUCKETS) {
+        return index;
+    }
+    shift = index / BBL_LATENCY_SUB_BUCKETS - 1;
+    return (((uint64_t)(index % BBL_LATENCY_SUB_BUCKETS + BBL_LATENCY_SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+/*
+ * Value below or equal to which the given share (parts per million)
+ * of all values fall, e.g. BBL_LATENCY_P99 for the 99th percentile.
+ * Returns the highest value of the bucket, which overestimates the
+ * percentile by less than 1 / BBL_LATENCY_SUB_BUCKETS.
+ */
+uint64_t
+bbl_latency_histogram_percentile (bbl_latency_histogram_s *histogram, uint32_t ppm)
+{
+    uint64_t target, count = 0;
+    uint32_t index;
+
+    if(!histogram->count) {
+        return 0;
+    }
+    target = (histogram->count * ppm + 999999) / 1000000;
+    if(!target) {
+        target = 1;
+    }
+    for(index = 0; index < BBL_LATENCY_BUCKETS; index++) {
+        count += histogram->bucket[index];
+        if(count >= target) {
+            break;
+        }
+    }
+    if(index == BBL_LATENCY_BUCKETS) {
+        index--;
+    }
+    return bbl_latency_histogram_value(index);
+}
+
+/*
+ * Add all values of the source histogram,
+ * e.g. to aggregate the histograms of all interfaces.
+ */
+void
+bbl_latency_histogram_merge (bbl_latency_histogram_s *histogram, bbl_latency_histogram_s *source)
+{
+    uint32_t index;
+
+    for(index = 0; index < BBL_LATENCY_BUCKETS; index++) {
+        histogram->bucket[index] += source->bucket[index];
+    }
+    histogram->count += source->count;
+}
@@ -0,0 +1,138 @@
+/*
+ * BNG Blaster (BBL) - Latency Measurement
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_LATENCY_H__
+#define __BBL_LATENCY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BBL_LATENCY_NSEC_PER_SEC    1000000000UL
+#define BBL_LATENCY_NSEC_PER_USEC   1000UL
+
+#define BBL_LATENCY_SUB_BITS        3 /* 8 sub buckets per power of 2 (12.5% precision) */
+#define BBL_LATENCY_SUB_BUCKETS     (1 << BBL_LATENCY_SUB_BITS)
+#define BBL_LATENCY_MAX_BITS        34 /* values up to 2^34 ns (~17s) */
+#define BBL_LATENCY_BUCKETS         ((BBL_LATENCY_MAX_BITS - BBL_LATENCY_SUB_BITS + 1) * BBL_LATENCY_SUB_BUCKETS)
+
+/* Percentiles in parts per million. */
+#define BBL_LATENCY_P50             500000
+#define BBL_LATENCY_P99             990000
+#define BBL_LATENCY_P999            999000
+
+/*
+ * One-way latency in nanoseconds, accumulated
+ * per flow (session traffic) or per interface.
+ */
+typedef struct bbl_latency_
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t last; /* latency of the last packet */
+    uint64_t jitter; /* interarrival jitter (RFC 3550) */
+} bbl_latency_s;
+
+/*
+ * Log-linear (HDR) histogram with fixed memory. Values below
+ * 2 * BBL_LATENCY_SUB_BUCKETS have their own bucket, larger values
+ * share a bucket with all values of the same power of two and
+ * sub bucket, such that the relative error is bounded by
+ * 1 / BBL_LATENCY_SUB_BUCKETS. Larger values are counted in the
+ * last bucket.
+ */
+typedef struct bbl_latency_histogram_
+{
+    uint64_t count;
+    uint64_t bucket[BBL_LATENCY_BUCKETS];
+} bbl_latency_histogram_s;
+
+static inline void
+bbl_latency_add (bbl_latency_s *latency, uint64_t delay)
+{
+    if(!latency->count || delay < latency->min) latency->min = delay;
+    if(delay > latency->max) latency->max = delay;
+    latency->sum += delay;
+    latency->count++;
+    latency->last = delay;
+}
+
+/*
+ * Delay variation to the previous packet of the same flow, which
+ * is also added to the interarrival jitter J += (|D| - J) / 16.
+ * Returns false for the first packet of the flow.
+ */
+static inline bool
+bbl_latency_variation (bbl_latency_s *latency, uint64_t delay, uint64_t *variation)
+{
+    if(!latency->count) {
+        return false;
+    }
+    *variation = delay > latency->last ? delay - latency->last : latency->last - delay;
+    latency->jitter += ((int64_t)*variation - (int64_t)latency->jitter) / 16;
+    return true;
+}
+
+static inline uint32_t
+bbl_latency_histogram_index (uint64_t value)
+{
+    uint32_t shift;
+
+    if(value < 2 * BBL_LATENCY_SUB_BUCKETS) {
+        return value;
+    }
+    if(value >> BBL_LATENCY_MAX_BITS) {
+        return BBL_LATENCY_BUCKETS - 1;
+    }
+    shift = 63 - __builtin_clzll(value) - BBL_LATENCY_SUB_BITS;
+    return (shift + 1) * BBL_LATENCY_SUB_BUCKETS + (value >> shift) - BBL_LATENCY_SUB_BUCKETS;
+}
+
+static inline void
+bbl_latency_histogram_add (bbl_latency_histogram_s *histogram, uint64_t value)
+{
+    histogram->bucket[bbl_latency_histogram_index(value)]++;
+    histogram->count++;
+}
+
+/*
+ * Delay between the TX timestamp carried in the BBL header
+ * (low 32 bits seconds, high 32 bits nanoseconds) and the
+ * RX timestamp. Returns false if the delay is negative which
+ * happens if sender and receiver clocks are not in sync.
+ */
+static inline bool
+bbl_latency_bbl_delay (uint64_t bbl_timestamp, uint32_t rx_sec, uint32_t rx_nsec, uint64_t *delay)
+{
+    uint64_t tx = (bbl_timestamp & 0xffffffff) * BBL_LATENCY_NSEC_PER_SEC + (bbl_timestamp >> 32);
+    uint64_t rx = (uint64_t)rx_sec * BBL_LATENCY_NSEC_PER_SEC + rx_nsec;
+
+    if(!(bbl_timestamp & 0xffffffff) || rx < tx) {
+        return false;
+    }
+    *delay = rx - tx;
+    return true;
+}
+
+static inline uint64_t
+bbl_latency_avg (bbl_latency_s *latency)
+{
+    if(!latency->count) {
+        return 0;
+    }
+    return latency->sum / latency->count;
+}
+
+uint64_t
+bbl_latency_histogram_percentile(bbl_latency_histogram_s *histogram, uint32_t ppm);
+
+void
+bbl_latency_histogram_merge(bbl_latency_histogram_s *histogram, bbl_latency_histogram_s *source);
+
+#endif
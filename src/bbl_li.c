@@ -65,7 +65,7 @@ bbl_qmx_li_handler_rx(bbl_ethernet_header_t *eth, bbl_qmx_li_t *qmx_li, bbl_inte
 
     UNUSED(eth);
 
-    search = dict_search(ctx->li_flow_dict, &qmx_li->header);
+    search = dict_search(ctx->li_flow_dict.dict, &qmx_li->header);
     if(search) {
         li_flow = *search;
     } else {
@@ -79,7 +79,9 @@ bbl_qmx_li_handler_rx(bbl_ethernet_header_t *eth, bbl_qmx_li_t *qmx_li, bbl_inte
         li_flow->packet_type = qmx_li->packet_type;
         li_flow->sub_packet_type = qmx_li->sub_packet_type;
         li_flow->liid = qmx_li->liid;
-        result = dict_insert(ctx->li_flow_dict, &qmx_li->header);
+        li_flow->header = qmx_li->header;
+        bbl_dict_reserve_deferred(&ctx->li_flow_dict);
+        result = dict_insert(ctx->li_flow_dict.dict, &li_flow->header);
         if (!result.inserted) {
             free(li_flow);
             return;
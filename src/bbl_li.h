@@ -13,6 +13,8 @@ typedef struct bbl_interface_ bbl_interface_s;
 
 typedef struct bbl_li_flow_
 {
+    uint32_t     header; /* dictionary key */
+
     uint32_t     src_ipv4;
     uint32_t     dst_ipv4;
     uint32_t     src_port;
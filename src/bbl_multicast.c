@@ -0,0 +1,248 @@
+/*
+ * BNG Blaster (BBL) - Multicast Traffic
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include "bbl.h"
+#include "bbl_pcap.h"
+
+/*
+ * Encode the multicast packet of a stream, padded to the
+ * configured frame length if larger than the minimum length.
+ */
+static bool
+bbl_multicast_encode (bbl_ctx_s *ctx, bbl_interface_s *interface, bbl_mc_stream_s *stream, uint16_t len)
+{
+    bbl_ethernet_header_t eth = {0};
+    bbl_ipv4_t ip = {0};
+    bbl_udp_t udp = {0};
+    bbl_bbl_t bbl = {0};
+    uint8_t mac[ETH_ADDR_LEN];
+    uint8_t buf[BBL_MC_MAX_LEN];
+    uint16_t min_len = 0;
+
+    /* Generate destination MAC */
+    ipv4_multicast_mac(stream->group, mac);
+
+    eth.src = interface->mac;
+    eth.dst = mac;
+    eth.vlan_outer = ctx->config.network_vlan;
+    eth.type = ETH_TYPE_IPV4;
+    eth.next = &ip;
+    ip.src = stream->source;
+    ip.dst = stream->group;
+    ip.ttl = 64;
+    ip.protocol = PROTOCOL_IPV4_UDP;
+    ip.next = &udp;
+    udp.src = BBL_UDP_PORT;
+    udp.dst = BBL_UDP_PORT;
+    udp.protocol = UDP_PROTOCOL_BBL;
+    udp.next = &bbl;
+    bbl.type = BBL_TYPE_MULTICAST;
+    bbl.direction = BBL_DIRECTION_DOWN;
+    bbl.mc_source = ip.src;
+    bbl.mc_group = ip.dst;
+    bbl.flow_id = ctx->flow_id++;
+    if(encode_ethernet(buf, &min_len, &eth) != PROTOCOL_SUCCESS) {
+        return false;
+    }
+    /* The BBL header is the last header followed by the padding. */
+    stream->seq_offset = min_len - 16;
+    stream->len = min_len;
+    if(len > min_len) {
+        bbl.padding = len - min_len;
+        stream->len = 0;
+        if(encode_ethernet(buf, &stream->len, &eth) != PROTOCOL_SUCCESS) {
+            return false;
+        }
+    }
+    stream->packet = malloc(stream->len);
+    if(!stream->packet) {
+        return false;
+    }
+    memcpy(stream->packet, buf, stream->len);
+    return true;
+}
+
+static bool
+bbl_multicast_add_stream (bbl_ctx_s *ctx, bbl_interface_s *interface, uint32_t group, uint32_t source, uint32_t pps, uint16_t len)
+{
+    bbl_mc_stream_s *stream = &interface->mc_streams[interface->mc_stream_count];
+
+    stream->group = group;
+    stream->source = source ? source : interface->ip;
+    stream->pps = pps ? pps : 1;
+    if(!bbl_multicast_encode(ctx, interface, stream, len)) {
+        LOG(ERROR, "Failed to encode multicast stream for group %s\n", format_ipv4_address(&group));
+        return false;
+    }
+    interface->mc_stream_count++;
+    return true;
+}
+
+/*
+ * Setup one stream per multicast S,G and schedule those streams
+ * using a calendar queue. If no multicast traffic is configured
+ * explicitly, one stream per IGMP group is generated.
+ */
+bool
+bbl_multicast_init (bbl_ctx_s *ctx, bbl_interface_s *interface)
+{
+    bbl_mc_traffic_config_s *mc_config;
+    bbl_mc_traffic_config_s default_config = {0};
+    bbl_mc_stream_s *stream;
+    uint64_t now;
+    uint32_t count = 0;
+    uint32_t max_len;
+    uint32_t group;
+    uint32_t i, s;
+
+    if(!ctx->config.send_multicast_traffic) {
+        return true;
+    }
+    if(!ctx->config.multicast_traffic_pps) {
+        /* One packet per group and TX interval as before. */
+        ctx->config.multicast_traffic_pps = ctx->config.tx_interval ? 1000 / ctx->config.tx_interval : 1000;
+    }
+
+    mc_config = ctx->config.multicast_traffic_config;
+    if(!mc_config) {
+        if(!ctx->config.igmp_group_count) {
+            return true;
+        }
+        default_config.group = ctx->config.igmp_group;
+        default_config.group_iter = ctx->config.igmp_group_iter;
+        default_config.group_count = ctx->config.igmp_group_count;
+        if(ctx->config.igmp_source) {
+            default_config.source[0] = ctx->config.igmp_source;
+            default_config.source_count = 1;
+        }
+        default_config.pps = ctx->config.multicast_traffic_pps;
+        default_config.len = ctx->config.multicast_traffic_len;
+        mc_config = &default_config;
+    }
+
+    /* The TX frame must hold the whole packet. */
+    if(interface->io_mode == BBL_IO_AF_XDP) {
+        max_len = BBL_XDP_FRAME_SIZE;
+    } else {
+        max_len = interface->req_tx.tp_frame_size;
+    }
+    max_len -= TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    if(max_len > BBL_MC_MAX_LEN) {
+        max_len = BBL_MC_MAX_LEN;
+    }
+
+    for(count = 0; mc_config; mc_config = mc_config->next) {
+        if(mc_config->len > max_len) {
+            LOG(ERROR, "Multicast traffic length %u exceeds the maximum of %u bytes\n", mc_config->len, max_len);
+            return false;
+        }
+        count += mc_config->group_count * (mc_config->source_count ? mc_config->source_count : 1);
+    }
+    if(!count) {
+        return true;
+    }
+    interface->mc_streams = calloc(count, sizeof(bbl_mc_stream_s));
+    if(!interface->mc_streams) {
+        return false;
+    }
+
+    mc_config = ctx->config.multicast_traffic_config ? ctx->config.multicast_traffic_config : &default_config;
+    for(; mc_config; mc_config = mc_config->next) {
+        for(i = 0; i < mc_config->group_count; i++) {
+            group = htobe32(be32toh(mc_config->group) + i * be32toh(mc_config->group_iter));
+            s = 0;
+            do {
+                if(!bbl_multicast_add_stream(ctx, interface, group, mc_config->source[s],
+                                             mc_config->pps ? mc_config->pps : ctx->config.multicast_traffic_pps,
+                                             mc_config->len ? mc_config->len : ctx->config.multicast_traffic_len)) {
+                    return false;
+                }
+            } while(++s < mc_config->source_count);
+        }
+    }
+
+    /*
+     * Spread the initial departure of the streams evenly over
+     * their interval, such that all streams are interleaved.
+     */
+    now = bbl_calendar_now();
+    interface->mc_calendar = bbl_calendar_new(BBL_CALENDAR_TICK_NSEC, now);
+    if(!interface->mc_calendar) {
+        return false;
+    }
+    for(i = 0; i < interface->mc_stream_count; i++) {
+        stream = &interface->mc_streams[i];
+        stream->entry.interval = BBL_CALENDAR_NSEC_PER_SEC / stream->pps;
+        stream->entry.expire = now + (stream->entry.interval * i) / interface->mc_stream_count;
+        bbl_calendar_add(interface->mc_calendar, &stream->entry);
+    }
+    LOG(NORMAL, "Add %u multicast streams on interface %s\n", interface->mc_stream_count, interface->name);
+    return true;
+}
+
+static bbl_calendar_result_t
+bbl_multicast_send (bbl_calendar_entry_s *entry, void *arg)
+{
+    bbl_interface_s *interface = arg;
+    bbl_mc_stream_s *stream = (bbl_mc_stream_s*)entry;
+    bbl_ctx_s *ctx = interface->ctx;
+    struct tpacket2_hdr* tphdr;
+    u_char *frame_ptr;
+    uint8_t *buf;
+
+    frame_ptr = bbl_tx_frame_get(interface, BBL_TX_CLASS_DATA);
+    if(!frame_ptr) {
+        return BBL_CALENDAR_DEFERRED;
+    }
+    buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    memcpy(buf, stream->packet, stream->len);
+    *(uint64_t*)(buf + stream->seq_offset) = ++stream->seq;
+    *(uint32_t*)(buf + stream->seq_offset + 8) = interface->tx_timestamp.tv_sec;
+    *(uint32_t*)(buf + stream->seq_offset + 12) = interface->tx_timestamp.tv_nsec;
+    tphdr = (struct tpacket2_hdr *)frame_ptr;
+    tphdr->tp_len = stream->len;
+    tphdr->tp_status = TP_STATUS_SEND_REQUEST;
+    interface->stats.mc_tx++;
+    stream->packets_tx++;
+    bbl_tx_frame_commit(interface, BBL_TX_CLASS_DATA);
+    /* Dump the packet into PCAP file. */
+    if (ctx->pcap.enabled) {
+        pcapng_push_packet_header(ctx, &interface->tx_timestamp, buf,
+                                  tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
+    }
+    return BBL_CALENDAR_SENT;
+}
+
+/*
+ * Send all multicast packets which are due. The run stops
+ * if the TX ring is full and continues with the next TX job.
+ */
+void
+bbl_multicast_tx (bbl_interface_s *interface)
+{
+    bbl_calendar_run(interface->mc_calendar, bbl_calendar_now(), bbl_multicast_send, interface);
+}
+
+void
+bbl_multicast_free (bbl_interface_s *interface)
+{
+    uint32_t i;
+
+    if(interface->mc_streams) {
+        for(i = 0; i < interface->mc_stream_count; i++) {
+            free(interface->mc_streams[i].packet);
+        }
+        free(interface->mc_streams);
+        interface->mc_streams = NULL;
+        interface->mc_stream_count = 0;
+    }
+    if(interface->mc_calendar) {
+        bbl_calendar_free(interface->mc_calendar);
+        interface->mc_calendar = NULL;
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * BNG Blaster (BBL) - Multicast Traffic
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_MULTICAST_H__
+#define __BBL_MULTICAST_H__
+
+#define BBL_MC_MAX_SOURCES      8
+#define BBL_MC_MAX_LEN          9216
+
+typedef struct bbl_ctx_ bbl_ctx_s;
+
+/*
+ * Multicast traffic configuration (one per entry
+ * of the multicast-traffic configuration section).
+ */
+typedef struct bbl_mc_traffic_config_
+{
+    uint32_t group;
+    uint32_t group_iter;
+    uint32_t group_count;
+    uint32_t source[BBL_MC_MAX_SOURCES];
+    uint8_t  source_count;
+    uint32_t pps;
+    uint16_t len; /* ethernet frame length without FCS */
+
+    void *next; /* next multicast traffic config */
+} bbl_mc_traffic_config_s;
+
+/*
+ * Multicast stream (one per S,G).
+ */
+typedef struct bbl_mc_stream_
+{
+    bbl_calendar_entry_s entry; /* must be first */
+    uint32_t group;
+    uint32_t source;
+    uint32_t pps;
+    uint16_t len;
+    uint16_t seq_offset; /* offset of the BBL flow sequence */
+    uint64_t seq;
+    uint64_t packets_tx;
+    uint8_t *packet;
+} bbl_mc_stream_s;
+
+bool bbl_multicast_init(bbl_ctx_s *ctx, bbl_interface_s *interface);
+void bbl_multicast_tx(bbl_interface_s *interface);
+void bbl_multicast_free(bbl_interface_s *interface);
+
+#endif
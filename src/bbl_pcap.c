@@ -16,6 +16,8 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <poll.h>
+#include <stddef.h>
 
 #include "bbl.h"
 #include "bbl_pcap.h"
@@ -26,93 +28,139 @@
  */
 void pcapng_open(bbl_ctx_s *);
 void write_le_uint(u_char *, uint , unsigned long long);
+void pcapng_push_section_header(bbl_ctx_s *);
+void pcapng_push_interface_header(bbl_ctx_s *, uint, const char *);
 
 /*
- * Flush the write buffer
+ * Write a buffer to the pcap file. The file descriptor is
+ * non-blocking such that the writer thread can be stopped
+ * while waiting for a slow reader of a fifo.
  */
-void
-pcapng_fflush (bbl_ctx_s *ctx)
+static bool
+pcapng_write (bbl_ctx_s *ctx, uint8_t *buf, uint len)
 {
+    struct pollfd fds[1];
     int res;
 
-    if (!ctx->pcap.write_buf) {
-	    return;
+    while (len) {
+        res = write(ctx->pcap.fd, buf, len);
+        if (res > 0) {
+            buf += res;
+            len -= res;
+            continue;
+        }
+        if (res == -1 && errno == EAGAIN) {
+            if (atomic_load_explicit(&ctx->pcap.stop, memory_order_relaxed)) {
+                return false;
+            }
+            fds[0].fd = ctx->pcap.fd;
+            fds[0].events = POLLOUT;
+            poll(fds, 1, PCAPNG_WRITER_POLL_TIMEOUT);
+            continue;
+        }
+        /*
+         * If our listener just went away (EPIPE), the fifo is reopened
+         * and a PCAP header is written for the next listener.
+         */
+        if (res == -1 && errno != EPIPE) {
+            atomic_store_explicit(&ctx->pcap.write_error, errno, memory_order_relaxed);
+        }
+        close(ctx->pcap.fd);
+        ctx->pcap.fd = -1;
+        return false;
     }
+    return true;
+}
 
-    if (!ctx->pcap.write_idx) {
-        return;
-    }
+/*
+ * Writer thread, draining capture buffers to the pcap file.
+ *
+ * Buffers which can not be written because the file can not
+ * be opened (e.g. no reader of a fifo) are dropped and counted.
+ */
+static void *
+pcapng_writer_main (void *arg)
+{
+    bbl_ctx_s *ctx = arg;
+    bbl_pcap_buf_s *pcap_buf;
 
-    if (ctx->pcap.fd == -1) {
-        /*
-         * File is not yet opened, try to open it.
-         */
-        pcapng_open(ctx);
+    while (true) {
+        pcap_buf = (bbl_pcap_buf_s*)bbl_spsc_peek(ctx->pcap.queue);
+        if (!pcap_buf) {
+            if (atomic_load_explicit(&ctx->pcap.stop, memory_order_acquire)) {
+                break;
+            }
+            usleep(PCAPNG_WRITER_SLEEP);
+            continue;
+        }
         if (ctx->pcap.fd == -1) {
             /*
-             * Darn, still closed.
-             */
-
-            /*
-             * We may have buffered for too long.
-             * Reset the buffer before it is running full.
+             * File is not yet opened, try to open it and
+             * write the section and interface headers.
              */
-            if (ctx->pcap.write_idx >= (PCAPNG_WRITEBUFSIZE/16)*15) {
-                ctx->pcap.write_idx = 0;
-                ctx->pcap.wrote_header = false;
+            pcapng_open(ctx);
+            if (ctx->pcap.fd != -1 &&
+                !pcapng_write(ctx, ctx->pcap.header, ctx->pcap.header_len)) {
+                if (ctx->pcap.fd != -1) {
+                    close(ctx->pcap.fd);
+                    ctx->pcap.fd = -1;
+                }
             }
-            return;
         }
+        if (ctx->pcap.fd != -1 && pcapng_write(ctx, pcap_buf->data, pcap_buf->len)) {
+            atomic_fetch_add_explicit(&ctx->pcap.packets_written, pcap_buf->packets, memory_order_relaxed);
+        } else {
+            atomic_fetch_add_explicit(&ctx->pcap.packets_write_dropped, pcap_buf->packets, memory_order_relaxed);
+        }
+        bbl_spsc_release(ctx->pcap.queue);
     }
+    return NULL;
+}
 
-    res = write(ctx->pcap.fd, ctx->pcap.write_buf, ctx->pcap.write_idx);
+/*
+ * Hand the current capture buffer over to the writer thread.
+ */
+void
+pcapng_fflush (bbl_ctx_s *ctx)
+{
+    bbl_pcap_buf_s *pcap_buf;
+    uint32_t opened;
+    int error;
 
-    /*
-     * Blocked?
-     */
-    if (res == -1) {
-        switch (errno) {
-            case EPIPE:
-                /*
-                 * Our listener just went away.
-                 * Restart the fifo and write a PCAP header for the next listener.
-                 */
-                close(ctx->pcap.fd);
-                pcapng_init(ctx);
-                break;
-            case EAGAIN:
-            default:
-                /*
-                 * Reset the buffer for unresponsive callers.
-                 */
-                pcapng_init(ctx);
-                break;
-        }
+    if (!ctx->pcap.enabled) {
         return;
     }
 
     /*
-     * Full write ?
+     * The writer thread does not log itself.
      */
-    if (res == (int)ctx->pcap.write_idx) {
-        LOG(PCAP, "drained %u bytes buffer to pcap file %s\n",
-            ctx->pcap.write_idx, ctx->pcap.filename);
+    opened = atomic_load_explicit(&ctx->pcap.opened, memory_order_relaxed);
+    if (opened != ctx->pcap.opened_logged) {
+        ctx->pcap.opened_logged = opened;
+        LOG(NORMAL, "opened pcap-file %s\n", ctx->pcap.filename);
+    }
+    error = atomic_exchange_explicit(&ctx->pcap.write_error, 0, memory_order_relaxed);
+    if (error) {
+        LOG(ERROR, "got ERROR %d when writing pcap-file %s\n", error, ctx->pcap.filename);
+    }
+
+    if (!ctx->pcap.write_buf) {
+	    return;
+    }
 
-        ctx->pcap.write_idx = 0;
+    if (!ctx->pcap.write_idx) {
         return;
     }
 
-    /*
-     * Partial write ?
-     */
-    if (res && res < (int)ctx->pcap.write_idx) {
+    pcap_buf = (bbl_pcap_buf_s*)(ctx->pcap.write_buf - offsetof(bbl_pcap_buf_s, data));
+    pcap_buf->len = ctx->pcap.write_idx;
+    pcap_buf->packets = ctx->pcap.write_packets;
+    bbl_spsc_commit(ctx->pcap.queue);
+    LOG(PCAP, "passed %u bytes buffer to pcap writer\n", ctx->pcap.write_idx);
 
-        /*
-         * Rebase the buffer.
-         */
-        memmove(ctx->pcap.write_buf, ctx->pcap.write_buf+res, ctx->pcap.write_idx - res);
-        ctx->pcap.write_idx -= res;
-    }
+    ctx->pcap.write_buf = NULL;
+    ctx->pcap.write_idx = 0;
+    ctx->pcap.write_packets = 0;
 }
 
 /*
@@ -142,7 +190,7 @@ push_le_uint (bbl_ctx_s *ctx, uint length, unsigned long long value)
     /*
      * Buffer overrun protection.
      */
-    if ((ctx->pcap.write_idx + length) >= PCAPNG_WRITEBUFSIZE) {
+    if ((ctx->pcap.write_idx + length) > PCAPNG_WRITEBUFSIZE) {
 	    return;
     }
 
@@ -159,6 +207,9 @@ push_le_uint (bbl_ctx_s *ctx, uint length, unsigned long long value)
 
 /*
  * Try to open the file.
+ *
+ * Called by the writer thread, errors are
+ * logged by the main thread in pcapng_fflush.
  */
 void
 pcapng_open (bbl_ctx_s *ctx)
@@ -168,43 +219,126 @@ pcapng_open (bbl_ctx_s *ctx)
      */
     ctx->pcap.fd = open(ctx->pcap.filename, O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, PCAPNG_PERMS);
     if (ctx->pcap.fd == -1) {
-        switch (errno) {
-            default:
-                LOG(ERROR, "got ERROR %d when opening pcap-file %s\n", errno, ctx->pcap.filename);
-                return;
-        }
+        atomic_store_explicit(&ctx->pcap.write_error, errno, memory_order_relaxed);
     } else {
-        LOG(NORMAL, "opened pcap-file %s\n", ctx->pcap.filename);
+        atomic_fetch_add_explicit(&ctx->pcap.opened, 1, memory_order_relaxed);
     }
 }
 
 /*
- * Initialize a fresh pcap fifo writing context.
+ * Capture filters are only evaluated if at least one
+ * option differs from capturing all packets in full.
  */
-void
+static bool
+pcapng_init_filter (bbl_ctx_s *ctx)
+{
+    bbl_interface_s *interface;
+    bool found;
+    uint i;
+
+    if (ctx->config.pcap_interfaces) {
+        ctx->pcap.capture = calloc(ctx->pcap.index, sizeof(bool));
+        if (!ctx->pcap.capture) {
+            LOG(ERROR, "failed to allocate pcap buffers\n");
+            return false;
+        }
+        for (i = 0; i < ctx->config.pcap_interfaces_count; i++) {
+            found = false;
+            CIRCLEQ_FOREACH(interface, &ctx->interface_qhead, interface_qnode) {
+                if (strcmp(interface->name, ctx->config.pcap_interfaces[i]) == 0) {
+                    ctx->pcap.capture[interface->pcap_index] = true;
+                    found = true;
+                }
+            }
+            if (!found) {
+                LOG(ERROR, "pcap interface %s not found\n", ctx->config.pcap_interfaces[i]);
+                return false;
+            }
+        }
+    }
+
+    ctx->pcap.filter = ctx->pcap.capture ||
+                       ctx->config.pcap_direction != PCAPNG_EPB_FLAGS_BOTH ||
+                       ctx->config.pcap_traffic != PCAPNG_TRAFFIC_ALL ||
+                       ctx->config.pcap_sample > 1 ||
+                       ctx->config.pcap_bpf;
+    return true;
+}
+
+/*
+ * Initialize the pcap writing context and start the writer thread.
+ * Must be called after all interfaces have been added.
+ * Returns false if capturing was requested but failed.
+ */
+bool
 pcapng_init (bbl_ctx_s *ctx)
 {
+    bbl_interface_s *interface;
+    int rc;
+
     if (!ctx) {
-        return;
+        return false;
     }
 
     if (!ctx->pcap.filename) {
-	    return;
+	    return true;
     }
 
-    /*
-     * Write buffer for I/O.
-     */
-    if (!ctx->pcap.write_buf) {
-	    ctx->pcap.write_buf = calloc(1, PCAPNG_WRITEBUFSIZE);
-    } else {
-	    ctx->pcap.write_idx = 0;
+    ctx->pcap.fd = -1;
+    ctx->pcap.header = calloc(1, PCAPNG_WRITEBUFSIZE);
+    ctx->pcap.queue = bbl_spsc_new(PCAPNG_BUFFERS, sizeof(bbl_pcap_buf_s));
+    if (!(ctx->pcap.header && ctx->pcap.queue)) {
+        LOG(ERROR, "failed to allocate pcap buffers\n");
+        pcapng_free(ctx);
+        return false;
     }
 
     /*
-     * Open the file.
+     * Build the section header and the list of interfaces
+     * which is written whenever the file is (re)opened.
      */
-    pcapng_open(ctx);
+    ctx->pcap.write_buf = ctx->pcap.header;
+    pcapng_push_section_header(ctx);
+    CIRCLEQ_FOREACH(interface, &ctx->interface_qhead, interface_qnode) {
+        pcapng_push_interface_header(ctx, DLT_EN10MB, interface->name);
+    }
+    ctx->pcap.header_len = ctx->pcap.write_idx;
+    ctx->pcap.write_buf = NULL;
+    ctx->pcap.write_idx = 0;
+
+    if (!pcapng_init_filter(ctx)) {
+        pcapng_free(ctx);
+        return false;
+    }
+
+    atomic_init(&ctx->pcap.stop, false);
+    rc = pthread_create(&ctx->pcap.thread, NULL, pcapng_writer_main, ctx);
+    if (rc) {
+        LOG(ERROR, "failed to start pcap writer thread (%s)\n", strerror(rc));
+        ctx->pcap.thread = 0;
+        pcapng_free(ctx);
+        return false;
+    }
+    ctx->pcap.enabled = true;
+    return true;
+}
+
+/*
+ * Flush the last capture buffer and stop the writer thread
+ * after all buffers have been written.
+ */
+void
+pcapng_stop (bbl_ctx_s *ctx)
+{
+    if (!ctx || !ctx->pcap.thread) {
+	    return;
+    }
+
+    pcapng_fflush(ctx);
+    ctx->pcap.enabled = false;
+    atomic_store_explicit(&ctx->pcap.stop, true, memory_order_release);
+    pthread_join(ctx->pcap.thread, NULL);
+    ctx->pcap.thread = 0;
 }
 
 /*
@@ -213,21 +347,26 @@ pcapng_init (bbl_ctx_s *ctx)
 void
 pcapng_free (bbl_ctx_s *ctx)
 {
-    if (!ctx) {
+    if (!ctx || !ctx->pcap.filename) {
 	    return;
     }
 
-    pcapng_fflush(ctx);
+    pcapng_stop(ctx);
+    ctx->pcap.enabled = false;
 
     if (ctx->pcap.fd != -1) {
 	    close(ctx->pcap.fd);
 	    ctx->pcap.fd = -1;
-	    return;
     }
 
-    if (ctx->pcap.write_buf) {
-	    free(ctx->pcap.write_buf);
-	    ctx->pcap.write_buf = NULL;
+    bbl_spsc_free(ctx->pcap.queue);
+    ctx->pcap.queue = NULL;
+    free(ctx->pcap.capture);
+    ctx->pcap.capture = NULL;
+    ctx->pcap.write_buf = NULL;
+    if (ctx->pcap.header) {
+	    free(ctx->pcap.header);
+	    ctx->pcap.header = NULL;
     }
 }
 
@@ -300,7 +439,7 @@ pcapng_push_interface_header (bbl_ctx_s *ctx, uint dlt, const char *if_name)
     push_le_uint(ctx, 4, 0); /* block total_length */
     push_le_uint(ctx, 2, dlt); /* link_type */
     push_le_uint(ctx, 2, 0); /* reserved */
-    push_le_uint(ctx, 4, 9*1024); /* snaplen */
+    push_le_uint(ctx, 4, ctx->config.pcap_snaplen); /* snaplen */
 
     /*
      * Write idb_ifname option
@@ -321,6 +460,50 @@ pcapng_push_interface_header (bbl_ctx_s *ctx, uint dlt, const char *if_name)
     push_le_uint(ctx, 4, total_length); /* block total_length */
 }
 
+/*
+ * Apply the capture filters in the order of their costs.
+ * Sampling applies to the packets matching all other
+ * filters except for control traffic, which is never
+ * sampled. Returns false if the packet is not captured,
+ * otherwise the capture length may be reduced by the
+ * return value of the BPF program.
+ */
+static bool
+pcapng_filter (bbl_ctx_s *ctx, u_char *data, uint packet_length, uint ifindex, uint direction,
+               uint *capture_length)
+{
+    uint traffic = 0;
+    uint32_t snaplen;
+
+    if (!(direction & ctx->config.pcap_direction)) {
+        return false;
+    }
+    if (ctx->pcap.capture && (ifindex >= ctx->pcap.index || !ctx->pcap.capture[ifindex])) {
+        return false;
+    }
+    if (ctx->config.pcap_traffic != PCAPNG_TRAFFIC_ALL || ctx->config.pcap_sample > 1) {
+        traffic = pcapng_traffic(data, packet_length);
+        if (!(traffic & ctx->config.pcap_traffic)) {
+            return false;
+        }
+    }
+    if (ctx->config.pcap_bpf) {
+        snaplen = bbl_bpf_filter(ctx->config.pcap_bpf, data, packet_length);
+        if (!snaplen) {
+            return false;
+        }
+        if (snaplen < *capture_length) {
+            *capture_length = snaplen;
+        }
+    }
+    if (ctx->config.pcap_sample > 1 && traffic != PCAPNG_TRAFFIC_CONTROL) {
+        if (ctx->pcap.sample_count++ % ctx->config.pcap_sample) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /*
  * Write a pcapng enhanced packet block.
  */
@@ -328,20 +511,43 @@ void
 pcapng_push_packet_header (bbl_ctx_s *ctx, struct timespec *ts, u_char *data, uint packet_length,
 			   uint ifindex, uint direction)
 {
-    bbl_interface_s *interface;
-    uint start_idx, total_length;
+    bbl_pcap_buf_s *pcap_buf;
+    uint start_idx, total_length, block_length;
+    uint capture_length;
     uint64_t ts_usec;
 
-    if (!ctx->pcap.wrote_header) {
-	    pcapng_push_section_header(ctx);
+    capture_length = packet_length;
+    if (capture_length > ctx->config.pcap_snaplen) {
+        capture_length = ctx->config.pcap_snaplen;
+    }
+    if (ctx->pcap.filter &&
+        !pcapng_filter(ctx, data, packet_length, ifindex, direction, &capture_length)) {
+        ctx->pcap.packets_filtered++;
+        return;
+    }
 
+    /*
+     * Enhanced packet block with epb_flags option.
+     */
+    block_length = 28 + capture_length + calc_pad(capture_length) + 8 + 4;
+    if (block_length > PCAPNG_WRITEBUFSIZE) {
+        ctx->pcap.packets_dropped++;
+        return;
+    }
+    if (ctx->pcap.write_idx + block_length > PCAPNG_WRITEBUFSIZE) {
+	    pcapng_fflush(ctx);
+    }
+    if (!ctx->pcap.write_buf) {
         /*
-        * Push a list of interfaces.
-        */
-        CIRCLEQ_FOREACH(interface, &ctx->interface_qhead, interface_qnode) {
-            pcapng_push_interface_header(ctx, DLT_EN10MB, interface->name);
+         * Get the next free capture buffer. If the writer thread
+         * falls behind, the packet is dropped and counted.
+         */
+        pcap_buf = (bbl_pcap_buf_s*)bbl_spsc_reserve(ctx->pcap.queue);
+        if (!pcap_buf) {
+            ctx->pcap.packets_dropped++;
+            return;
         }
-        ctx->pcap.wrote_header = true;
+        ctx->pcap.write_buf = pcap_buf->data;
     }
 
     start_idx = ctx->pcap.write_idx;
@@ -354,15 +560,15 @@ pcapng_push_packet_header (bbl_ctx_s *ctx, struct timespec *ts, u_char *data, ui
     push_le_uint(ctx, 4, ts_usec>>32); /* timestamp usec msb */
     push_le_uint(ctx, 4, ts_usec & 0xffffffff); /* timestamp usec lsb */
 
-    push_le_uint(ctx, 4, packet_length); /* captured packet length */
+    push_le_uint(ctx, 4, capture_length); /* captured packet length */
     push_le_uint(ctx, 4, packet_length); /* original packet length */
 
     /*
      * Copy packet
      */
-    memcpy(&ctx->pcap.write_buf[ctx->pcap.write_idx], data, packet_length);
-    ctx->pcap.write_idx += packet_length;
-    push_le_uint(ctx, calc_pad(packet_length), 0); /* write pad bytes */
+    memcpy(&ctx->pcap.write_buf[ctx->pcap.write_idx], data, capture_length);
+    ctx->pcap.write_idx += capture_length;
+    push_le_uint(ctx, calc_pad(capture_length), 0); /* write pad bytes */
 
     /*
      * Write epb_flags option for storing packet direction
@@ -378,13 +584,9 @@ pcapng_push_packet_header (bbl_ctx_s *ctx, struct timespec *ts, u_char *data, ui
     write_le_uint(ctx->pcap.write_buf+start_idx+4, 4, total_length); /* block total_length */
     push_le_uint(ctx, 4, total_length); /* block total_length */
 
-    LOG(PCAP, "wrote %u bytes pcap packet data, buffer fill %u/%u\n",
-	    packet_length, ctx->pcap.write_idx, PCAPNG_WRITEBUFSIZE);
+    ctx->pcap.write_packets++;
+    ctx->pcap.packets++;
 
-    /*
-     * Buffer about to be overrun ?
-     */
-    if (ctx->pcap.write_idx >= (PCAPNG_WRITEBUFSIZE/16)*15) {
-	    pcapng_fflush(ctx);
-    }
+    LOG(PCAP, "wrote %u bytes pcap packet data, buffer fill %u/%u\n",
+	    capture_length, ctx->pcap.write_idx, PCAPNG_WRITEBUFSIZE);
 }
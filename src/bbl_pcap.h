@@ -10,7 +10,12 @@
 #ifndef __BBL_PCAP_H__
 #define __BBL_PCAP_H__
 
+#include "bbl_pcap_traffic.h"
+
 #define PCAPNG_WRITEBUFSIZE 65536
+#define PCAPNG_BUFFERS 256 /* capture buffers queued to the writer thread */
+#define PCAPNG_WRITER_SLEEP 1000 /* microseconds */
+#define PCAPNG_WRITER_POLL_TIMEOUT 100 /* milliseconds */
 #define PCAPNG_PERMS 0644
 
 #define PCAPNG_SHB 0x0a0d0d0a
@@ -24,19 +29,30 @@
 #define PCAPNG_EPB_FLAGS_OPTION 2
 #define PCAPNG_EPB_FLAGS_INBOUND  0x1
 #define PCAPNG_EPB_FLAGS_OUTBOUND 0x2
+#define PCAPNG_EPB_FLAGS_BOTH     0x3
+
+#define PCAPNG_SNAPLEN 9216
 
 /* Ethernet (10Mb, 100Mb, 1000Mb, and up); 
  * the 10MB in the DLT_ name is historical. */
 #define DLT_EN10MB        1 /* Ethernet (10Mb) */
 #define DLT_NULL          0 /* RAW IP */
 
+/*
+ * Capture buffer as passed to the writer thread.
+ */
+typedef struct bbl_pcap_buf_ {
+    uint32_t len;
+    uint32_t packets;
+    uint8_t data[PCAPNG_WRITEBUFSIZE];
+} bbl_pcap_buf_s;
+
 /*
  * APIs
  */
-void pcapng_init(bbl_ctx_s *);
+bool pcapng_init(bbl_ctx_s *);
+void pcapng_stop(bbl_ctx_s *);
 void pcapng_free(bbl_ctx_s *);
-void pcapng_push_section_header(bbl_ctx_s *);
-void pcapng_push_interface_header(bbl_ctx_s *, uint, const char *);
 void pcapng_push_packet_header(bbl_ctx_s *, struct timespec *, u_char *, uint, uint, uint);
 void pcapng_fflush(bbl_ctx_s *);
 
@@ -0,0 +1,149 @@
+/*
+ * BNG Blaster (BBL) - PCAP Traffic Classes
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include "bbl_protocols.h"
+#include "bbl_pcap_traffic.h"
+
+/*
+ * Traffic class of an IPv4 or IPv6 packet, which
+ * is also used for IP packets tunneled in L2TP.
+ */
+uint
+pcapng_traffic_ip (uint8_t *buf, uint len, uint16_t type)
+{
+    uint8_t protocol;
+    uint header_len;
+    uint16_t port;
+    uint8_t flags;
+
+    while (true) {
+        if (type == ETH_TYPE_IPV4) {
+            if (len < 20) {
+                return PCAPNG_TRAFFIC_DATA;
+            }
+            if (be16toh(*(uint16_t*)(buf+6)) & IP_OFFMASK) {
+                /* Non-first fragments carry no UDP header. */
+                return PCAPNG_TRAFFIC_DATA;
+            }
+            protocol = buf[9];
+            header_len = (*buf & 0x0f) * 4;
+        } else {
+            if (len < 40) {
+                return PCAPNG_TRAFFIC_DATA;
+            }
+            protocol = buf[6];
+            header_len = 40;
+        }
+        switch (protocol) {
+            case PROTOCOL_IPV4_ICMP:
+            case PROTOCOL_IPV4_IGMP:
+            case IPV6_NEXT_HEADER_ICMPV6:
+                return PCAPNG_TRAFFIC_CONTROL;
+            case PROTOCOL_IPV4_UDP:
+                break;
+            default:
+                return PCAPNG_TRAFFIC_DATA;
+        }
+        if (len < header_len + 8) {
+            return PCAPNG_TRAFFIC_DATA;
+        }
+        BUMP_BUFFER(buf, len, header_len);
+
+        /* UDP */
+        port = be16toh(*(uint16_t*)(buf+2));
+        switch (port) {
+            case BBL_UDP_PORT:
+                if (len >= 8 + BBL_HEADER_LEN && *(uint64_t*)(buf+8) == BBL_MAGIC_NUMBER) {
+                    return PCAPNG_TRAFFIC_BBL;
+                }
+                return PCAPNG_TRAFFIC_DATA;
+            case DHCP_UDP_SERVER:
+            case DHCP_UDP_CLIENT:
+            case DHCPV6_UDP_SERVER:
+            case DHCPV6_UDP_CLIENT:
+                return PCAPNG_TRAFFIC_CONTROL;
+            case L2TP_UDP_PORT:
+                break;
+            default:
+                return PCAPNG_TRAFFIC_DATA;
+        }
+        BUMP_BUFFER(buf, len, 8);
+
+        /* L2TP data packets are classified by the tunneled PPP protocol. */
+        if (len < 6 || (*buf & L2TP_HDR_CTRL_BIT_MASK)) {
+            return PCAPNG_TRAFFIC_CONTROL;
+        }
+        flags = *buf;
+        header_len = 6;
+        if (flags & L2TP_HDR_LEN_BIT_MASK) header_len += 2;
+        if (flags & L2TP_HDR_SEQ_BIT_MASK) header_len += 4;
+        if (flags & L2TP_HDR_OFFSET_BIT_MASK) {
+            if (len < header_len + 2) {
+                return PCAPNG_TRAFFIC_CONTROL;
+            }
+            header_len += 2 + be16toh(*(uint16_t*)(buf+header_len));
+        }
+        if (len < header_len + 4) {
+            return PCAPNG_TRAFFIC_CONTROL;
+        }
+        BUMP_BUFFER(buf, len, header_len + 2); /* skip address and control field */
+        switch (be16toh(*(uint16_t*)buf)) {
+            case PROTOCOL_IPV4:
+                type = ETH_TYPE_IPV4;
+                break;
+            case PROTOCOL_IPV6:
+                type = ETH_TYPE_IPV6;
+                break;
+            default:
+                return PCAPNG_TRAFFIC_CONTROL;
+        }
+        BUMP_BUFFER(buf, len, 2);
+    }
+}
+
+/*
+ * Traffic class of an ethernet frame.
+ */
+uint
+pcapng_traffic (uint8_t *buf, uint len)
+{
+    uint16_t type;
+
+    if (len < 14) {
+        return PCAPNG_TRAFFIC_CONTROL;
+    }
+    type = be16toh(*(uint16_t*)(buf+12));
+    BUMP_BUFFER(buf, len, 14);
+    while (type == ETH_TYPE_VLAN || type == ETH_TYPE_QINQ) {
+        if (len < 4) {
+            return PCAPNG_TRAFFIC_CONTROL;
+        }
+        type = be16toh(*(uint16_t*)(buf+2));
+        BUMP_BUFFER(buf, len, 4);
+    }
+    if (type == ETH_TYPE_PPPOE_SESSION) {
+        if (len < 8) {
+            return PCAPNG_TRAFFIC_CONTROL;
+        }
+        switch (be16toh(*(uint16_t*)(buf+6))) {
+            case PROTOCOL_IPV4:
+                type = ETH_TYPE_IPV4;
+                break;
+            case PROTOCOL_IPV6:
+                type = ETH_TYPE_IPV6;
+                break;
+            default:
+                return PCAPNG_TRAFFIC_CONTROL;
+        }
+        BUMP_BUFFER(buf, len, 8);
+    }
+    if (type != ETH_TYPE_IPV4 && type != ETH_TYPE_IPV6) {
+        return PCAPNG_TRAFFIC_CONTROL;
+    }
+    return pcapng_traffic_ip(buf, len, type);
+}
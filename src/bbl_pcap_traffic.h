@@ -0,0 +1,26 @@
+/*
+ * BNG Blaster (BBL) - PCAP Traffic Classes
+ *
+ * Classify captured frames into control, data and
+ * BBL test traffic for the capture filters.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_PCAP_TRAFFIC_H__
+#define __BBL_PCAP_TRAFFIC_H__
+
+#include <stdint.h>
+
+/* Traffic classes for capture filters */
+#define PCAPNG_TRAFFIC_CONTROL  0x1 /* ARP, PPPoE, PPP, ICMP, IGMP, DHCP, L2TP, ... */
+#define PCAPNG_TRAFFIC_DATA     0x2 /* other IP traffic */
+#define PCAPNG_TRAFFIC_BBL      0x4 /* BBL test traffic */
+#define PCAPNG_TRAFFIC_ALL      0x7
+
+uint pcapng_traffic_ip(uint8_t *buf, uint len, uint16_t type);
+uint pcapng_traffic(uint8_t *buf, uint len);
+
+#endif
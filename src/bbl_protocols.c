@@ -11,90 +11,222 @@
 protocol_error_t decode_l2tp(uint8_t *buf, uint16_t len, uint8_t *sp, uint16_t sp_len, bbl_l2tp_t **_l2tp);
 protocol_error_t encode_l2tp(uint8_t *buf, uint16_t *len, bbl_l2tp_t *l2tp);
 
-uint16_t
-checksum(uint16_t *buf, uint16_t len) {
-         uint32_t sum = 0;
-         uint16_t checksum = 0;
+/*
+ * Internet Checksum (RFC 1071)
+ *
+ * The one's complement sum does not depend on the byte order,
+ * so the data is summed up in host byte order as 32 bit words
+ * into a 64 bit accumulator which is folded to 16 bit at the
+ * end. The kernel used is selected at runtime based on the
+ * CPU features.
+ */
+typedef uint64_t (*checksum_sum_fn)(const uint8_t *buf, uint16_t len, uint64_t sum);
+
+static uint64_t
+checksum_sum_generic(const uint8_t *buf, uint16_t len, uint64_t sum) {
+
+    uint32_t word32[4];
+    uint16_t word16;
+    uint8_t  pad[2] = {0};
 
-    while (len > 1) {
-        sum += *buf++;
-        len -= 2;
+    while(len >= 16) {
+        memcpy(word32, buf, 16);
+        sum += (uint64_t)word32[0] + word32[1] + word32[2] + word32[3];
+        BUMP_BUFFER(buf, len, 16);
+    }
+    while(len >= 4) {
+        memcpy(word32, buf, 4);
+        sum += word32[0];
+        BUMP_BUFFER(buf, len, 4);
+    }
+    if(len >= 2) {
+        memcpy(&word16, buf, 2);
+        sum += word16;
+        BUMP_BUFFER(buf, len, 2);
     }
     /* If any bytes left, pad the bytes and add */
-    if(len > 0) {
-        sum += ((*buf) & htobe16(0xFF00));
+    if(len) {
+        pad[0] = *buf;
+        memcpy(&word16, pad, 2);
+        sum += word16;
     }
+    return sum;
+}
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+static uint64_t
+checksum_sum_sse2(const uint8_t *buf, uint16_t len, uint64_t sum) {
+
+    __m128i mask = _mm_set1_epi64x(0xffffffff);
+    __m128i acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128();
+    __m128i data1, data2;
+    uint64_t lanes[2];
+
+    /* Add the low and high 32 bits of each 64 bit lane separately. */
+    while(len >= 32) {
+        data1 = _mm_loadu_si128((const __m128i*)buf);
+        data2 = _mm_loadu_si128((const __m128i*)(buf+16));
+        acc1 = _mm_add_epi64(acc1, _mm_and_si128(data1, mask));
+        acc2 = _mm_add_epi64(acc2, _mm_srli_epi64(data1, 32));
+        acc1 = _mm_add_epi64(acc1, _mm_and_si128(data2, mask));
+        acc2 = _mm_add_epi64(acc2, _mm_srli_epi64(data2, 32));
+        BUMP_BUFFER(buf, len, 32);
+    }
+    _mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(acc1, acc2));
+    return checksum_sum_generic(buf, len, sum + lanes[0] + lanes[1]);
+}
+
+__attribute__((target("avx2")))
+static uint64_t
+checksum_sum_avx2(const uint8_t *buf, uint16_t len, uint64_t sum) {
+
+    __m256i mask = _mm256_set1_epi64x(0xffffffff);
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    __m256i data1, data2;
+    uint64_t lanes[4];
+
+    while(len >= 64) {
+        data1 = _mm256_loadu_si256((const __m256i*)buf);
+        data2 = _mm256_loadu_si256((const __m256i*)(buf+32));
+        acc1 = _mm256_add_epi64(acc1, _mm256_and_si256(data1, mask));
+        acc2 = _mm256_add_epi64(acc2, _mm256_srli_epi64(data1, 32));
+        acc1 = _mm256_add_epi64(acc1, _mm256_and_si256(data2, mask));
+        acc2 = _mm256_add_epi64(acc2, _mm256_srli_epi64(data2, 32));
+        BUMP_BUFFER(buf, len, 64);
+    }
+    _mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(acc1, acc2));
+    /* Avoid AVX to SSE transition penalties in the SSE2 tail. */
+    _mm256_zeroupper();
+    return checksum_sum_sse2(buf, len, sum + lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+#endif
+
+static uint64_t checksum_sum_resolve(const uint8_t *buf, uint16_t len, uint64_t sum);
+
+static checksum_sum_fn checksum_sum = checksum_sum_resolve;
+
+/*
+ * checksum_kernel_set
+ *
+ * Select the checksum kernel. Returns false if
+ * the kernel is not supported by this CPU.
+ */
+bool
+checksum_kernel_set(checksum_kernel_t kernel) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if(kernel == CHECKSUM_KERNEL_AUTO) {
+        kernel = __builtin_cpu_supports("avx2") ? CHECKSUM_KERNEL_AVX2 : CHECKSUM_KERNEL_SSE2;
+    }
+    switch(kernel) {
+        case CHECKSUM_KERNEL_GENERIC:
+            checksum_sum = checksum_sum_generic;
+            return true;
+        case CHECKSUM_KERNEL_SSE2:
+            checksum_sum = checksum_sum_sse2;
+            return true;
+        case CHECKSUM_KERNEL_AVX2:
+            if(!__builtin_cpu_supports("avx2")) {
+                return false;
+            }
+            checksum_sum = checksum_sum_avx2;
+            return true;
+        default:
+            return false;
+    }
+#else
+    if(kernel == CHECKSUM_KERNEL_AUTO || kernel == CHECKSUM_KERNEL_GENERIC) {
+        checksum_sum = checksum_sum_generic;
+        return true;
+    }
+    return false;
+#endif
+}
+
+static uint64_t
+checksum_sum_resolve(const uint8_t *buf, uint16_t len, uint64_t sum) {
+    checksum_kernel_set(CHECKSUM_KERNEL_AUTO);
+    return checksum_sum(buf, len, sum);
+}
+
+static uint16_t
+checksum_fold(uint64_t sum) {
     /* Fold sum to 16 bits: add carrier to result */
-    while (sum>>16) {
+    while(sum >> 16) {
         sum = (sum & 0xffff) + (sum >> 16);
     }
     /* Calculate one's complement */
-    checksum = ~sum;
-    return checksum;
+    return ~sum;
+}
+
+uint16_t
+checksum(uint16_t *buf, uint16_t len) {
+    return checksum_fold(checksum_sum((uint8_t*)buf, len, 0));
+}
+
+/*
+ * checksum_update16
+ *
+ * Incremental checksum update (RFC 1624) if the
+ * 16 bit field old is changed to new, where all
+ * values are in the same (network) byte order.
+ *
+ * HC' = ~(~HC + ~m + m')
+ */
+uint16_t
+checksum_update16(uint16_t csum, uint16_t old, uint16_t new) {
+    return checksum_fold((uint16_t)~csum + (uint16_t)~old + new);
+}
+
+/*
+ * checksum_update32
+ *
+ * Incremental checksum update (RFC 1624) of a 32 bit field
+ * at an even offset, e.g. an IPv4 address or the halves
+ * of the BBL sequence number.
+ */
+uint16_t
+checksum_update32(uint16_t csum, uint32_t old, uint32_t new) {
+    return checksum_fold((uint16_t)~csum +
+                         (uint16_t)~(old >> 16) + (uint16_t)~old +
+                         (new >> 16) + (uint16_t)new);
 }
 
 uint16_t
 bbl_ipv6_checksum(ipv6addr_t src, ipv6addr_t dst, uint8_t nh, uint8_t *buf, uint16_t len) {
 
-    int i;
-    uint32_t checksum = 0;
-    uint16_t word16;
-    bool padding = false;
+    uint64_t sum;
+    uint16_t offset;
+
+    /* Add the IPv6 pseudo header which contains the source and
+     * destination addresses, the length and the next header */
+    sum = checksum_sum(src, IPV6_ADDR_LEN, 0);
+    sum = checksum_sum(dst, IPV6_ADDR_LEN, sum);
+    sum += htobe16(len) + htobe16(nh);
 
     /* The following block ensures that checksum field is ignored */
     switch(nh) {
         case IPV6_NEXT_HEADER_UDP:
-            word16 = ((buf[0]<<8)&0xFF00) + (buf[1]&0xFF); checksum += word16;
-            word16 = ((buf[2]<<8)&0xFF00) + (buf[3]&0xFF); checksum += word16;
-            word16 = ((buf[4]<<8)&0xFF00) + (buf[5]&0xFF); checksum += word16;
-            i = 8;
+            offset = 6;
             break;
         case IPV6_NEXT_HEADER_ICMPV6:
-            word16 = ((buf[0]<<8)&0xFF00) + (buf[1]&0xFF); checksum += word16;
-            i = 4;
+            offset = 2;
             break;
         default:
-            i = 0;
+            offset = len;
             break;
     }
-    if (len % 2) {
-        padding = true;
-        len--;
-    }
-    /* Make 16 bit words out of every two adjacent 8 bit words and
-     * calculate the sum of all 16 bit words */
-    for (; i < len; i = i+2) {
-        word16 = ((buf[i]<<8)&0xFF00) + (buf[i+1]&0xFF);
-        checksum += word16;
-    }
-    if(padding) {
-        word16 = (buf[len]<<8)&0xFF00;
-        checksum += word16;
-        len++;
-    }
-
-    /* Add the IPv6 pseudo header which contains the
-     * source and destinations addresses */
-    for (i = 0; i < IPV6_ADDR_LEN; i = i+2) {
-        word16 =((src[i]<<8)) + (src[i+1]);
-        checksum += word16;
-    }
-    for (i = 0; i<IPV6_ADDR_LEN; i = i+2) {
-        word16 = ((dst[i]<<8)) + (dst[i+1]);
-        checksum += word16;
+    if(offset + sizeof(uint16_t) <= len) {
+        sum = checksum_sum(buf, offset, sum);
+        sum = checksum_sum(buf + offset + sizeof(uint16_t), len - offset - sizeof(uint16_t), sum);
+    } else {
+        sum = checksum_sum(buf, len, sum);
     }
-
-    /* Add the protocol number and the length of the UDP packet */
-    checksum += nh + len;
-
-    /* Keep only the last 16 bits of the 32 bit calculated sum and add the carries */
-    while (checksum >> 16)
-        checksum = (checksum & 0xffff) + (checksum >> 16);
-
-    /* Take the one's complement of checksum */
-    checksum = ~checksum;
-
-    return (uint16_t)checksum;
+    return be16toh(checksum_fold(sum));
 }
 
 uint16_t
@@ -221,6 +353,10 @@ encode_bbl(uint8_t *buf, uint16_t *len,
     BUMP_WRITE_BUFFER(buf, len, sizeof(uint64_t));
     *(uint64_t*)buf = bbl->timestamp;
     BUMP_WRITE_BUFFER(buf, len, sizeof(uint64_t));
+    if(bbl->padding) {
+        memset(buf, 0x0, bbl->padding);
+        BUMP_WRITE_BUFFER(buf, len, bbl->padding);
+    }
     return PROTOCOL_SUCCESS;
 }
 
@@ -469,7 +605,9 @@ encode_ipv6(uint8_t *buf, uint16_t *len,
     uint16_t checksum;
 
     *(uint64_t*)buf = 0;
-    *buf = 6 <<4;
+    /* Version and traffic class */
+    *buf = 6 << 4 | ipv6->tos >> 4;
+    *(buf+1) = ipv6->tos << 4;
     BUMP_WRITE_BUFFER(buf, len, sizeof(uint32_t));
 
     /* Skip payload length field */
@@ -1368,8 +1506,6 @@ decode_dhcpv6(uint8_t *buf, uint16_t len,
     protocol_error_t ret_val = PROTOCOL_SUCCESS;
 
     bbl_dhcpv6_t *dhcpv6;
-    uint16_t option;
-    uint16_t option_len;
 
     if(len < 8 || sp_len < sizeof(bbl_dhcpv6_t)) {
         return DECODE_ERROR;
@@ -1384,50 +1520,95 @@ decode_dhcpv6(uint8_t *buf, uint16_t len,
     dhcpv6->transaction_id &= DHCPV6_TYPE_MASK;
     BUMP_BUFFER(buf, len, sizeof(uint32_t));
 
-    while(len >= 4) {
-        option = be16toh(*(uint16_t*)buf);
-        BUMP_BUFFER(buf, len, sizeof(uint16_t));
-        option_len = be16toh(*(uint16_t*)buf);
-        BUMP_BUFFER(buf, len, sizeof(uint16_t));
-        if(option_len > len) {
-            return DECODE_ERROR;
-        }
-        switch(option) {
+    dhcpv6->options = buf;
+    dhcpv6->options_len = len;
+
+    *_dhcpv6 = dhcpv6;
+    return ret_val;
+}
+
+/*
+ * dhcpv6_option_next
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |          option-code          |           option-len          |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |                          option-data                          |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ * Returns false at the end of the option list or if the next
+ * option is malformed, which is indicated by iter->error.
+ */
+bool
+dhcpv6_option_next(bbl_option_iter_t *iter, bbl_option_t *option) {
+
+    if(iter->len < 4) {
+        return false;
+    }
+    option->type = be16toh(*(uint16_t*)iter->buf);
+    option->len = be16toh(*(uint16_t*)(iter->buf+2));
+    BUMP_BUFFER(iter->buf, iter->len, 4);
+    if(option->len > iter->len) {
+        iter->error = true;
+        return false;
+    }
+    option->value = iter->buf;
+    BUMP_BUFFER(iter->buf, iter->len, option->len);
+    return true;
+}
+
+/*
+ * decode_dhcpv6_options
+ *
+ * Decode the DHCPv6 options of a received message
+ * which have been skipped by decode_dhcpv6.
+ */
+protocol_error_t
+decode_dhcpv6_options(bbl_dhcpv6_t *dhcpv6) {
+
+    bbl_option_iter_t iter = {dhcpv6->options, dhcpv6->options_len, false};
+    bbl_option_t option;
+
+    while(dhcpv6_option_next(&iter, &option)) {
+        switch(option.type) {
             case DHCPV6_OPTION_RAPID_COMMIT:
                 dhcpv6->rapid = true;
                 break;
             case DHCPV6_OPTION_IA_PD:
-                if(option_len < 41) {
+                if(option.len < 41) {
                     return DECODE_ERROR;
                 }
-                dhcpv6->ia_pd_option = buf;
-                dhcpv6->ia_pd_option_len = option_len;
-                option = be16toh(*(uint16_t*)(buf+12));
-                if(option == 26) {
-                    dhcpv6->delegated_prefix = (ipv6_prefix*)(buf+24);
+                dhcpv6->ia_pd_option = option.value;
+                dhcpv6->ia_pd_option_len = option.len;
+                if(be16toh(*(uint16_t*)(option.value+12)) == 26) {
+                    dhcpv6->delegated_prefix = (ipv6_prefix*)(option.value+24);
                 }
                 break;
             case DHCPV6_OPTION_SERVERID:
-                if(option_len < 2) {
+                if(option.len < 2) {
                     return DECODE_ERROR;
                 }
-                dhcpv6->server_duid = buf;
-                dhcpv6->server_duid_len = option_len;
+                dhcpv6->server_duid = option.value;
+                dhcpv6->server_duid_len = option.len;
                 break;
             case DHCPV6_OPTION_DNS_SERVERS:
-                if(option_len >= 16) {
-                    dhcpv6->dns1 = (ipv6addr_t*)(buf);
-                    if(option_len >= 32) {
-                        dhcpv6->dns2 = (ipv6addr_t*)(buf+16);
+                if(option.len >= 16) {
+                    dhcpv6->dns1 = (ipv6addr_t*)(option.value);
+                    if(option.len >= 32) {
+                        dhcpv6->dns2 = (ipv6addr_t*)(option.value+16);
                     }
                 }
+                break;
             default:
                 break;
         }
-        BUMP_BUFFER(buf, len, option_len);
     }
-    *_dhcpv6 = dhcpv6;
-    return ret_val;
+    if(iter.error) {
+        return DECODE_ERROR;
+    }
+    return PROTOCOL_SUCCESS;
 }
 
 protocol_error_t
@@ -1828,8 +2009,6 @@ decode_ppp_ip6cp(uint8_t *buf, uint16_t len,
     bbl_ip6cp_t *ip6cp;
 
     uint16_t ip6cp_len = 0;
-    uint8_t  ip6cp_option_type = 0;
-    uint8_t  ip6cp_option_len = 0;
 
     if(len < 4 || sp_len < sizeof(bbl_ip6cp_t)) {
         return DECODE_ERROR;
@@ -1854,7 +2033,7 @@ decode_ppp_ip6cp(uint8_t *buf, uint16_t len,
         return DECODE_ERROR;
     }
 
-    /* Decode options ...
+    /* Options are decoded on demand (decode_ppp_*_options) ...
      *  0                   1                   2                   3
      *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
      * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
@@ -1864,36 +2043,6 @@ decode_ppp_ip6cp(uint8_t *buf, uint16_t len,
     ip6cp->options = buf;
     ip6cp->options_len = ip6cp_len;
 
-    switch(ip6cp->code) {
-        case PPP_CODE_CONF_REQUEST:
-        case PPP_CODE_CONF_ACK:
-        case PPP_CODE_CONF_NAK:
-            while(ip6cp_len >= 2) {
-                ip6cp_option_type = *buf;
-                BUMP_BUFFER(buf, ip6cp_len, sizeof(uint8_t));
-                ip6cp_option_len = *buf;
-                BUMP_BUFFER(buf, ip6cp_len, sizeof(uint8_t));
-                if(ip6cp_option_len < 2) {
-                    return DECODE_ERROR;
-                }
-                ip6cp_option_len -= 2;
-                if(ip6cp_option_len > ip6cp_len) {
-                    return DECODE_ERROR;
-                }
-                switch (ip6cp_option_type) {
-                    case PPP_IP6CP_OPTION_IDENTIFIER:
-                        ip6cp->ipv6_identifier = *(uint64_t*)buf;
-                        break;
-                    default:
-                        break;
-                }
-                BUMP_BUFFER(buf, ip6cp_len, ip6cp_option_len);
-            }
-            break;
-        default:
-            break;
-    }
-
     *ppp_ip6cp = ip6cp;
     return PROTOCOL_SUCCESS;
 }
@@ -1906,8 +2055,6 @@ decode_ppp_ipcp(uint8_t *buf, uint16_t len,
     bbl_ipcp_t *ipcp;
 
     uint16_t ipcp_len = 0;
-    uint8_t  ipcp_option_type = 0;
-    uint8_t  ipcp_option_len = 0;
 
     if(len < 4 || sp_len < sizeof(bbl_ipcp_t)) {
         return DECODE_ERROR;
@@ -1932,7 +2079,7 @@ decode_ppp_ipcp(uint8_t *buf, uint16_t len,
         return DECODE_ERROR;
     }
 
-    /* Decode options ...
+    /* Options are decoded on demand (decode_ppp_*_options) ...
      *  0                   1                   2                   3
      *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
      * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
@@ -1942,42 +2089,6 @@ decode_ppp_ipcp(uint8_t *buf, uint16_t len,
     ipcp->options = buf;
     ipcp->options_len = ipcp_len;
 
-    switch(ipcp->code) {
-        case PPP_CODE_CONF_REQUEST:
-        case PPP_CODE_CONF_ACK:
-        case PPP_CODE_CONF_NAK:
-            while(ipcp_len >= 2) {
-                ipcp_option_type = *buf;
-                BUMP_BUFFER(buf, ipcp_len, sizeof(uint8_t));
-                ipcp_option_len = *buf;
-                BUMP_BUFFER(buf, ipcp_len, sizeof(uint8_t));
-                if(ipcp_option_len < 2) {
-                    return DECODE_ERROR;
-                }
-                ipcp_option_len -= 2;
-                if(ipcp_option_len > ipcp_len) {
-                    return DECODE_ERROR;
-                }
-                switch (ipcp_option_type) {
-                    case PPP_IPCP_OPTION_ADDRESS:
-                        ipcp->address = *(uint32_t*)buf;
-                        break;
-                    case PPP_IPCP_OPTION_DNS1:
-                        ipcp->dns1 = *(uint32_t*)buf;
-                        break;
-                    case PPP_IPCP_OPTION_DNS2:
-                        ipcp->dns2 = *(uint32_t*)buf;
-                        break;
-                    default:
-                        break;
-                }
-                BUMP_BUFFER(buf, ipcp_len, ipcp_option_len);
-            }
-            break;
-        default:
-            break;
-    }
-
     *ppp_ipcp = ipcp;
     return PROTOCOL_SUCCESS;
 }
@@ -2001,8 +2112,6 @@ decode_ppp_lcp(uint8_t *buf, uint16_t len,
     bbl_lcp_t *lcp;
 
     uint16_t lcp_len = 0;
-    uint8_t  lcp_option_type = 0;
-    uint8_t  lcp_option_len = 0;
 
     if(len < 4 || sp_len < sizeof(bbl_lcp_t)) {
         return DECODE_ERROR;
@@ -2027,7 +2136,7 @@ decode_ppp_lcp(uint8_t *buf, uint16_t len,
         return DECODE_ERROR;
     }
 
-    /* Decode options ...
+    /* Options are decoded on demand (decode_ppp_*_options) ...
      *  0                   1                   2                   3
      *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
      * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
@@ -2044,37 +2153,6 @@ decode_ppp_lcp(uint8_t *buf, uint16_t len,
                 lcp->magic = *(uint32_t*)buf;
             }
             break;
-        case PPP_CODE_CONF_REQUEST:
-        case PPP_CODE_CONF_ACK:
-        case PPP_CODE_CONF_NAK:
-            while(lcp_len >= 2) {
-                lcp_option_type = *buf;
-                BUMP_BUFFER(buf, lcp_len, sizeof(uint8_t));
-                lcp_option_len = *buf;
-                BUMP_BUFFER(buf, lcp_len, sizeof(uint8_t));
-                if(lcp_option_len < 2) {
-                    return DECODE_ERROR;
-                }
-                lcp_option_len -= 2;
-                if(lcp_option_len > lcp_len) {
-                    return DECODE_ERROR;
-                }
-                switch (lcp_option_type) {
-                    case PPP_LCP_OPTION_MRU:
-                        lcp->mru = be16toh(*(uint16_t*)buf);
-                        break;
-                    case PPP_LCP_OPTION_AUTH:
-                        lcp->auth = be16toh(*(uint16_t*)buf);
-                        break;
-                    case PPP_LCP_OPTION_MAGIC:
-                        lcp->magic = *(uint32_t*)buf;
-                        break;
-                    default:
-                        break;
-                }
-                BUMP_BUFFER(buf, lcp_len, lcp_option_len);
-            }
-            break;
         default:
             break;
     }
@@ -2083,6 +2161,130 @@ decode_ppp_lcp(uint8_t *buf, uint16_t len,
     return PROTOCOL_SUCCESS;
 }
 
+/*
+ * ppp_option_next
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |     Type      |    Length     |      Data ...
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ * Returns false at the end of the option list or if the next
+ * option is malformed, which is indicated by iter->error.
+ */
+bool
+ppp_option_next(bbl_option_iter_t *iter, bbl_option_t *option) {
+
+    if(iter->len < 2) {
+        return false;
+    }
+    option->type = *iter->buf;
+    option->len = *(iter->buf+1);
+    if(option->len < 2 || option->len > iter->len) {
+        iter->error = true;
+        return false;
+    }
+    option->len -= 2;
+    option->value = iter->buf+2;
+    BUMP_BUFFER(iter->buf, iter->len, option->len+2);
+    return true;
+}
+
+/*
+ * decode_ppp_lcp_options
+ *
+ * Decode the options of a received LCP configure
+ * request, ack or nak which have been skipped by
+ * decode_ppp_lcp.
+ */
+protocol_error_t
+decode_ppp_lcp_options(bbl_lcp_t *lcp) {
+
+    bbl_option_iter_t iter = {lcp->options, lcp->options_len, false};
+    bbl_option_t option;
+
+    while(ppp_option_next(&iter, &option)) {
+        switch(option.type) {
+            case PPP_LCP_OPTION_MRU:
+                if(option.len >= sizeof(uint16_t)) {
+                    lcp->mru = be16toh(*(uint16_t*)option.value);
+                }
+                break;
+            case PPP_LCP_OPTION_AUTH:
+                if(option.len >= sizeof(uint16_t)) {
+                    lcp->auth = be16toh(*(uint16_t*)option.value);
+                }
+                break;
+            case PPP_LCP_OPTION_MAGIC:
+                if(option.len >= sizeof(uint32_t)) {
+                    lcp->magic = *(uint32_t*)option.value;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if(iter.error) {
+        return DECODE_ERROR;
+    }
+    return PROTOCOL_SUCCESS;
+}
+
+/*
+ * decode_ppp_ipcp_options
+ */
+protocol_error_t
+decode_ppp_ipcp_options(bbl_ipcp_t *ipcp) {
+
+    bbl_option_iter_t iter = {ipcp->options, ipcp->options_len, false};
+    bbl_option_t option;
+
+    while(ppp_option_next(&iter, &option)) {
+        if(option.len < sizeof(uint32_t)) {
+            continue;
+        }
+        switch(option.type) {
+            case PPP_IPCP_OPTION_ADDRESS:
+                ipcp->address = *(uint32_t*)option.value;
+                break;
+            case PPP_IPCP_OPTION_DNS1:
+                ipcp->dns1 = *(uint32_t*)option.value;
+                break;
+            case PPP_IPCP_OPTION_DNS2:
+                ipcp->dns2 = *(uint32_t*)option.value;
+                break;
+            default:
+                break;
+        }
+    }
+    if(iter.error) {
+        return DECODE_ERROR;
+    }
+    return PROTOCOL_SUCCESS;
+}
+
+/*
+ * decode_ppp_ip6cp_options
+ */
+protocol_error_t
+decode_ppp_ip6cp_options(bbl_ip6cp_t *ip6cp) {
+
+    bbl_option_iter_t iter = {ip6cp->options, ip6cp->options_len, false};
+    bbl_option_t option;
+
+    while(ppp_option_next(&iter, &option)) {
+        if(option.type == PPP_IP6CP_OPTION_IDENTIFIER &&
+           option.len >= sizeof(uint64_t)) {
+            ip6cp->ipv6_identifier = *(uint64_t*)option.value;
+        }
+    }
+    if(iter.error) {
+        return DECODE_ERROR;
+    }
+    return PROTOCOL_SUCCESS;
+}
+
 protocol_error_t
 decode_l2tp(uint8_t *buf, uint16_t len,
             uint8_t *sp, uint16_t sp_len,
@@ -2400,6 +2602,146 @@ decode_arp(uint8_t *buf, uint16_t len,
     return PROTOCOL_SUCCESS;
 }
 
+/*
+ * Map the low 23 bits of the IPv4 multicast group
+ * (network byte order) to 01:00:5e:00:00:00.
+ */
+void
+ipv4_multicast_mac(uint32_t group, uint8_t *mac) {
+    uint32_t g = be32toh(group);
+
+    mac[0] = 0x01;
+    mac[1] = 0x00;
+    mac[2] = 0x5e;
+    mac[3] = (g >> 16) & 0x7f;
+    mac[4] = (g >> 8) & 0xff;
+    mac[5] = g & 0xff;
+}
+
+/*
+ * classify_bbl
+ *
+ * Fast path classifier for BBL test traffic (session, stream and
+ * multicast traffic), which recognizes the BBL header by fixed offsets
+ * behind VLAN, PPPoE, IPv4 or IPv6 and UDP headers without decoding
+ * all headers into the scratchpad. Returns UNKNOWN_PROTOCOL for all
+ * other frames, which must be decoded using decode_ethernet.
+ */
+protocol_error_t
+classify_bbl(uint8_t *buf, uint16_t len,
+             bbl_classify_t *classify) {
+
+    uint16_t type;
+    uint16_t payload_len;
+    uint16_t header_len;
+    uint8_t vlans = 0;
+
+    if(len < 14) {
+        return UNKNOWN_PROTOCOL;
+    }
+    type = be16toh(*(uint16_t*)(buf+12));
+    BUMP_BUFFER(buf, len, 14);
+
+    classify->vlan_outer = 0;
+    classify->vlan_inner = 0;
+    while(type == ETH_TYPE_VLAN || type == ETH_TYPE_QINQ) {
+        if(len < 4 || vlans == 3) {
+            return UNKNOWN_PROTOCOL;
+        }
+        if(vlans == 0) {
+            classify->vlan_outer = be16toh(*(uint16_t*)buf) & ETH_VLAN_ID_MAX;
+        } else if(vlans == 1) {
+            classify->vlan_inner = be16toh(*(uint16_t*)buf) & ETH_VLAN_ID_MAX;
+        }
+        vlans++;
+        type = be16toh(*(uint16_t*)(buf+2));
+        BUMP_BUFFER(buf, len, 4);
+    }
+
+    classify->pppoe = false;
+    if(type == ETH_TYPE_PPPOE_SESSION) {
+        /* Version and type 1, code 0 */
+        if(len < 8 || *(uint16_t*)buf != htobe16(0x1100)) {
+            return UNKNOWN_PROTOCOL;
+        }
+        payload_len = be16toh(*(uint16_t*)(buf+4));
+        switch(be16toh(*(uint16_t*)(buf+6))) {
+            case PROTOCOL_IPV4:
+                type = ETH_TYPE_IPV4;
+                break;
+            case PROTOCOL_IPV6:
+                type = ETH_TYPE_IPV6;
+                break;
+            default:
+                return UNKNOWN_PROTOCOL;
+        }
+        BUMP_BUFFER(buf, len, 8);
+        if(payload_len < 2 || payload_len - 2 > len) {
+            return UNKNOWN_PROTOCOL;
+        }
+        len = payload_len - 2;
+        classify->pppoe = true;
+    }
+
+    if(type == ETH_TYPE_IPV4) {
+        if(len < 20 || (*buf >> 4) != 4 || buf[9] != PROTOCOL_IPV4_UDP) {
+            return UNKNOWN_PROTOCOL;
+        }
+        header_len = (*buf & 0x0f) * 4;
+        payload_len = be16toh(*(uint16_t*)(buf+2));
+        if(header_len < 20 || header_len > payload_len || payload_len > len) {
+            return UNKNOWN_PROTOCOL;
+        }
+        classify->ipv4_dst = *(uint32_t*)(buf+16);
+        len = payload_len - header_len;
+        buf += header_len;
+    } else if(type == ETH_TYPE_IPV6) {
+        if(len < 40 || buf[6] != IPV6_NEXT_HEADER_UDP) {
+            return UNKNOWN_PROTOCOL;
+        }
+        payload_len = be16toh(*(uint16_t*)(buf+4));
+        BUMP_BUFFER(buf, len, 40);
+        if(payload_len > len) {
+            return UNKNOWN_PROTOCOL;
+        }
+        len = payload_len;
+    } else {
+        return UNKNOWN_PROTOCOL;
+    }
+    classify->type = type;
+
+    /* UDP */
+    if(len < 8 || *(uint16_t*)(buf+2) != htobe16(BBL_UDP_PORT)) {
+        return UNKNOWN_PROTOCOL;
+    }
+    payload_len = be16toh(*(uint16_t*)(buf+4));
+    if(payload_len < 8 + BBL_HEADER_LEN || payload_len > len) {
+        return UNKNOWN_PROTOCOL;
+    }
+    buf += 8;
+
+    /* BBL */
+    if(*(uint64_t*)buf != BBL_MAGIC_NUMBER) {
+        return UNKNOWN_PROTOCOL;
+    }
+    classify->bbl.type = buf[8];
+    classify->bbl.sub_type = buf[9];
+    classify->bbl.direction = buf[10];
+    classify->bbl.tos = buf[11];
+    if(classify->bbl.type == BBL_TYPE_UNICAST_SESSION) {
+        classify->bbl.ifindex = *(uint32_t*)(buf+16);
+        classify->bbl.outer_vlan_id = *(uint16_t*)(buf+20);
+        classify->bbl.inner_vlan_id = *(uint16_t*)(buf+22);
+    } else if(classify->bbl.type == BBL_TYPE_MULTICAST) {
+        classify->bbl.mc_source = *(uint32_t*)(buf+16);
+        classify->bbl.mc_group = *(uint32_t*)(buf+20);
+    }
+    classify->bbl.flow_id = *(uint64_t*)(buf+24);
+    classify->bbl.flow_seq = *(uint64_t*)(buf+32);
+    classify->bbl.timestamp = *(uint64_t*)(buf+40);
+    return PROTOCOL_SUCCESS;
+}
+
 protocol_error_t
 decode_ethernet(uint8_t *buf, uint16_t len,
                 uint8_t *sp, uint16_t sp_len,
@@ -124,6 +124,7 @@
 
 #define IGMP_MAX_SOURCES                3
 #define IGMP_MAX_GROUPS                 8
+#define IGMP_MAX_MC_FLOWS               8 /* multicast streams tracked per group */
 
 #define IPV4_MC_ALL_HOSTS               0x010000e0 /* 224.0.0.1 */
 #define IPV4_MC_ALL_ROUTERS             0x020000e0 /* 224.0.0.2 */
@@ -156,6 +157,8 @@
 #define DHCPV6_IA_ADDRESS_OPTION_LEN    24
 #define DHCPV6_IA_PREFIX_OPTION_LEN     25
 #define DHCPV6_ORO_OPTION_LEN           2
+#define DHCP_UDP_SERVER                 67
+#define DHCP_UDP_CLIENT                 68
 #define DHCPV6_UDP_CLIENT               546
 #define DHCPV6_UDP_SERVER               547
 
@@ -215,6 +218,13 @@ typedef enum protocol_error_ {
     IGNORED
 } protocol_error_t;
 
+typedef enum checksum_kernel_ {
+    CHECKSUM_KERNEL_AUTO = 0,
+    CHECKSUM_KERNEL_GENERIC,
+    CHECKSUM_KERNEL_SSE2,
+    CHECKSUM_KERNEL_AVX2
+} checksum_kernel_t;
+
 typedef enum icmpv6_message_type_ {
     IPV6_ICMPV6_ECHO_REQUEST           = 128,
     IPV6_ICMPV6_ECHO_REPLY             = 129,
@@ -387,6 +397,24 @@ struct pppoe_ppp_session_header {
     uint16_t  protocol;
 } __attribute__ ((__packed__));
 
+/*
+ * Option Iterator
+ *
+ * Option lists (PPP and DHCPv6) are not decoded together with
+ * the header but walked on demand by the receive handlers.
+ * The iterator points into the received frame.
+ */
+typedef struct bbl_option_iter_ {
+    uint8_t    *buf;
+    uint16_t    len;
+    bool        error; // malformed option found
+} bbl_option_iter_t;
+
+typedef struct bbl_option_ {
+    uint16_t    type;
+    uint16_t    len; // value length
+    uint8_t    *value;
+} bbl_option_t;
 
 /*
  * PPP LCP Structure
@@ -395,7 +423,7 @@ typedef struct bbl_lcp_ {
     uint8_t     code;
     uint8_t     identifier;
     uint8_t    *options;
-    uint8_t     options_len;
+    uint16_t    options_len;
     uint16_t    mru;
     uint16_t    auth;
     uint32_t    magic;
@@ -408,7 +436,7 @@ typedef struct bbl_ipcp_ {
     uint8_t     code;
     uint8_t     identifier;
     uint8_t    *options;
-    uint8_t     options_len;
+    uint16_t    options_len;
     uint32_t    address;
     uint32_t    dns1;
     uint32_t    dns2;
@@ -424,7 +452,7 @@ typedef struct bbl_ip6cp_ {
     uint8_t     code;
     uint8_t     identifier;
     uint8_t    *options;
-    uint8_t     options_len;
+    uint16_t    options_len;
     uint64_t    ipv6_identifier;
 } bbl_ip6cp_t;
 
@@ -547,6 +575,8 @@ typedef struct bbl_icmpv6_ {
 typedef struct bbl_dhcpv6_ {
     uint8_t      type;
     uint32_t     transaction_id;
+    uint8_t     *options;
+    uint16_t     options_len;
     uint8_t     *client_duid;
     uint8_t      client_duid_len;
     uint8_t     *server_duid;
@@ -592,6 +622,7 @@ typedef struct bbl_bbl_ {
     uint64_t     flow_id;
     uint64_t     flow_seq;
     uint64_t     timestamp;
+    uint16_t     padding; /* zero bytes appended to the header */
 } bbl_bbl_t;
 
 typedef struct bbl_qmx_li_ {
@@ -605,6 +636,67 @@ typedef struct bbl_qmx_li_ {
     uint16_t     payload_len; // LI payload length
 } bbl_qmx_li_t;
 
+/*
+ * Result of the BBL fast path classifier.
+ */
+typedef struct bbl_classify_ {
+    uint16_t     vlan_outer; // first VLAN tag in the frame
+    uint16_t     vlan_inner; // second VLAN tag in the frame
+    uint16_t     type; // ETH_TYPE_IPV4 or ETH_TYPE_IPV6 (also via PPPoE)
+    bool         pppoe; // PPPoE session frame
+    uint32_t     ipv4_dst; // IPv4 destination address
+    bbl_bbl_t    bbl;
+} bbl_classify_t;
+
+/*
+ * IPv4 multicast MAC address (RFC 1112)
+ */
+void
+ipv4_multicast_mac(uint32_t group, uint8_t *mac);
+
+/*
+ * classify_bbl
+ */
+protocol_error_t
+classify_bbl(uint8_t *buf, uint16_t len,
+             bbl_classify_t *classify);
+
+/*
+ * Internet checksum
+ */
+bool
+checksum_kernel_set(checksum_kernel_t kernel);
+
+uint16_t
+checksum(uint16_t *buf, uint16_t len);
+
+uint16_t
+checksum_update16(uint16_t csum, uint16_t old, uint16_t new);
+
+uint16_t
+checksum_update32(uint16_t csum, uint32_t old, uint32_t new);
+
+/*
+ * Option decoding on demand
+ */
+bool
+ppp_option_next(bbl_option_iter_t *iter, bbl_option_t *option);
+
+bool
+dhcpv6_option_next(bbl_option_iter_t *iter, bbl_option_t *option);
+
+protocol_error_t
+decode_ppp_lcp_options(bbl_lcp_t *lcp);
+
+protocol_error_t
+decode_ppp_ipcp_options(bbl_ipcp_t *ipcp);
+
+protocol_error_t
+decode_ppp_ip6cp_options(bbl_ip6cp_t *ip6cp);
+
+protocol_error_t
+decode_dhcpv6_options(bbl_dhcpv6_t *dhcpv6);
+
 /*
  * decode_ethernet
  */
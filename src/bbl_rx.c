@@ -21,6 +21,30 @@ struct keyval_ igmp_msg_names[] = {
     { 0, NULL}
 };
 
+/*
+ * Store an encoded session traffic packet in the session template.
+ * Templates are allocated from the template arena and reused as long
+ * as the packet fits into the allocated size, larger packets get a
+ * new template while the old one stays in the arena.
+ */
+static bool
+bbl_session_packet_template (bbl_ctx_s *ctx, uint8_t **template, uint16_t *template_len, uint16_t *template_size,
+                             uint8_t *buf, uint16_t len)
+{
+    if(!*template || *template_size < len) {
+        *template = bbl_arena_alloc(&ctx->template_arena, len, sizeof(uint64_t));
+        if(!*template) {
+            *template_size = 0;
+            *template_len = 0;
+            return false;
+        }
+        *template_size = len;
+    }
+    memcpy(*template, buf, len);
+    *template_len = len;
+    return true;
+}
+
 bool
 bbl_add_session_packets_ipv4 (bbl_ctx_s *ctx, bbl_session_s *session)
 {
@@ -29,7 +53,7 @@ bbl_add_session_packets_ipv4 (bbl_ctx_s *ctx, bbl_session_s *session)
     bbl_ipv4_t ip = {0};
     bbl_udp_t udp = {0};
     bbl_bbl_t bbl = {0};
-    uint8_t *buf;
+    uint8_t buf[DATA_TRAFFIC_MAX_LEN];
     uint16_t len = 0;
 
     /* Init BBL Session Key */
@@ -40,10 +64,6 @@ bbl_add_session_packets_ipv4 (bbl_ctx_s *ctx, bbl_session_s *session)
     bbl.inner_vlan_id = session->key.inner_vlan_id;
 
     /* Prepare Access (Session) to Network Packet */
-    if(!session->access_ipv4_tx_packet_template) {
-        session->access_ipv4_tx_packet_template = malloc(DATA_TRAFFIC_MAX_LEN);
-    }
-    buf = session->access_ipv4_tx_packet_template;
 
     eth.dst = session->server_mac;
     eth.src = session->client_mac;
@@ -81,7 +101,11 @@ bbl_add_session_packets_ipv4 (bbl_ctx_s *ctx, bbl_session_s *session)
     if(encode_ethernet(buf, &len, &eth) != PROTOCOL_SUCCESS) {
         return false;
     }
-    session->access_ipv4_tx_packet_len = len;
+    if(!bbl_session_packet_template(ctx, &session->access_ipv4_tx_packet_template,
+                                    &session->access_ipv4_tx_packet_len, &session->cold->tx_packet_size[BBL_SESSION_FLOW_ACCESS_IPV4],
+                                    buf, len)) {
+        return false;
+    }
 
     if(session->l2tp) {
         return true;
@@ -89,10 +113,6 @@ bbl_add_session_packets_ipv4 (bbl_ctx_s *ctx, bbl_session_s *session)
 
     /* Prepare Network to Access (Session) Packet */
     len = 0;
-    if(!session->network_ipv4_tx_packet_template) {
-        session->network_ipv4_tx_packet_template = malloc(DATA_TRAFFIC_MAX_LEN);
-    }
-    buf = session->network_ipv4_tx_packet_template;
 
     eth.dst = ctx->op.network_if->gateway_mac;
     eth.src = ctx->op.network_if->mac;
@@ -113,7 +133,11 @@ bbl_add_session_packets_ipv4 (bbl_ctx_s *ctx, bbl_session_s *session)
     if(encode_ethernet(buf, &len, &eth) != PROTOCOL_SUCCESS) {
         return false;
     }
-    session->network_ipv4_tx_packet_len = len;
+    if(!bbl_session_packet_template(ctx, &session->network_ipv4_tx_packet_template,
+                                    &session->network_ipv4_tx_packet_len, &session->cold->tx_packet_size[BBL_SESSION_FLOW_NETWORK_IPV4],
+                                    buf, len)) {
+        return false;
+    }
 
     return true;
 }
@@ -126,7 +150,7 @@ bbl_add_session_packets_ipv6 (bbl_ctx_s *ctx, bbl_session_s *session, bool ipv6_
     bbl_ipv6_t ip = {0};
     bbl_udp_t udp = {0};
     bbl_bbl_t bbl = {0};
-    uint8_t *buf;
+    uint8_t buf[DATA_TRAFFIC_MAX_LEN];
     uint16_t len = 0;
 
     /* Init BBL Session Key */
@@ -138,10 +162,6 @@ bbl_add_session_packets_ipv6 (bbl_ctx_s *ctx, bbl_session_s *session, bool ipv6_
     /* Prepare Access (Session) to Network Packet */
     if(ipv6_pd) {
         bbl.sub_type = BBL_SUB_TYPE_IPV6PD;
-        if(!session->access_ipv6pd_tx_packet_template) {
-            session->access_ipv6pd_tx_packet_template = malloc(DATA_TRAFFIC_MAX_LEN);
-        }
-        buf = session->access_ipv6pd_tx_packet_template;
         ip.src = session->delegated_ipv6_address;
         session->access_ipv6pd_tx_seq = 1;
         if(!session->access_ipv6pd_tx_flow_id) {
@@ -151,10 +171,6 @@ bbl_add_session_packets_ipv6 (bbl_ctx_s *ctx, bbl_session_s *session, bool ipv6_
         bbl.flow_id = session->access_ipv6pd_tx_flow_id;
     } else {
         bbl.sub_type = BBL_SUB_TYPE_IPV6;
-        if(!session->access_ipv6_tx_packet_template) {
-            session->access_ipv6_tx_packet_template = malloc(DATA_TRAFFIC_MAX_LEN);
-        }
-        buf = session->access_ipv6_tx_packet_template;
         ip.src = session->ipv6_address;
         session->access_ipv6_tx_seq = 1;
         if(!session->access_ipv6_tx_flow_id) {
@@ -194,18 +210,22 @@ bbl_add_session_packets_ipv6 (bbl_ctx_s *ctx, bbl_session_s *session, bool ipv6_
         return false;
     }
     if(ipv6_pd) {
-        session->access_ipv6pd_tx_packet_len = len;
+        if(!bbl_session_packet_template(ctx, &session->access_ipv6pd_tx_packet_template,
+                                        &session->access_ipv6pd_tx_packet_len, &session->cold->tx_packet_size[BBL_SESSION_FLOW_ACCESS_IPV6PD],
+                                        buf, len)) {
+            return false;
+        }
     } else {
-        session->access_ipv6_tx_packet_len = len;
+        if(!bbl_session_packet_template(ctx, &session->access_ipv6_tx_packet_template,
+                                        &session->access_ipv6_tx_packet_len, &session->cold->tx_packet_size[BBL_SESSION_FLOW_ACCESS_IPV6],
+                                        buf, len)) {
+            return false;
+        }
     }
 
     /* Prepare Network to Access (Session) Packet */
     len = 0;
     if(ipv6_pd) {
-        if(!session->network_ipv6pd_tx_packet_template) {
-            session->network_ipv6pd_tx_packet_template = malloc(DATA_TRAFFIC_MAX_LEN);
-        }
-        buf = session->network_ipv6pd_tx_packet_template;
         ip.dst = session->delegated_ipv6_address;
         session->network_ipv6pd_tx_seq = 1;
         if(!session->network_ipv6pd_tx_flow_id) {
@@ -214,10 +234,6 @@ bbl_add_session_packets_ipv6 (bbl_ctx_s *ctx, bbl_session_s *session, bool ipv6_
         session->network_ipv6pd_tx_flow_id = ctx->flow_id++;
         bbl.flow_id = session->network_ipv6pd_tx_flow_id;
     } else {
-        if(!session->network_ipv6_tx_packet_template) {
-            session->network_ipv6_tx_packet_template = malloc(DATA_TRAFFIC_MAX_LEN);
-        }
-        buf = session->network_ipv6_tx_packet_template;
         ip.dst = session->ipv6_address;
         session->network_ipv6_tx_seq = 1;
         if(!session->network_ipv6_tx_flow_id) {
@@ -240,92 +256,19 @@ bbl_add_session_packets_ipv6 (bbl_ctx_s *ctx, bbl_session_s *session, bool ipv6_
         return false;
     }
     if(ipv6_pd) {
-        session->network_ipv6pd_tx_packet_len = len;
-    } else {
-        session->network_ipv6_tx_packet_len = len;
-    }
-    return true;
-}
-
-void
-bbl_session_traffic_ipv4(timer_s *timer)
-{
-    bbl_session_s *session = timer->data;
-
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ipcp_state != BBL_PPP_OPENED) {
-            timer->periodic = false; /* Stop periodic timer */
-            return;
-        }
-    } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            timer->periodic = false; /* Stop periodic timer */
-            return;
-        }
-    }
-    if(session->session_traffic) {
-        session->send_requests |= BBL_SEND_SESSION_IPV4;
-        bbl_session_tx_qnode_insert(session);
-        if(session->l2tp == false) {
-            session->network_send_requests |= BBL_SEND_SESSION_IPV4;
-            bbl_session_network_tx_qnode_insert(session);
-        }
-    }
-}
-
-void
-bbl_session_traffic_ipv6(timer_s *timer)
-{
-    bbl_session_s *session = timer->data;
-
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ip6cp_state != BBL_PPP_OPENED) {
-            timer->periodic = false; /* Stop periodic timer */
-            return;
-        }
-    } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            timer->periodic = false; /* Stop periodic timer */
-            return;
-        }
-    }
-    if(session->session_traffic) {
-        if(session->ipv6_prefix.len) {
-            session->send_requests |= BBL_SEND_SESSION_IPV6;
-            session->network_send_requests |= BBL_SEND_SESSION_IPV6;
-        }
-        bbl_session_tx_qnode_insert(session);
-        bbl_session_network_tx_qnode_insert(session);
-    }
-}
-
-void
-bbl_session_traffic_ipv6pd(timer_s *timer)
-{
-    bbl_session_s *session = timer->data;
-
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ip6cp_state != BBL_PPP_OPENED) {
-            timer->periodic = false; /* Stop periodic timer */
-            return;
+        if(!bbl_session_packet_template(ctx, &session->network_ipv6pd_tx_packet_template,
+                                        &session->network_ipv6pd_tx_packet_len, &session->cold->tx_packet_size[BBL_SESSION_FLOW_NETWORK_IPV6PD],
+                                        buf, len)) {
+            return false;
         }
     } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            timer->periodic = false; /* Stop periodic timer */
-            return;
+        if(!bbl_session_packet_template(ctx, &session->network_ipv6_tx_packet_template,
+                                        &session->network_ipv6_tx_packet_len, &session->cold->tx_packet_size[BBL_SESSION_FLOW_NETWORK_IPV6],
+                                        buf, len)) {
+            return false;
         }
     }
-    if(session->session_traffic) {
-        if(session->delegated_ipv6_prefix.len) {
-            session->send_requests |= BBL_SEND_SESSION_IPV6PD;
-            session->network_send_requests |= BBL_SEND_SESSION_IPV6PD;
-        }
-        bbl_session_tx_qnode_insert(session);
-        bbl_session_network_tx_qnode_insert(session);
-    }
+    return true;
 }
 
 void
@@ -340,10 +283,10 @@ bbl_lcp_echo(timer_s *timer)
     ctx = interface->ctx;
 
     if(session->session_state == BBL_ESTABLISHED) {
-        if(session->lcp_retries) {
+        if(session->cold->lcp_retries) {
             interface->stats.lcp_echo_timeout++;
         }
-        if(session->lcp_retries > ctx->config.lcp_keepalive_retry) {
+        if(session->cold->lcp_retries > ctx->config.lcp_keepalive_retry) {
             LOG(PPPOE, "LCP ECHO TIMEOUT (Q-in-Q %u:%u)\n",
                 session->key.outer_vlan_id, session->key.inner_vlan_id);
             /* Force terminate session after timeout. */
@@ -351,10 +294,8 @@ bbl_lcp_echo(timer_s *timer)
             bbl_session_update_state(ctx, session, BBL_TERMINATING);
             bbl_session_tx_qnode_insert(session);
         } else {
-            session->lcp_request_code = PPP_CODE_ECHO_REQUEST;
-            session->lcp_identifier++;
-            session->lcp_options_len = 0;
-            session->send_requests |= BBL_SEND_LCP_REQUEST;
+            session->cold->lcp_identifier++;
+            session->send_requests |= BBL_SEND_LCP_ECHO_REQUEST;
             bbl_session_tx_qnode_insert(session);
         }
     }
@@ -387,37 +328,37 @@ bbl_igmp_zapping(timer_s *timer)
         return;
     }
 
-    if(!session->zapping_joined_group || !session->zapping_leaved_group) {
+    if(!session->cold->zapping_joined_group || !session->cold->zapping_leaved_group) {
         return;
     }
 
-    if(session->zapping_view_start_time.tv_sec) {
+    if(session->cold->zapping_view_start_time.tv_sec) {
         clock_gettime(CLOCK_MONOTONIC, &time_now);
-        timespec_sub(&time_diff, &time_now, &session->zapping_view_start_time);
+        timespec_sub(&time_diff, &time_now, &session->cold->zapping_view_start_time);
         if(time_diff.tv_sec >= ctx->config.igmp_zap_view_duration) {
-            session->zapping_view_start_time.tv_sec = 0;
-            session->zapping_count = 0;
+            session->cold->zapping_view_start_time.tv_sec = 0;
+            session->cold->zapping_count = 0;
         } else {
             return;
         }
     }
 
     /* Calculate last join delay... */
-    group = session->zapping_joined_group;
+    group = session->cold->zapping_joined_group;
     if(group->first_mc_rx_time.tv_sec) {
         timespec_sub(&time_diff, &group->first_mc_rx_time, &group->join_tx_time);
         ms = round(time_diff.tv_nsec / 1.0e6); // Convert nanoseconds to milliseconds
         join_delay = (time_diff.tv_sec * 1000) + ms;
 
-        session->zapping_join_delay_sum += join_delay;
-        session->zapping_join_delay_count++;
+        session->cold->zapping_join_delay_sum += join_delay;
+        session->cold->zapping_join_delay_count++;
         if(join_delay > session->stats.max_join_delay) session->stats.max_join_delay = join_delay;
         if(session->stats.min_join_delay) {
             if(join_delay < session->stats.min_join_delay) session->stats.min_join_delay = join_delay;
         } else {
             session->stats.min_join_delay = join_delay;
         }
-        session->stats.avg_join_delay = session->zapping_join_delay_sum / session->zapping_join_delay_count;
+        session->stats.avg_join_delay = session->cold->zapping_join_delay_sum / session->cold->zapping_join_delay_count;
 
         LOG(IGMP, "IGMP (Q-in-Q %u:%u) ZAPPING %u ms join delay for group %s\n",
                 session->key.outer_vlan_id, session->key.inner_vlan_id,
@@ -436,7 +377,7 @@ bbl_igmp_zapping(timer_s *timer)
 
     /* Select next group to be joined ... */
     next_group = be32toh(group->group) + be32toh(ctx->config.igmp_group_iter);
-    if(next_group > session->zapping_group_max) {
+    if(next_group > session->cold->zapping_group_max) {
         next_group = ctx->config.igmp_group;
     } else {
         next_group = htobe32(next_group);
@@ -444,7 +385,7 @@ bbl_igmp_zapping(timer_s *timer)
 
     /* Leave last joined group ... */
     group->state = IGMP_GROUP_LEAVING;
-    group->robustness_count = session->igmp_robustness;
+    group->robustness_count = session->cold->igmp_robustness;
     group->send = true;
     group->leave_tx_time.tv_sec = 0;
     group->leave_tx_time.tv_nsec = 0;
@@ -452,20 +393,20 @@ bbl_igmp_zapping(timer_s *timer)
     group->last_mc_rx_time.tv_nsec = 0;
 
     /* Calculate last leave delay ... */
-    group = session->zapping_leaved_group;
+    group = session->cold->zapping_leaved_group;
     if(group->group && group->last_mc_rx_time.tv_sec && group->leave_tx_time.tv_sec) {
         timespec_sub(&time_diff, &group->last_mc_rx_time, &group->leave_tx_time);
         ms = round(time_diff.tv_nsec / 1.0e6); // Convert nanoseconds to milliseconds
         leave_delay = (time_diff.tv_sec * 1000) + ms;
-        session->zapping_leave_delay_sum += leave_delay;
-        session->zapping_leave_delay_count++;
+        session->cold->zapping_leave_delay_sum += leave_delay;
+        session->cold->zapping_leave_delay_count++;
         if(leave_delay > session->stats.max_leave_delay) session->stats.max_leave_delay = leave_delay;
         if(session->stats.min_leave_delay) {
             if(leave_delay < session->stats.min_leave_delay) session->stats.min_leave_delay = leave_delay;
         } else {
             session->stats.min_leave_delay = leave_delay;
         }
-        session->stats.avg_leave_delay = session->zapping_leave_delay_sum / session->zapping_leave_delay_count;
+        session->stats.avg_leave_delay = session->cold->zapping_leave_delay_sum / session->cold->zapping_leave_delay_count;
 
         LOG(IGMP, "IGMP (Q-in-Q %u:%u) ZAPPING %u ms leave delay for group %s\n",
                     session->key.outer_vlan_id, session->key.inner_vlan_id,
@@ -475,7 +416,7 @@ bbl_igmp_zapping(timer_s *timer)
     /* Join next group ... */
     group->group = next_group;
     group->state = IGMP_GROUP_JOINING;
-    group->robustness_count = session->igmp_robustness;
+    group->robustness_count = session->cold->igmp_robustness;
     group->send = true;
     group->packets = 0;
     group->loss = 0;
@@ -487,24 +428,25 @@ bbl_igmp_zapping(timer_s *timer)
     group->leave_tx_time.tv_nsec = 0;
     group->last_mc_rx_time.tv_sec = 0;
     group->last_mc_rx_time.tv_nsec = 0;
+    memset(group->mc_flow, 0x0, sizeof(group->mc_flow));
 
     session->send_requests |= BBL_SEND_IGMP;
     bbl_session_tx_qnode_insert(session);
 
     /* Swap join/leave */
-    session->zapping_leaved_group = session->zapping_joined_group;
-    session->zapping_joined_group = group;
+    session->cold->zapping_leaved_group = session->cold->zapping_joined_group;
+    session->cold->zapping_joined_group = group;
 
     LOG(IGMP, "IGMP (Q-in-Q %u:%u) ZAPPING leave %s join %s\n",
               session->key.outer_vlan_id, session->key.inner_vlan_id,
-              format_ipv4_address(&session->zapping_leaved_group->group),
-              format_ipv4_address(&session->zapping_joined_group->group));
+              format_ipv4_address(&session->cold->zapping_leaved_group->group),
+              format_ipv4_address(&session->cold->zapping_joined_group->group));
 
     /* Handle viewing profile */
-    session->zapping_count++;
+    session->cold->zapping_count++;
     if(ctx->config.igmp_zap_count && ctx->config.igmp_zap_view_duration) {
-        if(session->zapping_count >= ctx->config.igmp_zap_count) {
-            clock_gettime(CLOCK_MONOTONIC, &session->zapping_view_start_time);
+        if(session->cold->zapping_count >= ctx->config.igmp_zap_count) {
+            clock_gettime(CLOCK_MONOTONIC, &session->cold->zapping_view_start_time);
         }
     }
 }
@@ -531,14 +473,14 @@ bbl_igmp_initial_join(timer_s *timer)
     }
     initial_group = htobe32(be32toh(ctx->config.igmp_group) + (group_start_index * be32toh(ctx->config.igmp_group_iter)));
 
-    group = &session->igmp_groups[0];
+    group = &session->cold->igmp_groups[0];
     memset(group, 0x0, sizeof(bbl_igmp_group_s));
     group->group = initial_group;
     group->source[0] = ctx->config.igmp_source;
-    group->robustness_count = session->igmp_robustness;
+    group->robustness_count = session->cold->igmp_robustness;
     group->state = IGMP_GROUP_JOINING;
     group->send = true;
-    session->zapping_count = 1;
+    session->cold->zapping_count = 1;
     session->send_requests |= BBL_SEND_IGMP;
     bbl_session_tx_qnode_insert(session);
 
@@ -549,19 +491,19 @@ bbl_igmp_initial_join(timer_s *timer)
     if(ctx->config.igmp_group_count > 1 && ctx->config.igmp_zap_interval > 0) {
         /* Start/Init Zapping Logic ... */
         group->zapping = true;
-        session->zapping_joined_group = group;
-        group = &session->igmp_groups[1];
-        session->zapping_leaved_group = group;
+        session->cold->zapping_joined_group = group;
+        group = &session->cold->igmp_groups[1];
+        session->cold->zapping_leaved_group = group;
         memset(group, 0x0, sizeof(bbl_igmp_group_s));
         group->zapping = true;
         group->source[0] = ctx->config.igmp_source;
 
         if(ctx->config.igmp_zap_count && ctx->config.igmp_zap_view_duration) {
-            session->zapping_count = rand() % ctx->config.igmp_zap_count;
+            session->cold->zapping_count = rand() % ctx->config.igmp_zap_count;
         }
 
         /* Adding 1 nanosecond to enforce a dedicated timer bucket for zapping. */
-        timer_add_periodic(&ctx->timer_root, &session->timer_zapping, "IGMP Zapping", ctx->config.igmp_zap_interval, 1, session, bbl_igmp_zapping);
+        timer_add_periodic(&ctx->timer_root, &session->cold->timer_zapping, "IGMP Zapping", ctx->config.igmp_zap_interval, 1, session, bbl_igmp_zapping);
         LOG(IGMP, "IGMP (Q-in-Q %u:%u) ZAPPING start zapping with interval %u\n",
                     session->key.outer_vlan_id, session->key.inner_vlan_id,
                     ctx->config.igmp_zap_interval);
@@ -576,45 +518,36 @@ bbl_rx_dhcpv6(bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *sessi
     bbl_udp_t *udp = (bbl_udp_t*)ipv6->next;
     bbl_dhcpv6_t *dhcpv6 = (bbl_dhcpv6_t*)udp->next;
     bbl_ctx_s *ctx = interface->ctx;
-    uint16_t tx_interval;
 
+    if(decode_dhcpv6_options(dhcpv6) != PROTOCOL_SUCCESS) {
+        interface->stats.packets_rx_drop_decode_error++;
+        return;
+    }
     if(dhcpv6->server_duid_len && dhcpv6->server_duid_len < DHCPV6_BUFFER) {
-        memcpy(session->server_duid, dhcpv6->server_duid, dhcpv6->server_duid_len);
-        session->server_duid_len = dhcpv6->server_duid_len;
+        memcpy(session->cold->server_duid, dhcpv6->server_duid, dhcpv6->server_duid_len);
+        session->cold->server_duid_len = dhcpv6->server_duid_len;
     }
     if(dhcpv6->type == DHCPV6_MESSAGE_REPLY) {
         if(dhcpv6->delegated_prefix) {
-            if(!session->dhcpv6_received) {
+            if(!session->cold->dhcpv6_received) {
                 if(dhcpv6->delegated_prefix->len) {
                     memcpy(&session->delegated_ipv6_prefix, dhcpv6->delegated_prefix, sizeof(ipv6_prefix));
                     *(uint64_t*)&session->delegated_ipv6_address[0] = *(uint64_t*)session->delegated_ipv6_prefix.address;
-                    *(uint64_t*)&session->delegated_ipv6_address[8] = session->ip6cp_ipv6_identifier;
+                    *(uint64_t*)&session->delegated_ipv6_address[8] = session->cold->ip6cp_ipv6_identifier;
                     LOG(IP, "IPv6 (Q-in-Q %u:%u) DHCPv6 PD prefix %s/%d\n",
                             session->key.outer_vlan_id, session->key.inner_vlan_id,
                             format_ipv6_address(&session->delegated_ipv6_prefix.address), session->delegated_ipv6_prefix.len);
                     if(dhcpv6->dns1) {
-                        memcpy(&session->dhcpv6_dns1, dhcpv6->dns1, IPV6_ADDR_LEN);
+                        memcpy(&session->cold->dhcpv6_dns1, dhcpv6->dns1, IPV6_ADDR_LEN);
                         if(dhcpv6->dns2) {
-                            memcpy(&session->dhcpv6_dns2, dhcpv6->dns2, IPV6_ADDR_LEN);
+                            memcpy(&session->cold->dhcpv6_dns2, dhcpv6->dns2, IPV6_ADDR_LEN);
                         }
                     }
                     if(session->l2tp == false && ctx->config.session_traffic_ipv6pd_pps && 
                        ctx->op.network_if && ctx->op.network_if->ip6.len) {
                         /* Start IPv6 PD Session Traffic */
-                        if(bbl_add_session_packets_ipv6(ctx, session, true)) {
-                            if(ctx->config.session_traffic_ipv6pd_pps > 1) {
-                                tx_interval = 1000 / ctx->config.session_traffic_ipv6pd_pps;
-                                if(tx_interval < ctx->config.tx_interval) {
-                                    /* It is not possible to send faster than TX interval. */
-                                    tx_interval = ctx->config.tx_interval;
-                                }
-                                timer_add_periodic(&ctx->timer_root, &session->timer_session_traffic_ipv6pd, "Session Traffic IPv6PD",
-                                                0, tx_interval * MSEC, session, bbl_session_traffic_ipv6pd);
-                            } else {
-                                timer_add_periodic(&ctx->timer_root, &session->timer_session_traffic_ipv6pd, "Session Traffic IPv6PD",
-                                                1, 0, session, bbl_session_traffic_ipv6pd);
-                            }
-                        } else {
+                        if(!bbl_add_session_packets_ipv6(ctx, session, true) ||
+                           !bbl_session_traffic_start(ctx, session, BBL_SUB_TYPE_IPV6PD)) {
                             LOG(ERROR, "Traffic (Q-in-Q %u:%u) failed to create IPv6 session traffic\n",
                                 session->key.outer_vlan_id, session->key.inner_vlan_id);
                         }
@@ -622,114 +555,175 @@ bbl_rx_dhcpv6(bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *sessi
                 }
             }
         }
-        if(!session->dhcpv6_received) {
+        if(!session->cold->dhcpv6_received) {
             ctx->dhcpv6_established++;
             if(ctx->dhcpv6_established > ctx->dhcpv6_established_max) {
                 ctx->dhcpv6_established_max = ctx->dhcpv6_established;
             }
         }
-        session->dhcpv6_received = true;
+        session->cold->dhcpv6_received = true;
         session->send_requests &= ~BBL_SEND_DHCPV6_REQUEST;
     } else if(dhcpv6->type == DHCPV6_MESSAGE_ADVERTISE) {
         if(dhcpv6->ia_pd_option_len && dhcpv6->ia_pd_option_len < DHCPV6_BUFFER) {
-            memcpy(session->dhcpv6_ia_pd_option, dhcpv6->ia_pd_option, dhcpv6->ia_pd_option_len);
-            session->dhcpv6_ia_pd_option_len = dhcpv6->ia_pd_option_len;
-            session->dhcpv6_type = DHCPV6_MESSAGE_REQUEST;
+            memcpy(session->cold->dhcpv6_ia_pd_option, dhcpv6->ia_pd_option, dhcpv6->ia_pd_option_len);
+            session->cold->dhcpv6_ia_pd_option_len = dhcpv6->ia_pd_option_len;
+            session->cold->dhcpv6_type = DHCPV6_MESSAGE_REQUEST;
         }
         session->send_requests |= BBL_SEND_DHCPV6_REQUEST;
         bbl_session_tx_qnode_insert(session);
     }
 }
 
-void
-bbl_rx_udp(bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *session) {
+/*
+ * One-way latency of a session traffic flow, measured by the receiver.
+ */
+static void
+bbl_rx_session_latency(bbl_ethernet_header_t *eth, bbl_bbl_t *bbl, bbl_interface_s *interface,
+                       bbl_io_thread_s *io_thread, bbl_session_s *session, bbl_session_flow_t type) {
+    bbl_interface_stats_s *stats = BBL_IO_STATS(interface, io_thread);
+    bbl_session_flow_s *flow;
+    uint64_t delay, variation;
+
+    if(!bbl_latency_bbl_delay(bbl->timestamp, eth->rx_sec, eth->rx_nsec, &delay)) {
+        return;
+    }
+    bbl_latency_add(&stats->session_latency, delay);
+    bbl_latency_histogram_add(&stats->session_latency_histogram, delay);
+    /* Allocated by the control thread with the first traffic start. */
+    flow = __atomic_load_n(&session->traffic_flows, __ATOMIC_ACQUIRE);
+    if(!flow) {
+        return;
+    }
+    flow += type;
+    if(bbl_latency_variation(&flow->latency, delay, &variation)) {
+        bbl_latency_histogram_add(&stats->session_jitter_histogram, variation);
+        if(flow->jitter_histogram) {
+            bbl_latency_histogram_add(flow->jitter_histogram, variation);
+        }
+    }
+    bbl_latency_add(&flow->latency, delay);
+    if(flow->latency_histogram) {
+        bbl_latency_histogram_add(flow->latency_histogram, delay);
+    }
+}
 
-    bbl_udp_t *udp = (bbl_udp_t*)ipv6->next;
-    bbl_bbl_t *bbl = NULL;
+/*
+ * Session traffic received on an access interface, accounted by
+ * the receiving I/O thread if the data plane is enabled.
+ */
+static void
+bbl_rx_session_traffic_access(bbl_ethernet_header_t *eth, bbl_bbl_t *bbl, bbl_interface_s *interface,
+                              bbl_io_thread_s *io_thread, bbl_session_s *session) {
+    bbl_interface_stats_s *stats = BBL_IO_STATS(interface, io_thread);
 
-    switch(udp->dst) {
-        case DHCPV6_UDP_CLIENT:
-        case DHCPV6_UDP_SERVER:
-            bbl_rx_dhcpv6(ipv6, interface, session);
-            interface->stats.dhcpv6_rx++;
-            break;
-        case BBL_UDP_PORT:
-            bbl = (bbl_bbl_t*)udp->next;
-            break;
-        default:
-            break;
+    if(!io_thread && interface->io_data) {
+        return;
     }
-
-    /* BBL receive handler */
-    if(bbl && bbl->type == BBL_TYPE_UNICAST_SESSION) {
+    if(bbl->outer_vlan_id != session->key.outer_vlan_id ||
+       bbl->inner_vlan_id != session->key.inner_vlan_id) {
+        /* Session traffic and streams received by the wrong session. */
         switch (bbl->sub_type) {
             case BBL_SUB_TYPE_IPV4:
-                if(bbl->outer_vlan_id != session->key.outer_vlan_id ||
-                   bbl->inner_vlan_id != session->key.inner_vlan_id) {
-                    interface->stats.session_ipv4_wrong_session++;
-                    return;
-                }
-                interface->stats.session_ipv4_rx++;
-                session->stats.access_ipv4_rx++;
-                if(!session->access_ipv4_rx_first_seq) {
-                    session->access_ipv4_rx_first_seq = bbl->flow_seq;
-                    interface->ctx->stats.session_traffic_flows_verified++;
-                } else {
-                    if(session->access_ipv4_rx_last_seq +1 != bbl->flow_seq) {
-                        interface->stats.session_ipv4_loss++;
-                        session->stats.access_ipv4_loss++;
+                stats->session_ipv4_wrong_session++;
+                break;
+            case BBL_SUB_TYPE_IPV6:
+                stats->session_ipv6_wrong_session++;
+                break;
+            case BBL_SUB_TYPE_IPV6PD:
+                stats->session_ipv6pd_wrong_session++;
+                break;
+        }
+        return;
+    }
+    if(bbl_stream_rx(interface, io_thread, bbl)) {
+        return;
+    }
+    switch (bbl->sub_type) {
+        case BBL_SUB_TYPE_IPV4:
+            stats->session_ipv4_rx++;
+            session->stats.access_ipv4_rx++;
+            if(!session->access_ipv4_rx_first_seq) {
+                session->access_ipv4_rx_first_seq = bbl->flow_seq;
+                __atomic_fetch_add(&interface->ctx->stats.session_traffic_flows_verified, 1, __ATOMIC_RELAXED);
+            } else {
+                if(session->access_ipv4_rx_last_seq +1 != bbl->flow_seq) {
+                    stats->session_ipv4_loss++;
+                    session->stats.access_ipv4_loss++;
+                    if(!io_thread) {
                         LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
                             session->key.outer_vlan_id, session->key.inner_vlan_id,
                             bbl->flow_id, bbl->flow_seq, session->access_ipv4_rx_last_seq);
                     }
                 }
-                session->access_ipv4_rx_last_seq = bbl->flow_seq;
-                break;
-            case BBL_SUB_TYPE_IPV6:
-                if(bbl->outer_vlan_id != session->key.outer_vlan_id ||
-                   bbl->inner_vlan_id != session->key.inner_vlan_id) {
-                    interface->stats.session_ipv6_wrong_session++;
-                    return;
-                }
-                interface->stats.session_ipv6_rx++;
-                session->stats.access_ipv6_rx++;
-                if(!session->access_ipv6_rx_first_seq) {
-                    session->access_ipv6_rx_first_seq = bbl->flow_seq;
-                    interface->ctx->stats.session_traffic_flows_verified++;
-                } else {
-                    if(session->access_ipv6_rx_last_seq +1 != bbl->flow_seq) {
-                        interface->stats.session_ipv6_loss++;
-                        session->stats.access_ipv6_loss++;
+            }
+            session->access_ipv4_rx_last_seq = bbl->flow_seq;
+            bbl_rx_session_latency(eth, bbl, interface, io_thread, session, BBL_SESSION_FLOW_NETWORK_IPV4);
+            break;
+        case BBL_SUB_TYPE_IPV6:
+            stats->session_ipv6_rx++;
+            session->stats.access_ipv6_rx++;
+            if(!session->access_ipv6_rx_first_seq) {
+                session->access_ipv6_rx_first_seq = bbl->flow_seq;
+                __atomic_fetch_add(&interface->ctx->stats.session_traffic_flows_verified, 1, __ATOMIC_RELAXED);
+            } else {
+                if(session->access_ipv6_rx_last_seq +1 != bbl->flow_seq) {
+                    stats->session_ipv6_loss++;
+                    session->stats.access_ipv6_loss++;
+                    if(!io_thread) {
                         LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
                             session->key.outer_vlan_id, session->key.inner_vlan_id,
                             bbl->flow_id, bbl->flow_seq, session->access_ipv6_rx_last_seq);
                     }
                 }
-                session->access_ipv6_rx_last_seq = bbl->flow_seq;
-                break;
-            case BBL_SUB_TYPE_IPV6PD:
-                if(bbl->outer_vlan_id != session->key.outer_vlan_id ||
-                   bbl->inner_vlan_id != session->key.inner_vlan_id) {
-                    interface->stats.session_ipv6pd_wrong_session++;
-                    return;
-                }
-                interface->stats.session_ipv6pd_rx++;
-                session->stats.access_ipv6pd_rx++;
-                if(!session->access_ipv6pd_rx_first_seq) {
-                    session->access_ipv6pd_rx_first_seq = bbl->flow_seq;
-                    interface->ctx->stats.session_traffic_flows_verified++;
-                } else {
-                    if(session->access_ipv6pd_rx_last_seq +1 != bbl->flow_seq) {
-                        interface->stats.session_ipv6pd_loss++;
-                        session->stats.access_ipv6pd_loss++;
+            }
+            session->access_ipv6_rx_last_seq = bbl->flow_seq;
+            bbl_rx_session_latency(eth, bbl, interface, io_thread, session, BBL_SESSION_FLOW_NETWORK_IPV6);
+            break;
+        case BBL_SUB_TYPE_IPV6PD:
+            stats->session_ipv6pd_rx++;
+            session->stats.access_ipv6pd_rx++;
+            if(!session->access_ipv6pd_rx_first_seq) {
+                session->access_ipv6pd_rx_first_seq = bbl->flow_seq;
+                __atomic_fetch_add(&interface->ctx->stats.session_traffic_flows_verified, 1, __ATOMIC_RELAXED);
+            } else {
+                if(session->access_ipv6pd_rx_last_seq +1 != bbl->flow_seq) {
+                    stats->session_ipv6pd_loss++;
+                    session->stats.access_ipv6pd_loss++;
+                    if(!io_thread) {
                         LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
                             session->key.outer_vlan_id, session->key.inner_vlan_id,
                             bbl->flow_id, bbl->flow_seq, session->access_ipv6pd_rx_last_seq);
                     }
                 }
-                session->access_ipv6pd_rx_last_seq = bbl->flow_seq;
-                break;
-        }
+            }
+            session->access_ipv6pd_rx_last_seq = bbl->flow_seq;
+            bbl_rx_session_latency(eth, bbl, interface, io_thread, session, BBL_SESSION_FLOW_NETWORK_IPV6PD);
+            break;
+    }
+}
+
+void
+bbl_rx_udp(bbl_ethernet_header_t *eth, bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *session) {
+
+    bbl_udp_t *udp = (bbl_udp_t*)ipv6->next;
+    bbl_bbl_t *bbl = NULL;
+
+    switch(udp->dst) {
+        case DHCPV6_UDP_CLIENT:
+        case DHCPV6_UDP_SERVER:
+            bbl_rx_dhcpv6(ipv6, interface, session);
+            interface->stats.dhcpv6_rx++;
+            break;
+        case BBL_UDP_PORT:
+            bbl = (bbl_bbl_t*)udp->next;
+            break;
+        default:
+            break;
+    }
+
+    /* BBL receive handler */
+    if(bbl && bbl->type == BBL_TYPE_UNICAST_SESSION) {
+        bbl_rx_session_traffic_access(eth, bbl, interface, NULL, session);
     }
 }
 
@@ -738,7 +732,6 @@ bbl_rx_icmpv6(bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *sessi
 
     bbl_icmpv6_t *icmpv6 = (bbl_icmpv6_t*)ipv6->next;
     bbl_ctx_s *ctx = interface->ctx;
-    uint16_t tx_interval;
 
     session->stats.icmpv6_rx++;
     if(icmpv6->type == IPV6_ICMPV6_ROUTER_ADVERTISEMENT) {
@@ -747,33 +740,21 @@ bbl_rx_icmpv6(bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *sessi
             if(icmpv6->prefix.len) {
                 memcpy(&session->ipv6_prefix, &icmpv6->prefix, sizeof(ipv6_prefix));
                 *(uint64_t*)&session->ipv6_address[0] = *(uint64_t*)session->ipv6_prefix.address;
-                *(uint64_t*)&session->ipv6_address[8] = session->ip6cp_ipv6_identifier;
+                *(uint64_t*)&session->ipv6_address[8] = session->cold->ip6cp_ipv6_identifier;
                 LOG(IP, "IPv6 (Q-in-Q %u:%u) ICMPv6 RA prefix %s/%d\n",
                         session->key.outer_vlan_id, session->key.inner_vlan_id,
                         format_ipv6_address(&session->ipv6_prefix.address), session->ipv6_prefix.len);
                 if(icmpv6->dns1) {
-                    memcpy(&session->ipv6_dns1, icmpv6->dns1, IPV6_ADDR_LEN);
+                    memcpy(&session->cold->ipv6_dns1, icmpv6->dns1, IPV6_ADDR_LEN);
                     if(icmpv6->dns2) {
-                        memcpy(&session->ipv6_dns2, icmpv6->dns2, IPV6_ADDR_LEN);
+                        memcpy(&session->cold->ipv6_dns2, icmpv6->dns2, IPV6_ADDR_LEN);
                     }
                 }
                 if(session->l2tp == false &&  ctx->config.session_traffic_ipv6_pps && 
                    ctx->op.network_if && ctx->op.network_if->ip6.len) {
                     /* Start IPv6 Session Traffic */
-                    if(bbl_add_session_packets_ipv6(ctx, session, false)) {
-                        if(ctx->config.session_traffic_ipv6_pps > 1) {
-                            tx_interval = 1000 / ctx->config.session_traffic_ipv6_pps;
-                            if(tx_interval < ctx->config.tx_interval) {
-                                /* It is not possible to send faster than TX interval. */
-                                tx_interval = ctx->config.tx_interval;
-                            }
-                            timer_add_periodic(&ctx->timer_root, &session->timer_session_traffic_ipv6, "Session Traffic IPv6",
-                                            0, tx_interval * MSEC, session, bbl_session_traffic_ipv6);
-                        } else {
-                            timer_add_periodic(&ctx->timer_root, &session->timer_session_traffic_ipv6, "Session Traffic IPv6",
-                                            1, 0, session, bbl_session_traffic_ipv6);
-                        }
-                    } else {
+                    if(!bbl_add_session_packets_ipv6(ctx, session, false) ||
+                       !bbl_session_traffic_start(ctx, session, BBL_SUB_TYPE_IPV6)) {
                         LOG(ERROR, "Traffic (Q-in-Q %u:%u) failed to create IPv6 session traffic\n",
                             session->key.outer_vlan_id, session->key.inner_vlan_id);
                     }
@@ -781,11 +762,11 @@ bbl_rx_icmpv6(bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *sessi
             }
             if(icmpv6->other) {
                 if(ctx->config.dhcpv6_enable) {
-                    if(!session->dhcpv6_requested) {
+                    if(!session->cold->dhcpv6_requested) {
                         ctx->dhcpv6_requested++;
                     }
-                    session->dhcpv6_requested = true;
-                    session->dhcpv6_type = DHCPV6_MESSAGE_SOLICIT;
+                    session->cold->dhcpv6_requested = true;
+                    session->cold->dhcpv6_type = DHCPV6_MESSAGE_SOLICIT;
                     session->send_requests |= BBL_SEND_DHCPV6_REQUEST;
                     bbl_session_tx_qnode_insert(session);
                 }
@@ -803,15 +784,15 @@ bbl_rx_icmp(bbl_ipv4_t *ipv4, bbl_session_s *session) {
     bbl_icmp_t *icmp = (bbl_icmp_t*)ipv4->next;
 
     if(icmp->type == ICMP_TYPE_ECHO_REQUEST) {
-        session->icmp_reply_type = ICMP_TYPE_ECHO_REPLY;
-        session->icmp_reply_destination = ipv4->src;
+        session->cold->icmp_reply_type = ICMP_TYPE_ECHO_REPLY;
+        session->cold->icmp_reply_destination = ipv4->src;
         if(icmp->data_len) {
             if(icmp->data_len > ICMP_DATA_BUFFER) {
-                memcpy(session->icmp_reply_data, icmp->data, ICMP_DATA_BUFFER);
-                session->icmp_reply_data_len = ICMP_DATA_BUFFER;
+                memcpy(session->cold->icmp_reply_data, icmp->data, ICMP_DATA_BUFFER);
+                session->cold->icmp_reply_data_len = ICMP_DATA_BUFFER;
             } else {
-                memcpy(session->icmp_reply_data, icmp->data, icmp->data_len);
-                session->icmp_reply_data_len = icmp->data_len;
+                memcpy(session->cold->icmp_reply_data, icmp->data, icmp->data_len);
+                session->cold->icmp_reply_data_len = icmp->data_len;
             }
         }
         session->send_requests |= BBL_SEND_ICMP_REPLY;
@@ -838,13 +819,13 @@ bbl_rx_igmp(bbl_ipv4_t *ipv4, bbl_session_s *session) {
     if(igmp->type == IGMP_TYPE_QUERY) {
 
         if(igmp->robustness) {
-            session->igmp_robustness = igmp->robustness;
+            session->cold->igmp_robustness = igmp->robustness;
         }
 
         if(igmp->group) {
             /* Group Specfic Query */
             for(i=0; i < IGMP_MAX_GROUPS; i++) {
-                group = &session->igmp_groups[i];
+                group = &session->cold->igmp_groups[i];
                 if(group->group == igmp->group &&
                    group->state == IGMP_GROUP_ACTIVE) {
                     group->send = true;
@@ -854,7 +835,7 @@ bbl_rx_igmp(bbl_ipv4_t *ipv4, bbl_session_s *session) {
         } else {
             /* General Query */
             for(i=0; i < IGMP_MAX_GROUPS; i++) {
-                group = &session->igmp_groups[i];
+                group = &session->cold->igmp_groups[i];
                 if(group->state == IGMP_GROUP_ACTIVE) {
                     group->send = true;
                     send = true;
@@ -869,13 +850,92 @@ bbl_rx_igmp(bbl_ipv4_t *ipv4, bbl_session_s *session) {
     }
 }
 
+/*
+ * Return the sequence tracking of a multicast stream received
+ * for a group. Groups with more sources than tracked streams
+ * take over a slot, which restarts loss detection for it.
+ */
+static uint64_t *
+bbl_rx_multicast_flow(bbl_igmp_group_s *group, uint64_t flow_id, bool *new) {
+    int i, free = -1;
+
+    for(i=0; i < IGMP_MAX_MC_FLOWS; i++) {
+        if(group->mc_flow[i].flow_id == flow_id) {
+            *new = false;
+            return &group->mc_flow[i].last_seq;
+        }
+        if(free < 0 && !group->mc_flow[i].flow_id) {
+            free = i;
+        }
+    }
+    if(free < 0) {
+        free = flow_id % IGMP_MAX_MC_FLOWS;
+    }
+    group->mc_flow[free].flow_id = flow_id;
+    *new = true;
+    return &group->mc_flow[free].last_seq;
+}
+
+/*
+ * Multicast traffic received on an access interface. Loss is
+ * detected for BBL multicast traffic only (bbl is NULL otherwise)
+ * using the expected sequence number of each stream (flow-id).
+ */
+static void
+bbl_rx_multicast(bbl_ethernet_header_t *eth, bbl_bbl_t *bbl, uint32_t group_address,
+                 bbl_interface_s *interface, bbl_session_s *session) {
+    bbl_igmp_group_s *group;
+    uint64_t *last_seq = NULL;
+    bool new_flow = true;
+    int i;
+
+    for(i=0; i < IGMP_MAX_GROUPS; i++) {
+        group = &session->cold->igmp_groups[i];
+        if(group_address == group->group) {
+            if(group->state >= IGMP_GROUP_ACTIVE) {
+                interface->stats.mc_rx++;
+                session->stats.mc_rx++;
+                group->packets++;
+                if(bbl) {
+                    last_seq = bbl_rx_multicast_flow(group, bbl->flow_id, &new_flow);
+                }
+                if(!group->first_mc_rx_time.tv_sec) {
+                    group->first_mc_rx_time.tv_sec = eth->rx_sec;
+                    group->first_mc_rx_time.tv_nsec = eth->rx_nsec;
+                } else if(last_seq && !new_flow && bbl->flow_seq > *last_seq + 1) {
+                    interface->stats.mc_loss++;
+                    session->stats.mc_loss++;
+                    group->loss++;
+                    LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
+                        session->key.outer_vlan_id, session->key.inner_vlan_id,
+                        bbl->flow_id, bbl->flow_seq, *last_seq);
+                }
+                if(last_seq) {
+                    *last_seq = bbl->flow_seq;
+                }
+            } else {
+                interface->stats.mc_rx++;
+                session->stats.mc_rx++;
+                group->packets++;
+                group->last_mc_rx_time.tv_sec = eth->rx_sec;
+                group->last_mc_rx_time.tv_nsec = eth->rx_nsec;
+                if(session->cold->zapping_joined_group &&
+                   session->cold->zapping_leaved_group == group) {
+                    if(session->cold->zapping_joined_group->first_mc_rx_time.tv_sec) {
+                        session->stats.mc_old_rx_after_first_new++;
+                    }
+                }
+            }
+            break;
+        }
+    }
+}
+
 void
 bbl_rx_ipv4(bbl_ethernet_header_t *eth, bbl_ipv4_t *ipv4, bbl_interface_s *interface, bbl_session_s *session) {
 
     bbl_udp_t *udp;
     bbl_bbl_t *bbl = NULL;
-    bbl_igmp_group_s *group = NULL;
-    int i;
 
     switch(ipv4->protocol) {
         case PROTOCOL_IPV4_IGMP:
@@ -897,107 +957,22 @@ bbl_rx_ipv4(bbl_ethernet_header_t *eth, bbl_ipv4_t *ipv4, bbl_interface_s *inter
     }
 
     /* BBL receive handler */
-    if(bbl) {
-        if(bbl->type == BBL_TYPE_UNICAST_SESSION) {
-            if(bbl->outer_vlan_id != session->key.outer_vlan_id ||
-               bbl->inner_vlan_id != session->key.inner_vlan_id) {
-                interface->stats.session_ipv4_wrong_session++;
-                return;
-            }
-            interface->stats.session_ipv4_rx++;
-            session->stats.access_ipv4_rx++;
-            if(!session->access_ipv4_rx_first_seq) {
-                session->access_ipv4_rx_first_seq = bbl->flow_seq;
-                interface->ctx->stats.session_traffic_flows_verified++;
-            } else {
-                if(session->access_ipv4_rx_last_seq +1 != bbl->flow_seq) {
-                    interface->stats.session_ipv4_loss++;
-                    session->stats.access_ipv4_loss++;
-                    LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
-                        session->key.outer_vlan_id, session->key.inner_vlan_id,
-                        bbl->flow_id, bbl->flow_seq, session->access_ipv4_rx_last_seq);
-                }
-            }
-            session->access_ipv4_rx_last_seq = bbl->flow_seq;
-
-        } else if(bbl->type == BBL_TYPE_MULTICAST) {
-            /* Multicast receive handler */
-            for(i=0; i < IGMP_MAX_GROUPS; i++) {
-                group = &session->igmp_groups[i];
-                if(ipv4->dst == group->group) {
-                    if(group->state >= IGMP_GROUP_ACTIVE) {
-                        interface->stats.mc_rx++;
-                        session->stats.mc_rx++;
-                        group->packets++;
-                        if(!group->first_mc_rx_time.tv_sec) {
-                            group->first_mc_rx_time.tv_sec = eth->rx_sec;
-                            group->first_mc_rx_time.tv_nsec = eth->rx_nsec;
-                        } else if(bbl->flow_seq > session->mc_rx_last_seq + 1) {
-                            interface->stats.mc_loss++;
-                            session->stats.mc_loss++;
-                            group->loss++;
-                            LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
-                                session->key.outer_vlan_id, session->key.inner_vlan_id,
-                                bbl->flow_id, bbl->flow_seq, session->mc_rx_last_seq);
-                        }
-                        session->mc_rx_last_seq = bbl->flow_seq;
-                    } else {
-                        interface->stats.mc_rx++;
-                        session->stats.mc_rx++;
-                        group->packets++;
-                        group->last_mc_rx_time.tv_sec = eth->rx_sec;
-                        group->last_mc_rx_time.tv_nsec = eth->rx_nsec;
-                        if(session->zapping_joined_group &&
-                            session->zapping_leaved_group == group) {
-                            if(session->zapping_joined_group->first_mc_rx_time.tv_sec) {
-                                session->stats.mc_old_rx_after_first_new++;
-                            }
-                        }
-                    }
-                    break;
-                }
-            }
-        }
-    } else {
-        /* Multicast receive handler */
-        for(i=0; i < IGMP_MAX_GROUPS; i++) {
-            group = &session->igmp_groups[i];
-            if(ipv4->dst == group->group) {
-                if(group->state >= IGMP_GROUP_ACTIVE) {
-                    interface->stats.mc_rx++;
-                    session->stats.mc_rx++;
-                    group->packets++;
-                    if(!group->first_mc_rx_time.tv_sec) {
-                        group->first_mc_rx_time.tv_sec = eth->rx_sec;
-                        group->first_mc_rx_time.tv_nsec = eth->rx_nsec;
-                    }
-                } else {
-                    interface->stats.mc_rx++;
-                    session->stats.mc_rx++;
-                    group->packets++;
-                    group->last_mc_rx_time.tv_sec = eth->rx_sec;
-                    group->last_mc_rx_time.tv_nsec = eth->rx_nsec;
-                    if(session->zapping_joined_group &&
-                       session->zapping_leaved_group == group) {
-                        if(session->zapping_joined_group->first_mc_rx_time.tv_sec) {
-                            session->stats.mc_old_rx_after_first_new++;
-                        }
-                    }
-                }
-            }
-        }
+    if(bbl && bbl->type == BBL_TYPE_UNICAST_SESSION) {
+        bbl_rx_session_traffic_access(eth, bbl, interface, NULL, session);
+    } else if(!bbl || bbl->type == BBL_TYPE_MULTICAST) {
+        bbl_rx_multicast(eth, bbl, ipv4->dst, interface, session);
     }
 }
 
 void
-bbl_rx_ipv6(bbl_ethernet_header_t *eth __attribute__((unused)), bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *session) {
+bbl_rx_ipv6(bbl_ethernet_header_t *eth, bbl_ipv6_t *ipv6, bbl_interface_s *interface, bbl_session_s *session) {
     switch(ipv6->protocol) {
         case IPV6_NEXT_HEADER_ICMPV6:
             bbl_rx_icmpv6(ipv6, interface, session);
             interface->stats.icmpv6_rx++;
             break;
         case IPV6_NEXT_HEADER_UDP:
-            bbl_rx_udp(ipv6, interface, session);
+            bbl_rx_udp(eth, ipv6, interface, session);
             break;
         default:
             break;
@@ -1026,20 +1001,20 @@ bbl_rx_pap(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s
                 bbl_session_update_state(ctx, session, BBL_PPP_NETWORK);
                 if(ctx->config.ipcp_enable) {
                     session->ipcp_state = BBL_PPP_INIT;
-                    session->ipcp_request_code = PPP_CODE_CONF_REQUEST;
+                    session->cold->ipcp_request_code = PPP_CODE_CONF_REQUEST;
                     session->send_requests |= BBL_SEND_IPCP_REQUEST;
                 }
                 if(ctx->config.ip6cp_enable) {
                     session->ip6cp_state = BBL_PPP_INIT;
-                    session->ip6cp_request_code = PPP_CODE_CONF_REQUEST;
+                    session->cold->ip6cp_request_code = PPP_CODE_CONF_REQUEST;
                     session->send_requests |= BBL_SEND_IP6CP_REQUEST;
                 }
                 bbl_session_tx_qnode_insert(session);
                 break;
             default:
                 bbl_session_update_state(ctx, session, BBL_PPP_TERMINATING);
-                session->lcp_request_code = PPP_CODE_TERM_REQUEST;
-                session->lcp_options_len = 0;
+                session->cold->lcp_request_code = PPP_CODE_TERM_REQUEST;
+                session->cold->lcp_options_len = 0;
                 session->send_requests |= BBL_SEND_LCP_REQUEST;
                 bbl_session_tx_qnode_insert(session);
                 break;
@@ -1064,17 +1039,17 @@ bbl_rx_chap(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_
             case CHAP_CODE_CHALLENGE:
                 if(chap->challenge_len != CHALLENGE_LEN) {
                     bbl_session_update_state(ctx, session, BBL_PPP_TERMINATING);
-                    session->lcp_request_code = PPP_CODE_TERM_REQUEST;
-                    session->lcp_options_len = 0;
+                    session->cold->lcp_request_code = PPP_CODE_TERM_REQUEST;
+                    session->cold->lcp_options_len = 0;
                     session->send_requests |= BBL_SEND_LCP_REQUEST;
                     bbl_session_tx_qnode_insert(session);
                 } else {
                     MD5_Init(&md5_ctx);
                     MD5_Update(&md5_ctx, &chap->identifier, 1);
-                    MD5_Update(&md5_ctx, session->password, strlen(session->password));
+                    MD5_Update(&md5_ctx, session->cold->password, strlen(session->cold->password));
                     MD5_Update(&md5_ctx, chap->challenge, chap->challenge_len);
-                    MD5_Final(session->chap_response, &md5_ctx);
-                    session->chap_identifier = chap->identifier;
+                    MD5_Final(session->cold->chap_response, &md5_ctx);
+                    session->cold->chap_identifier = chap->identifier;
                     session->send_requests |= BBL_SEND_CHAP_RESPONSE;
                     bbl_session_tx_qnode_insert(session);
                 }
@@ -1090,20 +1065,20 @@ bbl_rx_chap(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_
                 bbl_session_update_state(ctx, session, BBL_PPP_NETWORK);
                 if(ctx->config.ipcp_enable) {
                     session->ipcp_state = BBL_PPP_INIT;
-                    session->ipcp_request_code = PPP_CODE_CONF_REQUEST;
+                    session->cold->ipcp_request_code = PPP_CODE_CONF_REQUEST;
                     session->send_requests |= BBL_SEND_IPCP_REQUEST;
                 }
                 if(ctx->config.ip6cp_enable) {
                     session->ip6cp_state = BBL_PPP_INIT;
-                    session->ip6cp_request_code = PPP_CODE_CONF_REQUEST;
+                    session->cold->ip6cp_request_code = PPP_CODE_CONF_REQUEST;
                     session->send_requests |= BBL_SEND_IP6CP_REQUEST;
                 }
                 bbl_session_tx_qnode_insert(session);
                 break;
             default:
                 bbl_session_update_state(ctx, session, BBL_PPP_TERMINATING);
-                session->lcp_request_code = PPP_CODE_TERM_REQUEST;
-                session->lcp_options_len = 0;
+                session->cold->lcp_request_code = PPP_CODE_TERM_REQUEST;
+                session->cold->lcp_options_len = 0;
                 session->send_requests |= BBL_SEND_LCP_REQUEST;
                 bbl_session_tx_qnode_insert(session);
                 break;
@@ -1134,7 +1109,6 @@ bbl_rx_established(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_s
 
     bool ipcp = false;
     bool ip6cp = false;
-    uint16_t tx_interval;
 
     if(ctx->config.ipcp_enable == false || session->ipcp_state == BBL_PPP_OPENED) ipcp = true;
     if(ctx->config.ip6cp_enable == false || session->ip6cp_state == BBL_PPP_OPENED) ip6cp = true;
@@ -1153,33 +1127,21 @@ bbl_rx_established(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_s
             }
             if(ctx->config.lcp_keepalive_interval) {
                 /* Start LCP echo request / keep alive */
-                timer_add_periodic(&ctx->timer_root, &session->timer_lcp_echo, "LCP ECHO", ctx->config.lcp_keepalive_interval, 0, session, bbl_lcp_echo);
+                timer_add_periodic(&ctx->timer_root, &session->cold->timer_lcp_echo, "LCP ECHO", ctx->config.lcp_keepalive_interval, 0, session, bbl_lcp_echo);
             }
             if(session->l2tp == false && ctx->config.igmp_group && ctx->config.igmp_autostart && ctx->config.igmp_start_delay) {
                 /* Start IGMP */
-                timer_add(&ctx->timer_root, &session->timer_igmp, "IGMP", ctx->config.igmp_start_delay, 0, session, bbl_igmp_initial_join);
+                timer_add(&ctx->timer_root, &session->cold->timer_igmp, "IGMP", ctx->config.igmp_start_delay, 0, session, bbl_igmp_initial_join);
             }
             if(ctx->config.pppoe_session_time) {
                 /* Start Session Timer */
-                timer_add(&ctx->timer_root, &session->timer_session, "Session", ctx->config.pppoe_session_time, 0, session, bbl_session_timeout);
+                timer_add(&ctx->timer_root, &session->cold->timer_session, "Session", ctx->config.pppoe_session_time, 0, session, bbl_session_timeout);
             }
             if(ctx->config.session_traffic_ipv4_pps && session->ip_address &&
                ctx->op.network_if && ctx->op.network_if->ip) {
                 /* Start IPv4 Session Traffic */
-                if(bbl_add_session_packets_ipv4(ctx, session)) {
-                    if(ctx->config.session_traffic_ipv4_pps > 1) {
-                        tx_interval = 1000 / ctx->config.session_traffic_ipv4_pps;
-                        if(tx_interval < ctx->config.tx_interval) {
-                            /* It is not possible to send faster than TX interval. */
-                            tx_interval = ctx->config.tx_interval;
-                        }
-                        timer_add_periodic(&ctx->timer_root, &session->timer_session_traffic_ipv4, "Session Traffic IPv4",
-                                        0, tx_interval * MSEC, session, bbl_session_traffic_ipv4);
-                    } else {
-                        timer_add_periodic(&ctx->timer_root, &session->timer_session_traffic_ipv4, "Session Traffic IPv4",
-                                        1, 0, session, bbl_session_traffic_ipv4);
-                    }
-                } else {
+                if(!bbl_add_session_packets_ipv4(ctx, session) ||
+                   !bbl_session_traffic_start(ctx, session, BBL_SUB_TYPE_IPV4)) {
                     LOG(ERROR, "Traffic (Q-in-Q %u:%u) failed to create IPv4 session traffic\n",
                         session->key.outer_vlan_id, session->key.inner_vlan_id);
                 }
@@ -1192,7 +1154,6 @@ void
 bbl_rx_established_ipoe(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s *session) {
 
     bbl_ctx_s *ctx = interface->ctx;
-    uint16_t tx_interval;
 
     if(session->session_state != BBL_ESTABLISHED) {
         if(ctx->sessions_established_max < ctx->sessions) {
@@ -1207,25 +1168,13 @@ bbl_rx_established_ipoe(bbl_ethernet_header_t *eth, bbl_interface_s *interface,
         }
         if(ctx->config.igmp_group && ctx->config.igmp_autostart && ctx->config.igmp_start_delay) {
             /* Start IGMP */
-            timer_add(&ctx->timer_root, &session->timer_igmp, "IGMP", ctx->config.igmp_start_delay, 0, session, bbl_igmp_initial_join);
+            timer_add(&ctx->timer_root, &session->cold->timer_igmp, "IGMP", ctx->config.igmp_start_delay, 0, session, bbl_igmp_initial_join);
         }
         if(ctx->config.session_traffic_ipv4_pps && session->ip_address &&
             ctx->op.network_if && ctx->op.network_if->ip) {
             /* Start IPv4 Session Traffic */
-            if(bbl_add_session_packets_ipv4(ctx, session)) {
-                if(ctx->config.session_traffic_ipv4_pps > 1) {
-                    tx_interval = 1000 / ctx->config.session_traffic_ipv4_pps;
-                    if(tx_interval < ctx->config.tx_interval) {
-                        /* It is not possible to send faster than TX interval. */
-                        tx_interval = ctx->config.tx_interval;
-                    }
-                    timer_add_periodic(&ctx->timer_root, &session->timer_session_traffic_ipv4, "Session Traffic IPv4",
-                                    0, tx_interval * MSEC, session, bbl_session_traffic_ipv4);
-                } else {
-                    timer_add_periodic(&ctx->timer_root, &session->timer_session_traffic_ipv4, "Session Traffic IPv4",
-                                    1, 0, session, bbl_session_traffic_ipv4);
-                }
-            } else {
+            if(!bbl_add_session_packets_ipv4(ctx, session) ||
+               !bbl_session_traffic_start(ctx, session, BBL_SUB_TYPE_IPV4)) {
                 LOG(ERROR, "Traffic (Q-in-Q %u:%u) failed to create IPv4 session traffic\n",
                     session->key.outer_vlan_id, session->key.inner_vlan_id);
             }
@@ -1246,10 +1195,10 @@ bbl_rx_ip6cp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session
 
     if(!ctx->config.ip6cp_enable) {
         /* Protocol Reject */
-        *(uint16_t*)session->lcp_options = htobe16(PROTOCOL_IP6CP);
-        session->lcp_options_len = 2;
-        session->lcp_peer_identifier = ++session->lcp_identifier;
-        session->lcp_response_code = PPP_CODE_PROT_REJECT;
+        *(uint16_t*)session->cold->lcp_options = htobe16(PROTOCOL_IP6CP);
+        session->cold->lcp_options_len = 2;
+        session->cold->lcp_peer_identifier = ++session->cold->lcp_identifier;
+        session->cold->lcp_response_code = PPP_CODE_PROT_REJECT;
         session->send_requests |= BBL_SEND_LCP_RESPONSE;
         bbl_session_tx_qnode_insert(session);
         return;
@@ -1260,12 +1209,16 @@ bbl_rx_ip6cp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session
 
     switch(ip6cp->code) {
         case PPP_CODE_CONF_REQUEST:
+            if(decode_ppp_ip6cp_options(ip6cp) != PROTOCOL_SUCCESS) {
+                interface->stats.packets_rx_drop_decode_error++;
+                return;
+            }
             if(ip6cp->ipv6_identifier) {
-                session->ip6cp_ipv6_peer_identifier = ip6cp->ipv6_identifier;
+                session->cold->ip6cp_ipv6_peer_identifier = ip6cp->ipv6_identifier;
             }
             if(ip6cp->options_len <= PPP_OPTIONS_BUFFER) {
-                memcpy(session->ip6cp_options, ip6cp->options, ip6cp->options_len);
-                session->ip6cp_options_len = ip6cp->options_len;
+                memcpy(session->cold->ip6cp_options, ip6cp->options, ip6cp->options_len);
+                session->cold->ip6cp_options_len = ip6cp->options_len;
             } else {
                 ip6cp->options_len = 0;
             }
@@ -1276,31 +1229,35 @@ bbl_rx_ip6cp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session
                 case BBL_PPP_LOCAL_ACK:
                     session->ip6cp_state = BBL_PPP_OPENED;
                     bbl_rx_established(eth, interface, session);
-                    session->link_local_ipv6_address[0] = 0xfe;
-                    session->link_local_ipv6_address[0] = 0x80;
-                    *(uint64_t*)&session->link_local_ipv6_address[8] = session->ip6cp_ipv6_identifier;
+                    session->cold->link_local_ipv6_address[0] = 0xfe;
+                    session->cold->link_local_ipv6_address[0] = 0x80;
+                    *(uint64_t*)&session->cold->link_local_ipv6_address[8] = session->cold->ip6cp_ipv6_identifier;
                     session->send_requests |= BBL_SEND_ICMPV6_RS;
                     bbl_session_tx_qnode_insert(session);
                     break;
                 default:
                     break;
             }
-            session->ip6cp_peer_identifier = ip6cp->identifier;
-            session->ip6cp_response_code = PPP_CODE_CONF_ACK;
+            session->cold->ip6cp_peer_identifier = ip6cp->identifier;
+            session->cold->ip6cp_response_code = PPP_CODE_CONF_ACK;
             session->send_requests |= BBL_SEND_IP6CP_RESPONSE;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_CONF_NAK:
-            session->ip6cp_retries = 0;
+            if(decode_ppp_ip6cp_options(ip6cp) != PROTOCOL_SUCCESS) {
+                interface->stats.packets_rx_drop_decode_error++;
+                return;
+            }
+            session->cold->ip6cp_retries = 0;
             if(ip6cp->ipv6_identifier) {
-                session->ip6cp_ipv6_identifier = ip6cp->ipv6_identifier;
+                session->cold->ip6cp_ipv6_identifier = ip6cp->ipv6_identifier;
             }
             session->send_requests |= BBL_SEND_IP6CP_REQUEST;
-            session->ipcp_request_code = PPP_CODE_CONF_REQUEST;
+            session->cold->ipcp_request_code = PPP_CODE_CONF_REQUEST;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_CONF_ACK:
-            session->ip6cp_retries = 0;
+            session->cold->ip6cp_retries = 0;
             switch(session->ip6cp_state) {
                 case BBL_PPP_INIT:
                     session->ip6cp_state = BBL_PPP_LOCAL_ACK;
@@ -1308,9 +1265,9 @@ bbl_rx_ip6cp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session
                 case BBL_PPP_PEER_ACK:
                     session->ip6cp_state = BBL_PPP_OPENED;
                     bbl_rx_established(eth, interface, session);
-                    session->link_local_ipv6_address[0] = 0xfe;
-                    session->link_local_ipv6_address[1] = 0x80;
-                    *(uint64_t*)&session->link_local_ipv6_address[8] = session->ip6cp_ipv6_identifier;
+                    session->cold->link_local_ipv6_address[0] = 0xfe;
+                    session->cold->link_local_ipv6_address[1] = 0x80;
+                    *(uint64_t*)&session->cold->link_local_ipv6_address[8] = session->cold->ip6cp_ipv6_identifier;
                     session->send_requests |= BBL_SEND_ICMPV6_RS;
                     bbl_session_tx_qnode_insert(session);
                     break;
@@ -1319,13 +1276,13 @@ bbl_rx_ip6cp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session
             }
             break;
         case PPP_CODE_TERM_REQUEST:
-            session->ip6cp_peer_identifier = ip6cp->identifier;
-            session->ip6cp_response_code = PPP_CODE_TERM_ACK;
+            session->cold->ip6cp_peer_identifier = ip6cp->identifier;
+            session->cold->ip6cp_response_code = PPP_CODE_TERM_ACK;
             session->send_requests |= BBL_SEND_IP6CP_RESPONSE;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_TERM_ACK:
-            session->ip6cp_retries = 0;
+            session->cold->ip6cp_retries = 0;
             session->ip6cp_state = BBL_PPP_CLOSED;
             break;
         default:
@@ -1346,10 +1303,10 @@ bbl_rx_ipcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_
 
     if(!ctx->config.ipcp_enable) {
         /* Protocol Reject */
-        *(uint16_t*)session->lcp_options = htobe16(PROTOCOL_IPCP);
-        session->lcp_options_len = 2;
-        session->lcp_peer_identifier = ++session->lcp_identifier;
-        session->lcp_response_code = PPP_CODE_PROT_REJECT;
+        *(uint16_t*)session->cold->lcp_options = htobe16(PROTOCOL_IPCP);
+        session->cold->lcp_options_len = 2;
+        session->cold->lcp_peer_identifier = ++session->cold->lcp_identifier;
+        session->cold->lcp_response_code = PPP_CODE_PROT_REJECT;
         session->send_requests |= BBL_SEND_LCP_RESPONSE;
         bbl_session_tx_qnode_insert(session);
         return;
@@ -1360,12 +1317,16 @@ bbl_rx_ipcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_
 
     switch(ipcp->code) {
         case PPP_CODE_CONF_REQUEST:
+            if(decode_ppp_ipcp_options(ipcp) != PROTOCOL_SUCCESS) {
+                interface->stats.packets_rx_drop_decode_error++;
+                return;
+            }
             if(ipcp->address) {
                 session->peer_ip_address = ipcp->address;
             }
             if(ipcp->options_len <= PPP_OPTIONS_BUFFER) {
-                memcpy(session->ipcp_options, ipcp->options, ipcp->options_len);
-                session->ipcp_options_len = ipcp->options_len;
+                memcpy(session->cold->ipcp_options, ipcp->options, ipcp->options_len);
+                session->cold->ipcp_options_len = ipcp->options_len;
             } else {
                 ipcp->options_len = 0;
             }
@@ -1383,28 +1344,32 @@ bbl_rx_ipcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_
                 default:
                     break;
             }
-            session->ipcp_peer_identifier = ipcp->identifier;
-            session->ipcp_response_code = PPP_CODE_CONF_ACK;
+            session->cold->ipcp_peer_identifier = ipcp->identifier;
+            session->cold->ipcp_response_code = PPP_CODE_CONF_ACK;
             session->send_requests |= BBL_SEND_IPCP_RESPONSE;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_CONF_NAK:
-            session->ipcp_retries = 0;
+            if(decode_ppp_ipcp_options(ipcp) != PROTOCOL_SUCCESS) {
+                interface->stats.packets_rx_drop_decode_error++;
+                return;
+            }
+            session->cold->ipcp_retries = 0;
             if(ipcp->address) {
                 session->ip_address = ipcp->address;
             }
             if(ipcp->dns1) {
-                session->dns1 = ipcp->dns1;
+                session->cold->dns1 = ipcp->dns1;
             }
             if(ipcp->dns2) {
-                session->dns2 = ipcp->dns2;
+                session->cold->dns2 = ipcp->dns2;
             }
             session->send_requests |= BBL_SEND_IPCP_REQUEST;
-            session->ipcp_request_code = PPP_CODE_CONF_REQUEST;
+            session->cold->ipcp_request_code = PPP_CODE_CONF_REQUEST;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_CONF_ACK:
-            session->ipcp_retries = 0;
+            session->cold->ipcp_retries = 0;
             switch(session->ipcp_state) {
                 case BBL_PPP_INIT:
                     session->ipcp_state = BBL_PPP_LOCAL_ACK;
@@ -1421,13 +1386,13 @@ bbl_rx_ipcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_
             }
             break;
         case PPP_CODE_TERM_REQUEST:
-            session->ipcp_peer_identifier = ipcp->identifier;
-            session->ipcp_response_code = PPP_CODE_TERM_ACK;
+            session->cold->ipcp_peer_identifier = ipcp->identifier;
+            session->cold->ipcp_response_code = PPP_CODE_TERM_ACK;
             session->send_requests |= BBL_SEND_IPCP_RESPONSE;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_TERM_ACK:
-            session->ipcp_retries = 0;
+            session->cold->ipcp_retries = 0;
             session->ipcp_state = BBL_PPP_CLOSED;
             break;
         default:
@@ -1446,44 +1411,50 @@ bbl_rx_lcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s
 
     switch(lcp->code) {
         case PPP_CODE_CONF_REQUEST:
-            session->auth_protocol = lcp->auth;
-            if(session->access_config->authentication_protocol) {
-                if(session->access_config->authentication_protocol != lcp->auth) {
-                    lcp->auth = session->access_config->authentication_protocol;
-                    session->auth_protocol = 0;
+            if(decode_ppp_lcp_options(lcp) != PROTOCOL_SUCCESS) {
+                interface->stats.packets_rx_drop_decode_error++;
+                return;
+            }
+            session->cold->auth_protocol = lcp->auth;
+            if(session->cold->access_config->authentication_protocol) {
+                if(session->cold->access_config->authentication_protocol != lcp->auth) {
+                    lcp->auth = session->cold->access_config->authentication_protocol;
+                    session->cold->auth_protocol = 0;
                 }
             } else {
                 lcp->auth = PROTOCOL_PAP;
             }
-            if(!(session->auth_protocol == PROTOCOL_CHAP || session->auth_protocol == PROTOCOL_PAP)) {
+            if(!(session->cold->auth_protocol == PROTOCOL_CHAP || session->cold->auth_protocol == PROTOCOL_PAP)) {
                 /* Reject authentication protocol */
                 if(lcp->auth == PROTOCOL_CHAP) {
-                    session->lcp_options[0] = 3;
-                    session->lcp_options[1] = 5;
-                    *(uint16_t*)&session->lcp_options[2] = htobe16(PROTOCOL_CHAP);
-                    session->lcp_options[4] = 5;
-                    session->lcp_options_len = 5;
+                    session->cold->lcp_options[0] = 3;
+                    session->cold->lcp_options[1] = 5;
+                    *(uint16_t*)&session->cold->lcp_options[2] = htobe16(PROTOCOL_CHAP);
+                    session->cold->lcp_options[4] = 5;
+                    session->cold->lcp_options_len = 5;
                 } else {
-                    session->lcp_options[0] = 3;
-                    session->lcp_options[1] = 4;
-                    *(uint16_t*)&session->lcp_options[2] = htobe16(PROTOCOL_PAP);
-                    session->lcp_options_len = 4;
+                    session->cold->lcp_options[0] = 3;
+                    session->cold->lcp_options[1] = 4;
+                    *(uint16_t*)&session->cold->lcp_options[2] = htobe16(PROTOCOL_PAP);
+                    session->cold->lcp_options_len = 4;
                 }
-                session->lcp_peer_identifier = lcp->identifier;
-                session->lcp_response_code = PPP_CODE_CONF_NAK;
+                session->cold->lcp_peer_identifier = lcp->identifier;
+                session->cold->lcp_response_code = PPP_CODE_CONF_NAK;
                 session->send_requests |= BBL_SEND_LCP_RESPONSE;
                 bbl_session_tx_qnode_insert(session);
                 return;
             }
-            if(lcp->mru) {
-                session->mru = lcp->mru;
+            if(lcp->mru && lcp->mru != session->cold->mru) {
+                /* The MRU is also sent in the cached Conf-Request. */
+                session->cold->mru = lcp->mru;
+                bbl_tx_template_reset(session);
             }
             if(lcp->magic) {
-                session->peer_magic_number = lcp->magic;
+                session->cold->peer_magic_number = lcp->magic;
             }
             if(lcp->options_len <= PPP_OPTIONS_BUFFER) {
-                memcpy(session->lcp_options, lcp->options, lcp->options_len);
-                session->lcp_options_len = lcp->options_len;
+                memcpy(session->cold->lcp_options, lcp->options, lcp->options_len);
+                session->cold->lcp_options_len = lcp->options_len;
             } else {
                 lcp->options_len = 0;
             }
@@ -1494,7 +1465,7 @@ bbl_rx_lcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s
                 case BBL_PPP_LOCAL_ACK:
                     session->lcp_state = BBL_PPP_OPENED;
                     bbl_session_update_state(ctx, session, BBL_PPP_AUTH);
-                    if(session->auth_protocol == PROTOCOL_PAP) {
+                    if(session->cold->auth_protocol == PROTOCOL_PAP) {
                         session->send_requests |= BBL_SEND_PAP_REQUEST;
                         bbl_session_tx_qnode_insert(session);
                     }
@@ -1502,13 +1473,13 @@ bbl_rx_lcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s
                 default:
                     break;
             }
-            session->lcp_peer_identifier = lcp->identifier;
-            session->lcp_response_code = PPP_CODE_CONF_ACK;
+            session->cold->lcp_peer_identifier = lcp->identifier;
+            session->cold->lcp_response_code = PPP_CODE_CONF_ACK;
             session->send_requests |= BBL_SEND_LCP_RESPONSE;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_CONF_ACK:
-            session->lcp_retries = 0;
+            session->cold->lcp_retries = 0;
             switch(session->lcp_state) {
                 case BBL_PPP_INIT:
                     session->lcp_state = BBL_PPP_LOCAL_ACK;
@@ -1516,7 +1487,7 @@ bbl_rx_lcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s
                 case BBL_PPP_PEER_ACK:
                     session->lcp_state = BBL_PPP_OPENED;
                     bbl_session_update_state(ctx, session, BBL_PPP_AUTH);
-                    if(session->auth_protocol == PROTOCOL_PAP) {
+                    if(session->cold->auth_protocol == PROTOCOL_PAP) {
                         session->send_requests |= BBL_SEND_PAP_REQUEST;
                         bbl_session_tx_qnode_insert(session);
                     }
@@ -1526,42 +1497,45 @@ bbl_rx_lcp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s
             }
             break;
         case PPP_CODE_CONF_NAK:
-            session->lcp_retries = 0;
+            if(decode_ppp_lcp_options(lcp) != PROTOCOL_SUCCESS) {
+                interface->stats.packets_rx_drop_decode_error++;
+                return;
+            }
+            session->cold->lcp_retries = 0;
             if(lcp->mru) {
-                session->mru = lcp->mru;
+                session->cold->mru = lcp->mru;
             }
             if(lcp->magic) {
-                session->magic_number = lcp->magic;
+                session->cold->magic_number = lcp->magic;
             }
+            bbl_tx_template_reset(session);
             session->send_requests |= BBL_SEND_LCP_REQUEST;
-            session->lcp_request_code = PPP_CODE_CONF_REQUEST;
+            session->cold->lcp_request_code = PPP_CODE_CONF_REQUEST;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_ECHO_REQUEST:
-            session->lcp_peer_identifier = lcp->identifier;
-            session->lcp_response_code = PPP_CODE_ECHO_REPLY;
-            session->lcp_options_len = 0;
-            session->send_requests |= BBL_SEND_LCP_RESPONSE;
+            session->cold->lcp_echo_peer_identifier = lcp->identifier;
+            session->send_requests |= BBL_SEND_LCP_ECHO_REPLY;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_ECHO_REPLY:
-            session->lcp_retries = 0;
+            session->cold->lcp_retries = 0;
             break;
         case PPP_CODE_TERM_REQUEST:
             if(session->session_state != BBL_PPP_TERMINATING) {
-                session->lcp_request_code = PPP_CODE_TERM_REQUEST;
+                session->cold->lcp_request_code = PPP_CODE_TERM_REQUEST;
                 session->send_requests |= BBL_SEND_LCP_REQUEST;
             }
             bbl_session_update_state(ctx, session, BBL_PPP_TERMINATING);
-            session->lcp_peer_identifier = lcp->identifier;
-            session->lcp_response_code = PPP_CODE_TERM_ACK;
-            session->lcp_options_len = 0;
+            session->cold->lcp_peer_identifier = lcp->identifier;
+            session->cold->lcp_response_code = PPP_CODE_TERM_ACK;
+            session->cold->lcp_options_len = 0;
             session->send_requests = BBL_SEND_LCP_RESPONSE;
             bbl_session_tx_qnode_insert(session);
             break;
         case PPP_CODE_TERM_ACK:
             bbl_session_update_state(ctx, session, BBL_TERMINATING);
-            session->lcp_retries = 0;
+            session->cold->lcp_retries = 0;
             session->send_requests = BBL_SEND_DISCOVERY;
             bbl_session_tx_qnode_insert(session);
             break;
@@ -1620,36 +1594,37 @@ bbl_rx_discovery(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_ses
             if(session->session_state == BBL_PPPOE_INIT) {
                 /* Store server MAC address */
                 memcpy(session->server_mac, eth->src, ETH_ADDR_LEN);
+                bbl_tx_template_reset(session);
                 if(pppoed->ac_cookie_len) {
                     /* Store AC cookie */
-                    if(session->pppoe_ac_cookie) free(session->pppoe_ac_cookie);
-                    session->pppoe_ac_cookie = malloc(pppoed->ac_cookie_len);
-                    session->pppoe_ac_cookie_len = pppoed->ac_cookie_len;
-                    memcpy(session->pppoe_ac_cookie, pppoed->ac_cookie, pppoed->ac_cookie_len);
+                    if(session->cold->pppoe_ac_cookie) free(session->cold->pppoe_ac_cookie);
+                    session->cold->pppoe_ac_cookie = malloc(pppoed->ac_cookie_len);
+                    session->cold->pppoe_ac_cookie_len = pppoed->ac_cookie_len;
+                    memcpy(session->cold->pppoe_ac_cookie, pppoed->ac_cookie, pppoed->ac_cookie_len);
                 }
                 if(pppoed->service_name_len) {
-                    if(session->pppoe_service_name_len) {
+                    if(session->cold->pppoe_service_name_len) {
                         /* Compare service name */
-                        if(pppoed->service_name_len != session->pppoe_service_name_len || 
-                           memcmp(pppoed->service_name, session->pppoe_service_name, session->pppoe_service_name_len) != 0) {
+                        if(pppoed->service_name_len != session->cold->pppoe_service_name_len || 
+                           memcmp(pppoed->service_name, session->cold->pppoe_service_name, session->cold->pppoe_service_name_len) != 0) {
                             LOG(PPPOE, "PPPoE Error (Q-in-Q %u:%u) Wrong service name in PADO\n",
                                 session->key.outer_vlan_id, session->key.inner_vlan_id);
                             return;
                         }
                     } else {
                         /* Store service name */
-                        session->pppoe_service_name = malloc(pppoed->service_name_len);
-                        session->pppoe_service_name_len = pppoed->service_name_len;
-                        memcpy(session->pppoe_service_name, pppoed->service_name, pppoed->service_name_len);
+                        session->cold->pppoe_service_name = malloc(pppoed->service_name_len);
+                        session->cold->pppoe_service_name_len = pppoed->service_name_len;
+                        memcpy(session->cold->pppoe_service_name, pppoed->service_name, pppoed->service_name_len);
                     }
                 } else {
                     LOG(PPPOE, "PPPoE Error (Q-in-Q %u:%u) Missing service name in PADO\n",
                         session->key.outer_vlan_id, session->key.inner_vlan_id);
                     return;
                 }
-                if(session->pppoe_host_uniq) {
+                if(session->cold->pppoe_host_uniq) {
                     if(pppoed->host_uniq_len != sizeof(uint64_t) || 
-                       *(uint64_t*)pppoed->host_uniq != session->pppoe_host_uniq) {
+                       *(uint64_t*)pppoed->host_uniq != session->cold->pppoe_host_uniq) {
                         LOG(PPPOE, "PPPoE Error (Q-in-Q %u:%u) Wrong host-uniq in PADO\n",
                             session->key.outer_vlan_id, session->key.inner_vlan_id);
                         return;
@@ -1664,24 +1639,25 @@ bbl_rx_discovery(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_ses
             interface->stats.pads_rx++;
             if(session->session_state == BBL_PPPOE_REQUEST) {
                 if(pppoed->session_id) {
-                    if(session->pppoe_host_uniq) {
+                    if(session->cold->pppoe_host_uniq) {
                         if(pppoed->host_uniq_len != sizeof(uint64_t) || 
-                           *(uint64_t*)pppoed->host_uniq != session->pppoe_host_uniq) {
+                           *(uint64_t*)pppoed->host_uniq != session->cold->pppoe_host_uniq) {
                             LOG(PPPOE, "PPPoE Error (Q-in-Q %u:%u) Wrong host-uniq in PADS\n",
                                 session->key.outer_vlan_id, session->key.inner_vlan_id);
                             return;
                         }
                     }
-                    if(pppoed->service_name_len != session->pppoe_service_name_len || 
-                        memcmp(pppoed->service_name, session->pppoe_service_name, session->pppoe_service_name_len) != 0) {
+                    if(pppoed->service_name_len != session->cold->pppoe_service_name_len || 
+                        memcmp(pppoed->service_name, session->cold->pppoe_service_name, session->cold->pppoe_service_name_len) != 0) {
                         LOG(PPPOE, "PPPoE Error (Q-in-Q %u:%u) Wrong service name in PADS\n",
                             session->key.outer_vlan_id, session->key.inner_vlan_id);
                         return;
                     }
                     session->pppoe_session_id = pppoed->session_id;
+                    bbl_tx_template_reset(session);
                     bbl_session_update_state(ctx, session, BBL_PPP_LINK);
                     session->send_requests = BBL_SEND_LCP_REQUEST;
-                    session->lcp_request_code = PPP_CODE_CONF_REQUEST;
+                    session->cold->lcp_request_code = PPP_CODE_CONF_REQUEST;
                     session->lcp_state = BBL_PPP_INIT;
                     bbl_session_tx_qnode_insert(session);
                 } else {
@@ -1708,6 +1684,7 @@ bbl_rx_arp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s
     if(arp->sender_ip == session->peer_ip_address) {
         if(!session->arp_resolved) {
             memcpy(session->server_mac, arp->sender, ETH_ADDR_LEN);
+            bbl_tx_template_reset(session);
         }
         if(arp->code == ARP_REQUEST) {
             session->send_requests |= BBL_SEND_ARP_REPLY;
@@ -1723,17 +1700,9 @@ bbl_rx_arp(bbl_ethernet_header_t *eth, bbl_interface_s *interface, bbl_session_s
 
 void
 bbl_rx_handler_access(bbl_ethernet_header_t *eth, bbl_interface_s *interface) {
-    bbl_ctx_s *ctx;
     bbl_session_s *session;
-    void **search;
-    session_key_t key;
-    ctx = interface->ctx;
-    key.ifindex = interface->addr.sll_ifindex;
-    key.outer_vlan_id = eth->vlan_outer;
-    key.inner_vlan_id = eth->vlan_inner;
-    search = dict_search(ctx->session_dict, &key);
-    if(search) {
-        session = *search;
+    session = bbl_session_table_get(&interface->session_table, eth->vlan_outer, eth->vlan_inner);
+    if(session) {
         if(session->session_state != BBL_TERMINATED &&
            session->session_state != BBL_IDLE) {
             switch (session->access_type) {
@@ -1772,6 +1741,8 @@ bbl_rx_handler_access(bbl_ethernet_header_t *eth, bbl_interface_s *interface) {
                     break;
             }
         }
+        /* Pass state changes to the data plane of the I/O threads. */
+        bbl_session_io_update(interface->ctx, session);
     }
 }
 
@@ -1781,7 +1752,11 @@ bbl_rx_network_arp(bbl_ethernet_header_t *eth, bbl_interface_s *interface) {
 
     bbl_arp_t *arp = (bbl_arp_t*)eth->next;
     if(arp->sender_ip == interface->gateway) {
-        interface->arp_resolved = true;
+        if(!interface->arp_resolved) {
+            interface->arp_resolved = true;
+            /* Downstream streams are ready now. */
+            bbl_session_io_update_all(interface->ctx);
+        }
         if(*(uint32_t*)interface->gateway_mac == 0) {
             memcpy(interface->gateway_mac, arp->sender, ETH_ADDR_LEN);
         }
@@ -1812,7 +1787,11 @@ bbl_rx_network_icmpv6(bbl_ethernet_header_t *eth, bbl_interface_s *interface) {
     icmpv6 = (bbl_icmpv6_t*)ipv6->next;
 
     if(memcmp(ipv6->src, interface->gateway6.address, ETH_ADDR_LEN) == 0) {
-        interface->icmpv6_nd_resolved = true;
+        if(!interface->icmpv6_nd_resolved) {
+            interface->icmpv6_nd_resolved = true;
+            /* Downstream streams are ready now. */
+            bbl_session_io_update_all(interface->ctx);
+        }
         if(*(uint32_t*)interface->gateway_mac == 0) {
             memcpy(interface->gateway_mac, eth->src, ETH_ADDR_LEN);
         }
@@ -1828,6 +1807,95 @@ bbl_rx_network_icmpv6(bbl_ethernet_header_t *eth, bbl_interface_s *interface) {
 
 
 
+/*
+ * Session traffic received on the network interface.
+ */
+static void
+bbl_rx_session_traffic_network(bbl_ethernet_header_t *eth, bbl_bbl_t *bbl, bbl_interface_s *interface,
+                               bbl_io_thread_s *io_thread) {
+    bbl_interface_stats_s *stats = BBL_IO_STATS(interface, io_thread);
+    bbl_session_s *session;
+    session_key_t key;
+
+    if(!io_thread && interface->io_data) {
+        return;
+    }
+    if(bbl_stream_rx(interface, io_thread, bbl)) {
+        return;
+    }
+    key.ifindex = bbl->ifindex;
+    key.outer_vlan_id = bbl->outer_vlan_id;
+    key.inner_vlan_id = bbl->inner_vlan_id;
+    session = bbl_session_get(interface->ctx, &key);
+    if(!session) {
+        return;
+    }
+    switch (bbl->sub_type) {
+        case BBL_SUB_TYPE_IPV4:
+            stats->session_ipv4_rx++;
+            session->stats.network_ipv4_rx++;
+            if(!session->network_ipv4_rx_first_seq) {
+                session->network_ipv4_rx_first_seq = bbl->flow_seq;
+                __atomic_fetch_add(&interface->ctx->stats.session_traffic_flows_verified, 1, __ATOMIC_RELAXED);
+            } else {
+                if(session->network_ipv4_rx_last_seq +1 != bbl->flow_seq) {
+                    stats->session_ipv4_loss++;
+                    session->stats.network_ipv4_loss++;
+                    if(!io_thread) {
+                        LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
+                            session->key.outer_vlan_id, session->key.inner_vlan_id,
+                            bbl->flow_id, bbl->flow_seq, session->network_ipv4_rx_last_seq);
+                    }
+                }
+            }
+            session->network_ipv4_rx_last_seq = bbl->flow_seq;
+            bbl_rx_session_latency(eth, bbl, interface, io_thread, session, BBL_SESSION_FLOW_ACCESS_IPV4);
+            break;
+        case BBL_SUB_TYPE_IPV6:
+            stats->session_ipv6_rx++;
+            session->stats.network_ipv6_rx++;
+            if(!session->network_ipv6_rx_first_seq) {
+                session->network_ipv6_rx_first_seq = bbl->flow_seq;
+                __atomic_fetch_add(&interface->ctx->stats.session_traffic_flows_verified, 1, __ATOMIC_RELAXED);
+            } else {
+                if(session->network_ipv6_rx_last_seq +1 != bbl->flow_seq) {
+                    stats->session_ipv6_loss++;
+                    session->stats.network_ipv6_loss++;
+                    if(!io_thread) {
+                        LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
+                            session->key.outer_vlan_id, session->key.inner_vlan_id,
+                            bbl->flow_id, bbl->flow_seq, session->network_ipv6_rx_last_seq);
+                    }
+                }
+            }
+            session->network_ipv6_rx_last_seq = bbl->flow_seq;
+            bbl_rx_session_latency(eth, bbl, interface, io_thread, session, BBL_SESSION_FLOW_ACCESS_IPV6);
+            break;
+        case BBL_SUB_TYPE_IPV6PD:
+            stats->session_ipv6pd_rx++;
+            session->stats.network_ipv6pd_rx++;
+            if(!session->network_ipv6pd_rx_first_seq) {
+                session->network_ipv6pd_rx_first_seq = bbl->flow_seq;
+                __atomic_fetch_add(&interface->ctx->stats.session_traffic_flows_verified, 1, __ATOMIC_RELAXED);
+            } else {
+                if(session->network_ipv6pd_rx_last_seq +1 != bbl->flow_seq) {
+                    stats->session_ipv6pd_loss++;
+                    session->stats.network_ipv6pd_loss++;
+                    if(!io_thread) {
+                        LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
+                            session->key.outer_vlan_id, session->key.inner_vlan_id,
+                            bbl->flow_id, bbl->flow_seq, session->network_ipv6pd_rx_last_seq);
+                    }
+                }
+            }
+            session->network_ipv6pd_rx_last_seq = bbl->flow_seq;
+            bbl_rx_session_latency(eth, bbl, interface, io_thread, session, BBL_SESSION_FLOW_ACCESS_IPV6PD);
+            break;
+        default:
+            break;
+    }
+}
+
 void
 bbl_rx_handler_network(bbl_ethernet_header_t *eth, bbl_interface_s *interface) {
 
@@ -1838,10 +1906,6 @@ bbl_rx_handler_network(bbl_ethernet_header_t *eth, bbl_interface_s *interface) {
     bbl_udp_t *udp;
     bbl_bbl_t *bbl = NULL;
 
-    bbl_session_s *session;
-    void **search;
-    session_key_t key;
-
     ctx = interface->ctx;
     if(ctx->config.network_vlan && (ctx->config.network_vlan != eth->vlan_outer)) {
         /* Drop wrong VLAN */
@@ -1881,153 +1945,365 @@ bbl_rx_handler_network(bbl_ethernet_header_t *eth, bbl_interface_s *interface) {
 
     if(bbl) {
         if(bbl->type == BBL_TYPE_UNICAST_SESSION) {
-            key.ifindex = bbl->ifindex;
-            key.outer_vlan_id = bbl->outer_vlan_id;
-            key.inner_vlan_id = bbl->inner_vlan_id;
-            search = dict_search(ctx->session_dict, &key);
-            if(search) {
-                session = *search;
-                switch (bbl->sub_type) {
-                    case BBL_SUB_TYPE_IPV4:
-                        interface->stats.session_ipv4_rx++;
-                        session->stats.network_ipv4_rx++;
-                        if(!session->network_ipv4_rx_first_seq) {
-                            session->network_ipv4_rx_first_seq = bbl->flow_seq;
-                            interface->ctx->stats.session_traffic_flows_verified++;
-                        } else {
-                            if(session->network_ipv4_rx_last_seq +1 != bbl->flow_seq) {
-                                interface->stats.session_ipv4_loss++;
-                                session->stats.network_ipv4_loss++;
-                                LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
-                                    session->key.outer_vlan_id, session->key.inner_vlan_id,
-                                    bbl->flow_id, bbl->flow_seq, session->network_ipv4_rx_last_seq);
-                            }
-                        }
-                        session->network_ipv4_rx_last_seq = bbl->flow_seq;
-                        break;
-                    case BBL_SUB_TYPE_IPV6:
-                        interface->stats.session_ipv6_rx++;
-                        session->stats.network_ipv6_rx++;
-                        if(!session->network_ipv6_rx_first_seq) {
-                            session->network_ipv6_rx_first_seq = bbl->flow_seq;
-                            interface->ctx->stats.session_traffic_flows_verified++;
-                        } else {
-                            if(session->network_ipv6_rx_last_seq +1 != bbl->flow_seq) {
-                                interface->stats.session_ipv6_loss++;
-                                session->stats.network_ipv6_loss++;
-                                LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
-                                    session->key.outer_vlan_id, session->key.inner_vlan_id,
-                                    bbl->flow_id, bbl->flow_seq, session->network_ipv6_rx_last_seq);
-                            }
-                        }
-                        session->network_ipv6_rx_last_seq = bbl->flow_seq;
-                        break;
-                    case BBL_SUB_TYPE_IPV6PD:
-                        interface->stats.session_ipv6pd_rx++;
-                        session->stats.network_ipv6pd_rx++;
-                        if(!session->network_ipv6pd_rx_first_seq) {
-                            session->network_ipv6pd_rx_first_seq = bbl->flow_seq;
-                            interface->ctx->stats.session_traffic_flows_verified++;
-                        } else {
-                            if(session->network_ipv6pd_rx_last_seq +1 != bbl->flow_seq) {
-                                interface->stats.session_ipv6pd_loss++;
-                                session->stats.network_ipv6pd_loss++;
-                                LOG(LOSS, "LOSS (Q-in-Q %u:%u) flow: %lu seq: %lu last: %lu\n",
-                                    session->key.outer_vlan_id, session->key.inner_vlan_id,
-                                    bbl->flow_id, bbl->flow_seq, session->network_ipv6pd_rx_last_seq);
-                            }
-                        }
-                        session->network_ipv6pd_rx_last_seq = bbl->flow_seq;
-                        break;
-                    default:
-                        break;
-                }
-            }
+            bbl_rx_session_traffic_network(eth, bbl, interface, NULL);
         }
     } else {
         interface->stats.packets_rx_drop_unknown++;
     }
 }
 
-void
-bbl_rx_job (timer_s *timer)
+/*
+ * Fast path for BBL traffic recognized by classify_bbl, which
+ * updates the flow counters without decoding the frame. Returns
+ * false if the frame must be passed to the full decoder.
+ *
+ * Also called by the I/O threads if the data plane is enabled,
+ * which account unicast session traffic and streams only. Those
+ * check the session state published by the control thread.
+ */
+bool
+bbl_rx_fast_path(bbl_interface_s *interface, bbl_io_thread_s *io_thread, bbl_classify_t *classify,
+                 uint16_t vlan_tci, uint32_t rx_sec, uint32_t rx_nsec) {
+    bbl_ethernet_header_t eth = {0};
+    bbl_session_s *session;
+
+    /* Only VLAN and RX timestamp are used by the BBL handlers. */
+    eth.vlan_outer = vlan_tci & ETH_VLAN_ID_MAX;
+    eth.vlan_inner = classify->vlan_outer;
+    eth.type = classify->type;
+    eth.rx_sec = rx_sec;
+    eth.rx_nsec = rx_nsec;
+
+    if(!interface->access) {
+        if(classify->bbl.type != BBL_TYPE_UNICAST_SESSION ||
+           (interface->ctx->config.network_vlan && interface->ctx->config.network_vlan != eth.vlan_outer)) {
+            return false;
+        }
+        bbl_rx_session_traffic_network(&eth, &classify->bbl, interface, io_thread);
+        return true;
+    }
+
+    session = bbl_session_table_get(&interface->session_table, eth.vlan_outer, eth.vlan_inner);
+    if(!session || classify->pppoe != (session->access_type == ACCESS_TYPE_PPPOE)) {
+        return false;
+    }
+    if(io_thread) {
+        if(classify->bbl.type != BBL_TYPE_UNICAST_SESSION ||
+           !__atomic_load_n(&session->io_rx_active, __ATOMIC_RELAXED)) {
+            return false;
+        }
+        bbl_rx_session_traffic_access(&eth, &classify->bbl, interface, io_thread, session);
+        return true;
+    }
+    if(session->session_state == BBL_TERMINATED ||
+       session->session_state == BBL_IDLE) {
+        return false;
+    }
+    if(classify->bbl.type == BBL_TYPE_UNICAST_SESSION) {
+        bbl_rx_session_traffic_access(&eth, &classify->bbl, interface, NULL, session);
+    } else if(classify->bbl.type == BBL_TYPE_MULTICAST && classify->type == ETH_TYPE_IPV4) {
+        bbl_rx_multicast(&eth, &classify->bbl, classify->ipv4_dst, interface, session);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Decode a received packet into the scratchpad. This function
+ * has no side effects and is also called by the I/O threads.
+ */
+protocol_error_t
+bbl_rx_decode (uint8_t *eth_start, uint eth_len, uint16_t vlan_tci, uint32_t rx_sec, uint32_t rx_nsec,
+               uint8_t *sp, bbl_ethernet_header_t **eth)
 {
-    bbl_ctx_s *ctx;
-    bbl_interface_s *interface;
-    struct tpacket2_hdr* tphdr;
-    u_char* frame_ptr;
-    struct pollfd fds[1] = {0};
+    protocol_error_t decode_result;
 
-    uint8_t *eth_start;
-    uint eth_len;
-    bbl_ethernet_header_t *eth;
+    decode_result = decode_ethernet(eth_start, eth_len, sp, SCRATCHPAD_LEN, eth);
+    if(decode_result == PROTOCOL_SUCCESS) {
+        /* The outer VLAN is stripped from header */
+        (*eth)->vlan_inner = (*eth)->vlan_outer;
+        (*eth)->vlan_outer = vlan_tci & ETH_VLAN_ID_MAX;
+        /* Copy RX timestamp */
+        (*eth)->rx_sec = rx_sec; /* ktime/hw timestamp */
+        (*eth)->rx_nsec = rx_nsec; /* ktime/hw timestamp */
+    }
+    return decode_result;
+}
 
+static void
+bbl_rx_decoded (bbl_interface_s *interface, bbl_ethernet_header_t *eth, protocol_error_t decode_result)
+{
+    if(decode_result == PROTOCOL_SUCCESS) {
+        if(interface->access) {
+            bbl_rx_handler_access(eth, interface);
+        } else {
+            bbl_rx_handler_network(eth, interface);
+        }
+    } else if (decode_result == UNKNOWN_PROTOCOL) {
+        interface->stats.packets_rx_drop_unknown++;
+    } else {
+        interface->stats.packets_rx_drop_decode_error++;
+    }
+}
+
+static void
+bbl_rx_pcap (bbl_interface_s *interface, uint8_t *eth_start, uint eth_len, uint32_t rx_sec, uint32_t rx_nsec)
+{
+    struct timespec rx_timestamp;
+
+    rx_timestamp.tv_sec = rx_sec;
+    rx_timestamp.tv_nsec = rx_nsec;
+    pcapng_push_packet_header(interface->ctx, &rx_timestamp, eth_start, eth_len,
+                              interface->pcap_index, PCAPNG_EPB_FLAGS_INBOUND);
+}
+
+void
+bbl_rx_packet (bbl_interface_s *interface, uint8_t *eth_start, uint eth_len,
+               uint16_t vlan_tci, uint32_t rx_sec, uint32_t rx_nsec)
+{
+    bbl_ctx_s *ctx = interface->ctx;
+    bbl_ethernet_header_t *eth;
+    bbl_classify_t classify;
     protocol_error_t decode_result;
 
-    interface = timer->data;
-    if (!interface) {
+    interface->stats.packets_rx++;
+
+    /*
+     * Dump the packet into pcap file.
+     */
+    if (ctx->pcap.enabled) {
+        bbl_rx_pcap(interface, eth_start, eth_len, rx_sec, rx_nsec);
+    }
+
+    if(ctx->config.rx_fast_path &&
+       classify_bbl(eth_start, eth_len, &classify) == PROTOCOL_SUCCESS &&
+       bbl_rx_fast_path(interface, NULL, &classify, vlan_tci, rx_sec, rx_nsec)) {
+        interface->stats.packets_rx_fast_path++;
         return;
     }
-    ctx = interface->ctx;
 
-    fds[0].fd = interface->fd_rx;
+    decode_result = bbl_rx_decode(eth_start, eth_len, vlan_tci, rx_sec, rx_nsec, ctx->sp_rx, &eth);
+    bbl_rx_decoded(interface, eth, decode_result);
+}
+
+/*
+ * Poll the kernel if no packet is available on the RX ring.
+ */
+static void
+bbl_rx_packet_mmap_poll (bbl_rx_ring_s *rx_ring)
+{
+    bbl_interface_s *interface = rx_ring->interface;
+    struct pollfd fds[1] = {0};
+
+    fds[0].fd = rx_ring->fd;
     fds[0].events = POLLIN;
-    fds[0].revents = 0;
+    if (poll(fds, 1, 0) == -1) {
+        LOG(IO, "RX poll interface %s", interface->name);
+        return;
+    }
+    rx_ring->stats.poll_rx++;
+    interface->stats.poll_rx++;
+    pcapng_fflush(interface->ctx);
+}
 
-    /* Get RX timestamp */
-    clock_gettime(CLOCK_REALTIME, &interface->rx_timestamp);
+/*
+ * TPACKET_V2 RX ring walk.
+ */
+void
+bbl_rx_packet_mmap (bbl_rx_ring_s *rx_ring)
+{
+    bbl_interface_s *interface = rx_ring->interface;
+    struct tpacket2_hdr* tphdr;
+    uint32_t rx_sec, rx_nsec;
 
     while (true) {
 
-        frame_ptr = interface->ring_rx + (interface->cursor_rx * interface->req_rx.tp_frame_size);
-        tphdr = (struct tpacket2_hdr*)frame_ptr;
+        tphdr = (struct tpacket2_hdr*)(rx_ring->ring + (rx_ring->cursor * rx_ring->req.tp_frame_size));
 
         /* If no buffer is available poll kernel */
-        while (!(tphdr->tp_status & TP_STATUS_USER)) {
-            if (poll(fds, 1, 0) == -1) {
-                LOG(IO, "RX poll interface %s", interface->name);
-                return;
-            }
-            interface->stats.poll_rx++;
-	        pcapng_fflush(ctx);
+        if (!(tphdr->tp_status & TP_STATUS_USER)) {
+            bbl_rx_packet_mmap_poll(rx_ring);
             return;
         }
 
-        //printf("consumed packet #%llu, %p, len %u\n", interface->packets, frame_ptr, tphdr->tp_len);
-        interface->stats.packets_rx++;
+        rx_ring->stats.packets_rx++;
+        rx_sec = tphdr->tp_sec;
+        rx_nsec = tphdr->tp_nsec;
+        if(tphdr->tp_status & TP_STATUS_TS_RAW_HARDWARE) {
+            bbl_io_phc_timestamp(&interface->phc_offset, &rx_sec, &rx_nsec);
+        }
+        bbl_rx_packet(interface, (uint8_t*)tphdr + tphdr->tp_mac, tphdr->tp_len,
+                      tphdr->tp_vlan_tci, rx_sec, rx_nsec);
+
+        tphdr->tp_status = TP_STATUS_KERNEL; /* Return ownership back to kernel */
+        rx_ring->cursor = (rx_ring->cursor + 1) % rx_ring->req.tp_frame_nr;
+    }
+}
+
+/*
+ * Check the status word of the next RX frame (busy poll).
+ */
+bool
+bbl_rx_packet_mmap_ready (bbl_rx_ring_s *rx_ring)
+{
+    struct tpacket2_hdr *tphdr;
+
+    tphdr = (struct tpacket2_hdr*)(rx_ring->ring + (rx_ring->cursor * rx_ring->req.tp_frame_size));
+    return tphdr->tp_status & TP_STATUS_USER;
+}
+
+/*
+ * TPACKET_V3 RX ring walk.
+ *
+ * The kernel hands over whole blocks of packets. Each block
+ * is processed completely before ownership is returned to
+ * the kernel, which saves the per frame status checks.
+ */
+void
+bbl_rx_packet_mmap_v3 (bbl_rx_ring_s *rx_ring)
+{
+    bbl_interface_s *interface = rx_ring->interface;
+    struct tpacket_block_desc *block;
+    struct tpacket3_hdr *tphdr;
+    uint32_t rx_sec, rx_nsec;
+    uint32_t num_pkts;
+    uint32_t i;
+
+    while (true) {
 
-        eth_start = (uint8_t*)tphdr + tphdr->tp_mac;
-        eth_len = tphdr->tp_len;
+        block = (struct tpacket_block_desc*)(rx_ring->ring + (rx_ring->cursor * rx_ring->req.tp_block_size));
 
-        /*
-	     * Dump the packet into pcap file.
-	     */
-        if (ctx->pcap.write_buf) {
-	        pcapng_push_packet_header(ctx, &interface->rx_timestamp, eth_start, eth_len,
-				                      interface->pcap_index, PCAPNG_EPB_FLAGS_INBOUND);
+        /* If no block is available poll kernel */
+        if (!(block->hdr.bh1.block_status & TP_STATUS_USER)) {
+            bbl_rx_packet_mmap_poll(rx_ring);
+            return;
         }
 
-        decode_result = decode_ethernet(eth_start, eth_len, interface->ctx->sp_rx, SCRATCHPAD_LEN, &eth);
-
-        if(decode_result == PROTOCOL_SUCCESS) {
-            /* The outer VLAN is stripped from header */
-            eth->vlan_inner = eth->vlan_outer;
-            eth->vlan_outer = tphdr->tp_vlan_tci & ETH_VLAN_ID_MAX;
-            /* Copy RX timestamp */
-            eth->rx_sec = tphdr->tp_sec; /* ktime/hw timestamp */
-            eth->rx_nsec = tphdr->tp_nsec; /* ktime/hw timestamp */
-            if(interface->access) {
-                bbl_rx_handler_access(eth, interface);
+        num_pkts = block->hdr.bh1.num_pkts;
+        tphdr = (struct tpacket3_hdr*)((uint8_t*)block + block->hdr.bh1.offset_to_first_pkt);
+        for (i = 0; i < num_pkts; i++) {
+            rx_sec = tphdr->tp_sec;
+            rx_nsec = tphdr->tp_nsec;
+            if(tphdr->tp_status & TP_STATUS_TS_RAW_HARDWARE) {
+                bbl_io_phc_timestamp(&interface->phc_offset, &rx_sec, &rx_nsec);
+            }
+            bbl_rx_packet(interface, (uint8_t*)tphdr + tphdr->tp_mac, tphdr->tp_snaplen,
+                          tphdr->hv1.tp_vlan_tci, rx_sec, rx_nsec);
+            tphdr = (struct tpacket3_hdr*)((uint8_t*)tphdr + tphdr->tp_next_offset);
+        }
+
+        rx_ring->stats.packets_rx += num_pkts;
+        rx_ring->stats.rx_blocks++;
+        interface->stats.rx_blocks++;
+        interface->stats.rx_block_packets += num_pkts;
+        if(num_pkts > interface->stats.rx_block_packets_max) {
+            interface->stats.rx_block_packets_max = num_pkts;
+        }
+
+        block->hdr.bh1.block_status = TP_STATUS_KERNEL; /* Return ownership back to kernel */
+        rx_ring->cursor = (rx_ring->cursor + 1) % rx_ring->req.tp_block_nr;
+    }
+}
+
+/*
+ * Check the status word of the next RX block (busy poll).
+ */
+bool
+bbl_rx_packet_mmap_v3_ready (bbl_rx_ring_s *rx_ring)
+{
+    struct tpacket_block_desc *block;
+
+    block = (struct tpacket_block_desc*)(rx_ring->ring + (rx_ring->cursor * rx_ring->req.tp_block_size));
+    return block->hdr.bh1.block_status & TP_STATUS_USER;
+}
+
+/*
+ * Process all packets received by the I/O thread. Those are
+ * already classified or decoded and are returned to the kernel
+ * by the I/O thread after processing.
+ */
+void
+bbl_rx_io_thread (bbl_rx_ring_s *rx_ring)
+{
+    bbl_interface_s *interface = rx_ring->interface;
+    bbl_ctx_s *ctx = interface->ctx;
+    bbl_io_rx_slot_s *slot;
+    bbl_ethernet_header_t *eth;
+    protocol_error_t decode_result;
+    bool released = false;
+    while((slot = (bbl_io_rx_slot_s*)bbl_spsc_peek(rx_ring->io_queue))) {
+        if (ctx->pcap.enabled) {
+            bbl_rx_pcap(interface, slot->eth_start, slot->eth_len, slot->rx_sec, slot->rx_nsec);
+        }
+        if(slot->classified) {
+            if(bbl_rx_fast_path(interface, NULL, &slot->classify, slot->vlan_tci, slot->rx_sec, slot->rx_nsec)) {
+                interface->stats.packets_rx_fast_path++;
             } else {
-                bbl_rx_handler_network(eth, interface);
+                decode_result = bbl_rx_decode(slot->eth_start, slot->eth_len, slot->vlan_tci,
+                                              slot->rx_sec, slot->rx_nsec, ctx->sp_rx, &eth);
+                bbl_rx_decoded(interface, eth, decode_result);
             }
-        } else if (decode_result == UNKNOWN_PROTOCOL) {
-            interface->stats.packets_rx_drop_unknown++;
         } else {
-            interface->stats.packets_rx_drop_decode_error++;
+            bbl_rx_decoded(interface, slot->eth, slot->decode_result);
         }
+        bbl_spsc_release(rx_ring->io_queue);
+        released = true;
+    }
+    if(released) {
+        /* The I/O thread returns the frames to the kernel. */
+        bbl_io_thread_wakeup(rx_ring->io_thread);
+    }
+    if(rx_ring->id == 0) {
+        bbl_io_thread_stats(interface);
+    }
+    pcapng_fflush(ctx);
+}
 
-        tphdr->tp_status = TP_STATUS_KERNEL; /* Return ownership back to kernel */
-        interface->cursor_rx = (interface->cursor_rx + 1) % interface->req_rx.tp_frame_nr;
+bool
+bbl_rx_io_thread_ready (bbl_rx_ring_s *rx_ring)
+{
+    return bbl_spsc_peek(rx_ring->io_queue) != NULL;
+}
+
+/*
+ * RX job, event and busy poll callbacks. The RX ring (AF_XDP
+ * socket) is served by the I/O backend of the interface.
+ */
+void
+bbl_rx_job (timer_s *timer)
+{
+    bbl_rx_ring_s *rx_ring;
+
+    rx_ring = timer->data;
+    if (!rx_ring) {
+        return;
+    }
+    rx_ring->interface->io_ops->rx(rx_ring);
+}
+
+/*
+ * RX ringbuffer has become readable (event loop).
+ */
+void
+bbl_rx_event (void *arg)
+{
+    bbl_rx_ring_s *rx_ring = arg;
+
+    rx_ring->interface->io_ops->rx(rx_ring);
+}
+
+/*
+ * Process the RX ringbuffer if ready (busy poll).
+ */
+bool
+bbl_rx_poll (void *arg)
+{
+    bbl_rx_ring_s *rx_ring = arg;
+
+    if(!rx_ring->interface->io_ops->rx_ready(rx_ring)) {
+        return false;
     }
+    rx_ring->interface->io_ops->rx(rx_ring);
+    return true;
 }
@@ -10,7 +10,32 @@
 #ifndef __BBL_RX_H__
 #define __BBL_RX_H__
 
+protocol_error_t
+bbl_rx_decode (uint8_t *eth_start, uint eth_len, uint16_t vlan_tci, uint32_t rx_sec, uint32_t rx_nsec,
+               uint8_t *sp, bbl_ethernet_header_t **eth);
+
+bool
+bbl_rx_fast_path(bbl_interface_s *interface, bbl_io_thread_s *io_thread, bbl_classify_t *classify,
+                 uint16_t vlan_tci, uint32_t rx_sec, uint32_t rx_nsec);
+
+void
+bbl_rx_packet (bbl_interface_s *interface, uint8_t *eth_start, uint eth_len,
+               uint16_t vlan_tci, uint32_t rx_sec, uint32_t rx_nsec);
+
+void bbl_rx_packet_mmap(bbl_rx_ring_s *rx_ring);
+bool bbl_rx_packet_mmap_ready(bbl_rx_ring_s *rx_ring);
+void bbl_rx_packet_mmap_v3(bbl_rx_ring_s *rx_ring);
+bool bbl_rx_packet_mmap_v3_ready(bbl_rx_ring_s *rx_ring);
+void bbl_rx_io_thread(bbl_rx_ring_s *rx_ring);
+bool bbl_rx_io_thread_ready(bbl_rx_ring_s *rx_ring);
+
 void
 bbl_rx_job (timer_s *timer);
 
+void
+bbl_rx_event (void *arg);
+
+bool
+bbl_rx_poll (void *arg);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+/*
+ * BNG Blaster (BBL) - Session VLAN Table
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <stdlib.h>
+#include "bbl_session_table.h"
+
+/*
+ * Add a session to the table. Returns false if the
+ * VLAN identifiers are out of range, already in use
+ * or if the memory allocation has failed.
+ */
+bool
+bbl_session_table_add (bbl_session_table_s *table, uint16_t outer_vlan, uint16_t inner_vlan, struct bbl_session_ *session)
+{
+    struct bbl_session_ **inner;
+
+    if(outer_vlan >= BBL_SESSION_TABLE_VLANS || inner_vlan >= BBL_SESSION_TABLE_VLANS) {
+        return false;
+    }
+    if(!table->outer) {
+        table->outer = calloc(BBL_SESSION_TABLE_VLANS, sizeof(struct bbl_session_ **));
+        if(!table->outer) {
+            return false;
+        }
+    }
+    inner = table->outer[outer_vlan];
+    if(!inner) {
+        inner = calloc(BBL_SESSION_TABLE_VLANS, sizeof(struct bbl_session_ *));
+        if(!inner) {
+            return false;
+        }
+        table->outer[outer_vlan] = inner;
+        table->stats.inner_tables++;
+    }
+    if(inner[inner_vlan]) {
+        return false;
+    }
+    inner[inner_vlan] = session;
+    table->stats.sessions++;
+    return true;
+}
+
+void
+bbl_session_table_free (bbl_session_table_s *table)
+{
+    int i;
+
+    if(table->outer) {
+        for(i = 0; i < BBL_SESSION_TABLE_VLANS; i++) {
+            if(table->outer[i]) {
+                free(table->outer[i]);
+            }
+        }
+        free(table->outer);
+        table->outer = NULL;
+    }
+    table->stats.sessions = 0;
+    table->stats.inner_tables = 0;
+}
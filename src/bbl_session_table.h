@@ -0,0 +1,54 @@
+/*
+ * BNG Blaster (BBL) - Session VLAN Table
+ *
+ * Direct session lookup per access interface indexed
+ * by outer and inner VLAN identifier.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_SESSION_TABLE_H__
+#define __BBL_SESSION_TABLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BBL_SESSION_TABLE_VLANS 4096 /* 12 bit VLAN identifier */
+
+struct bbl_session_;
+
+/*
+ * The outer table is allocated with the first session, inner
+ * tables are allocated on demand for each outer VLAN in use.
+ * A lookup costs two dependent loads and no key compare.
+ */
+typedef struct bbl_session_table_
+{
+    struct bbl_session_ ***outer;
+
+    struct {
+        uint32_t sessions;
+        uint32_t inner_tables;
+    } stats;
+} bbl_session_table_s;
+
+bool bbl_session_table_add(bbl_session_table_s *table, uint16_t outer_vlan, uint16_t inner_vlan, struct bbl_session_ *session);
+void bbl_session_table_free(bbl_session_table_s *table);
+
+static inline struct bbl_session_ *
+bbl_session_table_get (bbl_session_table_s *table, uint16_t outer_vlan, uint16_t inner_vlan) {
+    struct bbl_session_ **inner;
+
+    if(!table->outer || outer_vlan >= BBL_SESSION_TABLE_VLANS || inner_vlan >= BBL_SESSION_TABLE_VLANS) {
+        return NULL;
+    }
+    inner = table->outer[outer_vlan];
+    if(!inner) {
+        return NULL;
+    }
+    return inner[inner_vlan];
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * BNG Blaster (BBL) - Single Producer Single Consumer Queue
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bbl_spsc.h"
+
+/*
+ * Allocate a queue. The number of slots is rounded
+ * up to the next power of two.
+ */
+bbl_spsc_s *
+bbl_spsc_new (uint32_t slots, uint32_t slot_size)
+{
+    bbl_spsc_s *q;
+    uint32_t size = 1;
+
+    while(size < slots) {
+        size <<= 1;
+    }
+
+    if(posix_memalign((void**)&q, BBL_SPSC_CACHELINE, sizeof(bbl_spsc_s))) {
+        return NULL;
+    }
+    memset(q, 0x0, sizeof(bbl_spsc_s));
+
+    q->slots = size;
+    q->mask = size - 1;
+    q->slot_size = slot_size;
+    if(posix_memalign((void**)&q->buf, BBL_SPSC_CACHELINE, (size_t)size * slot_size)) {
+        free(q);
+        return NULL;
+    }
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return q;
+}
+
+void
+bbl_spsc_free (bbl_spsc_s *q)
+{
+    if(q) {
+        free(q->buf);
+        free(q);
+    }
+}
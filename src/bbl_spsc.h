@@ -0,0 +1,98 @@
+/*
+ * BNG Blaster (BBL) - Single Producer Single Consumer Queue
+ *
+ * Lock-free ring of fixed size slots used to pass
+ * packets between exactly two threads.
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_SPSC_H__
+#define __BBL_SPSC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define BBL_SPSC_CACHELINE 64
+
+typedef struct bbl_spsc_
+{
+    /* Producer side */
+    _Atomic uint32_t head __attribute__ ((aligned (BBL_SPSC_CACHELINE)));
+    uint32_t tail_cache; /* last tail seen by the producer */
+
+    /* Consumer side */
+    _Atomic uint32_t tail __attribute__ ((aligned (BBL_SPSC_CACHELINE)));
+    uint32_t head_cache; /* last head seen by the consumer */
+
+    /* Read only after creation */
+    uint32_t slots __attribute__ ((aligned (BBL_SPSC_CACHELINE))); /* power of two */
+    uint32_t mask;
+    uint32_t slot_size;
+    uint8_t *buf;
+} bbl_spsc_s;
+
+bbl_spsc_s *bbl_spsc_new(uint32_t slots, uint32_t slot_size);
+void bbl_spsc_free(bbl_spsc_s *q);
+
+/*
+ * Producer: Return the next free slot or NULL if the queue is full.
+ * The slot becomes visible to the consumer with bbl_spsc_commit().
+ */
+static inline uint8_t *
+bbl_spsc_reserve (bbl_spsc_s *q) {
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if(head - q->tail_cache == q->slots) {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if(head - q->tail_cache == q->slots) {
+            return NULL;
+        }
+    }
+    return q->buf + ((head & q->mask) * q->slot_size);
+}
+
+static inline void
+bbl_spsc_commit (bbl_spsc_s *q) {
+    atomic_store_explicit(&q->head, atomic_load_explicit(&q->head, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/*
+ * Consumer: Return the oldest slot or NULL if the queue is empty.
+ * The slot is handed back to the producer with bbl_spsc_release().
+ */
+static inline uint8_t *
+bbl_spsc_peek (bbl_spsc_s *q) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if(tail == q->head_cache) {
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        if(tail == q->head_cache) {
+            return NULL;
+        }
+    }
+    return q->buf + ((tail & q->mask) * q->slot_size);
+}
+
+static inline void
+bbl_spsc_release (bbl_spsc_s *q) {
+    atomic_store_explicit(&q->tail, atomic_load_explicit(&q->tail, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/*
+ * Producer: Number of slots committed and released by the consumer
+ * so far (both wrap around), used to track when the consumer is done
+ * with all slots committed up to a given point.
+ */
+static inline uint32_t
+bbl_spsc_produced (bbl_spsc_s *q) {
+    return atomic_load_explicit(&q->head, memory_order_relaxed);
+}
+
+static inline uint32_t
+bbl_spsc_consumed (bbl_spsc_s *q) {
+    return atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+#endif
@@ -47,19 +47,52 @@ bbl_stats_update_cps (bbl_ctx_s *ctx) {
     }
 }
 
+/*
+ * Pull the PACKET_STATISTICS counters of all RX rings into the interface
+ * stats. The kernel resets the counters with every read, so the values
+ * are accumulated here. Packets dropped because of a full RX ring are
+ * counted by the kernel as received and dropped.
+ */
+void
+bbl_stats_update_kernel (bbl_interface_s *interface) {
+    bbl_rx_ring_s *rx_ring;
+    struct tpacket_stats_v3 kstats;
+    socklen_t len;
+    uint8_t i;
+
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        rx_ring = &interface->rx_ring[i];
+        memset(&kstats, 0x0, sizeof(kstats));
+        len = interface->rx_tpacket_v3 ? sizeof(struct tpacket_stats_v3) : sizeof(struct tpacket_stats);
+        if(getsockopt(rx_ring->fd, SOL_PACKET, PACKET_STATISTICS, &kstats, &len) == -1) {
+            continue;
+        }
+        rx_ring->stats.kernel_packets += kstats.tp_packets;
+        rx_ring->stats.kernel_drops += kstats.tp_drops;
+        interface->stats.rx_kernel_packets += kstats.tp_packets;
+        interface->stats.rx_kernel_drops += kstats.tp_drops;
+        interface->stats.rx_kernel_freeze += kstats.tp_freeze_q_cnt;
+    }
+}
+
 void
 bbl_stats_generate (bbl_ctx_s *ctx, bbl_stats_t * stats) {
 
     struct dict_itor *itor;
     bbl_session_s *session;
+    bbl_interface_s *interface;
 
     int join_delays = 0;
     int leave_delays = 0;
 
     bbl_stats_update_cps(ctx);
 
+    CIRCLEQ_FOREACH(interface, &ctx->interface_qhead, interface_qnode) {
+        bbl_stats_update_kernel(interface);
+    }
+
     /* Iterate over all sessions */
-    itor = dict_itor_new(ctx->session_dict);
+    itor = dict_itor_new(ctx->session_dict.dict);
     dict_itor_first(itor);
     for (; dict_itor_valid(itor); dict_itor_next(itor)) {
         session = (bbl_session_s*)*dict_itor_datum(itor);
@@ -149,6 +182,210 @@ bbl_stats_generate (bbl_ctx_s *ctx, bbl_stats_t * stats) {
     }
 }
 
+static void
+bbl_stats_rx_rings_stdout (bbl_interface_s *interface) {
+    uint8_t i;
+
+    if(interface->rx_ring_count < 2) return;
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        printf("  RX Ring %2u:        %10lu packets (%lu poll, %lu kernel drops)\n", i,
+               interface->rx_ring[i].stats.packets_rx, interface->rx_ring[i].stats.poll_rx,
+               interface->rx_ring[i].stats.kernel_drops);
+    }
+}
+
+static void
+bbl_stats_tx_kicks_stdout (bbl_interface_s *interface) {
+    printf("  TX Kicks:          %10lu (%lu early, %lu skipped, %lu again)\n",
+           interface->stats.tx_kicks, interface->stats.tx_kicks_early,
+           interface->stats.tx_kicks_skipped, interface->stats.tx_kicks_again);
+    if(interface->stats.tx_inflight_max) {
+        printf("  TX Inflight Max:   %10u frames\n", interface->stats.tx_inflight_max);
+    }
+}
+
+static void
+bbl_stats_tx_class_stdout (bbl_interface_s *interface) {
+    char label[32];
+    int class;
+    for(class = 0; class < BBL_TX_CLASS_MAX; class++) {
+        snprintf(label, sizeof(label), "TX %s:", bbl_tx_class_string(class));
+        printf("  %-19s%10lu packets (%lu deferred, %lu ring full)\n",
+               label, interface->stats.tx_class[class].packets,
+               interface->stats.tx_class[class].deferred, interface->stats.tx_class[class].ring_full);
+    }
+}
+
+static void
+bbl_stats_rx_kernel_stdout (bbl_interface_s *interface) {
+    if(!interface->rx_ring_count) return;
+    printf("  RX Kernel Drops:   %10lu packets (%lu received)\n",
+           interface->stats.rx_kernel_drops, interface->stats.rx_kernel_packets);
+    if(interface->rx_tpacket_v3) {
+        printf("  RX Kernel Freeze:  %10lu\n", interface->stats.rx_kernel_freeze);
+    }
+}
+
+static void
+bbl_stats_rx_kernel_json (bbl_interface_s *interface, json_t *jobj) {
+    if(!interface->rx_ring_count) return;
+    json_object_set(jobj, "rx-kernel-packets", json_integer(interface->stats.rx_kernel_packets));
+    json_object_set(jobj, "rx-kernel-drops", json_integer(interface->stats.rx_kernel_drops));
+    if(interface->rx_tpacket_v3) {
+        json_object_set(jobj, "rx-kernel-freeze", json_integer(interface->stats.rx_kernel_freeze));
+    }
+}
+
+static void
+bbl_stats_tx_kicks_json (bbl_interface_s *interface, json_t *jobj) {
+    json_object_set(jobj, "tx-kicks", json_integer(interface->stats.tx_kicks));
+    json_object_set(jobj, "tx-kicks-early", json_integer(interface->stats.tx_kicks_early));
+    json_object_set(jobj, "tx-kicks-skipped", json_integer(interface->stats.tx_kicks_skipped));
+    json_object_set(jobj, "tx-kicks-again", json_integer(interface->stats.tx_kicks_again));
+    json_object_set(jobj, "tx-inflight-max", json_integer(interface->stats.tx_inflight_max));
+}
+
+static void
+bbl_stats_tx_class_json (bbl_interface_s *interface, json_t *jobj) {
+    static const char *keys[BBL_TX_CLASS_MAX][3] = {
+        { "tx-control-packets", "tx-control-deferred", "tx-control-ring-full" },
+        { "tx-keepalive-packets", "tx-keepalive-deferred", "tx-keepalive-ring-full" },
+        { "tx-data-packets", "tx-data-deferred", "tx-data-ring-full" }
+    };
+    int class;
+    for(class = 0; class < BBL_TX_CLASS_MAX; class++) {
+        json_object_set(jobj, keys[class][0], json_integer(interface->stats.tx_class[class].packets));
+        json_object_set(jobj, keys[class][1], json_integer(interface->stats.tx_class[class].deferred));
+        json_object_set(jobj, keys[class][2], json_integer(interface->stats.tx_class[class].ring_full));
+    }
+}
+
+static void
+bbl_stats_session_traffic_stdout (bbl_interface_s *interface) {
+    if(!interface->traffic_calendar) return;
+    printf("  TX Session Flows:  %10u (%lu deferred, %lu late)\n", interface->traffic_flows,
+           interface->traffic_calendar->stats.deferred, interface->traffic_calendar->stats.late);
+}
+
+static void
+bbl_stats_session_traffic_json (bbl_interface_s *interface, json_t *jobj) {
+    if(!interface->traffic_calendar) return;
+    json_object_set(jobj, "tx-session-flows", json_integer(interface->traffic_flows));
+    json_object_set(jobj, "tx-session-flows-deferred", json_integer(interface->traffic_calendar->stats.deferred));
+    json_object_set(jobj, "tx-session-flows-late", json_integer(interface->traffic_calendar->stats.late));
+}
+
+/*
+ * Add the percentiles of the histogram in nanoseconds
+ * as <prefix>-p50-ns, <prefix>-p99-ns and <prefix>-p999-ns.
+ */
+void
+bbl_stats_latency_histogram_json (bbl_latency_histogram_s *histogram, const char *prefix, json_t *jobj) {
+    static const uint32_t ppm[] = { BBL_LATENCY_P50, BBL_LATENCY_P99, BBL_LATENCY_P999 };
+    static const char *suffix[] = { "p50-ns", "p99-ns", "p999-ns" };
+    char key[64];
+    int i;
+
+    if(!histogram->count) return;
+    for(i = 0; i < 3; i++) {
+        snprintf(key, sizeof(key), "%s-%s", prefix, suffix[i]);
+        json_object_set_new(jobj, key, json_integer(bbl_latency_histogram_percentile(histogram, ppm[i])));
+    }
+}
+
+static void
+bbl_stats_latency_histogram_stdout (bbl_latency_histogram_s *histogram, const char *label) {
+    if(!histogram->count) return;
+    printf("  %-20sp50 %lu p99 %lu p99.9 %lu us\n", label,
+           bbl_latency_histogram_percentile(histogram, BBL_LATENCY_P50) / BBL_LATENCY_NSEC_PER_USEC,
+           bbl_latency_histogram_percentile(histogram, BBL_LATENCY_P99) / BBL_LATENCY_NSEC_PER_USEC,
+           bbl_latency_histogram_percentile(histogram, BBL_LATENCY_P999) / BBL_LATENCY_NSEC_PER_USEC);
+}
+
+static void
+bbl_stats_latency_stdout (bbl_interface_s *interface) {
+    bbl_latency_s *latency = &interface->stats.session_latency;
+    if(latency->count) {
+        printf("  RX Session Latency: min %lu avg %lu max %lu us\n",
+               latency->min / BBL_LATENCY_NSEC_PER_USEC, bbl_latency_avg(latency) / BBL_LATENCY_NSEC_PER_USEC,
+               latency->max / BBL_LATENCY_NSEC_PER_USEC);
+        bbl_stats_latency_histogram_stdout(&interface->stats.session_latency_histogram, "RX Session Latency:");
+        bbl_stats_latency_histogram_stdout(&interface->stats.session_jitter_histogram, "RX Session Jitter:");
+    }
+    latency = &interface->stats.tx_delay;
+    if(latency->count) {
+        printf("  TX Delay:          min %lu avg %lu max %lu us\n",
+               latency->min / BBL_LATENCY_NSEC_PER_USEC, bbl_latency_avg(latency) / BBL_LATENCY_NSEC_PER_USEC,
+               latency->max / BBL_LATENCY_NSEC_PER_USEC);
+    }
+}
+
+static void
+bbl_stats_latency_json (bbl_interface_s *interface, json_t *jobj) {
+    bbl_latency_s *latency = &interface->stats.session_latency;
+    if(latency->count) {
+        json_object_set(jobj, "rx-session-latency-min-ns", json_integer(latency->min));
+        json_object_set(jobj, "rx-session-latency-avg-ns", json_integer(bbl_latency_avg(latency)));
+        json_object_set(jobj, "rx-session-latency-max-ns", json_integer(latency->max));
+        bbl_stats_latency_histogram_json(&interface->stats.session_latency_histogram, "rx-session-latency", jobj);
+        bbl_stats_latency_histogram_json(&interface->stats.session_jitter_histogram, "rx-session-jitter", jobj);
+    }
+    latency = &interface->stats.tx_delay;
+    if(latency->count) {
+        json_object_set(jobj, "tx-delay-min-ns", json_integer(latency->min));
+        json_object_set(jobj, "tx-delay-avg-ns", json_integer(bbl_latency_avg(latency)));
+        json_object_set(jobj, "tx-delay-max-ns", json_integer(latency->max));
+    }
+}
+
+static void
+bbl_stats_streams_stdout (bbl_interface_s *interface) {
+    if(!interface->ctx->stats.stream_flows) return;
+    printf("  TX Stream:         %10lu packets\n", interface->stats.stream_tx);
+    printf("  RX Stream:         %10lu packets (%lu loss)\n", interface->stats.stream_rx,
+           interface->stats.stream_loss);
+    if(interface->stream_calendar) {
+        printf("  TX Streams:        %10u (%lu skipped, %lu deferred, %lu late)\n", interface->stream_count,
+               interface->stream_calendar->stats.skipped, interface->stream_calendar->stats.deferred,
+               interface->stream_calendar->stats.late);
+    }
+}
+
+static void
+bbl_stats_streams_json (bbl_interface_s *interface, json_t *jobj) {
+    if(!interface->ctx->stats.stream_flows) return;
+    json_object_set(jobj, "tx-stream-packets", json_integer(interface->stats.stream_tx));
+    json_object_set(jobj, "rx-stream-packets", json_integer(interface->stats.stream_rx));
+    json_object_set(jobj, "rx-stream-packets-loss", json_integer(interface->stats.stream_loss));
+    json_object_set(jobj, "tx-stream-packets-avg-pps-max", json_integer(interface->stats.rate_stream_tx.avg_max));
+    json_object_set(jobj, "rx-stream-packets-avg-pps-max", json_integer(interface->stats.rate_stream_rx.avg_max));
+    if(interface->stream_calendar) {
+        json_object_set(jobj, "tx-streams", json_integer(interface->stream_count));
+        json_object_set(jobj, "tx-streams-skipped", json_integer(interface->stream_calendar->stats.skipped));
+        json_object_set(jobj, "tx-streams-deferred", json_integer(interface->stream_calendar->stats.deferred));
+        json_object_set(jobj, "tx-streams-late", json_integer(interface->stream_calendar->stats.late));
+    }
+}
+
+static json_t *
+bbl_stats_rx_rings_json (bbl_interface_s *interface) {
+    json_t *jobj_array = json_array();
+    json_t *jobj_ring;
+    uint8_t i;
+
+    for(i = 0; i < interface->rx_ring_count; i++) {
+        jobj_ring = json_object();
+        json_object_set(jobj_ring, "id", json_integer(i));
+        json_object_set(jobj_ring, "rx-packets", json_integer(interface->rx_ring[i].stats.packets_rx));
+        json_object_set(jobj_ring, "rx-poll", json_integer(interface->rx_ring[i].stats.poll_rx));
+        json_object_set(jobj_ring, "rx-blocks", json_integer(interface->rx_ring[i].stats.rx_blocks));
+        json_object_set(jobj_ring, "rx-kernel-packets", json_integer(interface->rx_ring[i].stats.kernel_packets));
+        json_object_set(jobj_ring, "rx-kernel-drops", json_integer(interface->rx_ring[i].stats.kernel_drops));
+        json_array_append(jobj_array, jobj_ring);
+    }
+    return jobj_array;
+}
+
 void
 bbl_stats_stdout (bbl_ctx_s *ctx, bbl_stats_t * stats) {
     struct bbl_interface_ *access_if;    
@@ -163,11 +400,21 @@ bbl_stats_stdout (bbl_ctx_s *ctx, bbl_stats_t * stats) {
     printf("Setup Rate: %0.02lf CPS (MIN: %0.02lf AVG: %0.02lf MAX: %0.02lf)\n",
            ctx->stats.cps, ctx->stats.cps_min, ctx->stats.cps_avg, ctx->stats.cps_max);
     printf("Flapped: %u\n", ctx->sessions_flapped);
+    if(ctx->event_loop && ctx->event_loop->busy_poll) {
+        printf("Busy Poll Loops: %lu (%lu empty)\n",
+               ctx->event_loop->stats.busy_poll_loops, ctx->event_loop->stats.busy_poll_empty);
+    }
+    if(ctx->pcap.filename) {
+        printf("PCAP Packets: %lu (%lu written, %lu dropped, %lu write dropped, %lu filtered)\n",
+               ctx->pcap.packets, atomic_load(&ctx->pcap.packets_written),
+               ctx->pcap.packets_dropped, atomic_load(&ctx->pcap.packets_write_dropped),
+               ctx->pcap.packets_filtered);
+    }
 
     if(ctx->op.network_if) {
-        if(dict_count(ctx->li_flow_dict)) {
+        if(dict_count(ctx->li_flow_dict.dict)) {
             printf("\nLI Statistics:\n");
-            printf("  Flows:        %10lu\n", dict_count(ctx->li_flow_dict));
+            printf("  Flows:        %10lu\n", dict_count(ctx->li_flow_dict.dict));
             printf("  RX Packets:   %10lu\n", ctx->op.network_if->stats.li_rx);
         }
         if(ctx->config.l2tp_server) {
@@ -197,14 +444,39 @@ bbl_stats_stdout (bbl_ctx_s *ctx, bbl_stats_t * stats) {
         printf("  TX Session IPv6PD: %10lu packets\n", ctx->op.network_if->stats.session_ipv6pd_tx);
         printf("  RX Session IPv6PD: %10lu packets (%lu loss)\n", ctx->op.network_if->stats.session_ipv6pd_rx,
                ctx->op.network_if->stats.session_ipv6pd_loss);
+        bbl_stats_session_traffic_stdout(ctx->op.network_if);
+        bbl_stats_latency_stdout(ctx->op.network_if);
         printf("  TX Multicast:      %10lu packets\n", ctx->op.network_if->stats.mc_tx);
+        if(ctx->op.network_if->mc_calendar) {
+            printf("  TX Multicast Streams: %7u (%lu deferred, %lu late)\n", ctx->op.network_if->mc_stream_count,
+                   ctx->op.network_if->mc_calendar->stats.deferred, ctx->op.network_if->mc_calendar->stats.late);
+        }
+        bbl_stats_streams_stdout(ctx->op.network_if);
         printf("  RX Drop Unknown:   %10lu packets\n", ctx->op.network_if->stats.packets_rx_drop_unknown);
         printf("  TX Encode Error:   %10lu\n", ctx->op.network_if->stats.encode_errors);
         printf("  RX Decode Error:   %10lu packets\n", ctx->op.network_if->stats.packets_rx_drop_decode_error);
+        printf("  RX Fast Path:      %10lu packets\n", ctx->op.network_if->stats.packets_rx_fast_path);
         printf("  TX Send Failed:    %10lu\n", ctx->op.network_if->stats.sendto_failed);
         printf("  TX No Buffer:      %10lu\n", ctx->op.network_if->stats.no_tx_buffer);
         printf("  TX Poll Kernel:    %10lu\n", ctx->op.network_if->stats.poll_tx);
+        bbl_stats_tx_kicks_stdout(ctx->op.network_if);
+        bbl_stats_tx_class_stdout(ctx->op.network_if);
         printf("  RX Poll Kernel:    %10lu\n", ctx->op.network_if->stats.poll_rx);
+        bbl_stats_rx_kernel_stdout(ctx->op.network_if);
+        if(ctx->op.network_if->rx_tpacket_v3) {
+            printf("  RX Blocks:         %10lu (%lu packets per block avg, %u max)\n", ctx->op.network_if->stats.rx_blocks,
+                   ctx->op.network_if->stats.rx_blocks ? ctx->op.network_if->stats.rx_block_packets / ctx->op.network_if->stats.rx_blocks : 0,
+                   ctx->op.network_if->stats.rx_block_packets_max);
+        }
+        if(ctx->op.network_if->io_thread) {
+            printf("  IO RX Queue Full:  %10lu\n", ctx->op.network_if->stats.io_rx_queue_full);
+            if(ctx->op.network_if->io_data) {
+                printf("  IO Data Queue Full:%10lu\n", ctx->op.network_if->stats.io_data_queue_full);
+            }
+            printf("  IO Loops:          %10lu (%lu empty)\n", ctx->op.network_if->stats.io_loops,
+                   ctx->op.network_if->stats.io_empty_loops);
+        }
+        bbl_stats_rx_rings_stdout(ctx->op.network_if);
     }
 
     for(i=0; i < ctx->op.access_if_count; i++) {
@@ -222,15 +494,36 @@ bbl_stats_stdout (bbl_ctx_s *ctx, bbl_stats_t * stats) {
             printf("  TX Session IPv6PD: %10lu packets\n", access_if->stats.session_ipv6pd_tx);
             printf("  RX Session IPv6PD: %10lu packets (%lu loss, %lu wrong session)\n", access_if->stats.session_ipv6pd_rx,
                 access_if->stats.session_ipv6pd_loss, access_if->stats.session_ipv6pd_wrong_session);
+            bbl_stats_session_traffic_stdout(access_if);
+            bbl_stats_latency_stdout(access_if);
             printf("  RX Multicast:      %10lu packets (%lu loss)\n", access_if->stats.mc_rx,
                 access_if->stats.mc_loss);
+            bbl_stats_streams_stdout(access_if);
             printf("  RX Drop Unknown:   %10lu packets\n", access_if->stats.packets_rx_drop_unknown);
             printf("  TX Encode Error:   %10lu packets\n", access_if->stats.encode_errors);
             printf("  RX Decode Error:   %10lu packets\n", access_if->stats.packets_rx_drop_decode_error);
+            printf("  RX Fast Path:      %10lu packets\n", access_if->stats.packets_rx_fast_path);
             printf("  TX Send Failed:    %10lu\n", access_if->stats.sendto_failed);
             printf("  TX No Buffer:      %10lu\n", access_if->stats.no_tx_buffer);
             printf("  TX Poll Kernel:    %10lu\n", access_if->stats.poll_tx);
+            bbl_stats_tx_kicks_stdout(access_if);
+            bbl_stats_tx_class_stdout(access_if);
             printf("  RX Poll Kernel:    %10lu\n", access_if->stats.poll_rx);
+            bbl_stats_rx_kernel_stdout(access_if);
+            if(access_if->rx_tpacket_v3) {
+                printf("  RX Blocks:         %10lu (%lu packets per block avg, %u max)\n", access_if->stats.rx_blocks,
+                       access_if->stats.rx_blocks ? access_if->stats.rx_block_packets / access_if->stats.rx_blocks : 0,
+                       access_if->stats.rx_block_packets_max);
+            }
+            if(access_if->io_thread) {
+                printf("  IO RX Queue Full:  %10lu\n", access_if->stats.io_rx_queue_full);
+                if(access_if->io_data) {
+                    printf("  IO Data Queue Full:%10lu\n", access_if->stats.io_data_queue_full);
+                }
+                printf("  IO Loops:          %10lu (%lu empty)\n", access_if->stats.io_loops,
+                       access_if->stats.io_empty_loops);
+            }
+            bbl_stats_rx_rings_stdout(access_if);
             printf("\n  Access Interface Protocol Packet Stats:\n");
             printf("    ARP    TX: %10u RX: %10u\n", access_if->stats.arp_tx, access_if->stats.arp_rx);
             printf("    PADI   TX: %10u RX: %10u\n", access_if->stats.padi_tx, 0);
@@ -281,6 +574,11 @@ bbl_stats_stdout (bbl_ctx_s *ctx, bbl_stats_t * stats) {
         printf("    Network IPv6PD  MIN: %8lu MAX: %8lu\n", stats->min_network_ipv6pd_rx_first_seq, stats->max_network_ipv6pd_rx_first_seq);
     }
 
+    if(ctx->stats.stream_flows) {
+        printf("\nTraffic Streams:\n");
+        printf("  Verified Traffic Flows: %u/%u\n", ctx->stats.stream_flows_verified, ctx->stats.stream_flows);
+    }
+
     if(ctx->config.igmp_group_count > 1) {
         printf("\nIGMP Config:\n");
         printf("  Version: %d\n", ctx->config.igmp_version);
@@ -319,6 +617,7 @@ bbl_stats_json (bbl_ctx_s *ctx, bbl_stats_t * stats) {
     json_t *jobj_l2tp          = NULL;
     json_t *jobj_li            = NULL;
     json_t *jobj_straffic      = NULL;
+    json_t *jobj_streams       = NULL;
     json_t *jobj_multicast     = NULL;
     json_t *jobj_protocols     = NULL;
 
@@ -338,12 +637,23 @@ bbl_stats_json (bbl_ctx_s *ctx, bbl_stats_t * stats) {
     json_object_set(jobj, "setup-rate-cps-avg", json_real(ctx->stats.cps_avg));
     json_object_set(jobj, "setup-rate-cps-max", json_real(ctx->stats.cps_max));
     json_object_set(jobj, "dhcpv6-sessions-established", json_integer(ctx->dhcpv6_established_max));
+    if(ctx->event_loop && ctx->event_loop->busy_poll) {
+        json_object_set(jobj, "busy-poll-loops", json_integer(ctx->event_loop->stats.busy_poll_loops));
+        json_object_set(jobj, "busy-poll-empty-loops", json_integer(ctx->event_loop->stats.busy_poll_empty));
+    }
+    if(ctx->pcap.filename) {
+        json_object_set(jobj, "pcap-packets", json_integer(ctx->pcap.packets));
+        json_object_set(jobj, "pcap-packets-written", json_integer(atomic_load(&ctx->pcap.packets_written)));
+        json_object_set(jobj, "pcap-packets-dropped", json_integer(ctx->pcap.packets_dropped));
+        json_object_set(jobj, "pcap-packets-write-dropped", json_integer(atomic_load(&ctx->pcap.packets_write_dropped)));
+        json_object_set(jobj, "pcap-packets-filtered", json_integer(ctx->pcap.packets_filtered));
+    }
 
     jobj_array = json_array();
     if (ctx->op.network_if) {
-        if(dict_count(ctx->li_flow_dict)) {
+        if(dict_count(ctx->li_flow_dict.dict)) {
             jobj_li = json_object();
-            json_object_set(jobj_li, "flows", json_integer(dict_count(ctx->li_flow_dict)));
+            json_object_set(jobj_li, "flows", json_integer(dict_count(ctx->li_flow_dict.dict)));
             json_object_set(jobj_li, "rx-packets", json_integer(ctx->op.network_if->stats.li_rx));
             json_object_set(jobj, "li-statistics", jobj_li);
         }
@@ -365,6 +675,7 @@ bbl_stats_json (bbl_ctx_s *ctx, bbl_stats_t * stats) {
         json_object_set(jobj_network_if, "name", json_string(ctx->op.network_if->name));
         json_object_set(jobj_network_if, "tx-packets", json_integer(ctx->op.network_if->stats.packets_tx));
         json_object_set(jobj_network_if, "rx-packets", json_integer(ctx->op.network_if->stats.packets_rx));
+        json_object_set(jobj_network_if, "rx-fast-path-packets", json_integer(ctx->op.network_if->stats.packets_rx_fast_path));
         json_object_set(jobj_network_if, "tx-session-packets", json_integer(ctx->op.network_if->stats.session_ipv4_tx));
         json_object_set(jobj_network_if, "rx-session-packets", json_integer(ctx->op.network_if->stats.session_ipv4_rx));
         json_object_set(jobj_network_if, "rx-session-packets-loss", json_integer(ctx->op.network_if->stats.session_ipv4_loss));
@@ -380,7 +691,33 @@ bbl_stats_json (bbl_ctx_s *ctx, bbl_stats_t * stats) {
         json_object_set(jobj_network_if, "rx-session-packets-ipv6pd-loss", json_integer(ctx->op.network_if->stats.session_ipv6pd_loss));
         json_object_set(jobj_network_if, "tx-session-packets-avg-pps-max-ipv6pd", json_integer(ctx->op.network_if->stats.rate_session_ipv6pd_tx.avg_max));
         json_object_set(jobj_network_if, "rx-session-packets-avg-pps-max-ipv6pd", json_integer(ctx->op.network_if->stats.rate_session_ipv6pd_rx.avg_max));
+        bbl_stats_session_traffic_json(ctx->op.network_if, jobj_network_if);
+        bbl_stats_latency_json(ctx->op.network_if, jobj_network_if);
         json_object_set(jobj_network_if, "tx-multicast-packets", json_integer(ctx->op.network_if->stats.mc_tx));
+        if(ctx->op.network_if->mc_calendar) {
+            json_object_set(jobj_network_if, "tx-multicast-streams", json_integer(ctx->op.network_if->mc_stream_count));
+            json_object_set(jobj_network_if, "tx-multicast-deferred", json_integer(ctx->op.network_if->mc_calendar->stats.deferred));
+            json_object_set(jobj_network_if, "tx-multicast-late", json_integer(ctx->op.network_if->mc_calendar->stats.late));
+        }
+        bbl_stats_streams_json(ctx->op.network_if, jobj_network_if);
+        bbl_stats_tx_kicks_json(ctx->op.network_if, jobj_network_if);
+        bbl_stats_tx_class_json(ctx->op.network_if, jobj_network_if);
+        bbl_stats_rx_kernel_json(ctx->op.network_if, jobj_network_if);
+        if(ctx->op.network_if->rx_tpacket_v3) {
+            json_object_set(jobj_network_if, "rx-blocks", json_integer(ctx->op.network_if->stats.rx_blocks));
+            json_object_set(jobj_network_if, "rx-block-packets-avg", json_integer(ctx->op.network_if->stats.rx_blocks ?
+                            ctx->op.network_if->stats.rx_block_packets / ctx->op.network_if->stats.rx_blocks : 0));
+            json_object_set(jobj_network_if, "rx-block-packets-max", json_integer(ctx->op.network_if->stats.rx_block_packets_max));
+        }
+        if(ctx->op.network_if->io_thread) {
+            json_object_set(jobj_network_if, "io-rx-queue-full", json_integer(ctx->op.network_if->stats.io_rx_queue_full));
+            json_object_set(jobj_network_if, "io-data-queue-full", json_integer(ctx->op.network_if->stats.io_data_queue_full));
+            json_object_set(jobj_network_if, "io-loops", json_integer(ctx->op.network_if->stats.io_loops));
+            json_object_set(jobj_network_if, "io-empty-loops", json_integer(ctx->op.network_if->stats.io_empty_loops));
+        }
+        if(ctx->op.network_if->rx_ring_count > 1) {
+            json_object_set(jobj_network_if, "rx-rings", bbl_stats_rx_rings_json(ctx->op.network_if));
+        }
         json_array_append(jobj_array, jobj_network_if);
     }
     json_object_set(jobj, "network-interfaces", jobj_array);
@@ -393,6 +730,7 @@ bbl_stats_json (bbl_ctx_s *ctx, bbl_stats_t * stats) {
             json_object_set(jobj_access_if, "name", json_string(access_if->name));
             json_object_set(jobj_access_if, "tx-packets", json_integer(access_if->stats.packets_tx));
             json_object_set(jobj_access_if, "rx-packets", json_integer(access_if->stats.packets_rx));
+            json_object_set(jobj_access_if, "rx-fast-path-packets", json_integer(access_if->stats.packets_rx_fast_path));
             json_object_set(jobj_access_if, "tx-session-packets", json_integer(access_if->stats.session_ipv4_tx));
             json_object_set(jobj_access_if, "rx-session-packets", json_integer(access_if->stats.session_ipv4_rx));
             json_object_set(jobj_access_if, "rx-session-packets-loss", json_integer(access_if->stats.session_ipv4_loss));
@@ -411,8 +749,29 @@ bbl_stats_json (bbl_ctx_s *ctx, bbl_stats_t * stats) {
             json_object_set(jobj_access_if, "rx-session-packets-ipv6pd-wrong-session", json_integer(access_if->stats.session_ipv6pd_wrong_session));
             json_object_set(jobj_access_if, "tx-session-packets-avg-pps-max-ipv6pd", json_integer(access_if->stats.rate_session_ipv6pd_tx.avg_max));
             json_object_set(jobj_access_if, "rx-session-packets-avg-pps-max-ipv6pd", json_integer(access_if->stats.rate_session_ipv6pd_rx.avg_max));
+            bbl_stats_session_traffic_json(access_if, jobj_access_if);
+            bbl_stats_latency_json(access_if, jobj_access_if);
             json_object_set(jobj_access_if, "rx-multicast-packets", json_integer(access_if->stats.mc_rx));
             json_object_set(jobj_access_if, "rx-multicast-packets-loss", json_integer(access_if->stats.mc_loss));
+            bbl_stats_streams_json(access_if, jobj_access_if);
+            bbl_stats_tx_kicks_json(access_if, jobj_access_if);
+            bbl_stats_tx_class_json(access_if, jobj_access_if);
+            bbl_stats_rx_kernel_json(access_if, jobj_access_if);
+            if(access_if->rx_tpacket_v3) {
+                json_object_set(jobj_access_if, "rx-blocks", json_integer(access_if->stats.rx_blocks));
+                json_object_set(jobj_access_if, "rx-block-packets-avg", json_integer(access_if->stats.rx_blocks ?
+                                access_if->stats.rx_block_packets / access_if->stats.rx_blocks : 0));
+                json_object_set(jobj_access_if, "rx-block-packets-max", json_integer(access_if->stats.rx_block_packets_max));
+            }
+            if(access_if->io_thread) {
+                json_object_set(jobj_access_if, "io-rx-queue-full", json_integer(access_if->stats.io_rx_queue_full));
+                json_object_set(jobj_access_if, "io-data-queue-full", json_integer(access_if->stats.io_data_queue_full));
+                json_object_set(jobj_access_if, "io-loops", json_integer(access_if->stats.io_loops));
+                json_object_set(jobj_access_if, "io-empty-loops", json_integer(access_if->stats.io_empty_loops));
+            }
+            if(access_if->rx_ring_count > 1) {
+                json_object_set(jobj_access_if, "rx-rings", bbl_stats_rx_rings_json(access_if));
+            }
             jobj_protocols = json_object();
             json_object_set(jobj_protocols, "arp-tx", json_integer(access_if->stats.arp_tx));
             json_object_set(jobj_protocols, "arp-rx", json_integer(access_if->stats.arp_rx));
@@ -481,6 +840,12 @@ bbl_stats_json (bbl_ctx_s *ctx, bbl_stats_t * stats) {
         json_object_set(jobj_straffic, "first-seq-rx-network-ipv6pd-max", json_integer(stats->max_network_ipv6pd_rx_first_seq));
         json_object_set(jobj, "session-traffic", jobj_straffic);
     }
+    if(ctx->stats.stream_flows) {
+        jobj_streams = json_object();
+        json_object_set(jobj_streams, "total-flows", json_integer(ctx->stats.stream_flows));
+        json_object_set(jobj_streams, "verified-flows", json_integer(ctx->stats.stream_flows_verified));
+        json_object_set(jobj, "traffic-streams", jobj_streams);
+    }
     if(ctx->config.igmp_group_count > 1) {
         jobj_multicast = json_object();
         json_object_set(jobj_multicast, "config-version", json_integer(ctx->config.igmp_version));
@@ -548,6 +913,7 @@ bbl_compute_interface_rate_job (timer_s *timer)
 
     interface = timer->data;
 
+    bbl_stats_update_kernel(interface);
     bbl_compute_avg_rate(&interface->stats.rate_packets_tx, interface->stats.packets_tx);
     bbl_compute_avg_rate(&interface->stats.rate_packets_rx, interface->stats.packets_rx);
     bbl_compute_avg_rate(&interface->stats.rate_session_ipv4_tx, interface->stats.session_ipv4_tx);
@@ -557,6 +923,8 @@ bbl_compute_interface_rate_job (timer_s *timer)
     bbl_compute_avg_rate(&interface->stats.rate_session_ipv6pd_tx, interface->stats.session_ipv6pd_tx);
     bbl_compute_avg_rate(&interface->stats.rate_session_ipv6pd_rx, interface->stats.session_ipv6pd_rx);
     bbl_compute_avg_rate(&interface->stats.rate_mc_rx, interface->stats.mc_rx);
+    bbl_compute_avg_rate(&interface->stats.rate_stream_tx, interface->stats.stream_tx);
+    bbl_compute_avg_rate(&interface->stats.rate_stream_rx, interface->stats.stream_rx);
     if(!interface->access) {
         bbl_compute_avg_rate(&interface->stats.rate_mc_tx, interface->stats.mc_tx);
         bbl_compute_avg_rate(&interface->stats.rate_l2tp_data_rx, interface->stats.l2tp_data_rx);
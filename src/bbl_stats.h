@@ -10,6 +10,8 @@
 #ifndef __BBL_STATS_H__
 #define __BBL_STATS_H__
 
+#include <jansson.h>
+
 typedef struct bbl_stats_ {
     uint32_t min_join_delay; // IGMP join delay
     uint32_t avg_join_delay; // IGMP join delay
@@ -44,9 +46,11 @@ typedef struct bbl_stats_ {
 } bbl_stats_t;
 
 void bbl_stats_update_cps (bbl_ctx_s *ctx);
+void bbl_stats_update_kernel(bbl_interface_s *interface);
 void bbl_stats_generate(bbl_ctx_s *ctx, bbl_stats_t *stats);
 void bbl_stats_stdout(bbl_ctx_s *ctx, bbl_stats_t *stats);
 void bbl_stats_json(bbl_ctx_s *ctx, bbl_stats_t *stats);
 void bbl_compute_interface_rate_job(timer_s *timer);
+void bbl_stats_latency_histogram_json(bbl_latency_histogram_s *histogram, const char *prefix, json_t *jobj);
 
 #endif
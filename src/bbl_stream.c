@@ -0,0 +1,484 @@
+/*
+ * BNG Blaster (BBL) - Traffic Streams
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include "bbl.h"
+#include "bbl_pcap.h"
+
+static const ipv6addr_t ipv6_zero = {0};
+
+/*
+ * Maximum frame length which fits into a TX frame of the interface.
+ */
+static uint16_t
+bbl_stream_max_len (bbl_interface_s *interface)
+{
+    uint32_t max_len;
+
+    if(interface->io_mode == BBL_IO_AF_XDP) {
+        max_len = BBL_XDP_FRAME_SIZE;
+    } else {
+        max_len = interface->req_tx.tp_frame_size;
+    }
+    max_len -= TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    if(max_len > BBL_STREAM_MAX_LEN) {
+        max_len = BBL_STREAM_MAX_LEN;
+    }
+    return max_len;
+}
+
+/*
+ * Check if the session and the network interface are ready to
+ * send and receive the traffic of the stream.
+ */
+static bool
+bbl_stream_ready (bbl_ctx_s *ctx, bbl_stream_s *stream)
+{
+    bbl_session_s *session = stream->session;
+    bbl_interface_s *network_if = ctx->op.network_if;
+
+    if(session->session_state != BBL_ESTABLISHED || !session->session_traffic) {
+        return false;
+    }
+    if(stream->direction == BBL_STREAM_DIRECTION_DOWN && session->l2tp) {
+        return false;
+    }
+    switch(stream->config->type) {
+        case BBL_SUB_TYPE_IPV4:
+            if(session->access_type == ACCESS_TYPE_PPPOE && session->ipcp_state != BBL_PPP_OPENED) {
+                return false;
+            }
+            if(!session->ip_address || !network_if->ip) {
+                return false;
+            }
+            if(stream->direction == BBL_STREAM_DIRECTION_DOWN && !network_if->arp_resolved) {
+                return false;
+            }
+            break;
+        case BBL_SUB_TYPE_IPV6:
+        case BBL_SUB_TYPE_IPV6PD:
+            if(session->access_type == ACCESS_TYPE_PPPOE && session->ip6cp_state != BBL_PPP_OPENED) {
+                return false;
+            }
+            if(stream->config->type == BBL_SUB_TYPE_IPV6) {
+                if(!session->ipv6_prefix.len) {
+                    return false;
+                }
+            } else if(!session->delegated_ipv6_prefix.len) {
+                return false;
+            }
+            if(!network_if->ip6.len) {
+                return false;
+            }
+            if(stream->direction == BBL_STREAM_DIRECTION_DOWN && !network_if->icmpv6_nd_resolved) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Encode the packet template of the stream, padded to the
+ * configured frame length if larger than the minimum length.
+ */
+static bool
+bbl_stream_encode (bbl_ctx_s *ctx, bbl_stream_s *stream)
+{
+    bbl_session_s *session = stream->session;
+    bbl_interface_s *network_if = ctx->op.network_if;
+    bbl_stream_config_s *config = stream->config;
+    bbl_ethernet_header_t eth = {0};
+    bbl_pppoe_session_t pppoe = {0};
+    bbl_ipv4_t ipv4 = {0};
+    bbl_ipv6_t ipv6 = {0};
+    bbl_udp_t udp = {0};
+    bbl_bbl_t bbl = {0};
+    uint8_t buf[BBL_STREAM_MAX_LEN];
+    uint16_t len = 0;
+    uint16_t min_len = 0;
+    uint32_t network_ipv4;
+    uint8_t *network_ipv6;
+    uint8_t *session_ipv6;
+    void *ip;
+
+    /* Init BBL Session Key */
+    bbl.type = BBL_TYPE_UNICAST_SESSION;
+    bbl.sub_type = config->type;
+    bbl.tos = config->priority;
+    bbl.ifindex = session->key.ifindex;
+    bbl.outer_vlan_id = session->key.outer_vlan_id;
+    bbl.inner_vlan_id = session->key.inner_vlan_id;
+    bbl.flow_id = stream->flow_id;
+
+    udp.src = BBL_UDP_PORT;
+    udp.dst = BBL_UDP_PORT;
+    udp.protocol = UDP_PROTOCOL_BBL;
+    udp.next = &bbl;
+
+    if(config->type == BBL_SUB_TYPE_IPV4) {
+        network_ipv4 = config->ipv4_network_address ? config->ipv4_network_address : network_if->ip;
+        ipv4.tos = config->priority;
+        ipv4.ttl = 64;
+        ipv4.protocol = PROTOCOL_IPV4_UDP;
+        ipv4.next = &udp;
+        ip = &ipv4;
+    } else {
+        if(memcmp(config->ipv6_network_address, ipv6_zero, IPV6_ADDR_LEN)) {
+            network_ipv6 = config->ipv6_network_address;
+        } else {
+            network_ipv6 = network_if->ip6.address;
+        }
+        if(config->type == BBL_SUB_TYPE_IPV6PD) {
+            session_ipv6 = session->delegated_ipv6_address;
+        } else {
+            session_ipv6 = session->ipv6_address;
+        }
+        ipv6.tos = config->priority;
+        ipv6.ttl = 64;
+        ipv6.protocol = IPV6_NEXT_HEADER_UDP;
+        ipv6.next = &udp;
+        ip = &ipv6;
+    }
+
+    if(stream->direction == BBL_STREAM_DIRECTION_UP) {
+        /* Access (Session) to Network */
+        bbl.direction = BBL_DIRECTION_UP;
+        eth.dst = session->server_mac;
+        eth.src = session->client_mac;
+        eth.vlan_outer = session->key.outer_vlan_id;
+        eth.vlan_inner = session->key.inner_vlan_id;
+        eth.vlan_three = session->access_third_vlan;
+        if(session->access_type == ACCESS_TYPE_PPPOE) {
+            eth.type = ETH_TYPE_PPPOE_SESSION;
+            eth.next = &pppoe;
+            pppoe.session_id = session->pppoe_session_id;
+            pppoe.protocol = config->type == BBL_SUB_TYPE_IPV4 ? PROTOCOL_IPV4 : PROTOCOL_IPV6;
+            pppoe.next = ip;
+        } else {
+            eth.type = config->type == BBL_SUB_TYPE_IPV4 ? ETH_TYPE_IPV4 : ETH_TYPE_IPV6;
+            eth.next = ip;
+        }
+        if(config->type == BBL_SUB_TYPE_IPV4) {
+            ipv4.src = session->ip_address;
+            ipv4.dst = network_ipv4;
+        } else {
+            ipv6.src = session_ipv6;
+            ipv6.dst = network_ipv6;
+        }
+    } else {
+        /* Network to Access (Session) */
+        bbl.direction = BBL_DIRECTION_DOWN;
+        eth.dst = network_if->gateway_mac;
+        eth.src = network_if->mac;
+        eth.vlan_outer = ctx->config.network_vlan;
+        eth.type = config->type == BBL_SUB_TYPE_IPV4 ? ETH_TYPE_IPV4 : ETH_TYPE_IPV6;
+        eth.next = ip;
+        if(config->type == BBL_SUB_TYPE_IPV4) {
+            ipv4.src = network_ipv4;
+            ipv4.dst = session->ip_address;
+        } else {
+            ipv6.src = network_ipv6;
+            ipv6.dst = session_ipv6;
+        }
+    }
+
+    if(encode_ethernet(buf, &min_len, &eth) != PROTOCOL_SUCCESS) {
+        return false;
+    }
+    len = min_len;
+    if(config->length > min_len) {
+        bbl.padding = config->length - min_len;
+        len = 0;
+        if(encode_ethernet(buf, &len, &eth) != PROTOCOL_SUCCESS) {
+            return false;
+        }
+    }
+    if(stream->buf_len < len) {
+        /* The old template stays in the arena. */
+        stream->buf = bbl_arena_alloc(&ctx->stream_arena, len, sizeof(uint64_t));
+        if(!stream->buf) {
+            stream->buf_len = 0;
+            return false;
+        }
+        stream->buf_len = len;
+    }
+    memcpy(stream->buf, buf, len);
+    /* The BBL header is the last header followed by the padding. */
+    stream->seq_offset = min_len - 16;
+    stream->tx_len = len;
+    return true;
+}
+
+/*
+ * Calendar send callback. Streams of sessions which are not
+ * established are skipped, which keeps them scheduled without
+ * accounting them as sent, such that traffic starts as soon
+ * as the session is ready.
+ */
+static bbl_calendar_result_t
+bbl_stream_send (bbl_calendar_entry_s *entry, void *arg)
+{
+    bbl_interface_s *interface = arg;
+    bbl_stream_s *stream = (bbl_stream_s*)entry;
+    bbl_ctx_s *ctx = interface->ctx;
+    struct tpacket2_hdr* tphdr;
+    u_char *frame_ptr;
+    uint8_t *buf;
+
+    if(!bbl_stream_ready(ctx, stream)) {
+        /* Addresses may change, rebuild the template when ready again. */
+        stream->tx_len = 0;
+        return BBL_CALENDAR_SKIPPED;
+    }
+    if(!stream->tx_len) {
+        if(!bbl_stream_encode(ctx, stream)) {
+            interface->stats.encode_errors++;
+            return BBL_CALENDAR_SKIPPED;
+        }
+    }
+
+    frame_ptr = bbl_tx_frame_get(interface, BBL_TX_CLASS_DATA);
+    if(!frame_ptr) {
+        return BBL_CALENDAR_DEFERRED;
+    }
+    buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    memcpy(buf, stream->buf, stream->tx_len);
+    *(uint64_t*)(buf + stream->seq_offset) = ++stream->flow_seq;
+    *(uint32_t*)(buf + stream->seq_offset + 8) = interface->tx_timestamp.tv_sec;
+    *(uint32_t*)(buf + stream->seq_offset + 12) = interface->tx_timestamp.tv_nsec;
+    tphdr = (struct tpacket2_hdr *)frame_ptr;
+    tphdr->tp_len = stream->tx_len;
+    tphdr->tp_status = TP_STATUS_SEND_REQUEST;
+    interface->stats.stream_tx++;
+    stream->stats.packets_tx++;
+    bbl_tx_frame_commit(interface, BBL_TX_CLASS_DATA);
+    /* Dump the packet into PCAP file. */
+    if (ctx->pcap.enabled) {
+        pcapng_push_packet_header(ctx, &interface->tx_timestamp, buf,
+                                  tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
+    }
+    return BBL_CALENDAR_SENT;
+}
+
+static bool
+bbl_stream_add (bbl_ctx_s *ctx, bbl_session_s *session, bbl_stream_config_s *config, bbl_stream_direction_t direction)
+{
+    bbl_interface_s *interface;
+    bbl_stream_s *stream;
+    dict_insert_result result;
+    uint64_t now;
+
+    if(direction == BBL_STREAM_DIRECTION_UP) {
+        interface = session->interface;
+    } else {
+        interface = ctx->op.network_if;
+    }
+    if(config->length > bbl_stream_max_len(interface)) {
+        LOG(ERROR, "Stream %s length %u exceeds the maximum of %u bytes on interface %s\n",
+            config->name, config->length, bbl_stream_max_len(interface), interface->name);
+        return false;
+    }
+
+    stream = bbl_arena_alloc(&ctx->stream_arena, sizeof(bbl_stream_s), sizeof(uint64_t));
+    if(!stream) {
+        return false;
+    }
+    memset(stream, 0x0, sizeof(bbl_stream_s));
+    stream->config = config;
+    stream->session = session;
+    stream->interface = interface;
+    stream->direction = direction;
+    stream->flow_id = ctx->flow_id++;
+
+    bbl_dict_reserve(&ctx->stream_flow_dict);
+    result = dict_insert(ctx->stream_flow_dict.dict, &stream->flow_id);
+    if (!result.inserted) {
+        return false;
+    }
+    *result.datum_ptr = stream;
+
+    now = bbl_calendar_now();
+    if(!interface->stream_calendar) {
+        interface->stream_calendar = bbl_calendar_new(BBL_CALENDAR_TICK_NSEC, now);
+        if(!interface->stream_calendar) {
+            return false;
+        }
+    }
+    /* Spread the streams of an interface over their interval. */
+    stream->entry.interval = BBL_CALENDAR_NSEC_PER_SEC / config->pps;
+    stream->entry.expire = now + (stream->entry.interval * (interface->stream_count & 0xff)) / 256;
+    bbl_calendar_add(interface->stream_calendar, &stream->entry);
+    interface->stream_count++;
+
+    stream->session_next = session->cold->streams;
+    session->cold->streams = stream;
+    ctx->stats.stream_flows++;
+    return true;
+}
+
+/*
+ * Add all streams of the stream group referred by
+ * the access configuration of the session.
+ */
+bool
+bbl_stream_add_session (bbl_ctx_s *ctx, bbl_session_s *session)
+{
+    bbl_stream_config_s *config = ctx->config.stream_config;
+    uint16_t stream_group_id = session->cold->access_config->stream_group_id;
+
+    if(!stream_group_id) {
+        return true;
+    }
+    for(; config; config = config->next) {
+        if(config->stream_group_id != stream_group_id) {
+            continue;
+        }
+        if(!ctx->op.network_if) {
+            LOG(ERROR, "Stream %s requires a network interface\n", config->name);
+            return false;
+        }
+        if(config->direction & BBL_STREAM_DIRECTION_UP) {
+            if(!bbl_stream_add(ctx, session, config, BBL_STREAM_DIRECTION_UP)) {
+                return false;
+            }
+        }
+        if(config->direction & BBL_STREAM_DIRECTION_DOWN) {
+            if(!bbl_stream_add(ctx, session, config, BBL_STREAM_DIRECTION_DOWN)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Send all stream packets which are due. The run stops
+ * if the TX ring is full and continues with the next TX job.
+ */
+void
+bbl_stream_tx (bbl_interface_s *interface)
+{
+    bbl_calendar_run(interface->stream_calendar, bbl_calendar_now(), bbl_stream_send, interface);
+}
+
+/*
+ * Account a received stream packet. Returns false if the
+ * packet does not belong to a stream, which leaves it to
+ * the session traffic receive handlers. Also called by the
+ * I/O threads if the data plane is enabled.
+ */
+bool
+bbl_stream_rx (bbl_interface_s *interface, bbl_io_thread_s *io_thread, bbl_bbl_t *bbl)
+{
+    bbl_ctx_s *ctx = interface->ctx;
+    bbl_interface_stats_s *stats = BBL_IO_STATS(interface, io_thread);
+    bbl_stream_s *stream;
+    void **search;
+
+    if(!ctx->config.stream_config) {
+        return false;
+    }
+    search = dict_search(ctx->stream_flow_dict.dict, &bbl->flow_id);
+    if(!search) {
+        return false;
+    }
+    stream = *search;
+    stats->stream_rx++;
+    stream->stats.packets_rx++;
+    if(!stream->rx_first_seq) {
+        stream->rx_first_seq = bbl->flow_seq;
+        __atomic_fetch_add(&ctx->stats.stream_flows_verified, 1, __ATOMIC_RELAXED);
+    } else if(stream->rx_last_seq +1 != bbl->flow_seq) {
+        stats->stream_loss++;
+        stream->stats.loss++;
+        if(!io_thread) {
+            LOG(LOSS, "LOSS (Q-in-Q %u:%u) stream: %s flow: %lu seq: %lu last: %lu\n",
+                stream->session->key.outer_vlan_id, stream->session->key.inner_vlan_id,
+                stream->config->name, bbl->flow_id, bbl->flow_seq, stream->rx_last_seq);
+        }
+    }
+    stream->rx_last_seq = bbl->flow_seq;
+    return true;
+}
+
+/*
+ * Invalidate the packet templates of all streams of the session,
+ * which are encoded again with the next send. Called with every
+ * session state change, as the session may come up again with
+ * another server MAC, PPPoE session or addresses.
+ */
+void
+bbl_stream_reset (bbl_session_s *session)
+{
+    bbl_stream_s *stream;
+
+    for(stream = session->cold->streams; stream; stream = stream->session_next) {
+        stream->tx_len = 0;
+    }
+}
+
+/*
+ * Pass the streams of the session sent by the data plane of I/O
+ * threads to those (control thread). Ready streams get a copy of
+ * the template, which is encoded again after every session state
+ * change, all others are told to stop.
+ */
+void
+bbl_stream_io_update (bbl_ctx_s *ctx, bbl_session_s *session)
+{
+    bbl_stream_s *stream;
+    bbl_io_data_msg_s msg;
+    bool ready;
+
+    for(stream = session->cold->streams; stream; stream = stream->session_next) {
+        if(!stream->interface->io_data) {
+            continue;
+        }
+        ready = bbl_stream_ready(ctx, stream);
+        if(ready && (!stream->io_active || !stream->tx_len)) {
+            if(!bbl_stream_encode(ctx, stream)) {
+                stream->interface->stats.encode_errors++;
+                if(!stream->io_active) {
+                    continue;
+                }
+                ready = false;
+            }
+        } else if(ready || !stream->io_active) {
+            continue;
+        }
+        memset(&msg, 0x0, sizeof(msg));
+        msg.type = BBL_IO_DATA_STREAM;
+        msg.object = stream;
+        if(ready) {
+            msg.template = malloc(stream->tx_len);
+            if(!msg.template) {
+                continue;
+            }
+            memcpy(msg.template, stream->buf, stream->tx_len);
+            msg.len = stream->tx_len;
+            msg.seq_offset = stream->seq_offset;
+        } else {
+            stream->tx_len = 0;
+        }
+        stream->io_active = ready;
+        bbl_io_thread_data_update(stream->interface, &msg);
+    }
+}
+
+void
+bbl_stream_free (bbl_interface_s *interface)
+{
+    /* Streams and their templates are freed with the stream arena. */
+    if(interface->stream_calendar) {
+        bbl_calendar_free(interface->stream_calendar);
+        interface->stream_calendar = NULL;
+        interface->stream_count = 0;
+    }
+}
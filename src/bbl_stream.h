@@ -0,0 +1,94 @@
+/*
+ * BNG Blaster (BBL) - Traffic Streams
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_STREAM_H__
+#define __BBL_STREAM_H__
+
+#define BBL_STREAM_MAX_LEN          9000
+
+typedef struct bbl_ctx_ bbl_ctx_s;
+typedef struct bbl_interface_ bbl_interface_s;
+typedef struct bbl_session_ bbl_session_s;
+
+typedef enum {
+    BBL_STREAM_DIRECTION_UP     = 1,
+    BBL_STREAM_DIRECTION_DOWN   = 2,
+    BBL_STREAM_DIRECTION_BOTH   = 3
+} __attribute__ ((__packed__)) bbl_stream_direction_t;
+
+/*
+ * Stream configuration (one per entry of the streams
+ * configuration section). All streams with the same
+ * group identifier are added to each session of the
+ * access configurations referring to this group.
+ */
+typedef struct bbl_stream_config_
+{
+    char *name;
+    uint16_t stream_group_id;
+    uint8_t type; /* BBL_SUB_TYPE_IPV4, IPV6 or IPV6PD */
+    bbl_stream_direction_t direction;
+    uint8_t priority; /* IPv4 TOS or IPv6 traffic class */
+    uint16_t length; /* ethernet frame length without FCS */
+    uint32_t pps;
+
+    /* Network address used instead of the network interface address. */
+    uint32_t ipv4_network_address;
+    ipv6addr_t ipv6_network_address;
+
+    void *next; /* next stream config */
+} bbl_stream_config_s;
+
+/*
+ * Stream of one session and direction, scheduled
+ * by the calendar of the sending interface.
+ */
+typedef struct bbl_stream_
+{
+    bbl_calendar_entry_s entry; /* must be first */
+    bbl_stream_config_s *config;
+    bbl_session_s *session;
+    bbl_interface_s *interface; /* sending interface */
+    bbl_stream_direction_t direction;
+
+    uint64_t flow_id;
+    uint64_t flow_seq;
+
+    uint8_t *buf; /* packet template */
+    uint16_t buf_len;
+    uint16_t tx_len; /* 0 if the template must be (re)build */
+    uint16_t seq_offset; /* offset of the BBL flow sequence */
+
+    /* Template passed to the sending I/O thread (control thread). */
+    bool io_active;
+
+    /* Private to the sending I/O thread. */
+    uint8_t *io_buf;
+    uint16_t io_len; /* 0 if stopped */
+    uint16_t io_seq_offset;
+
+    uint64_t rx_first_seq;
+    uint64_t rx_last_seq;
+
+    struct {
+        uint64_t packets_tx;
+        uint64_t packets_rx;
+        uint64_t loss;
+    } stats;
+
+    struct bbl_stream_ *session_next; /* next stream of the session */
+} bbl_stream_s;
+
+bool bbl_stream_add_session(bbl_ctx_s *ctx, bbl_session_s *session);
+void bbl_stream_tx(bbl_interface_s *interface);
+bool bbl_stream_rx(bbl_interface_s *interface, bbl_io_thread_s *io_thread, bbl_bbl_t *bbl);
+void bbl_stream_reset(bbl_session_s *session);
+void bbl_stream_io_update(bbl_ctx_s *ctx, bbl_session_s *session);
+void bbl_stream_free(bbl_interface_s *interface);
+
+#endif
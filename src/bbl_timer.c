@@ -98,6 +98,28 @@ timer_change (timer_s *timer)
     timer->on_change_list = true;
 }
 
+static inline uint
+timer_bucket_hash (time_t sec, long nsec)
+{
+    uint64_t key;
+
+    key = (uint64_t)sec * 1000000000ULL + nsec;
+    return (key * 0x9E3779B97F4A7C15ULL) >> (64 - TIMER_BUCKET_HASH_BITS);
+}
+
+static timer_bucket_s *
+timer_bucket_lookup (timer_root_s *root, time_t sec, long nsec)
+{
+    timer_bucket_s *timer_bucket;
+
+    LIST_FOREACH(timer_bucket, &root->timer_bucket_hash[timer_bucket_hash(sec, nsec)], timer_bucket_hash_qnode) {
+        if (timer_bucket->sec == sec && timer_bucket->nsec == nsec) {
+            return timer_bucket;
+        }
+    }
+    return NULL;
+}
+
 void
 timer_enqueue_bucket (timer_root_s *root, timer_s *timer, time_t sec, long nsec)
 {
@@ -106,14 +128,8 @@ timer_enqueue_bucket (timer_root_s *root, timer_s *timer, time_t sec, long nsec)
     /*
      * Find the bucket for insertion.
      */
-    CIRCLEQ_FOREACH(timer_bucket, &root->timer_bucket_qhead, timer_bucket_qnode) {
-        if (timer_bucket->sec != sec ||  timer_bucket->nsec != nsec) {
-            continue;
-        }
-
-        /*
-         * Found it !
-         */
+    timer_bucket = timer_bucket_lookup(root, sec, nsec);
+    if (timer_bucket) {
         goto insert;
     }
 
@@ -126,6 +142,7 @@ timer_enqueue_bucket (timer_root_s *root, timer_s *timer, time_t sec, long nsec)
     }
 
     CIRCLEQ_INSERT_TAIL(&root->timer_bucket_qhead, timer_bucket, timer_bucket_qnode);
+    LIST_INSERT_HEAD(&root->timer_bucket_hash[timer_bucket_hash(sec, nsec)], timer_bucket, timer_bucket_hash_qnode);
     CIRCLEQ_INIT(&timer_bucket->timer_qhead);
     timer_bucket->sec = sec;
     timer_bucket->nsec = nsec;
@@ -156,37 +173,35 @@ timer_smear_bucket (timer_root_s *root, time_t sec, long nsec)
     /*
      * Find the bucket for smearing.
      */
-    CIRCLEQ_FOREACH(timer_bucket, &root->timer_bucket_qhead, timer_bucket_qnode) {
-        if (timer_bucket->sec != sec ||  timer_bucket->nsec != nsec) {
-            continue;
-        }
+    timer_bucket = timer_bucket_lookup(root, sec, nsec);
+    if (!timer_bucket) {
+        return;
+    }
 
-        /*
-         * Found the bucket. Next compute the timespan between now and last timer.
-         */
-        last_timer = CIRCLEQ_LAST(&timer_bucket->timer_qhead);
-        if (!last_timer) {
-            return;
-        }
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        timespec_sub(&diff, &last_timer->expire, &now);
-        step_nsec = (diff.tv_sec * 1e9 + diff.tv_nsec) / (timer_bucket->timers); /* calculate smear step */
-        step.tv_sec = step_nsec / 1e9;
-        step.tv_nsec = step_nsec - (step.tv_sec * 1e9);
+    /*
+     * Found the bucket. Next compute the timespan between now and last timer.
+     */
+    last_timer = CIRCLEQ_LAST(&timer_bucket->timer_qhead);
+    if (!last_timer) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    timespec_sub(&diff, &last_timer->expire, &now);
+    step_nsec = (diff.tv_sec * 1e9 + diff.tv_nsec) / (timer_bucket->timers); /* calculate smear step */
+    step.tv_sec = step_nsec / 1e9;
+    step.tv_nsec = step_nsec - (step.tv_sec * 1e9);
 
-        LOG(TIMER_DETAIL, "Smear %u timers in bucket %lu.%06lus\n", timer_bucket->timers, sec, nsec);
-        LOG(TIMER_DETAIL, "Now %s, last expire %s, step %s\n", timespec_format(&now),
-                          timespec_format(&last_timer->expire), timespec_format(&step));
+    LOG(TIMER_DETAIL, "Smear %u timers in bucket %lu.%06lus\n", timer_bucket->timers, sec, nsec);
+    LOG(TIMER_DETAIL, "Now %s, last expire %s, step %s\n", timespec_format(&now),
+                      timespec_format(&last_timer->expire), timespec_format(&step));
 
-        /*
-        * Now walk all timers and space them <step> apart.
-        */
-        CIRCLEQ_FOREACH(timer, &timer_bucket->timer_qhead, timer_qnode) {
-            timespec_add(&timer->expire, &now, &step);
-            now = timer->expire;
-            LOG(TIMER_DETAIL, "  Smear %s -> expire %s\n", timer->name, timespec_format(&timer->expire));
-        }
-	    return;
+    /*
+     * Now walk all timers and space them <step> apart.
+     */
+    CIRCLEQ_FOREACH(timer, &timer_bucket->timer_qhead, timer_qnode) {
+        timespec_add(&timer->expire, &now, &step);
+        now = timer->expire;
+        LOG(TIMER_DETAIL, "  Smear %s -> expire %s\n", timer->name, timespec_format(&timer->expire));
     }
 }
 
@@ -211,6 +226,7 @@ timer_dequeue_bucket (timer_s *timer)
      */
     if (!timer_bucket->timers) {
 	CIRCLEQ_REMOVE(&timer_root->timer_bucket_qhead, timer_bucket, timer_bucket_qnode);
+	LIST_REMOVE(timer_bucket, timer_bucket_hash_qnode);
 
 	LOG(TIMER_DETAIL, "  Delete timer bucket %lu.%06lus\n",
 	    timer_bucket->sec, timer_bucket->nsec/1000);
@@ -248,6 +264,47 @@ timer_requeue (timer_s *timer, time_t sec, long nsec)
     LOG(TIMER_DETAIL, "  Reset %s timer, expire in %lu.%06lus\n", timer->name, sec, nsec/1000);
 }
 
+/*
+ * Restart an expired periodic timer relative to its previous
+ * expiration such that the configured interval is kept on
+ * average, independent of how late the timer walk fired it.
+ * Timers which have fallen behind by more than one interval
+ * are restarted from now to avoid a burst of callbacks.
+ *
+ * All timers of a bucket share the same interval, hence the timer
+ * is appended to the tail of the bucket queue in O(1). If a timer
+ * was added to the bucket after this one became due, the new
+ * expiration is aligned to the tail to keep the queue sorted,
+ * which delays it at most by the lateness of the timer walk.
+ */
+void
+timer_rearm (timer_s *timer)
+{
+    timer_bucket_s *timer_bucket;
+    timer_s *last;
+    struct timespec now, interval;
+
+    timer_bucket = timer->timer_bucket;
+    interval.tv_sec = timer_bucket->sec;
+    interval.tv_nsec = timer_bucket->nsec;
+    timespec_add(&timer->expire, &timer->expire, &interval);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_compare(&timer->expire, &now) != 1) {
+        timespec_add(&timer->expire, &now, &interval);
+    }
+    timer->expired = false;
+
+    CIRCLEQ_REMOVE(&timer_bucket->timer_qhead, timer, timer_qnode);
+    if (!CIRCLEQ_EMPTY(&timer_bucket->timer_qhead)) {
+        last = CIRCLEQ_LAST(&timer_bucket->timer_qhead);
+        if (timespec_compare(&last->expire, &timer->expire) == 1) {
+            timer->expire = last->expire;
+        }
+    }
+    CIRCLEQ_INSERT_TAIL(&timer_bucket->timer_qhead, timer, timer_qnode);
+}
+
 /*
  * We do not delete timers, but rather dequeue them and move them to
  * the garbage collection queue, where they may get recycled.
@@ -313,11 +370,9 @@ void
 timer_process_changes (timer_root_s *root)
 {
     timer_s *timer;
-    timer_bucket_s *timer_bucket;
 
     while (!CIRCLEQ_EMPTY(&root->timer_change_qhead)) {
         timer = CIRCLEQ_FIRST(&root->timer_change_qhead);
-        timer_bucket = timer->timer_bucket;
 
         /*
         * Changes are only processed once.
@@ -335,10 +390,11 @@ timer_process_changes (timer_root_s *root)
         }
 
         /*
-        * Requeue.
+        * Requeue. Periodic timers restarted by their
+        * callback are not expired anymore.
         */
-        if (timer->periodic) {
-            timer_requeue(timer, timer_bucket->sec, timer_bucket->nsec);
+        if (timer->periodic && timer->expired) {
+            timer_rearm(timer);
             continue;
         }
     }
@@ -460,137 +516,140 @@ timespec_compare (struct timespec *ts1, struct timespec *ts2)
 }
 
 /*
- * Process the timer queue.
+ * Process all expired timers once and return the time until the
+ * next timer expires in sleep. Returns false if no timers are left.
  */
-void
-timer_walk (timer_root_s *root)
+bool
+timer_walk_once (timer_root_s *root, struct timespec *sleep)
 {
     timer_s *timer;
     timer_bucket_s *timer_bucket;
-    struct timespec now, min, sleep, rem;
-    int res;
+    struct timespec now, min;
 
-    while (true) {
+    /*
+     * No buckets filled and we're done.
+     */
+    if (CIRCLEQ_EMPTY(&root->timer_bucket_qhead)) {
+        return false;
+    }
 
-        /*
-         * No buckets filled and we're done.
-         */
-        if (CIRCLEQ_EMPTY(&root->timer_bucket_qhead)) {
-            return;
-        }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    LOG(TIMER_DETAIL, "Walk timer queue, now %s\n", timespec_format(&now));
+    min.tv_sec = 0;
+    min.tv_nsec = 0;
+
+    /*
+     * Walk all buckets.
+     */
+    CIRCLEQ_FOREACH(timer_bucket, &root->timer_bucket_qhead, timer_bucket_qnode) {
 
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        LOG(TIMER_DETAIL, "Walk timer queue, now %s\n", timespec_format(&now));
-        min.tv_sec = 0;
-        min.tv_nsec = 0;
+        LOG(TIMER_DETAIL, "  Checking timer bucket %lu.%06lus\n",
+            timer_bucket->sec, timer_bucket->nsec/1000);
 
         /*
-         * Walk all buckets.
+         * First pass. Call into expired nodes.
          */
-        CIRCLEQ_FOREACH(timer_bucket, &root->timer_bucket_qhead, timer_bucket_qnode) {
+        CIRCLEQ_FOREACH(timer, &timer_bucket->timer_qhead, timer_qnode) {
 
-            LOG(TIMER_DETAIL, "  Checking timer bucket %lu.%06lus\n",
-                timer_bucket->sec, timer_bucket->nsec/1000);
+            /*
+             * Hitting the first non-expired timer means
+             * we're done processing this buckets queue.
+             */
+            if ((timespec_compare(&timer->expire, &now) == 1)) {
+                break;
+            }
 
             /*
-             * First pass. Call into expired nodes.
+             * Ignore deleted timers that wait for change processing
+             * and periodic timers which already wait for restart.
              */
-            CIRCLEQ_FOREACH(timer, &timer_bucket->timer_qhead, timer_qnode) {
+            if (timer->delete || timer->expired) {
+                continue;
+            }
 
+            /*
+             * Everything from here one is expired.
+             */
+            timer->expired = true;
+
+            /* Execute callback */
+            if (timer->cb) {
+                LOG(TIMER_DETAIL, "  Firing %s timer\n", timer->name);
+                (*timer->cb)(timer);
+            }
+
+            if (timer->periodic) {
                 /*
-                 * Hitting the first non-expired timer means
-                 * we're done processing this buckets queue.
+                 * Periodic timers are restarted relative to
+                 * this expiration during change processing.
                  */
-                if ((timespec_compare(&timer->expire, &now) == 1)) {
-                    break;
-                }
-
+                timer_change(timer);
+            } else {
                 /*
-                 * Everything from here one is expired.
+                 * Everything else gets deleted.
                  */
-                timer->expired = true;
-
-                /* Execute callback */
-                if (timer->cb) {
-                    LOG(TIMER_DETAIL, "  Firing %s timer\n", timer->name);
-                    (*timer->cb)(timer);
-                }
-
-                if (timer->periodic) {
-                    /*
-                     * Periodic timers are simple de-queued and
-                     * re-inserted at the tail of this buckets queue.
-                     */
-		            timer_change(timer);
-                } else {
-                    /*
-                     * Everything else gets deleted.
-                     */
-                    timer_del(timer);
-                }
+                timer_del(timer);
             }
         }
+    }
 
-        /*
-        * Process all changes from the last timer run.
-        */
-        timer_process_changes(root);
-
-        /*
-        * Second pass. Figure out min sleep time.
-        */
-        CIRCLEQ_FOREACH(timer_bucket, &root->timer_bucket_qhead, timer_bucket_qnode) {
-            CIRCLEQ_FOREACH(timer, &timer_bucket->timer_qhead, timer_qnode) {
-
-                /*
-                * Ignore deleted timers that wait for change processing.
-                */
-                if (timer->delete) {
-                    continue;
-                }
+    /*
+     * Process all changes from the last timer run.
+     */
+    timer_process_changes(root);
 
-                /*
-                * First timer in the queue becomes the actual minimum.
-                */
-                if (min.tv_sec == 0 && min.tv_nsec == 0) {
-                    min.tv_sec = timer->expire.tv_sec;
-                    min.tv_nsec = timer->expire.tv_nsec;
-                }
+    /*
+     * Second pass. Figure out min sleep time. The bucket
+     * queues are sorted, the first timer of each bucket
+     * which is not deleted is the minimum of its bucket.
+     */
+    CIRCLEQ_FOREACH(timer_bucket, &root->timer_bucket_qhead, timer_bucket_qnode) {
+        CIRCLEQ_FOREACH(timer, &timer_bucket->timer_qhead, timer_qnode) {
 
-                /*
-                 * Find the min timer.
-                 */
-                if (timespec_compare(&timer->expire, &min) == -1) {
-                    min.tv_sec = timer->expire.tv_sec;
-                    min.tv_nsec = timer->expire.tv_nsec;
-                    LOG(TIMER_DETAIL, "New minimum sleep (%s) timer, found %s\n", 
-                        timer->name, timespec_format(&min));
-                }
+            /*
+             * Ignore deleted timers that wait for change processing.
+             */
+            if (timer->delete) {
+                continue;
+            }
 
-                /*
-                 * Hitting the first non-expired timer means
-                 * we're done processing this buckets queue.
-                 */
-                if ((timespec_compare(&timer->expire, &now) == 1)) {
-                    break;
-                }
+            if ((min.tv_sec == 0 && min.tv_nsec == 0) ||
+                timespec_compare(&timer->expire, &min) == -1) {
+                min.tv_sec = timer->expire.tv_sec;
+                min.tv_nsec = timer->expire.tv_nsec;
+                LOG(TIMER_DETAIL, "New minimum sleep (%s) timer, found %s\n",
+                    timer->name, timespec_format(&min));
             }
+            break;
         }
+    }
 
-        /*
-        * Calculate the sleep timer.
-        */
-        LOG(TIMER_DETAIL, "  Now %s\n", timespec_format(&now));
-        LOG(TIMER_DETAIL, "  Min %s\n", timespec_format(&min));
-
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        if (timespec_compare(&now, &min) == -1) {
-            timespec_sub(&sleep, &min, &now);
-        } else {
-            sleep.tv_sec = 0;
-            sleep.tv_nsec = 1 * MSEC; /* sleep time is negative, sleep at least some time */
-        }
+    /*
+     * Calculate the sleep timer.
+     */
+    LOG(TIMER_DETAIL, "  Now %s\n", timespec_format(&now));
+    LOG(TIMER_DETAIL, "  Min %s\n", timespec_format(&min));
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_compare(&now, &min) == -1) {
+        timespec_sub(sleep, &min, &now);
+    } else {
+        sleep->tv_sec = 0;
+        sleep->tv_nsec = 0; /* next timer already expired */
+    }
+    return true;
+}
 
+/*
+ * Process the timer queue.
+ */
+void
+timer_walk (timer_root_s *root)
+{
+    struct timespec sleep, rem;
+    int res;
+
+    while (timer_walk_once(root, &sleep)) {
         LOG(TIMER_DETAIL, "  Sleep %s\n", timespec_format(&sleep));
         res = nanosleep(&sleep, &rem);
         if (res == -1) {
@@ -606,9 +665,14 @@ timer_walk (timer_root_s *root)
 void
 timer_init_root (timer_root_s *timer_root)
 {
+    uint slot;
+
     CIRCLEQ_INIT(&timer_root->timer_bucket_qhead);
     CIRCLEQ_INIT(&timer_root->timer_gc_qhead);
     CIRCLEQ_INIT(&timer_root->timer_change_qhead);
+    for (slot = 0; slot < TIMER_BUCKET_HASH_SIZE; slot++) {
+        LIST_INIT(&timer_root->timer_bucket_hash[slot]);
+    }
 }
 
 /*
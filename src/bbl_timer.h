@@ -11,6 +11,9 @@
 
 #define MSEC 1000*1000 /* 1 million nanoseconds */
 
+#define TIMER_BUCKET_HASH_BITS  10
+#define TIMER_BUCKET_HASH_SIZE  (1 << TIMER_BUCKET_HASH_BITS)
+
 /*
  * Top level data structure for timers.
  */
@@ -19,6 +22,7 @@ typedef struct timer_root_
     CIRCLEQ_HEAD(timer_bucket_root_, timer_bucket_ ) timer_bucket_qhead; /* Bucket list  */
     CIRCLEQ_HEAD(timer_gc_root_, timer_ ) timer_gc_qhead; /* Garbage collection list */
     CIRCLEQ_HEAD(timer_change_root_, timer_ ) timer_change_qhead; /* Change timers list */
+    LIST_HEAD(timer_bucket_hash_, timer_bucket_ ) timer_bucket_hash[TIMER_BUCKET_HASH_SIZE]; /* Bucket lookup */
 
     uint buckets; /* # of buckets hanging off */
     uint gc; /* # of timers waiting for GC */
@@ -27,14 +31,16 @@ typedef struct timer_root_
 
 /*
  * Group each like timers (e.g. all 100ms, 1s, 5s timers) into a timer bucket.
- * All buckets hang off the timer root.
+ * All buckets hang off the timer root and are found by hashing the interval.
  * Since time does not run backwards, timer insertion becomes a O(1) operation as one needs
  * only to locate the appropriate bucket and insert at the tail of the per bucket queue.
+ * The same holds for re-arming periodic timers, see timer_rearm().
  */
 typedef struct timer_bucket_
 {
     CIRCLEQ_HEAD(timer_bucket_head_, timer_ ) timer_qhead; /* head of timers */
     CIRCLEQ_ENTRY(timer_bucket_) timer_bucket_qnode; /* node in bucket list */
+    LIST_ENTRY(timer_bucket_) timer_bucket_hash_qnode; /* node in bucket hash */
 
     struct timer_root_ *timer_root; /* back pointer */
 
@@ -80,8 +86,10 @@ void timer_add_periodic(timer_root_s *, timer_s **, char *, time_t , long , void
 void timer_del(timer_s *);
 void timer_smear_bucket(timer_root_s *, time_t, long);
 void timer_walk(struct timer_root_ *);
+bool timer_walk_once(timer_root_s *, struct timespec *);
 
 void timespec_add(struct timespec *, struct timespec *, struct timespec *);
 void timespec_sub(struct timespec *, struct timespec *, struct timespec *);
+int timespec_compare(struct timespec *, struct timespec *);
 
 #endif /* __BBL_TIMER_H__ */
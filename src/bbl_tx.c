@@ -10,169 +10,444 @@
 #include "bbl.h"
 #include "bbl_pcap.h"
 
-protocol_error_t
-bbl_encode_packet_session_ipv4 (bbl_session_s *session)
+/*
+ * Control Packet Templates
+ *
+ * Recurring control packets like PADI retries or LCP echo
+ * requests are encoded once and stored per session. All further
+ * packets of the same type are copied from this template with
+ * only the PPP identifier patched in place. The templates must
+ * be reset with bbl_tx_template_reset() if any other field of
+ * those packets changes, e.g. MRU, server MAC or PPPoE session.
+ *
+ * Templates are allocated from the template arena and are
+ * only marked invalid by a reset, such that the memory is
+ * reused if the packet encoded next fits.
+ */
+void
+bbl_tx_template_reset (bbl_session_s *session)
 {
-    bbl_interface_s *interface;
-    interface = session->interface;
+    int i;
 
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ipcp_state != BBL_PPP_OPENED) {
-            return WRONG_PROTOCOL_STATE;
-        }
-    } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            return WRONG_PROTOCOL_STATE;
+    for(i = 0; i < BBL_TX_TEMPLATE_MAX; i++) {
+        if(session->cold->tx_template[i]) {
+            session->cold->tx_template[i]->len = 0;
         }
     }
-
-    session->stats.access_ipv4_tx++;
-    interface->stats.session_ipv4_tx++;
-
-    memcpy(session->write_buf, session->access_ipv4_tx_packet_template, session->access_ipv4_tx_packet_len);
-    session->write_idx = session->access_ipv4_tx_packet_len;
-
-    *(uint64_t*)(session->write_buf + (session->access_ipv4_tx_packet_len - 16)) = session->access_ipv4_tx_seq++;
-    *(uint32_t*)(session->write_buf + (session->access_ipv4_tx_packet_len - 8)) = interface->tx_timestamp.tv_sec;
-    *(uint32_t*)(session->write_buf + (session->access_ipv4_tx_packet_len - 4)) = interface->tx_timestamp.tv_nsec;
-    return PROTOCOL_SUCCESS;
 }
 
-protocol_error_t
-bbl_encode_packet_session_ipv6 (bbl_session_s *session)
+/*
+ * Offset of the PPP identifier in PPPoE session packets
+ * (ethernet + VLAN + PPPoE + PPP protocol + PPP code).
+ */
+static uint16_t
+bbl_tx_template_ppp_identifier_offset (bbl_session_s *session)
 {
-    bbl_interface_s *interface;
-    interface = session->interface;
-
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ip6cp_state != BBL_PPP_OPENED) {
-            return WRONG_PROTOCOL_STATE;
-        }
-    } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            return WRONG_PROTOCOL_STATE;
+    uint16_t offset = (ETH_ADDR_LEN * 2) + 2;
+
+    if(session->key.outer_vlan_id) {
+        offset += 4;
+        if(session->key.inner_vlan_id) {
+            offset += 4;
+            if(session->access_third_vlan) {
+                offset += 4;
+            }
         }
     }
-     
-    session->stats.access_ipv6_tx++;
-    interface->stats.session_ipv6_tx++;
-
-    memcpy(session->write_buf, session->access_ipv6_tx_packet_template, session->access_ipv6_tx_packet_len);
-    session->write_idx = session->access_ipv6_tx_packet_len;
-
-    *(uint64_t*)(session->write_buf + (session->access_ipv6_tx_packet_len - 16)) = session->access_ipv6_tx_seq++;
-    *(uint32_t*)(session->write_buf + (session->access_ipv6_tx_packet_len - 8)) = interface->tx_timestamp.tv_sec;
-    *(uint32_t*)(session->write_buf + (session->access_ipv6_tx_packet_len - 4)) = interface->tx_timestamp.tv_nsec;
-    return PROTOCOL_SUCCESS;
+    return offset + 6 + 2 + 1;
 }
 
-protocol_error_t
-bbl_encode_packet_session_ipv6pd (bbl_session_s *session)
+/*
+ * Write control packet from template or encode and
+ * store as template if not present.
+ */
+static protocol_error_t
+bbl_tx_template_encode (bbl_session_s *session, bbl_tx_template_t type,
+                        bool ppp, uint8_t identifier, bbl_ethernet_header_t *eth)
 {
-    bbl_interface_s *interface;
-    interface = session->interface;
+    bbl_tx_template_s *template = session->cold->tx_template[type];
+    protocol_error_t result;
+
+    if(template && template->len) {
+        memcpy(session->write_buf, template->data, template->len);
+        session->write_idx = template->len;
+        if(template->identifier_offset) {
+            session->write_buf[template->identifier_offset] = identifier;
+        }
+        return PROTOCOL_SUCCESS;
+    }
 
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ip6cp_state != BBL_PPP_OPENED) {
-            return WRONG_PROTOCOL_STATE;
+    result = encode_ethernet(session->write_buf, &session->write_idx, eth);
+    if(result == PROTOCOL_SUCCESS) {
+        if(!template || template->size < session->write_idx) {
+            template = bbl_arena_alloc(&session->interface->ctx->template_arena,
+                                       sizeof(bbl_tx_template_s) + session->write_idx, sizeof(uint64_t));
+            if(template) {
+                template->size = session->write_idx;
+            }
         }
-    } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            return WRONG_PROTOCOL_STATE;
+        if(template) {
+            template->len = session->write_idx;
+            template->identifier_offset = ppp ? bbl_tx_template_ppp_identifier_offset(session) : 0;
+            memcpy(template->data, session->write_buf, session->write_idx);
+            session->cold->tx_template[type] = template;
         }
     }
-
-    session->stats.access_ipv6pd_tx++;
-    interface->stats.session_ipv6pd_tx++;
-
-    memcpy(session->write_buf, session->access_ipv6pd_tx_packet_template, session->access_ipv6pd_tx_packet_len);
-    session->write_idx = session->access_ipv6pd_tx_packet_len;
-
-    *(uint64_t*)(session->write_buf + (session->access_ipv6pd_tx_packet_len - 16)) = session->access_ipv6pd_tx_seq++;
-    *(uint32_t*)(session->write_buf + (session->access_ipv6pd_tx_packet_len - 8)) = interface->tx_timestamp.tv_sec;
-    *(uint32_t*)(session->write_buf + (session->access_ipv6pd_tx_packet_len - 4)) = interface->tx_timestamp.tv_nsec;
-    return PROTOCOL_SUCCESS;
+    return result;
 }
 
-protocol_error_t
-bbl_encode_packet_network_session_ipv4 (bbl_interface_s *interface, bbl_session_s *session)
+/*
+ * Send the next packet of a session traffic flow, called
+ * by the traffic calendar of the sending interface. Flows
+ * of sessions which are no longer established are removed
+ * from the calendar and scheduled again if the traffic is
+ * restarted after the session is established again.
+ */
+static bbl_calendar_result_t
+bbl_session_traffic_send (bbl_calendar_entry_s *entry, void *arg)
 {
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ipcp_state != BBL_PPP_OPENED) {
-            return WRONG_PROTOCOL_STATE;
+    bbl_interface_s *interface = arg;
+    bbl_session_flow_s *flow = (bbl_session_flow_s*)entry;
+    bbl_session_s *session = flow->session;
+    bbl_ctx_s *ctx = interface->ctx;
+    struct tpacket2_hdr* tphdr;
+    ppp_state_t ncp_state;
+    uint8_t *template;
+    uint16_t len;
+    uint64_t *seq;
+    uint64_t *session_tx;
+    uint64_t *interface_tx;
+    u_char *frame_ptr;
+    uint8_t *buf;
+
+    switch(flow->type) {
+        case BBL_SESSION_FLOW_ACCESS_IPV4:
+            template = session->access_ipv4_tx_packet_template;
+            len = session->access_ipv4_tx_packet_len;
+            seq = &session->access_ipv4_tx_seq;
+            session_tx = &session->stats.access_ipv4_tx;
+            interface_tx = &interface->stats.session_ipv4_tx;
+            ncp_state = session->ipcp_state;
+            break;
+        case BBL_SESSION_FLOW_NETWORK_IPV4:
+            template = session->network_ipv4_tx_packet_template;
+            len = session->network_ipv4_tx_packet_len;
+            seq = &session->network_ipv4_tx_seq;
+            session_tx = &session->stats.network_ipv4_tx;
+            interface_tx = &interface->stats.session_ipv4_tx;
+            ncp_state = session->ipcp_state;
+            break;
+        case BBL_SESSION_FLOW_ACCESS_IPV6:
+            template = session->access_ipv6_tx_packet_template;
+            len = session->access_ipv6_tx_packet_len;
+            seq = &session->access_ipv6_tx_seq;
+            session_tx = &session->stats.access_ipv6_tx;
+            interface_tx = &interface->stats.session_ipv6_tx;
+            ncp_state = session->ip6cp_state;
+            break;
+        case BBL_SESSION_FLOW_NETWORK_IPV6:
+            template = session->network_ipv6_tx_packet_template;
+            len = session->network_ipv6_tx_packet_len;
+            seq = &session->network_ipv6_tx_seq;
+            session_tx = &session->stats.network_ipv6_tx;
+            interface_tx = &interface->stats.session_ipv6_tx;
+            ncp_state = session->ip6cp_state;
+            break;
+        case BBL_SESSION_FLOW_ACCESS_IPV6PD:
+            template = session->access_ipv6pd_tx_packet_template;
+            len = session->access_ipv6pd_tx_packet_len;
+            seq = &session->access_ipv6pd_tx_seq;
+            session_tx = &session->stats.access_ipv6pd_tx;
+            interface_tx = &interface->stats.session_ipv6pd_tx;
+            ncp_state = session->ip6cp_state;
+            break;
+        case BBL_SESSION_FLOW_NETWORK_IPV6PD:
+            template = session->network_ipv6pd_tx_packet_template;
+            len = session->network_ipv6pd_tx_packet_len;
+            seq = &session->network_ipv6pd_tx_seq;
+            session_tx = &session->stats.network_ipv6pd_tx;
+            interface_tx = &interface->stats.session_ipv6pd_tx;
+            ncp_state = session->ip6cp_state;
+            break;
+        default:
+            return BBL_CALENDAR_SKIPPED;
+    }
+
+    if(session->session_state != BBL_ESTABLISHED ||
+       (session->access_type == ACCESS_TYPE_PPPOE && ncp_state != BBL_PPP_OPENED)) {
+        /* Remove flow from calendar. */
+        flow->scheduled = false;
+        entry->interval = 0;
+        interface->traffic_flows--;
+        return BBL_CALENDAR_SKIPPED;
+    }
+    if(!session->session_traffic || !template) {
+        return BBL_CALENDAR_SKIPPED;
+    }
+    if(flow->type >= BBL_SESSION_FLOW_ACCESS_IPV6PD) {
+        if(!session->delegated_ipv6_prefix.len) {
+            return BBL_CALENDAR_SKIPPED;
         }
-    } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            return WRONG_PROTOCOL_STATE;
+    } else if(flow->type >= BBL_SESSION_FLOW_ACCESS_IPV6) {
+        if(!session->ipv6_prefix.len) {
+            return BBL_CALENDAR_SKIPPED;
         }
     }
 
-    session->stats.network_ipv4_tx++;
-    interface->stats.session_ipv4_tx++;
+    frame_ptr = bbl_tx_frame_get(interface, BBL_TX_CLASS_DATA);
+    if(!frame_ptr) {
+        return BBL_CALENDAR_DEFERRED;
+    }
+    buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    memcpy(buf, template, len);
+    *(uint64_t*)(buf + (len - 16)) = (*seq)++;
+    *(uint32_t*)(buf + (len - 8)) = interface->tx_timestamp.tv_sec;
+    *(uint32_t*)(buf + (len - 4)) = interface->tx_timestamp.tv_nsec;
+    tphdr = (struct tpacket2_hdr *)frame_ptr;
+    tphdr->tp_len = len;
+    tphdr->tp_status = TP_STATUS_SEND_REQUEST;
+    (*session_tx)++;
+    (*interface_tx)++;
+    bbl_tx_frame_commit(interface, BBL_TX_CLASS_DATA);
+    /* Dump the packet into PCAP file. */
+    if (ctx->pcap.enabled) {
+        pcapng_push_packet_header(ctx, &interface->tx_timestamp, buf,
+                                  tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
+    }
+    return BBL_CALENDAR_SENT;
+}
 
-    memcpy(session->write_buf, session->network_ipv4_tx_packet_template, session->network_ipv4_tx_packet_len);
-    session->write_idx = session->network_ipv4_tx_packet_len;
+static bool
+bbl_session_traffic_schedule (bbl_interface_s *interface, bbl_session_flow_s *flow, uint32_t pps)
+{
+    uint64_t now;
 
-    *(uint64_t*)(session->write_buf + (session->network_ipv4_tx_packet_len - 16)) = session->network_ipv4_tx_seq++;
-    *(uint32_t*)(session->write_buf + (session->network_ipv4_tx_packet_len - 8)) = interface->tx_timestamp.tv_sec;
-    *(uint32_t*)(session->write_buf + (session->network_ipv4_tx_packet_len - 4)) = interface->tx_timestamp.tv_nsec;
-    return PROTOCOL_SUCCESS;
+    if(interface->io_data) {
+        /* Scheduled by the I/O thread, see bbl_session_traffic_io_update(). */
+        flow->io_started = true;
+        flow->io_interval = BBL_CALENDAR_NSEC_PER_SEC / pps;
+        return true;
+    }
+    flow->entry.interval = BBL_CALENDAR_NSEC_PER_SEC / pps;
+    if(flow->scheduled) {
+        /* Still scheduled since the session was established before. */
+        return true;
+    }
+    now = bbl_calendar_now();
+    if(!interface->traffic_calendar) {
+        interface->traffic_calendar = bbl_calendar_new(BBL_CALENDAR_TICK_NSEC, now);
+        if(!interface->traffic_calendar) {
+            return false;
+        }
+    }
+    /* Spread the flows of an interface over their interval. */
+    flow->entry.expire = now + (flow->entry.interval * (interface->traffic_flows & 0xff)) / 256;
+    bbl_calendar_add(interface->traffic_calendar, &flow->entry);
+    flow->scheduled = true;
+    interface->traffic_flows++;
+    return true;
 }
 
-protocol_error_t
-bbl_encode_packet_network_session_ipv6 (bbl_interface_s *interface, bbl_session_s *session)
+/*
+ * Start session traffic of the given address family (BBL_SUB_TYPE_IPV4,
+ * IPV6 or IPV6PD) after the session packet templates have been created.
+ * The access flow is sent on the access interface of the session and the
+ * network flow on the network interface, except for L2TP sessions where
+ * the network flow is sent by the LNS. Flows sent by the data plane of
+ * I/O threads are passed to those with bbl_session_io_update().
+ */
+bool
+bbl_session_traffic_start (bbl_ctx_s *ctx, bbl_session_s *session, uint8_t sub_type)
 {
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ip6cp_state != BBL_PPP_OPENED) {
-            return WRONG_PROTOCOL_STATE;
+    bbl_session_flow_s *flow;
+    bbl_session_flow_s *flows;
+    bbl_session_flow_t type;
+    bbl_latency_histogram_s *histogram = NULL;
+    uint32_t pps;
+    int i;
+
+    switch(sub_type) {
+        case BBL_SUB_TYPE_IPV4:
+            type = BBL_SESSION_FLOW_ACCESS_IPV4;
+            pps = ctx->config.session_traffic_ipv4_pps;
+            break;
+        case BBL_SUB_TYPE_IPV6:
+            type = BBL_SESSION_FLOW_ACCESS_IPV6;
+            pps = ctx->config.session_traffic_ipv6_pps;
+            break;
+        case BBL_SUB_TYPE_IPV6PD:
+            type = BBL_SESSION_FLOW_ACCESS_IPV6PD;
+            pps = ctx->config.session_traffic_ipv6pd_pps;
+            break;
+        default:
+            return false;
+    }
+    if(!pps) {
+        return false;
+    }
+
+    if(!session->traffic_flows) {
+        flows = bbl_arena_alloc(&ctx->template_arena, BBL_SESSION_FLOW_MAX * sizeof(bbl_session_flow_s),
+                                sizeof(uint64_t));
+        if(!flows) {
+            return false;
         }
-    } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            return WRONG_PROTOCOL_STATE;
+        memset(flows, 0x0, BBL_SESSION_FLOW_MAX * sizeof(bbl_session_flow_s));
+        if(ctx->config.session_traffic_histogram) {
+            /* Latency and jitter histogram per flow. */
+            histogram = bbl_arena_alloc(&ctx->template_arena,
+                                        2 * BBL_SESSION_FLOW_MAX * sizeof(bbl_latency_histogram_s),
+                                        sizeof(uint64_t));
+            if(!histogram) {
+                return false;
+            }
+            memset(histogram, 0x0, 2 * BBL_SESSION_FLOW_MAX * sizeof(bbl_latency_histogram_s));
         }
+        for(i = 0; i < BBL_SESSION_FLOW_MAX; i++) {
+            flows[i].session = session;
+            flows[i].type = i;
+            if(histogram) {
+                flows[i].latency_histogram = histogram++;
+                flows[i].jitter_histogram = histogram++;
+            }
+        }
+        /* Publish the initialized flows to the RX I/O threads. */
+        __atomic_store_n(&session->traffic_flows, flows, __ATOMIC_RELEASE);
     }
 
-    session->stats.network_ipv6_tx++;
-    interface->stats.session_ipv6_tx++;
-
-    memcpy(session->write_buf, session->network_ipv6_tx_packet_template, session->network_ipv6_tx_packet_len);
-    session->write_idx = session->network_ipv6_tx_packet_len;
+    /* Access flow followed by network flow. */
+    flow = &session->traffic_flows[type];
+    if(!bbl_session_traffic_schedule(session->interface, flow, pps)) {
+        return false;
+    }
+    if(session->l2tp == false && ctx->op.network_if) {
+        flow = &session->traffic_flows[type+1];
+        if(!bbl_session_traffic_schedule(ctx->op.network_if, flow, pps)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    *(uint64_t*)(session->write_buf + (session->network_ipv6_tx_packet_len - 16)) = session->network_ipv6_tx_seq++;
-    *(uint32_t*)(session->write_buf + (session->network_ipv6_tx_packet_len - 8)) = interface->tx_timestamp.tv_sec;
-    *(uint32_t*)(session->write_buf + (session->network_ipv6_tx_packet_len - 4)) = interface->tx_timestamp.tv_nsec;
-    return PROTOCOL_SUCCESS;
+/*
+ * Session traffic template of a flow, which is NULL if not yet created.
+ */
+static uint8_t *
+bbl_session_traffic_template (bbl_session_s *session, bbl_session_flow_t type,
+                              uint16_t *len, uint64_t *flow_id, ppp_state_t *ncp_state)
+{
+    switch(type) {
+        case BBL_SESSION_FLOW_ACCESS_IPV4:
+            *len = session->access_ipv4_tx_packet_len;
+            *flow_id = session->access_ipv4_tx_flow_id;
+            *ncp_state = session->ipcp_state;
+            return session->access_ipv4_tx_packet_template;
+        case BBL_SESSION_FLOW_NETWORK_IPV4:
+            *len = session->network_ipv4_tx_packet_len;
+            *flow_id = session->network_ipv4_tx_flow_id;
+            *ncp_state = session->ipcp_state;
+            return session->network_ipv4_tx_packet_template;
+        case BBL_SESSION_FLOW_ACCESS_IPV6:
+            *len = session->access_ipv6_tx_packet_len;
+            *flow_id = session->access_ipv6_tx_flow_id;
+            *ncp_state = session->ip6cp_state;
+            return session->access_ipv6_tx_packet_template;
+        case BBL_SESSION_FLOW_NETWORK_IPV6:
+            *len = session->network_ipv6_tx_packet_len;
+            *flow_id = session->network_ipv6_tx_flow_id;
+            *ncp_state = session->ip6cp_state;
+            return session->network_ipv6_tx_packet_template;
+        case BBL_SESSION_FLOW_ACCESS_IPV6PD:
+            *len = session->access_ipv6pd_tx_packet_len;
+            *flow_id = session->access_ipv6pd_tx_flow_id;
+            *ncp_state = session->ip6cp_state;
+            return session->access_ipv6pd_tx_packet_template;
+        case BBL_SESSION_FLOW_NETWORK_IPV6PD:
+            *len = session->network_ipv6pd_tx_packet_len;
+            *flow_id = session->network_ipv6pd_tx_flow_id;
+            *ncp_state = session->ip6cp_state;
+            return session->network_ipv6pd_tx_packet_template;
+        default:
+            return NULL;
+    }
 }
 
-protocol_error_t
-bbl_encode_packet_network_session_ipv6pd (bbl_interface_s *interface, bbl_session_s *session)
+/*
+ * Pass the session traffic flows sent by the data plane of I/O
+ * threads to those (control thread). A flow is active under the
+ * same conditions bbl_session_traffic_send() sends it. The I/O
+ * thread gets a copy of the template if the flow is started or
+ * the template has been rebuilt and is told to stop otherwise.
+ */
+void
+bbl_session_traffic_io_update (bbl_ctx_s *ctx, bbl_session_s *session)
 {
-    if(session->access_type == ACCESS_TYPE_PPPOE) {
-        if(session->session_state != BBL_ESTABLISHED ||
-            session->ip6cp_state != BBL_PPP_OPENED) {
-            return WRONG_PROTOCOL_STATE;
+    bbl_session_flow_s *flow;
+    bbl_interface_s *interface;
+    bbl_io_data_msg_s msg;
+    ppp_state_t ncp_state;
+    uint8_t *template;
+    uint16_t len;
+    uint64_t flow_id;
+    bool active;
+    int i;
+
+    if(!session->traffic_flows) {
+        return;
+    }
+    for(i = 0; i < BBL_SESSION_FLOW_MAX; i++) {
+        flow = &session->traffic_flows[i];
+        if(!flow->io_started) {
+            continue;
         }
-    } else {
-        if(session->session_state != BBL_ESTABLISHED) {
-            return WRONG_PROTOCOL_STATE;
+        interface = (i & 1) ? ctx->op.network_if : session->interface;
+        template = bbl_session_traffic_template(session, i, &len, &flow_id, &ncp_state);
+        active = session->session_state == BBL_ESTABLISHED &&
+                 (session->access_type != ACCESS_TYPE_PPPOE || ncp_state == BBL_PPP_OPENED) &&
+                 session->session_traffic && template;
+        if(i >= BBL_SESSION_FLOW_ACCESS_IPV6PD) {
+            active = active && session->delegated_ipv6_prefix.len;
+        } else if(i >= BBL_SESSION_FLOW_ACCESS_IPV6) {
+            active = active && session->ipv6_prefix.len;
+        }
+        if(active == flow->io_active && (!active || flow_id == flow->io_flow_id)) {
+            continue;
+        }
+        memset(&msg, 0x0, sizeof(msg));
+        msg.type = BBL_IO_DATA_FLOW;
+        msg.object = flow;
+        if(active) {
+            msg.template = malloc(len);
+            if(!msg.template) {
+                continue;
+            }
+            memcpy(msg.template, template, len);
+            msg.len = len;
+            msg.interval = flow->io_interval;
+            /* New template with a new flow identifier. */
+            msg.seq_reset = flow_id != flow->io_flow_id;
+            flow->io_flow_id = flow_id;
         }
+        flow->io_active = active;
+        bbl_io_thread_data_update(interface, &msg);
     }
-    
-    session->stats.network_ipv6pd_tx++;
-    interface->stats.session_ipv6pd_tx++;
+}
 
-    memcpy(session->write_buf, session->network_ipv6pd_tx_packet_template, session->network_ipv6pd_tx_packet_len);
-    session->write_idx = session->network_ipv6pd_tx_packet_len;
+static void
+bbl_session_traffic_tx (bbl_interface_s *interface)
+{
+    bbl_calendar_run(interface->traffic_calendar, bbl_calendar_now(), bbl_session_traffic_send, interface);
+}
 
-    *(uint64_t*)(session->write_buf + (session->network_ipv6pd_tx_packet_len - 16)) = session->network_ipv6pd_tx_seq++;
-    *(uint32_t*)(session->write_buf + (session->network_ipv6pd_tx_packet_len - 8)) = interface->tx_timestamp.tv_sec;
-    *(uint32_t*)(session->write_buf + (session->network_ipv6pd_tx_packet_len - 4)) = interface->tx_timestamp.tv_nsec;
-    return PROTOCOL_SUCCESS;
+void
+bbl_session_traffic_free (bbl_interface_s *interface)
+{
+    /* Flows are freed with the template arena. */
+    if(interface->traffic_calendar) {
+        bbl_calendar_free(interface->traffic_calendar);
+        interface->traffic_calendar = NULL;
+        interface->traffic_flows = 0;
+    }
 }
 
 void
@@ -191,7 +466,7 @@ bbl_igmp_timeout(timer_s *timer)
     }
 
     for(i=0; i < IGMP_MAX_GROUPS; i++) {
-        group = &session->igmp_groups[i];
+        group = &session->cold->igmp_groups[i];
         if(group->state == IGMP_GROUP_JOINING) {
             if(group->robustness_count) {
                 session->send_requests |= BBL_SEND_IGMP;
@@ -269,8 +544,8 @@ bbl_encode_packet_igmp (bbl_session_s *session)
     ipv4.router_alert_option = true;
     ipv4.next = &igmp;
     for(i=0; i < IGMP_MAX_GROUPS; i++) {
-        if(session->igmp_groups[i].send && session->igmp_groups[i].state) {
-            group = &session->igmp_groups[i];
+        if(session->cold->igmp_groups[i].send && session->cold->igmp_groups[i].state) {
+            group = &session->cold->igmp_groups[i];
             if(group->state == IGMP_GROUP_LEAVING) {
                 if(is_join) {
                     if(!ctx->config.igmp_combined_leave_join) {
@@ -294,7 +569,7 @@ bbl_encode_packet_igmp (bbl_session_s *session)
                 group->robustness_count--;
             }
 
-            if(session->igmp_version == IGMP_VERSION_3) {
+            if(session->cold->igmp_version == IGMP_VERSION_3) {
                 igmp.version = IGMP_VERSION_3;
                 igmp.type = IGMP_TYPE_REPORT_V3;
                 gr = &igmp.group_record[igmp.group_records++];
@@ -343,7 +618,7 @@ bbl_encode_packet_igmp (bbl_session_s *session)
             } else {
                 ipv4.dst = group->group;
                 igmp.group = group->group;
-                if(session->igmp_version == IGMP_VERSION_2) {
+                if(session->cold->igmp_version == IGMP_VERSION_2) {
                     igmp.version = IGMP_VERSION_2;
                     if(group->state == IGMP_GROUP_LEAVING) {
                         igmp.type = IGMP_TYPE_LEAVE;
@@ -380,7 +655,7 @@ bbl_encode_packet_igmp (bbl_session_s *session)
         session->send_requests &= ~BBL_SEND_IGMP;
         return IGNORED;
     }
-    timer_add(&ctx->timer_root, &session->timer_igmp, "IGMP", 1, 0, session, bbl_igmp_timeout);
+    timer_add(&ctx->timer_root, &session->cold->timer_igmp, "IGMP", 1, 0, session, bbl_igmp_timeout);
     session->stats.igmp_tx++;
     interface->stats.igmp_tx++;
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
@@ -394,7 +669,7 @@ bbl_encode_packet_icmp_reply (bbl_session_s *session)
     bbl_ipv4_t ipv4 = {0};
     bbl_icmp_t icmp = {0};
 
-    if(session->icmp_reply_destination) {
+    if(session->cold->icmp_reply_destination) {
         session->stats.icmp_tx++;
         session->interface->stats.icmp_tx++;
         eth.dst = session->server_mac;
@@ -413,17 +688,17 @@ bbl_encode_packet_icmp_reply (bbl_session_s *session)
             eth.type = ETH_TYPE_IPV4;
             eth.next = &ipv4;
         }
-        ipv4.dst = session->icmp_reply_destination;
+        ipv4.dst = session->cold->icmp_reply_destination;
         ipv4.src = session->ip_address;
         ipv4.ttl = 64;
         ipv4.protocol = PROTOCOL_IPV4_ICMP;
         ipv4.next = &icmp;
-        icmp.type = session->icmp_reply_type;
-        icmp.data = session->icmp_reply_data;
-        icmp.data_len = session->icmp_reply_data_len;
-        session->icmp_reply_destination = 0;
-        session->icmp_reply_type = 0;
-        session->icmp_reply_data_len = 0;
+        icmp.type = session->cold->icmp_reply_type;
+        icmp.data = session->cold->icmp_reply_data;
+        icmp.data_len = session->cold->icmp_reply_data_len;
+        session->cold->icmp_reply_destination = 0;
+        session->cold->icmp_reply_type = 0;
+        session->cold->icmp_reply_data_len = 0;
         return encode_ethernet(session->write_buf, &session->write_idx, &eth);
     } else {
         return PROTOCOL_SUCCESS;
@@ -470,11 +745,11 @@ bbl_encode_packet_pap_request (bbl_session_s *session) {
 
     pap.code = PAP_CODE_REQUEST;
     pap.identifier = 1;
-    pap.username = session->username;
-    pap.username_len = strlen(session->username);
-    pap.password = session->password;
-    pap.password_len = strlen(session->password);
-    timer_add(&ctx->timer_root, &session->timer_auth, "Authentication Timeout", 5, 0, session, bbl_pap_timeout);
+    pap.username = session->cold->username;
+    pap.username_len = strlen(session->cold->username);
+    pap.password = session->cold->password;
+    pap.password_len = strlen(session->cold->password);
+    timer_add(&ctx->timer_root, &session->cold->timer_auth, "Authentication Timeout", 5, 0, session, bbl_pap_timeout);
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
 
@@ -516,12 +791,12 @@ bbl_encode_packet_chap_response (bbl_session_s *session) {
     pppoe.protocol = PROTOCOL_CHAP;
     pppoe.next = &chap;
     chap.code = CHAP_CODE_RESPONSE;
-    chap.identifier = session->chap_identifier;
-    chap.challenge = session->chap_response;
+    chap.identifier = session->cold->chap_identifier;
+    chap.challenge = session->cold->chap_response;
     chap.challenge_len = CHALLENGE_LEN;
-    chap.name = session->username;
-    chap.name_len = strlen(session->username);
-    timer_add(&ctx->timer_root, &session->timer_auth, "Authentication Timeout", 5, 0, session, bbl_chap_timeout);
+    chap.name = session->cold->username;
+    chap.name_len = strlen(session->cold->username);
+    timer_add(&ctx->timer_root, &session->cold->timer_auth, "Authentication Timeout", 5, 0, session, bbl_chap_timeout);
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
 
@@ -573,12 +848,12 @@ bbl_encode_packet_icmpv6_rs (bbl_session_s *session) {
         eth.next = &ipv6;
     }
     ipv6.dst = (void*)ipv6_multicast_all_routers;
-    ipv6.src = (void*)session->link_local_ipv6_address;
+    ipv6.src = (void*)session->cold->link_local_ipv6_address;
     ipv6.ttl = 255;
     ipv6.protocol = IPV6_NEXT_HEADER_ICMPV6;
     ipv6.next = &icmpv6;
     icmpv6.type = IPV6_ICMPV6_ROUTER_SOLICITATION;
-    timer_add(&ctx->timer_root, &session->timer_icmpv6, "ICMPv6", 5, 0, session, bbl_icmpv6_timeout);
+    timer_add(&ctx->timer_root, &session->cold->timer_icmpv6, "ICMPv6", 5, 0, session, bbl_icmpv6_timeout);
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
 
@@ -589,7 +864,7 @@ bbl_dhcpv6_timeout (timer_s *timer)
     bbl_interface_s *interface;
     session = timer->data;
     interface = session->interface;
-    if(!session->dhcpv6_received) {
+    if(!session->cold->dhcpv6_received) {
         interface->stats.dhcpv6_timeout++;
         session->send_requests |= BBL_SEND_DHCPV6_REQUEST;
         bbl_session_tx_qnode_insert(session);
@@ -631,7 +906,7 @@ bbl_encode_packet_dhcpv6_request (bbl_session_s *session) {
         eth.next = &ipv6;
     }
     ipv6.dst = (void*)ipv6_multicast_all_routers;
-    ipv6.src = (void*)session->link_local_ipv6_address;
+    ipv6.src = (void*)session->cold->link_local_ipv6_address;
     ipv6.ttl = 255;
     ipv6.protocol = IPV6_NEXT_HEADER_UDP;
     ipv6.next = &udp;
@@ -639,26 +914,26 @@ bbl_encode_packet_dhcpv6_request (bbl_session_s *session) {
     udp.src = DHCPV6_UDP_CLIENT;
     udp.protocol = UDP_PROTOCOL_DHCPV6;
     udp.next = &dhcpv6;
-    dhcpv6.type = session->dhcpv6_type;
+    dhcpv6.type = session->cold->dhcpv6_type;
     dhcpv6.transaction_id = rand();
-    dhcpv6.client_duid = session->duid;
+    dhcpv6.client_duid = session->cold->duid;
     dhcpv6.client_duid_len = DUID_LEN;
     dhcpv6.delegated_prefix_iaid = rand();
     dhcpv6.delegated_prefix = &session->delegated_ipv6_prefix;
     if(dhcpv6.type == DHCPV6_MESSAGE_REQUEST) {
-        if(session->server_duid_len) {
-            dhcpv6.server_duid = session->server_duid;
-            dhcpv6.server_duid_len = session->server_duid_len;
+        if(session->cold->server_duid_len) {
+            dhcpv6.server_duid = session->cold->server_duid;
+            dhcpv6.server_duid_len = session->cold->server_duid_len;
         }
-        if(session->dhcpv6_ia_pd_option_len) {
-            dhcpv6.ia_pd_option = session->dhcpv6_ia_pd_option;
-            dhcpv6.ia_pd_option_len = session->dhcpv6_ia_pd_option_len;
+        if(session->cold->dhcpv6_ia_pd_option_len) {
+            dhcpv6.ia_pd_option = session->cold->dhcpv6_ia_pd_option;
+            dhcpv6.ia_pd_option_len = session->cold->dhcpv6_ia_pd_option_len;
         }
     } else {
         dhcpv6.rapid = ctx->config.dhcpv6_rapid_commit;
         dhcpv6.oro = true;
     }
-    timer_add(&ctx->timer_root, &session->timer_dhcpv6, "DHCPv6", 5, 0, session, bbl_dhcpv6_timeout);
+    timer_add(&ctx->timer_root, &session->cold->timer_dhcpv6, "DHCPv6", 5, 0, session, bbl_dhcpv6_timeout);
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
 
@@ -673,10 +948,10 @@ bbl_ip6cp_timeout (timer_s *timer)
     interface = session->interface;
     ctx = interface->ctx;
     if(session->session_state == BBL_PPP_NETWORK && session->ip6cp_state != BBL_PPP_OPENED) {
-        if(session->ip6cp_retries) {
+        if(session->cold->ip6cp_retries) {
             interface->stats.ip6cp_timeout++;
         }
-        if(session->ip6cp_retries > ctx->config.ip6cp_conf_request_retry) {
+        if(session->cold->ip6cp_retries > ctx->config.ip6cp_conf_request_retry) {
             session->ip6cp_state = BBL_PPP_CLOSED;
             LOG(PPPOE, "IP6CP TIMEOUT (Q-in-Q %u:%u)\n",
                 session->key.outer_vlan_id, session->key.inner_vlan_id);
@@ -718,12 +993,12 @@ bbl_encode_packet_ip6cp_request (bbl_session_s *session) {
     pppoe.protocol = PROTOCOL_IP6CP;
     pppoe.next = &ip6cp;
 
-    ip6cp.code = session->ip6cp_request_code;
-    ip6cp.identifier = ++session->ip6cp_identifier;
+    ip6cp.code = session->cold->ip6cp_request_code;
+    ip6cp.identifier = ++session->cold->ip6cp_identifier;
     if(ip6cp.code == PPP_CODE_CONF_REQUEST) {
-        ip6cp.ipv6_identifier = session->ip6cp_ipv6_identifier;
+        ip6cp.ipv6_identifier = session->cold->ip6cp_ipv6_identifier;
     }
-    timer_add(&ctx->timer_root, &session->timer_ip6cp, "IP6CP timeout", ctx->config.ip6cp_conf_request_timeout, 0, session, bbl_ip6cp_timeout);
+    timer_add(&ctx->timer_root, &session->cold->timer_ip6cp, "IP6CP timeout", ctx->config.ip6cp_conf_request_timeout, 0, session, bbl_ip6cp_timeout);
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
 
@@ -746,13 +1021,13 @@ bbl_encode_packet_ip6cp_response (bbl_session_s *session) {
     pppoe.protocol = PROTOCOL_IP6CP;
     pppoe.next = &ip6cp;
 
-    ip6cp.code = session->ip6cp_response_code;
-    ip6cp.identifier = session->ip6cp_peer_identifier;
-    if(session->ip6cp_options_len) {
-        ip6cp.options = session->ip6cp_options;
-        ip6cp.options_len = session->ip6cp_options_len;
+    ip6cp.code = session->cold->ip6cp_response_code;
+    ip6cp.identifier = session->cold->ip6cp_peer_identifier;
+    if(session->cold->ip6cp_options_len) {
+        ip6cp.options = session->cold->ip6cp_options;
+        ip6cp.options_len = session->cold->ip6cp_options_len;
     } else {
-        ip6cp.ipv6_identifier = session->ip6cp_ipv6_identifier;
+        ip6cp.ipv6_identifier = session->cold->ip6cp_ipv6_identifier;
     }
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
@@ -768,10 +1043,10 @@ bbl_ipcp_timeout (timer_s *timer)
     interface = session->interface;
     ctx = interface->ctx;
     if(session->session_state == BBL_PPP_NETWORK && session->ipcp_state != BBL_PPP_OPENED) {
-        if(session->ipcp_retries) {
+        if(session->cold->ipcp_retries) {
             interface->stats.ipcp_timeout++;
         }
-        if(session->ipcp_retries > ctx->config.ipcp_conf_request_retry) {
+        if(session->cold->ipcp_retries > ctx->config.ipcp_conf_request_retry) {
             session->ipcp_state = BBL_PPP_CLOSED;
             LOG(PPPOE, "IPCP TIMEOUT (Q-in-Q %u:%u)\n",
                 session->key.outer_vlan_id, session->key.inner_vlan_id);
@@ -813,23 +1088,23 @@ bbl_encode_packet_ipcp_request (bbl_session_s *session) {
     pppoe.protocol = PROTOCOL_IPCP;
     pppoe.next = &ipcp;
 
-    ipcp.code = session->ipcp_request_code;
-    ipcp.identifier = ++session->ipcp_identifier;
+    ipcp.code = session->cold->ipcp_request_code;
+    ipcp.identifier = ++session->cold->ipcp_identifier;
     if(ipcp.code == PPP_CODE_CONF_REQUEST) {
         if(session->ip_address || ctx->config.ipcp_request_ip) {
             ipcp.address = session->ip_address;
             ipcp.option_address = true;
         }
         if(ctx->config.ipcp_request_dns1) {
-            ipcp.dns1 = session->dns1;
+            ipcp.dns1 = session->cold->dns1;
             ipcp.option_dns1 = true;
         }
         if(ctx->config.ipcp_request_dns2) {
-            ipcp.dns2 = session->dns2;
+            ipcp.dns2 = session->cold->dns2;
             ipcp.option_dns2 = true;
         }
     }
-    timer_add(&ctx->timer_root, &session->timer_ipcp, "IPCP timeout", ctx->config.ipcp_conf_request_timeout, 0, session, bbl_ipcp_timeout);
+    timer_add(&ctx->timer_root, &session->cold->timer_ipcp, "IPCP timeout", ctx->config.ipcp_conf_request_timeout, 0, session, bbl_ipcp_timeout);
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
 
@@ -852,11 +1127,11 @@ bbl_encode_packet_ipcp_response (bbl_session_s *session) {
     pppoe.protocol = PROTOCOL_IPCP;
     pppoe.next = &ipcp;
 
-    ipcp.code = session->ipcp_response_code;
-    ipcp.identifier = session->ipcp_peer_identifier;
-    if(session->ipcp_options_len) {
-        ipcp.options = session->ipcp_options;
-        ipcp.options_len = session->ipcp_options_len;
+    ipcp.code = session->cold->ipcp_response_code;
+    ipcp.identifier = session->cold->ipcp_peer_identifier;
+    if(session->cold->ipcp_options_len) {
+        ipcp.options = session->cold->ipcp_options;
+        ipcp.options_len = session->cold->ipcp_options_len;
     }
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
@@ -873,17 +1148,17 @@ bbl_lcp_timeout (timer_s *timer)
     ctx = interface->ctx;
 
     if(session->session_state == BBL_PPP_LINK && session->lcp_state != BBL_PPP_OPENED) {
-        if(session->lcp_retries) {
+        if(session->cold->lcp_retries) {
             interface->stats.lcp_timeout++;
         }
-        if(session->lcp_retries > ctx->config.lcp_conf_request_retry) {
+        if(session->cold->lcp_retries > ctx->config.lcp_conf_request_retry) {
             bbl_session_clear(ctx, session);
         } else {
             session->send_requests |= BBL_SEND_LCP_REQUEST;
             bbl_session_tx_qnode_insert(session);
         }
     } else if (session->session_state == BBL_PPP_TERMINATING) {
-        if(session->lcp_retries > 3) {
+        if(session->cold->lcp_retries > 3) {
             /* Send max 3 terminate requests. */
             bbl_session_update_state(ctx, session, BBL_TERMINATING);
             session->send_requests = BBL_SEND_DISCOVERY;
@@ -919,22 +1194,47 @@ bbl_encode_packet_lcp_request (bbl_session_s *session) {
     pppoe.protocol = PROTOCOL_LCP;
     pppoe.next = &lcp;
 
-    lcp.code = session->lcp_request_code;
-    lcp.identifier = ++session->lcp_identifier;
-    if(lcp.code == PPP_CODE_ECHO_REQUEST) {
-        lcp.magic = session->magic_number;
-        timeout = 0;
-    } else if(lcp.code == PPP_CODE_CONF_REQUEST) {
-        lcp.mru = session->mru;
-        lcp.magic = session->magic_number;
+    lcp.code = session->cold->lcp_request_code;
+    lcp.identifier = ++session->cold->lcp_identifier;
+    if(lcp.code == PPP_CODE_CONF_REQUEST) {
+        lcp.mru = session->cold->mru;
+        lcp.magic = session->cold->magic_number;
         timeout = ctx->config.lcp_conf_request_timeout;
     }
     if(timeout) {
-        timer_add(&ctx->timer_root, &session->timer_lcp, "LCP timeout", timeout, 0, session, bbl_lcp_timeout);
+        timer_add(&ctx->timer_root, &session->cold->timer_lcp, "LCP timeout", timeout, 0, session, bbl_lcp_timeout);
+    }
+    if(lcp.code == PPP_CODE_CONF_REQUEST) {
+        return bbl_tx_template_encode(session, BBL_TX_TEMPLATE_LCP_CONF_REQUEST, true, lcp.identifier, &eth);
     }
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
 
+protocol_error_t
+bbl_encode_packet_lcp_echo_request (bbl_session_s *session) {
+    bbl_ethernet_header_t eth = {0};
+    bbl_pppoe_session_t pppoe = {0};
+    bbl_lcp_t lcp = {0};
+
+    session->interface->stats.lcp_tx++;
+
+    eth.dst = session->server_mac;
+    eth.src = session->client_mac;
+    eth.vlan_outer = session->key.outer_vlan_id;
+    eth.vlan_inner = session->key.inner_vlan_id;
+    eth.vlan_three = session->access_third_vlan;
+    eth.type = ETH_TYPE_PPPOE_SESSION;
+    eth.next = &pppoe;
+    pppoe.session_id = session->pppoe_session_id;
+    pppoe.protocol = PROTOCOL_LCP;
+    pppoe.next = &lcp;
+
+    lcp.code = PPP_CODE_ECHO_REQUEST;
+    lcp.identifier = ++session->cold->lcp_identifier;
+    lcp.magic = session->cold->magic_number;
+    return bbl_tx_template_encode(session, BBL_TX_TEMPLATE_LCP_ECHO_REQUEST, true, lcp.identifier, &eth);
+}
+
 protocol_error_t
 bbl_encode_packet_lcp_response (bbl_session_s *session) {
     bbl_ethernet_header_t eth = {0};
@@ -954,24 +1254,45 @@ bbl_encode_packet_lcp_response (bbl_session_s *session) {
     pppoe.protocol = PROTOCOL_LCP;
     pppoe.next = &lcp;
 
-    lcp.code = session->lcp_response_code;
-    lcp.identifier = session->lcp_peer_identifier;
+    lcp.code = session->cold->lcp_response_code;
+    lcp.identifier = session->cold->lcp_peer_identifier;
 
-    if(lcp.code == PPP_CODE_ECHO_REPLY) {
-        lcp.magic = session->magic_number;
+    if(session->cold->lcp_options_len) {
+        lcp.options = session->cold->lcp_options;
+        lcp.options_len = session->cold->lcp_options_len;
     } else {
-        if(session->lcp_options_len) {
-            lcp.options = session->lcp_options;
-            lcp.options_len = session->lcp_options_len;
-        } else {
-            lcp.mru = session->peer_mru;
-            lcp.auth = session->auth_protocol;
-            lcp.magic = session->peer_magic_number;
-        }
+        lcp.mru = session->cold->peer_mru;
+        lcp.auth = session->cold->auth_protocol;
+        lcp.magic = session->cold->peer_magic_number;
     }
     return encode_ethernet(session->write_buf, &session->write_idx, &eth);
 }
 
+protocol_error_t
+bbl_encode_packet_lcp_echo_reply (bbl_session_s *session) {
+    bbl_ethernet_header_t eth = {0};
+    bbl_pppoe_session_t pppoe = {0};
+    bbl_lcp_t lcp = {0};
+
+    session->interface->stats.lcp_tx++;
+
+    eth.dst = session->server_mac;
+    eth.src = session->client_mac;
+    eth.vlan_outer = session->key.outer_vlan_id;
+    eth.vlan_inner = session->key.inner_vlan_id;
+    eth.vlan_three = session->access_third_vlan;
+    eth.type = ETH_TYPE_PPPOE_SESSION;
+    eth.next = &pppoe;
+    pppoe.session_id = session->pppoe_session_id;
+    pppoe.protocol = PROTOCOL_LCP;
+    pppoe.next = &lcp;
+
+    lcp.code = PPP_CODE_ECHO_REPLY;
+    lcp.identifier = session->cold->lcp_echo_peer_identifier;
+    lcp.magic = session->cold->magic_number;
+    return bbl_tx_template_encode(session, BBL_TX_TEMPLATE_LCP_ECHO_REPLY, true, lcp.identifier, &eth);
+}
+
 void
 bbl_padi_timeout (timer_s *timer)
 {
@@ -1007,22 +1328,22 @@ bbl_encode_padi (bbl_session_s *session)
     eth.type = ETH_TYPE_PPPOE_DISCOVERY;
     eth.next = &pppoe;
     pppoe.code = PPPOE_PADI;
-    if(session->pppoe_service_name) {
-        pppoe.service_name = (uint8_t*)session->pppoe_service_name;
-        pppoe.service_name_len = session->pppoe_service_name_len;
+    if(session->cold->pppoe_service_name) {
+        pppoe.service_name = (uint8_t*)session->cold->pppoe_service_name;
+        pppoe.service_name_len = session->cold->pppoe_service_name_len;
     }
-    if(session->pppoe_host_uniq) {
-        pppoe.host_uniq = (uint8_t*)&session->pppoe_host_uniq;
+    if(session->cold->pppoe_host_uniq) {
+        pppoe.host_uniq = (uint8_t*)&session->cold->pppoe_host_uniq;
         pppoe.host_uniq_len = sizeof(uint64_t);
     }
-    if(strlen(session->agent_circuit_id) || strlen(session->agent_remote_id)) {
-        access_line.aci = session->agent_circuit_id;
-        access_line.ari = session->agent_remote_id;
-        access_line.up = session->rate_up;
-        access_line.down = session->rate_down;
+    if(strlen(session->cold->agent_circuit_id) || strlen(session->cold->agent_remote_id)) {
+        access_line.aci = session->cold->agent_circuit_id;
+        access_line.ari = session->cold->agent_remote_id;
+        access_line.up = session->cold->rate_up;
+        access_line.down = session->cold->rate_down;
         pppoe.access_line = &access_line;
     }
-    return encode_ethernet(session->write_buf, &session->write_idx, &eth);
+    return bbl_tx_template_encode(session, BBL_TX_TEMPLATE_PADI, false, 0, &eth);
 }
 
 protocol_error_t
@@ -1040,24 +1361,24 @@ bbl_encode_padr (bbl_session_s *session)
     eth.type = ETH_TYPE_PPPOE_DISCOVERY;
     eth.next = &pppoe;
     pppoe.code = PPPOE_PADR;
-    pppoe.ac_cookie = session->pppoe_ac_cookie;
-    pppoe.ac_cookie_len = session->pppoe_ac_cookie_len;
-    if(session->pppoe_service_name) {
-        pppoe.service_name = (uint8_t*)session->pppoe_service_name;
-        pppoe.service_name_len = session->pppoe_service_name_len;
-    }
-    if(session->pppoe_host_uniq) {
-        pppoe.host_uniq = (uint8_t*)&session->pppoe_host_uniq;
+    pppoe.ac_cookie = session->cold->pppoe_ac_cookie;
+    pppoe.ac_cookie_len = session->cold->pppoe_ac_cookie_len;
+    if(session->cold->pppoe_service_name) {
+        pppoe.service_name = (uint8_t*)session->cold->pppoe_service_name;
+        pppoe.service_name_len = session->cold->pppoe_service_name_len;
+    }
+    if(session->cold->pppoe_host_uniq) {
+        pppoe.host_uniq = (uint8_t*)&session->cold->pppoe_host_uniq;
         pppoe.host_uniq_len = sizeof(uint64_t);
     }
-    if(strlen(session->agent_circuit_id) || strlen(session->agent_remote_id)) {
-        access_line.aci = session->agent_circuit_id;
-        access_line.ari = session->agent_remote_id;
-        access_line.up = session->rate_up;
-        access_line.down = session->rate_down;
+    if(strlen(session->cold->agent_circuit_id) || strlen(session->cold->agent_remote_id)) {
+        access_line.aci = session->cold->agent_circuit_id;
+        access_line.ari = session->cold->agent_remote_id;
+        access_line.up = session->cold->rate_up;
+        access_line.down = session->cold->rate_down;
         pppoe.access_line = &access_line;
     }
-    return encode_ethernet(session->write_buf, &session->write_idx, &eth);
+    return bbl_tx_template_encode(session, BBL_TX_TEMPLATE_PADR, false, 0, &eth);
 }
 
 protocol_error_t
@@ -1090,7 +1411,7 @@ bbl_encode_packet_discovery (bbl_session_s *session) {
      switch(session->session_state) {
         case BBL_PPPOE_INIT:
             result = bbl_encode_padi(session);
-            timer_add(&ctx->timer_root, &session->timer_padi, "PADI timeout", 5, 0, session, bbl_padi_timeout);
+            timer_add(&ctx->timer_root, &session->cold->timer_padi, "PADI timeout", 5, 0, session, bbl_padi_timeout);
             interface->stats.padi_tx++;
             if(!ctx->stats.first_session_tx.tv_sec) {
                 ctx->stats.first_session_tx.tv_sec = interface->tx_timestamp.tv_sec;
@@ -1099,7 +1420,7 @@ bbl_encode_packet_discovery (bbl_session_s *session) {
             break;
         case BBL_PPPOE_REQUEST:
             result = bbl_encode_padr(session);
-            timer_add(&ctx->timer_root, &session->timer_padr, "PADR timeout", 5, 0, session, bbl_padr_timeout);
+            timer_add(&ctx->timer_root, &session->cold->timer_padr, "PADR timeout", 5, 0, session, bbl_padr_timeout);
             interface->stats.padr_tx++;
             break;
         case BBL_TERMINATING:
@@ -1145,16 +1466,16 @@ bbl_encode_packet_arp_request (bbl_session_s *session)
     arp.target_ip = session->peer_ip_address;
 
     if(session->arp_resolved) {
-        timer_add(&ctx->timer_root, &session->timer_arp, "ARP timeout", 300, 0, session, bbl_arp_timeout);
+        timer_add(&ctx->timer_root, &session->cold->timer_arp, "ARP timeout", 300, 0, session, bbl_arp_timeout);
     } else {
-        timer_add(&ctx->timer_root, &session->timer_arp, "ARP timeout", 1, 0, session, bbl_arp_timeout);
+        timer_add(&ctx->timer_root, &session->cold->timer_arp, "ARP timeout", 1, 0, session, bbl_arp_timeout);
     }
     interface->stats.arp_tx++;
     if(!ctx->stats.first_session_tx.tv_sec) {
         ctx->stats.first_session_tx.tv_sec = interface->tx_timestamp.tv_sec;
         ctx->stats.first_session_tx.tv_nsec = interface->tx_timestamp.tv_nsec;
     }
-    return encode_ethernet(session->write_buf, &session->write_idx, &eth);
+    return bbl_tx_template_encode(session, BBL_TX_TEMPLATE_ARP_REQUEST, false, 0, &eth);
 }
 
 protocol_error_t
@@ -1179,75 +1500,74 @@ bbl_encode_packet_arp_reply (bbl_session_s *session)
 }
 
 bool
-bbl_encode_packet (bbl_session_s *session, u_char *frame_ptr)
+bbl_encode_packet (bbl_session_s *session, u_char *frame_ptr, uint32_t mask)
 {
     struct tpacket2_hdr* tphdr;
     protocol_error_t result = UNKNOWN_PROTOCOL;
+    uint32_t requests = session->send_requests & mask;
 
     /* Reset write buffer. */
     session->write_buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
     session->write_idx = 0;
 
-    if(session->send_requests & BBL_SEND_DISCOVERY) {
+    if(requests & BBL_SEND_DISCOVERY) {
         result = bbl_encode_packet_discovery(session);
         session->send_requests &= ~BBL_SEND_DISCOVERY;
-    } else if (session->send_requests & BBL_SEND_LCP_RESPONSE) {
+    } else if (requests & BBL_SEND_LCP_RESPONSE) {
         result = bbl_encode_packet_lcp_response(session);
         session->send_requests &= ~BBL_SEND_LCP_RESPONSE;
-    } else if (session->send_requests & BBL_SEND_LCP_REQUEST) {
+    } else if (requests & BBL_SEND_LCP_REQUEST) {
         result = bbl_encode_packet_lcp_request(session);
         session->send_requests &= ~BBL_SEND_LCP_REQUEST;
-        session->lcp_retries++;
-    } else if (session->send_requests & BBL_SEND_PAP_REQUEST) {
+        session->cold->lcp_retries++;
+    } else if (requests & BBL_SEND_PAP_REQUEST) {
         result = bbl_encode_packet_pap_request(session);
         session->send_requests &= ~BBL_SEND_PAP_REQUEST;
-        session->auth_retries++;
-    } else if (session->send_requests & BBL_SEND_CHAP_RESPONSE) {
+        session->cold->auth_retries++;
+    } else if (requests & BBL_SEND_CHAP_RESPONSE) {
         result = bbl_encode_packet_chap_response(session);
         session->send_requests &= ~BBL_SEND_CHAP_RESPONSE;
-        session->auth_retries++;
-    } else if (session->send_requests & BBL_SEND_IPCP_RESPONSE) {
+        session->cold->auth_retries++;
+    } else if (requests & BBL_SEND_IPCP_RESPONSE) {
         result = bbl_encode_packet_ipcp_response(session);
         session->send_requests &= ~BBL_SEND_IPCP_RESPONSE;
-    } else if (session->send_requests & BBL_SEND_IPCP_REQUEST) {
+    } else if (requests & BBL_SEND_IPCP_REQUEST) {
         result = bbl_encode_packet_ipcp_request(session);
         session->send_requests &= ~BBL_SEND_IPCP_REQUEST;
-        session->ipcp_retries++;
-    } else if (session->send_requests & BBL_SEND_IP6CP_RESPONSE) {
+        session->cold->ipcp_retries++;
+    } else if (requests & BBL_SEND_IP6CP_RESPONSE) {
         result = bbl_encode_packet_ip6cp_response(session);
         session->send_requests &= ~BBL_SEND_IP6CP_RESPONSE;
-    } else if (session->send_requests & BBL_SEND_IP6CP_REQUEST) {
+    } else if (requests & BBL_SEND_IP6CP_REQUEST) {
         result = bbl_encode_packet_ip6cp_request(session);
         session->send_requests &= ~BBL_SEND_IP6CP_REQUEST;
-        session->ip6cp_retries++;
-    } else if (session->send_requests & BBL_SEND_ICMPV6_RS) {
+        session->cold->ip6cp_retries++;
+    } else if (requests & BBL_SEND_ICMPV6_RS) {
         result = bbl_encode_packet_icmpv6_rs(session);
         session->send_requests &= ~BBL_SEND_ICMPV6_RS;
-    } else if (session->send_requests & BBL_SEND_DHCPV6_REQUEST) {
+    } else if (requests & BBL_SEND_DHCPV6_REQUEST) {
         result = bbl_encode_packet_dhcpv6_request(session);
         session->send_requests &= ~BBL_SEND_DHCPV6_REQUEST;
-    } else if (session->send_requests & BBL_SEND_IGMP) {
+    } else if (requests & BBL_SEND_IGMP) {
         result = bbl_encode_packet_igmp(session);
-    } else if (session->send_requests & BBL_SEND_ICMP_REPLY) {
+    } else if (requests & BBL_SEND_ICMP_REPLY) {
         result = bbl_encode_packet_icmp_reply(session);
         session->send_requests &= ~BBL_SEND_ICMP_REPLY;
-    } else if (session->send_requests & BBL_SEND_SESSION_IPV4) {
-        result = bbl_encode_packet_session_ipv4(session);
-        session->send_requests &= ~BBL_SEND_SESSION_IPV4;
-    } else if (session->send_requests & BBL_SEND_SESSION_IPV6) {
-        result = bbl_encode_packet_session_ipv6(session);
-        session->send_requests &= ~BBL_SEND_SESSION_IPV6;
-    } else if (session->send_requests & BBL_SEND_SESSION_IPV6PD) {
-        result = bbl_encode_packet_session_ipv6pd(session);
-        session->send_requests &= ~BBL_SEND_SESSION_IPV6PD;
-    } else if (session->send_requests & BBL_SEND_ARP_REQUEST) {
+    } else if (requests & BBL_SEND_ARP_REQUEST) {
         result = bbl_encode_packet_arp_request(session);
         session->send_requests &= ~BBL_SEND_ARP_REQUEST;
-    } else if (session->send_requests & BBL_SEND_ARP_REPLY) {
+    } else if (requests & BBL_SEND_ARP_REPLY) {
         result = bbl_encode_packet_arp_reply(session);
         session->send_requests &= ~BBL_SEND_ARP_REPLY;
+    } else if (requests & BBL_SEND_LCP_ECHO_REPLY) {
+        result = bbl_encode_packet_lcp_echo_reply(session);
+        session->send_requests &= ~BBL_SEND_LCP_ECHO_REPLY;
+    } else if (requests & BBL_SEND_LCP_ECHO_REQUEST) {
+        result = bbl_encode_packet_lcp_echo_request(session);
+        session->send_requests &= ~BBL_SEND_LCP_ECHO_REQUEST;
+        session->cold->lcp_retries++;
     } else {
-        session->send_requests = 0;
+        session->send_requests &= ~mask;
     }
 
     if(result == PROTOCOL_SUCCESS) {
@@ -1260,38 +1580,6 @@ bbl_encode_packet (bbl_session_s *session, u_char *frame_ptr)
     return false;
 }
 
-bool
-bbl_encode_network_packet (bbl_interface_s *interface, bbl_session_s *session, u_char *frame_ptr)
-{
-    struct tpacket2_hdr* tphdr;
-    protocol_error_t result = UNKNOWN_PROTOCOL;
-
-    /* Reset write buffer. */
-    session->write_buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
-    session->write_idx = 0;
-
-    if (session->network_send_requests & BBL_SEND_SESSION_IPV4) {
-        result = bbl_encode_packet_network_session_ipv4(interface, session);
-        session->network_send_requests &= ~BBL_SEND_SESSION_IPV4;
-    } else if (session->network_send_requests & BBL_SEND_SESSION_IPV6) {
-        result = bbl_encode_packet_network_session_ipv6(interface, session);
-        session->network_send_requests &= ~BBL_SEND_SESSION_IPV6;
-    } else if (session->network_send_requests & BBL_SEND_SESSION_IPV6PD) {
-        result = bbl_encode_packet_network_session_ipv6pd(interface, session);
-        session->network_send_requests &= ~BBL_SEND_SESSION_IPV6PD;
-    } else {
-        session->network_send_requests = 0;
-    }
-
-    if(result == PROTOCOL_SUCCESS) {
-        tphdr = (struct tpacket2_hdr *)frame_ptr;
-        tphdr->tp_len = session->write_idx;
-        tphdr->tp_status = TP_STATUS_SEND_REQUEST;
-        return true;
-    }
-    return false;
-}
-
 void
 bbl_network_arp_timeout (timer_s *timer)
 {
@@ -1419,19 +1707,51 @@ bbl_encode_interface_packet (bbl_interface_s *interface, u_char *frame_ptr)
     return false;
 }
 
-bool
-bbl_encode_multicast_packet (bbl_interface_s *interface, int i, u_char *frame_ptr)
+/*
+ * Get the next free TX frame for a frame of the given TX class.
+ * Returns NULL if the class has filled its share of ring slots
+ * in this TX job or if there is no TX buffer available.
+ */
+u_char *
+bbl_tx_frame_get (bbl_interface_s *interface, bbl_tx_class_t class)
 {
-    struct tpacket2_hdr* tphdr;
-    uint8_t *buf = frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
-    memcpy(buf, interface->mc_packets + (i*interface->mc_packet_len), interface->mc_packet_len);
-    *(uint64_t*)(buf + (interface->mc_packet_len - 16)) = interface->mc_packet_seq;
-    *(uint32_t*)(buf + (interface->mc_packet_len - 8)) = interface->tx_timestamp.tv_sec;
-    *(uint32_t*)(buf + (interface->mc_packet_len - 4)) = interface->tx_timestamp.tv_nsec;
-    tphdr = (struct tpacket2_hdr *)frame_ptr;
-    tphdr->tp_len = interface->mc_packet_len;
-    tphdr->tp_status = TP_STATUS_SEND_REQUEST;
-    return true;
+    u_char *frame_ptr;
+
+    if(!interface->tx_class_budget[class]) {
+        interface->stats.tx_class[class].deferred++;
+        return NULL;
+    }
+    frame_ptr = interface->io_ops->tx_frame_get(interface);
+    if(!frame_ptr) {
+        interface->stats.tx_class[class].ring_full++;
+    } else if(interface->timestamping) {
+        /* Per packet instead of per TX job timestamp. */
+        clock_gettime(CLOCK_REALTIME, &interface->tx_timestamp);
+    }
+    return frame_ptr;
+}
+
+/*
+ * Hand over the frame returned by bbl_tx_frame_get().
+ */
+void
+bbl_tx_frame_commit (bbl_interface_s *interface, bbl_tx_class_t class)
+{
+    interface->tx_class_budget[class]--;
+    interface->stats.tx_class[class].packets++;
+    interface->stats.packets_tx++;
+    interface->io_ops->tx_frame_commit(interface);
+}
+
+const char *
+bbl_tx_class_string (bbl_tx_class_t class)
+{
+    switch(class) {
+        case BBL_TX_CLASS_CONTROL: return "Control";
+        case BBL_TX_CLASS_KEEPALIVE: return "Keepalive";
+        case BBL_TX_CLASS_DATA: return "Data";
+        default: return "N/A";
+    }
 }
 
 void
@@ -1443,9 +1763,8 @@ bbl_tx_job (timer_s *timer)
     bbl_l2tp_queue_t *q;
     struct tpacket2_hdr* tphdr;
     u_char *frame_ptr;
-    struct pollfd fds[1] = {0};
-    int i, g = 0; // helper variables
     bool encode_success;
+    int class;
 
     interface = timer->data;
     if (!interface) {
@@ -1453,19 +1772,13 @@ bbl_tx_job (timer_s *timer)
     }
     ctx = interface->ctx;
 
-    fds[0].fd = interface->fd_tx;
-    fds[0].events = POLLOUT;
-    fds[0].revents = 0;
-
     frame_ptr = interface->ring_tx + (interface->cursor_tx * interface->req_tx.tp_frame_size);
     tphdr = (struct tpacket2_hdr *)frame_ptr;
 
-    while (tphdr->tp_status != TP_STATUS_AVAILABLE) {
-        /* If no buffer is available poll kernel. */
-        if (poll(fds, 1, 10) == -1) {
-            LOG(IO, "TX poll interface %s", interface->name);
-            return;
-        }
+    if (interface->io_ops != &bbl_io_xdp_ops && (tphdr->tp_status & ~BBL_IO_TP_STATUS_TS) != TP_STATUS_AVAILABLE) {
+        /* No buffer available, kick the kernel again if
+         * required instead of blocking in poll. */
+        interface->io_ops->tx_flush(interface);
         interface->stats.poll_tx++;
         return;
     }
@@ -1473,21 +1786,82 @@ bbl_tx_job (timer_s *timer)
     /* Get TX timestamp */
     clock_gettime(CLOCK_REALTIME, &interface->tx_timestamp);
 
-    /* Write per interface frames like ARP, ICMPv6 NS or LLDP. */
-    while(interface->send_requests) {
-        frame_ptr = interface->ring_tx + (interface->cursor_tx * interface->req_tx.tp_frame_size);
+    /* Refill the share of ring slots of all TX classes. */
+    for(class = 0; class < BBL_TX_CLASS_MAX; class++) {
+        interface->tx_class_budget[class] = interface->tx_class_slots[class];
+    }
+
+    /* Control: write per session control protocol frames. */
+    while (!CIRCLEQ_EMPTY(&interface->session_tx_qhead)) {
+        frame_ptr = bbl_tx_frame_get(interface, BBL_TX_CLASS_CONTROL);
+        if (!frame_ptr) {
+            break;
+        }
+        session = CIRCLEQ_FIRST(&interface->session_tx_qhead);
+        tphdr = (struct tpacket2_hdr *)frame_ptr;
+        /* Encode the packet straight into the mmapped send buffer. */
+        encode_success = false;
+        if(session->send_requests & ~BBL_SEND_KEEPALIVE) {
+            encode_success = bbl_encode_packet(session, frame_ptr, ~BBL_SEND_KEEPALIVE);
+        }
+        /* Remove only from TX queue if all requests are processed,
+         * otherwise move the session to the end. */
+        bbl_session_tx_qnode_remove(session);
+        if(session->send_requests & ~BBL_SEND_KEEPALIVE) {
+            bbl_session_tx_qnode_insert(session);
+        }
+        if(encode_success) {
+            bbl_tx_frame_commit(interface, BBL_TX_CLASS_CONTROL);
+            /* Dump the packet into PCAP file. */
+            if (ctx->pcap.enabled) {
+                pcapng_push_packet_header(ctx, &interface->tx_timestamp,
+                            frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll),
+                            tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
+            }
+        }
+    }
+
+    /* Control: send L2TP packets (network interface only). */
+    while (!interface->access && !CIRCLEQ_EMPTY(&interface->l2tp_tx_qhead)) {
+        frame_ptr = bbl_tx_frame_get(interface, BBL_TX_CLASS_CONTROL);
+        if (!frame_ptr) {
+            break;
+        }
         tphdr = (struct tpacket2_hdr *)frame_ptr;
-        /* Check if this slot available for writing. */
-        if (tphdr->tp_status != TP_STATUS_AVAILABLE) {
-            interface->stats.no_tx_buffer++;
-            goto Send;
+
+        /* Pop element from queue */
+        q = CIRCLEQ_FIRST(&interface->l2tp_tx_qhead);
+        CIRCLEQ_REMOVE(&interface->l2tp_tx_qhead, q, tx_qnode);
+        CIRCLEQ_NEXT(q, tx_qnode) = NULL;
+        CIRCLEQ_PREV(q, tx_qnode) = NULL;
+        /* Copy packet from queue to ring buffer */
+        memcpy((frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll)), q->packet, q->packet_len);
+        tphdr->tp_len = q->packet_len;
+        tphdr->tp_status = TP_STATUS_SEND_REQUEST;
+        bbl_tx_frame_commit(interface, BBL_TX_CLASS_CONTROL);
+        /* Captrue packet */
+        if (ctx->pcap.enabled) {
+            pcapng_push_packet_header(ctx, &interface->tx_timestamp,
+                        frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll),
+                        tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
+        }
+        if(q->data) {
+            free(q);
         }
+    }
+
+    /* Keepalive: write per interface frames like ARP, ICMPv6 NS or LLDP. */
+    while(interface->send_requests) {
+        frame_ptr = bbl_tx_frame_get(interface, BBL_TX_CLASS_KEEPALIVE);
+        if (!frame_ptr) {
+            break;
+        }
+        tphdr = (struct tpacket2_hdr *)frame_ptr;
         /* Encode the packet straight into the mmapped send buffer. */
         if(bbl_encode_interface_packet(interface, frame_ptr)){
-            interface->stats.packets_tx++;
-            interface->cursor_tx = (interface->cursor_tx + 1) % interface->req_tx.tp_frame_nr;
+            bbl_tx_frame_commit(interface, BBL_TX_CLASS_KEEPALIVE);
             /* Dump the packet into pcap file. */
-            if (ctx->pcap.write_buf) {
+            if (ctx->pcap.enabled) {
                 pcapng_push_packet_header(ctx, &interface->tx_timestamp,
                             frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll),
 			    tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
@@ -1495,55 +1869,26 @@ bbl_tx_job (timer_s *timer)
         }
     }
 
-    /* Write per session frames. */
-    while (!CIRCLEQ_EMPTY(&interface->session_tx_qhead)) {
-        session = CIRCLEQ_FIRST(&interface->session_tx_qhead);
-
-        frame_ptr = interface->ring_tx + (interface->cursor_tx * interface->req_tx.tp_frame_size);
-        tphdr = (struct tpacket2_hdr *)frame_ptr;
-        /* Check if this slot available for writing. */
-        if (tphdr->tp_status != TP_STATUS_AVAILABLE) {
-            interface->stats.no_tx_buffer++;
-            goto Send;
+    /* Keepalive: write per session frames like LCP echo or ARP. */
+    while (!CIRCLEQ_EMPTY(&interface->session_keepalive_qhead)) {
+        frame_ptr = bbl_tx_frame_get(interface, BBL_TX_CLASS_KEEPALIVE);
+        if (!frame_ptr) {
+            break;
         }
-        /* Encode the packet straight into the mmapped send buffer. */
+        session = CIRCLEQ_FIRST(&interface->session_keepalive_qhead);
+        tphdr = (struct tpacket2_hdr *)frame_ptr;
         encode_success = false;
-        if(interface->access) {
-            /* Access Interface */
-            if(session->send_requests != 0) {
-                encode_success = bbl_encode_packet(session, frame_ptr);
-                /* Remove only from TX queue if all requests are processed! */
-                if(session->send_requests == 0) {
-                    bbl_session_tx_qnode_remove(session);
-                } else {
-                    /* Move to the end */
-                    bbl_session_tx_qnode_remove(session);
-                    bbl_session_tx_qnode_insert(session);
-                }
-            } else {
-                bbl_session_tx_qnode_remove(session);
-            }
-        } else {
-            /* Network Interface */
-            if(session->network_send_requests != 0) {
-                encode_success = bbl_encode_network_packet(interface, session, frame_ptr);
-                /* Remove only from TX queue if all requests are processed! */
-                if(session->network_send_requests == 0) {
-                    bbl_session_network_tx_qnode_remove(session);
-                } else {
-                    /* Move to the end */
-                    bbl_session_network_tx_qnode_remove(session);
-                    bbl_session_network_tx_qnode_insert(session);
-                }
-            } else {
-                bbl_session_network_tx_qnode_remove(session);
-            }
+        if(session->send_requests & BBL_SEND_KEEPALIVE) {
+            encode_success = bbl_encode_packet(session, frame_ptr, BBL_SEND_KEEPALIVE);
+        }
+        bbl_session_keepalive_qnode_remove(session);
+        if(session->send_requests & BBL_SEND_KEEPALIVE) {
+            bbl_session_tx_qnode_insert(session);
         }
         if(encode_success) {
-            interface->stats.packets_tx++;
-            interface->cursor_tx = (interface->cursor_tx + 1) % interface->req_tx.tp_frame_nr;
+            bbl_tx_frame_commit(interface, BBL_TX_CLASS_KEEPALIVE);
             /* Dump the packet into PCAP file. */
-            if (ctx->pcap.write_buf) {
+            if (ctx->pcap.enabled) {
                 pcapng_push_packet_header(ctx, &interface->tx_timestamp,
                             frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll),
                             tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
@@ -1551,74 +1896,46 @@ bbl_tx_job (timer_s *timer)
         }
     }
 
-    /* Network Interface Only! */
-    if(!interface->access) {
-        /* Send L2TP Packets */
-        while (!CIRCLEQ_EMPTY(&interface->l2tp_tx_qhead)) {
-            frame_ptr = interface->ring_tx + (interface->cursor_tx * interface->req_tx.tp_frame_size);
-            tphdr = (struct tpacket2_hdr *)frame_ptr;
-            /* Check if this slot available for writing. */
-            if (tphdr->tp_status != TP_STATUS_AVAILABLE) {
-                interface->stats.no_tx_buffer++;
-                goto Send;
-            }
+    /* Data: sent by the I/O thread if the data plane is enabled. */
+    if(!interface->io_data) {
+        /* Data: generate Multicast Traffic (network interface only). */
+        if(interface->mc_calendar && ctx->multicast_traffic) {
+            bbl_multicast_tx(interface);
+        }
 
-            /* Pop element from queue */
-            q = CIRCLEQ_FIRST(&interface->l2tp_tx_qhead);
-            CIRCLEQ_REMOVE(&interface->l2tp_tx_qhead, q, tx_qnode);
-            CIRCLEQ_NEXT(q, tx_qnode) = NULL;
-            CIRCLEQ_PREV(q, tx_qnode) = NULL;
-            /* Copy packet from queue to ring buffer */
-            memcpy((frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll)), q->packet, q->packet_len);
-            tphdr->tp_len = q->packet_len;
-            tphdr->tp_status = TP_STATUS_SEND_REQUEST;
-            interface->stats.packets_tx++;
-            interface->cursor_tx = (interface->cursor_tx + 1) % interface->req_tx.tp_frame_nr;
-            /* Captrue packet */
-            if (ctx->pcap.write_buf) {
-                pcapng_push_packet_header(ctx, &interface->tx_timestamp,
-                            frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll),
-                            tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
-            }
-            if(q->data) {
-                free(q);
-            }
+        /* Data: generate Session Traffic */
+        if(interface->traffic_calendar) {
+            bbl_session_traffic_tx(interface);
         }
-        /* Generate Multicast Traffic */
-        g = ctx->config.igmp_group_count;
-        if(ctx->config.send_multicast_traffic && ctx->multicast_traffic && g) {
-            interface->mc_packet_seq++;
-            for(i = 0; i < g; i++) {
-                frame_ptr = interface->ring_tx + (interface->cursor_tx * interface->req_tx.tp_frame_size);
-                tphdr = (struct tpacket2_hdr *)frame_ptr;
-                /* Check if this slot available for writing. */
-                if (tphdr->tp_status != TP_STATUS_AVAILABLE) {
-                    interface->stats.no_tx_buffer++;
-                    goto Send;
-                }
 
-                if(bbl_encode_multicast_packet(interface, i, frame_ptr)) {
-                    interface->stats.packets_tx++;
-                    interface->stats.mc_tx++;
-                    interface->cursor_tx = (interface->cursor_tx + 1) % interface->req_tx.tp_frame_nr;
-                    /* Dump the packet into PCAP file. */
-                    if (ctx->pcap.write_buf) {
-                        pcapng_push_packet_header(ctx, &interface->tx_timestamp,
-                                    frame_ptr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll),
-                                    tphdr->tp_len, interface->pcap_index, PCAPNG_EPB_FLAGS_OUTBOUND);
-                    }
-                }
-            }
+        /* Data: generate Stream Traffic */
+        if(interface->stream_calendar) {
+            bbl_stream_tx(interface);
         }
     }
 
-Send:
     pcapng_fflush(ctx);
 
     /* Notify kernel. */
-    if (sendto(interface->fd_tx, NULL, 0 , 0, NULL, 0) == -1) {
-        LOG(IO, "Sendto failed with errno: %i\n", errno);
-        interface->stats.sendto_failed++;
-        return;
+    interface->io_ops->tx_flush(interface);
+}
+
+/*
+ * Run the TX job immediately if there is something
+ * to send (busy poll). Returns true if the job was run.
+ */
+bool
+bbl_tx_poll (bbl_interface_s *interface)
+{
+    if(interface->send_requests ||
+       (!interface->io_data && interface->mc_calendar && interface->ctx->multicast_traffic) ||
+       (!interface->io_data && interface->traffic_calendar) ||
+       (!interface->io_data && interface->stream_calendar) ||
+       !CIRCLEQ_EMPTY(&interface->session_tx_qhead) ||
+       !CIRCLEQ_EMPTY(&interface->session_keepalive_qhead) ||
+       (!interface->access && !CIRCLEQ_EMPTY(&interface->l2tp_tx_qhead))) {
+        bbl_tx_job(interface->tx_job);
+        return true;
     }
+    return false;
 }
@@ -9,7 +9,54 @@
 #ifndef __BBL_TX_H__
 #define __BBL_TX_H__
 
+typedef struct bbl_ctx_ bbl_ctx_s;
+typedef struct bbl_session_ bbl_session_s;
+typedef struct bbl_interface_ bbl_interface_s;
+
+/*
+ * TX priority classes, served in this order by the TX job.
+ * Each class may fill a configurable share of the TX ring
+ * slots per TX job, such that control and keepalive frames
+ * find free slots even if the ring is filled with traffic.
+ */
+typedef enum {
+    BBL_TX_CLASS_CONTROL = 0, /* session and L2TP control protocols */
+    BBL_TX_CLASS_KEEPALIVE, /* LCP echo, ARP and ND */
+    BBL_TX_CLASS_DATA, /* session traffic, streams and multicast */
+    BBL_TX_CLASS_MAX
+} __attribute__ ((__packed__)) bbl_tx_class_t;
+
+typedef struct bbl_tx_class_stats_ {
+    uint64_t packets;
+    uint64_t deferred; /* share of ring slots exhausted */
+    uint64_t ring_full; /* no TX buffer available */
+} bbl_tx_class_stats_s;
+
+u_char *
+bbl_tx_frame_get (bbl_interface_s *interface, bbl_tx_class_t class);
+
+void
+bbl_tx_frame_commit (bbl_interface_s *interface, bbl_tx_class_t class);
+
+const char *
+bbl_tx_class_string (bbl_tx_class_t class);
+
 void
 bbl_tx_job (timer_s *timer);
 
+bool
+bbl_tx_poll (bbl_interface_s *interface);
+
+void
+bbl_tx_template_reset (bbl_session_s *session);
+
+bool
+bbl_session_traffic_start (bbl_ctx_s *ctx, bbl_session_s *session, uint8_t sub_type);
+
+void
+bbl_session_traffic_io_update (bbl_ctx_s *ctx, bbl_session_s *session);
+
+void
+bbl_session_traffic_free (bbl_interface_s *interface);
+
 #endif
\ No newline at end of file
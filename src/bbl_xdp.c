@@ -0,0 +1,435 @@
+/*
+ * BNG Blaster (BBL) - AF_XDP I/O Backend
+ *
+ * The AF_XDP socket shares a UMEM area with the kernel. Received
+ * packets are redirected to the socket by a minimal XDP program
+ * using an XSKMAP. This works with generic (skb) XDP mode on every
+ * interface including veth pairs, or with native (driver) XDP mode
+ * on supported NICs. Only the kernel UAPI is used (Linux 5.9+).
+ *
+ * https://www.kernel.org/doc/html/latest/networking/af_xdp.html
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#include <stddef.h>
+#include <sys/syscall.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/bpf.h>
+#include "bbl.h"
+#include "bbl_rx.h"
+#include "bbl_pcap.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+/* Packet data offset in TX frames, see bbl_io_ops_s. */
+#define BBL_XDP_TX_HEADROOM (TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+
+
+static int
+bbl_xdp_bpf (int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/*
+ * Load and attach the XDP program redirecting all packets
+ * received on the bound queue to the AF_XDP socket:
+ *
+ *   return bpf_redirect_map(&xsks_map, ctx->rx_queue_index, XDP_PASS);
+ */
+static bool
+bbl_xdp_load_program (bbl_interface_s *interface, bbl_xdp_s *xdp, bool native)
+{
+    union bpf_attr attr;
+    int fd = xdp->fd;
+
+    memset(&attr, 0x0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(int);
+    attr.max_entries = xdp->queue + 1;
+    xdp->map_fd = bbl_xdp_bpf(BPF_MAP_CREATE, &attr);
+    if(xdp->map_fd < 0) {
+        LOG(ERROR, "AF_XDP map create error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+
+    struct bpf_insn insns[] = {
+        /* r2 = ctx->rx_queue_index */
+        { .code = BPF_LDX | BPF_MEM | BPF_W, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_1,
+          .off = offsetof(struct xdp_md, rx_queue_index) },
+        /* r1 = xsks_map */
+        { .code = BPF_LD | BPF_DW | BPF_IMM, .dst_reg = BPF_REG_1, .src_reg = BPF_PSEUDO_MAP_FD,
+          .imm = xdp->map_fd },
+        { .code = 0 },
+        /* r3 = XDP_PASS if no socket is bound to this queue */
+        { .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_3, .imm = XDP_PASS },
+        /* r0 = bpf_redirect_map(r1, r2, r3) */
+        { .code = BPF_JMP | BPF_CALL, .imm = BPF_FUNC_redirect_map },
+        { .code = BPF_JMP | BPF_EXIT },
+    };
+
+    memset(&attr, 0x0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t)(uintptr_t)insns;
+    attr.insn_cnt = sizeof(insns) / sizeof(struct bpf_insn);
+    attr.license = (uint64_t)(uintptr_t)"Dual BSD/GPL";
+    xdp->prog_fd = bbl_xdp_bpf(BPF_PROG_LOAD, &attr);
+    if(xdp->prog_fd < 0) {
+        LOG(ERROR, "AF_XDP program load error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+
+    /* The program is detached automatically if the link FD is closed. */
+    memset(&attr, 0x0, sizeof(attr));
+    attr.link_create.prog_fd = xdp->prog_fd;
+    attr.link_create.target_ifindex = interface->addr.sll_ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = native ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+    xdp->link_fd = bbl_xdp_bpf(BPF_LINK_CREATE, &attr);
+    if(xdp->link_fd < 0) {
+        LOG(ERROR, "AF_XDP program attach error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+
+    memset(&attr, 0x0, sizeof(attr));
+    attr.map_fd = xdp->map_fd;
+    attr.key = (uint64_t)(uintptr_t)&xdp->queue;
+    attr.value = (uint64_t)(uintptr_t)&fd;
+    attr.flags = BPF_ANY;
+    if(bbl_xdp_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+        LOG(ERROR, "AF_XDP map update error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+    return true;
+}
+
+static bool
+bbl_xdp_ring_map (bbl_xdp_s *xdp, bbl_xdp_ring_s *ring, struct xdp_ring_offset *off,
+                  size_t entry_size, off_t pgoff)
+{
+    uint8_t *map;
+
+    map = mmap(NULL, off->desc + (ring->size * entry_size), PROT_READ|PROT_WRITE,
+               MAP_SHARED|MAP_POPULATE, xdp->fd, pgoff);
+    if(map == MAP_FAILED) {
+        return false;
+    }
+    ring->producer = (uint32_t*)(map + off->producer);
+    ring->consumer = (uint32_t*)(map + off->consumer);
+    ring->flags = (uint32_t*)(map + off->flags);
+    ring->ring = map + off->desc;
+    ring->mask = ring->size - 1;
+    return true;
+}
+
+bool
+bbl_xdp_add (bbl_ctx_s *ctx, bbl_interface_s *interface, bbl_interface_config_s *interface_config)
+{
+    bbl_xdp_s *xdp;
+    struct xdp_umem_reg umem_reg = {0};
+    struct xdp_mmap_offsets off;
+    struct sockaddr_xdp sxdp = {0};
+    socklen_t optlen;
+    bbl_rx_ring_s *rx_ring;
+    char timer_name[16];
+    uint64_t *fill;
+    int size = BBL_XDP_RING_SIZE;
+    int umem_flags;
+    uint32_t i;
+
+    xdp = calloc(1, sizeof(bbl_xdp_s));
+    if(!xdp) {
+        return false;
+    }
+    xdp->queue = interface_config->xdp_queue;
+    xdp->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if(xdp->fd == -1) {
+        LOG(ERROR, "AF_XDP socket() error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+
+    /*
+     * Register the UMEM. The first half of the frames is
+     * used for RX and the second half for TX.
+     */
+    xdp->umem_len = BBL_XDP_NUM_FRAMES * BBL_XDP_FRAME_SIZE;
+    umem_flags = MAP_PRIVATE|MAP_ANONYMOUS;
+    if(interface_config->ring_locked) {
+        umem_flags |= MAP_LOCKED|MAP_POPULATE;
+    }
+    xdp->umem = MAP_FAILED;
+    if(interface_config->ring_hugepages) {
+        /* Fall back to regular pages if the huge page pool is exhausted. */
+        xdp->umem = mmap(NULL, xdp->umem_len, PROT_READ|PROT_WRITE, umem_flags|MAP_HUGETLB, -1, 0);
+        if(xdp->umem == MAP_FAILED) {
+            LOG(NORMAL, "AF_XDP UMEM huge page allocation error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        }
+    }
+    if(xdp->umem == MAP_FAILED) {
+        xdp->umem = mmap(NULL, xdp->umem_len, PROT_READ|PROT_WRITE, umem_flags, -1, 0);
+    }
+    if(xdp->umem == MAP_FAILED) {
+        LOG(ERROR, "AF_XDP UMEM allocation error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+    umem_reg.addr = (uint64_t)(uintptr_t)xdp->umem;
+    umem_reg.len = xdp->umem_len;
+    umem_reg.chunk_size = BBL_XDP_FRAME_SIZE;
+    umem_reg.headroom = 0;
+    if(setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_REG, &umem_reg, sizeof(umem_reg)) == -1) {
+        LOG(ERROR, "AF_XDP UMEM register error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+
+    /*
+     * Setup fill, completion, RX and TX rings.
+     */
+    if(setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_FILL_RING, &size, sizeof(size)) == -1 ||
+       setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &size, sizeof(size)) == -1 ||
+       setsockopt(xdp->fd, SOL_XDP, XDP_RX_RING, &size, sizeof(size)) == -1 ||
+       setsockopt(xdp->fd, SOL_XDP, XDP_TX_RING, &size, sizeof(size)) == -1) {
+        LOG(ERROR, "AF_XDP ring setup error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+    optlen = sizeof(off);
+    if(getsockopt(xdp->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) == -1) {
+        LOG(ERROR, "AF_XDP ring offsets error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+    xdp->rx.size = xdp->tx.size = xdp->fill.size = xdp->comp.size = BBL_XDP_RING_SIZE;
+    if(!(bbl_xdp_ring_map(xdp, &xdp->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) &&
+         bbl_xdp_ring_map(xdp, &xdp->tx, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) &&
+         bbl_xdp_ring_map(xdp, &xdp->fill, &off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) &&
+         bbl_xdp_ring_map(xdp, &xdp->comp, &off.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING))) {
+        LOG(ERROR, "AF_XDP ring mmap error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+
+    /*
+     * Hand over all RX frames to the kernel.
+     */
+    fill = xdp->fill.ring;
+    for(i = 0; i < BBL_XDP_RING_SIZE; i++) {
+        fill[i] = (uint64_t)i * BBL_XDP_FRAME_SIZE;
+    }
+    xdp->fill.cached_prod = BBL_XDP_RING_SIZE;
+    __atomic_store_n(xdp->fill.producer, xdp->fill.cached_prod, __ATOMIC_RELEASE);
+
+    for(i = 0; i < BBL_XDP_RING_SIZE; i++) {
+        xdp->tx_free[i] = (uint64_t)(BBL_XDP_RING_SIZE + i) * BBL_XDP_FRAME_SIZE;
+    }
+    xdp->tx_free_count = BBL_XDP_RING_SIZE;
+
+    /*
+     * Bind the socket to the interface queue. The generic (skb)
+     * mode requires copy mode. In native mode the kernel chooses
+     * zero-copy if supported by the driver.
+     */
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = interface->addr.sll_ifindex;
+    sxdp.sxdp_queue_id = xdp->queue;
+    sxdp.sxdp_flags = interface_config->xdp_native ? 0 : XDP_COPY;
+    if(bind(xdp->fd, (struct sockaddr*)&sxdp, sizeof(sxdp)) == -1) {
+        LOG(ERROR, "AF_XDP bind() error %s (%d) for interface %s\n", strerror(errno), errno, interface->name);
+        return false;
+    }
+
+    if(!bbl_xdp_load_program(interface, xdp, interface_config->xdp_native)) {
+        return false;
+    }
+    interface->xdp = xdp;
+
+    /*
+     * The first RX ring serves the AF_XDP socket, such
+     * that the common RX job callbacks can be used.
+     */
+    rx_ring = &interface->rx_ring[0];
+    rx_ring->interface = interface;
+    rx_ring->fd = xdp->fd;
+    if(ctx->event_loop) {
+        /* RX ring is served as soon as the socket becomes readable. */
+        if(ctx->config.busy_poll) {
+            bbl_event_busy_poll_socket(ctx, xdp->fd, interface->name);
+        }
+        return bbl_event_add(ctx, &rx_ring->rx_event, xdp->fd, bbl_rx_event, bbl_rx_poll, rx_ring);
+    }
+    snprintf(timer_name, sizeof(timer_name), "%s RX", interface->name);
+    timer_add_periodic(&ctx->timer_root, &rx_ring->rx_job, timer_name, 0, ctx->config.rx_interval * MSEC,
+                       rx_ring, bbl_rx_job);
+    return true;
+}
+
+/*
+ * Return completed TX frames to the free stack.
+ */
+static void
+bbl_xdp_tx_complete (bbl_xdp_s *xdp)
+{
+    uint64_t *comp = xdp->comp.ring;
+    uint32_t prod;
+
+    prod = __atomic_load_n(xdp->comp.producer, __ATOMIC_ACQUIRE);
+    if(prod == xdp->comp.cached_cons) {
+        return;
+    }
+    while(xdp->comp.cached_cons != prod) {
+        xdp->tx_free[xdp->tx_free_count++] = comp[xdp->comp.cached_cons & xdp->comp.mask] & ~((uint64_t)BBL_XDP_FRAME_SIZE - 1);
+        xdp->comp.cached_cons++;
+    }
+    __atomic_store_n(xdp->comp.consumer, xdp->comp.cached_cons, __ATOMIC_RELEASE);
+}
+
+/*
+ * The TX ring has the same size as the number of TX frames,
+ * therefore a free TX frame implies a free TX ring slot.
+ */
+static u_char *
+bbl_xdp_tx_frame_get (bbl_interface_s *interface)
+{
+    bbl_xdp_s *xdp = interface->xdp;
+
+    if(!xdp->tx_reserved) {
+        bbl_xdp_tx_complete(xdp);
+        if(!xdp->tx_free_count) {
+            interface->stats.no_tx_buffer++;
+            return NULL;
+        }
+        xdp->tx_reserved = true;
+    }
+    return xdp->umem + xdp->tx_free[xdp->tx_free_count - 1];
+}
+
+static void
+bbl_xdp_tx_flush (bbl_interface_s *interface)
+{
+    bbl_xdp_s *xdp = interface->xdp;
+
+    if(!xdp->tx_pending && !interface->tx_kick_retry) {
+        interface->stats.tx_kicks_skipped++;
+        return;
+    }
+    __atomic_store_n(xdp->tx.producer, xdp->tx.cached_prod, __ATOMIC_RELEASE);
+    xdp->tx_pending = 0;
+    interface->tx_kick_retry = false;
+
+    /* Notify kernel. */
+    interface->stats.tx_kicks++;
+    if (sendto(xdp->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) == -1) {
+        if(errno == EAGAIN || errno == EBUSY || errno == ENOBUFS) {
+            interface->stats.tx_kicks_again++;
+            interface->tx_kick_retry = true;
+        } else {
+            LOG(IO, "Sendto failed with errno: %i\n", errno);
+            interface->stats.sendto_failed++;
+        }
+    }
+}
+
+static void
+bbl_xdp_tx_frame_commit (bbl_interface_s *interface)
+{
+    bbl_xdp_s *xdp = interface->xdp;
+    struct xdp_desc *desc;
+    struct tpacket2_hdr *tphdr;
+    uint64_t addr;
+
+    addr = xdp->tx_free[--xdp->tx_free_count];
+    xdp->tx_reserved = false;
+    tphdr = (struct tpacket2_hdr*)(xdp->umem + addr);
+
+    desc = (struct xdp_desc*)xdp->tx.ring + (xdp->tx.cached_prod & xdp->tx.mask);
+    desc->addr = addr + BBL_XDP_TX_HEADROOM;
+    desc->len = tphdr->tp_len;
+    desc->options = 0;
+    xdp->tx.cached_prod++;
+    if(++xdp->tx_pending >= interface->tx_flush_threshold) {
+        interface->stats.tx_kicks_early++;
+        bbl_xdp_tx_flush(interface);
+    }
+}
+
+
+/*
+ * AF_XDP has no RX timestamps, each packet is
+ * timestamped when dequeued from the RX ring.
+ */
+static void
+bbl_xdp_rx (bbl_rx_ring_s *rx_ring)
+{
+    bbl_interface_s *interface = rx_ring->interface;
+    bbl_xdp_s *xdp = interface->xdp;
+    struct xdp_desc *desc;
+    struct timespec rx_timestamp;
+    uint64_t *fill;
+    uint8_t *eth_start;
+    uint eth_len;
+    uint16_t vlan_tci;
+    uint32_t prod;
+
+    fill = xdp->fill.ring;
+
+    prod = __atomic_load_n(xdp->rx.producer, __ATOMIC_ACQUIRE);
+    if(prod == xdp->rx.cached_cons) {
+        interface->stats.poll_rx++;
+        pcapng_fflush(interface->ctx);
+        return;
+    }
+
+    while(xdp->rx.cached_cons != prod) {
+        desc = (struct xdp_desc*)xdp->rx.ring + (xdp->rx.cached_cons & xdp->rx.mask);
+        eth_start = xdp->umem + desc->addr;
+        eth_len = desc->len;
+
+        /*
+         * The VLAN tag is not stripped by the kernel with AF_XDP.
+         * Strip the outer VLAN here, same as with AF_PACKET.
+         */
+        vlan_tci = 0;
+        if(eth_len >= 18 &&
+           (be16toh(*(uint16_t*)(eth_start + 12)) == ETH_TYPE_VLAN ||
+            be16toh(*(uint16_t*)(eth_start + 12)) == ETH_TYPE_QINQ)) {
+            vlan_tci = be16toh(*(uint16_t*)(eth_start + 14));
+            memmove(eth_start + 4, eth_start, 12);
+            eth_start += 4;
+            eth_len -= 4;
+        }
+
+        clock_gettime(CLOCK_REALTIME, &rx_timestamp);
+        bbl_rx_packet(interface, eth_start, eth_len, vlan_tci,
+                      rx_timestamp.tv_sec, rx_timestamp.tv_nsec);
+
+        /* Return frame to the kernel. */
+        fill[xdp->fill.cached_prod & xdp->fill.mask] = desc->addr & ~((uint64_t)BBL_XDP_FRAME_SIZE - 1);
+        xdp->fill.cached_prod++;
+        xdp->rx.cached_cons++;
+    }
+    __atomic_store_n(xdp->rx.consumer, xdp->rx.cached_cons, __ATOMIC_RELEASE);
+    __atomic_store_n(xdp->fill.producer, xdp->fill.cached_prod, __ATOMIC_RELEASE);
+}
+
+static bool
+bbl_xdp_rx_ready (bbl_rx_ring_s *rx_ring)
+{
+    bbl_xdp_s *xdp = rx_ring->interface->xdp;
+
+    return __atomic_load_n(xdp->rx.producer, __ATOMIC_ACQUIRE) != xdp->rx.cached_cons;
+}
+
+const bbl_io_ops_s bbl_io_xdp_ops = {
+    .name = "af-xdp",
+    .tx_frame_get = bbl_xdp_tx_frame_get,
+    .tx_frame_commit = bbl_xdp_tx_frame_commit,
+    .tx_flush = bbl_xdp_tx_flush,
+    .rx = bbl_xdp_rx,
+    .rx_ready = bbl_xdp_rx_ready,
+};
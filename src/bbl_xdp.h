@@ -0,0 +1,57 @@
+/*
+ * BNG Blaster (BBL) - AF_XDP I/O Backend
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+
+#ifndef __BBL_XDP_H__
+#define __BBL_XDP_H__
+
+#define BBL_XDP_FRAME_SIZE      2048
+#define BBL_XDP_NUM_FRAMES      4096 /* half for RX and half for TX */
+#define BBL_XDP_RING_SIZE       (BBL_XDP_NUM_FRAMES/2)
+
+typedef struct bbl_ctx_ bbl_ctx_s;
+
+/*
+ * Userspace view of an AF_XDP ring shared with the kernel.
+ */
+typedef struct bbl_xdp_ring_
+{
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void     *ring; /* struct xdp_desc (RX/TX) or UMEM addresses (fill/completion) */
+    uint32_t  size;
+    uint32_t  mask;
+    uint32_t  cached_prod;
+    uint32_t  cached_cons;
+} bbl_xdp_ring_s;
+
+typedef struct bbl_xdp_
+{
+    int fd;
+    int map_fd; /* XSKMAP */
+    int prog_fd;
+    int link_fd;
+    uint32_t queue;
+
+    uint8_t *umem;
+    size_t   umem_len;
+
+    bbl_xdp_ring_s rx;
+    bbl_xdp_ring_s tx;
+    bbl_xdp_ring_s fill;
+    bbl_xdp_ring_s comp;
+
+    uint64_t tx_free[BBL_XDP_RING_SIZE]; /* stack of free TX frames */
+    uint32_t tx_free_count;
+    bool     tx_reserved; /* top of stack handed out by tx_frame_get */
+    uint32_t tx_pending; /* committed but not yet flushed */
+} bbl_xdp_s;
+
+bool bbl_xdp_add(bbl_ctx_s *ctx, bbl_interface_s *interface, bbl_interface_config_s *interface_config);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * BNG Blaster (BBL) - Classic BPF Tests
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+#include <bbl_bpf.h>
+
+/* tcpdump -ddd ip */
+static const char bpf_ip[] = "4,40 0 0 12,21 0 1 2048,6 0 0 262144,6 0 0 0";
+
+/* tcpdump -ddd udp dst port 65056 and ip (as printed, one instruction per line) */
+static const char bpf_udp[] =
+    "11\n"
+    "40 0 0 12\n"
+    "21 0 8 2048\n"
+    "48 0 0 23\n"
+    "21 0 6 17\n"
+    "40 0 0 20\n"
+    "69 4 0 8191\n"
+    "177 0 0 14\n"
+    "72 0 0 16\n"
+    "21 0 1 65056\n"
+    "6 0 0 262144\n"
+    "6 0 0 0\n";
+
+/* Ethernet, IPv4 (IHL 6) and UDP from port 65056 to port 65056 */
+static uint8_t udp_packet[] = {
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x00,
+    0x46, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x40, 0x11, 0x00, 0x00,
+    0x0a, 0x00, 0x00, 0x01, 0x0a, 0x64, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0xfe, 0x20, 0xfe, 0x20, 0x00, 0x08, 0x00, 0x00
+};
+
+static uint8_t arp_packet[] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x06,
+    0x00, 0x01, 0x08, 0x00, 0x06, 0x04, 0x00, 0x01
+};
+
+static void
+test_bpf_filter(void **unused) {
+    (void) unused;
+
+    bbl_bpf_s *bpf;
+
+    bpf = bbl_bpf_new(bpf_ip);
+    assert_non_null(bpf);
+    assert_int_equal(bpf->len, 4);
+    assert_int_equal(bbl_bpf_filter(bpf, udp_packet, sizeof(udp_packet)), 262144);
+    assert_int_equal(bbl_bpf_filter(bpf, arp_packet, sizeof(arp_packet)), 0);
+    /* Loads beyond the end of the packet do not match. */
+    assert_int_equal(bbl_bpf_filter(bpf, arp_packet, 13), 0);
+    bbl_bpf_free(bpf);
+
+    bpf = bbl_bpf_new(bpf_udp);
+    assert_non_null(bpf);
+    assert_int_equal(bbl_bpf_filter(bpf, udp_packet, sizeof(udp_packet)), 262144);
+    assert_int_equal(bbl_bpf_filter(bpf, arp_packet, sizeof(arp_packet)), 0);
+    udp_packet[41] = 53;
+    assert_int_equal(bbl_bpf_filter(bpf, udp_packet, sizeof(udp_packet)), 0);
+    udp_packet[41] = 0x20;
+    /* Fragments do not match. */
+    udp_packet[21] = 0x01;
+    assert_int_equal(bbl_bpf_filter(bpf, udp_packet, sizeof(udp_packet)), 0);
+    udp_packet[21] = 0x00;
+    assert_int_equal(bbl_bpf_filter(bpf, udp_packet, 40), 0);
+    bbl_bpf_free(bpf);
+
+    /* Snap length returned by the program */
+    bpf = bbl_bpf_new("1,6 0 0 64");
+    assert_non_null(bpf);
+    assert_int_equal(bbl_bpf_filter(bpf, arp_packet, sizeof(arp_packet)), 64);
+    bbl_bpf_free(bpf);
+
+    /* Scratch memory, ALU and return A: (len + 2) * 3 */
+    bpf = bbl_bpf_new("6,128 0 0 0,2 0 0 15,96 0 0 15,4 0 0 2,36 0 0 3,22 0 0 0");
+    assert_non_null(bpf);
+    assert_int_equal(bbl_bpf_filter(bpf, arp_packet, sizeof(arp_packet)), 72);
+    bbl_bpf_free(bpf);
+}
+
+static void
+test_bpf_invalid(void **unused) {
+    (void) unused;
+
+    /* Empty, missing or trailing instructions */
+    assert_null(bbl_bpf_new(""));
+    assert_null(bbl_bpf_new("0"));
+    assert_null(bbl_bpf_new("2,6 0 0 0"));
+    assert_null(bbl_bpf_new("1,6 0 0 0,6 0 0 0"));
+    assert_null(bbl_bpf_new("1,6 0 0 x"));
+    /* Jump beyond the end of the program */
+    assert_null(bbl_bpf_new("2,21 0 1 2048,6 0 0 0"));
+    assert_null(bbl_bpf_new("2,5 0 0 1,6 0 0 0"));
+    /* Program does not end with return */
+    assert_null(bbl_bpf_new("1,40 0 0 12"));
+    /* Division by constant zero */
+    assert_null(bbl_bpf_new("2,52 0 0 0,6 0 0 0"));
+    /* Scratch memory out of range */
+    assert_null(bbl_bpf_new("2,2 0 0 16,6 0 0 0"));
+    /* Unknown instruction */
+    assert_null(bbl_bpf_new("2,255 0 0 0,6 0 0 0"));
+}
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_bpf_filter),
+        cmocka_unit_test(test_bpf_invalid),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
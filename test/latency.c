@@ -0,0 +1,92 @@
+/*
+ * BNG Blaster (BBL) - Latency Histogram Tests
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+#include <bbl_latency.h>
+
+static void
+test_latency_histogram_precision(void **unused) {
+    (void) unused;
+
+    bbl_latency_histogram_s histogram;
+    uint64_t value, percentile;
+
+    /* Each value is reported with less than 12.5% error. */
+    for(value = 0; value < (1ULL << BBL_LATENCY_MAX_BITS); value += value / 7 + 1) {
+        memset(&histogram, 0x0, sizeof(histogram));
+        bbl_latency_histogram_add(&histogram, value);
+        percentile = bbl_latency_histogram_percentile(&histogram, BBL_LATENCY_P50);
+        assert_true(percentile >= value);
+        assert_true(percentile - value <= value / BBL_LATENCY_SUB_BUCKETS);
+        assert_int_equal(bbl_latency_histogram_index(percentile), bbl_latency_histogram_index(value));
+    }
+    assert_int_equal(bbl_latency_histogram_index(UINT64_MAX), BBL_LATENCY_BUCKETS - 1);
+}
+
+static void
+test_latency_histogram_percentile(void **unused) {
+    (void) unused;
+
+    bbl_latency_histogram_s histogram;
+    bbl_latency_histogram_s merged;
+    uint64_t value;
+
+    memset(&histogram, 0x0, sizeof(histogram));
+    assert_int_equal(bbl_latency_histogram_percentile(&histogram, BBL_LATENCY_P99), 0);
+
+    /* 1000 values of 10us and 10 values of 1ms */
+    for(value = 0; value < 1000; value++) {
+        bbl_latency_histogram_add(&histogram, 10000);
+    }
+    for(value = 0; value < 10; value++) {
+        bbl_latency_histogram_add(&histogram, 1000000);
+    }
+    assert_int_equal(bbl_latency_histogram_percentile(&histogram, BBL_LATENCY_P50), 10239);
+    assert_int_equal(bbl_latency_histogram_percentile(&histogram, BBL_LATENCY_P99), 10239);
+    assert_int_equal(bbl_latency_histogram_percentile(&histogram, BBL_LATENCY_P999), 1048575);
+
+    memset(&merged, 0x0, sizeof(merged));
+    bbl_latency_histogram_merge(&merged, &histogram);
+    bbl_latency_histogram_merge(&merged, &histogram);
+    assert_int_equal(merged.count, 2020);
+    assert_int_equal(bbl_latency_histogram_percentile(&merged, BBL_LATENCY_P999), 1048575);
+}
+
+static void
+test_latency_jitter(void **unused) {
+    (void) unused;
+
+    bbl_latency_s latency;
+    uint64_t variation;
+
+    memset(&latency, 0x0, sizeof(latency));
+    assert_false(bbl_latency_variation(&latency, 1000, &variation));
+    bbl_latency_add(&latency, 1000);
+    assert_true(bbl_latency_variation(&latency, 2600, &variation));
+    assert_int_equal(variation, 1600);
+    assert_int_equal(latency.jitter, 100);
+    bbl_latency_add(&latency, 2600);
+    assert_true(bbl_latency_variation(&latency, 1000, &variation));
+    assert_int_equal(variation, 1600);
+    bbl_latency_add(&latency, 1000);
+    assert_int_equal(latency.min, 1000);
+    assert_int_equal(latency.max, 2600);
+    assert_int_equal(bbl_latency_avg(&latency), 1533);
+}
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_latency_histogram_precision),
+        cmocka_unit_test(test_latency_histogram_percentile),
+        cmocka_unit_test(test_latency_jitter),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,198 @@
+/*
+ * BNG Blaster (BBL) - PCAP Traffic Class Tests
+ *
+ * Hannes Gredler, March 2021
+ *
+ * Copyright (C) 2020-2021, RtBrick, Inc.
+ */
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+#include <bbl_protocols.h>
+#include <bbl_pcap_traffic.h>
+
+/* Ethernet with one VLAN and PPPoE session header (IPv4) */
+static const uint8_t pppoe_header[] = {
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x81, 0x00,
+    0x00, 0x80, 0x88, 0x64,
+    0x11, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x21
+};
+
+/* Ethernet without VLAN (IPv4) */
+static const uint8_t eth_header[] = {
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x00
+};
+
+/* PPPoE session LCP echo request */
+static const uint8_t pppoe_lcp[] = {
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x81, 0x00,
+    0x00, 0x80, 0x88, 0x64,
+    0x11, 0x00, 0x00, 0x01, 0x00, 0x0a, 0xc0, 0x21,
+    0x09, 0x01, 0x00, 0x08, 0x01, 0x02, 0x03, 0x04
+};
+
+static const uint8_t arp[] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x06,
+    0x00, 0x01, 0x08, 0x00, 0x06, 0x04, 0x00, 0x01
+};
+
+static uint
+test_pcap_ipv4(uint8_t *buf, uint8_t protocol, uint16_t frag, uint payload_len) {
+    memset(buf, 0x0, 20);
+    buf[0] = 0x45;
+    *(uint16_t*)(buf+2) = htobe16(20 + payload_len);
+    *(uint16_t*)(buf+6) = htobe16(frag);
+    buf[8] = 64;
+    buf[9] = protocol;
+    return 20;
+}
+
+static uint
+test_pcap_udp(uint8_t *buf, uint16_t src, uint16_t dst, uint payload_len) {
+    *(uint16_t*)(buf) = htobe16(src);
+    *(uint16_t*)(buf+2) = htobe16(dst);
+    *(uint16_t*)(buf+4) = htobe16(8 + payload_len);
+    *(uint16_t*)(buf+6) = 0;
+    return 8;
+}
+
+/* IPv4, UDP and BBL header */
+static uint
+test_pcap_ipv4_bbl(uint8_t *buf) {
+    uint len;
+
+    len = test_pcap_ipv4(buf, PROTOCOL_IPV4_UDP, 0, 8 + BBL_HEADER_LEN);
+    len += test_pcap_udp(buf + len, BBL_UDP_PORT, BBL_UDP_PORT, BBL_HEADER_LEN);
+    memset(buf + len, 0x0, BBL_HEADER_LEN);
+    *(uint64_t*)(buf + len) = BBL_MAGIC_NUMBER;
+    return len + BBL_HEADER_LEN;
+}
+
+static void
+test_pcap_traffic_pppoe(void **unused) {
+    (void) unused;
+
+    uint8_t buf[512];
+    uint len;
+
+    assert_int_equal(pcapng_traffic((uint8_t*)pppoe_lcp, sizeof(pppoe_lcp)), PCAPNG_TRAFFIC_CONTROL);
+    assert_int_equal(pcapng_traffic((uint8_t*)arp, sizeof(arp)), PCAPNG_TRAFFIC_CONTROL);
+    /* Truncated ethernet or PPPoE header */
+    assert_int_equal(pcapng_traffic((uint8_t*)pppoe_lcp, 13), PCAPNG_TRAFFIC_CONTROL);
+    assert_int_equal(pcapng_traffic((uint8_t*)pppoe_lcp, 24), PCAPNG_TRAFFIC_CONTROL);
+
+    /* BBL session traffic in PPPoE */
+    memcpy(buf, pppoe_header, sizeof(pppoe_header));
+    len = sizeof(pppoe_header);
+    len += test_pcap_ipv4_bbl(buf + len);
+    assert_int_equal(pcapng_traffic(buf, len), PCAPNG_TRAFFIC_BBL);
+    /* Truncated BBL header */
+    assert_int_equal(pcapng_traffic(buf, len - 1), PCAPNG_TRAFFIC_DATA);
+    /* Wrong magic number */
+    buf[len - BBL_HEADER_LEN]++;
+    assert_int_equal(pcapng_traffic(buf, len), PCAPNG_TRAFFIC_DATA);
+
+    /* TCP in PPPoE */
+    len = sizeof(pppoe_header);
+    len += test_pcap_ipv4(buf + len, PROTOCOL_IPV4_TCP, 0, 20);
+    memset(buf + len, 0x0, 20);
+    len += 20;
+    assert_int_equal(pcapng_traffic(buf, len), PCAPNG_TRAFFIC_DATA);
+}
+
+static void
+test_pcap_traffic_ipoe(void **unused) {
+    (void) unused;
+
+    uint8_t buf[512];
+    uint len;
+
+    /* DHCP */
+    memcpy(buf, eth_header, sizeof(eth_header));
+    len = sizeof(eth_header);
+    len += test_pcap_ipv4(buf + len, PROTOCOL_IPV4_UDP, 0, 8 + 240);
+    len += test_pcap_udp(buf + len, DHCP_UDP_CLIENT, DHCP_UDP_SERVER, 240);
+    memset(buf + len, 0x0, 240);
+    len += 240;
+    assert_int_equal(pcapng_traffic(buf, len), PCAPNG_TRAFFIC_CONTROL);
+
+    /* BBL */
+    len = sizeof(eth_header);
+    len += test_pcap_ipv4_bbl(buf + len);
+    assert_int_equal(pcapng_traffic(buf, len), PCAPNG_TRAFFIC_BBL);
+
+    /* ICMPv6 */
+    memset(buf, 0x0, 48);
+    buf[0] = 0x60;
+    buf[6] = IPV6_NEXT_HEADER_ICMPV6;
+    assert_int_equal(pcapng_traffic_ip(buf, 48, ETH_TYPE_IPV6), PCAPNG_TRAFFIC_CONTROL);
+    assert_int_equal(pcapng_traffic_ip(buf, 39, ETH_TYPE_IPV6), PCAPNG_TRAFFIC_DATA);
+}
+
+static void
+test_pcap_traffic_fragment(void **unused) {
+    (void) unused;
+
+    uint8_t buf[512];
+    uint len;
+
+    /* Non-first fragment with payload looking like DHCP or BBL */
+    len = test_pcap_ipv4(buf, PROTOCOL_IPV4_UDP, 185, 8 + 240);
+    len += test_pcap_udp(buf + len, DHCP_UDP_CLIENT, DHCP_UDP_SERVER, 240);
+    assert_int_equal(pcapng_traffic_ip(buf, len, ETH_TYPE_IPV4), PCAPNG_TRAFFIC_DATA);
+    len = test_pcap_ipv4_bbl(buf);
+    *(uint16_t*)(buf+6) = htobe16(185);
+    assert_int_equal(pcapng_traffic_ip(buf, len, ETH_TYPE_IPV4), PCAPNG_TRAFFIC_DATA);
+    /* First fragment (more fragments) */
+    *(uint16_t*)(buf+6) = htobe16(IP_MF);
+    assert_int_equal(pcapng_traffic_ip(buf, len, ETH_TYPE_IPV4), PCAPNG_TRAFFIC_BBL);
+}
+
+static void
+test_pcap_traffic_l2tp(void **unused) {
+    (void) unused;
+
+    uint8_t buf[512];
+    uint8_t *l2tp;
+    uint len;
+
+    /* L2TP data (length and sequence) with PPP IPv4 and BBL */
+    len = test_pcap_ipv4(buf, PROTOCOL_IPV4_UDP, 0, 8 + 12 + 4 + 20 + 8 + BBL_HEADER_LEN);
+    len += test_pcap_udp(buf + len, L2TP_UDP_PORT, L2TP_UDP_PORT, 12 + 4 + 20 + 8 + BBL_HEADER_LEN);
+    l2tp = buf + len;
+    memset(l2tp, 0x0, 12);
+    l2tp[0] = L2TP_HDR_LEN_BIT_MASK | L2TP_HDR_SEQ_BIT_MASK;
+    l2tp[1] = 0x02;
+    len += 12;
+    buf[len++] = 0xff;
+    buf[len++] = 0x03;
+    *(uint16_t*)(buf + len) = htobe16(PROTOCOL_IPV4);
+    len += 2;
+    len += test_pcap_ipv4_bbl(buf + len);
+    assert_int_equal(pcapng_traffic_ip(buf, len, ETH_TYPE_IPV4), PCAPNG_TRAFFIC_BBL);
+
+    /* L2TP data with LCP */
+    *(uint16_t*)(l2tp + 14) = htobe16(PROTOCOL_LCP);
+    assert_int_equal(pcapng_traffic_ip(buf, len, ETH_TYPE_IPV4), PCAPNG_TRAFFIC_CONTROL);
+
+    /* L2TP data with offset beyond the packet */
+    *(uint16_t*)(l2tp + 14) = htobe16(PROTOCOL_IPV4);
+    l2tp[0] |= L2TP_HDR_OFFSET_BIT_MASK;
+    assert_int_equal(pcapng_traffic_ip(buf, len, ETH_TYPE_IPV4), PCAPNG_TRAFFIC_CONTROL);
+
+    /* L2TP control */
+    l2tp[0] = L2TP_HDR_CTRL_BIT_MASK | L2TP_HDR_LEN_BIT_MASK | L2TP_HDR_SEQ_BIT_MASK;
+    assert_int_equal(pcapng_traffic_ip(buf, len, ETH_TYPE_IPV4), PCAPNG_TRAFFIC_CONTROL);
+}
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_pcap_traffic_pppoe),
+        cmocka_unit_test(test_pcap_traffic_ipoe),
+        cmocka_unit_test(test_pcap_traffic_fragment),
+        cmocka_unit_test(test_pcap_traffic_l2tp),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -37,15 +37,303 @@ test_protocols_decode_pppoe_ipcp_conf_request(void **unused) {
     ipcp = (bbl_ipcp_t*)pppoes->next;
 
     assert_int_equal(ipcp->code, PPP_CODE_CONF_REQUEST);
+    assert_int_equal(ipcp->options_len, 18);
+
+    /* Options are decoded on demand. */
+    assert_int_equal(ipcp->address, 0);
+    assert_int_equal(decode_ppp_ipcp_options(ipcp), PROTOCOL_SUCCESS);
     assert_int_equal(ipcp->address, ip);
     assert_int_equal(ipcp->dns1, dns1);
     assert_int_equal(ipcp->dns2, dns2);
 
 }
 
+static void
+test_protocols_decode_pppoe_ipcp_invalid_option(void **unused) {
+    (void) unused;
+
+    uint8_t *sp = calloc(1, SCRATCHPAD_LEN);
+    uint8_t packet[sizeof(pppoe_ipcp_conf_request)];
+    bbl_ethernet_header_t *eth;
+    protocol_error_t decode_result;
+    bbl_pppoe_session_t *pppoes;
+    bbl_ipcp_t *ipcp;
+
+    /* Set length of the first IPCP option to 1. */
+    memcpy(packet, pppoe_ipcp_conf_request, sizeof(packet));
+    packet[35] = 1;
+
+    decode_result = decode_ethernet(packet, sizeof(packet), sp, SCRATCHPAD_LEN, &eth);
+    assert_int_equal(decode_result, PROTOCOL_SUCCESS);
+
+    pppoes = (bbl_pppoe_session_t*)eth->next;
+    ipcp = (bbl_ipcp_t*)pppoes->next;
+
+    assert_int_equal(ipcp->code, PPP_CODE_CONF_REQUEST);
+    assert_int_equal(decode_ppp_ipcp_options(ipcp), DECODE_ERROR);
+}
+
+static void
+test_protocols_checksum(void **unused) {
+    (void) unused;
+
+    uint8_t header[20] = {
+        0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00,
+        0x40, 0x11, 0x00, 0x00, 0xc0, 0xa8, 0x00, 0x01,
+        0xc0, 0xa8, 0x00, 0xc7
+    };
+    uint8_t buf[1501];
+    uint16_t expected;
+    uint16_t csum;
+    uint16_t ttl;
+    int kernel;
+    int len;
+    int i;
+
+    csum = checksum((uint16_t*)header, sizeof(header));
+    assert_int_equal(be16toh(csum), 0xb861);
+
+    /* Decrement TTL and update checksum incrementally. */
+    *(uint16_t*)(header+10) = csum;
+    ttl = *(uint16_t*)(header+8);
+    header[8]--;
+    csum = checksum_update16(csum, ttl, *(uint16_t*)(header+8));
+    *(uint16_t*)(header+10) = 0;
+    assert_int_equal(csum, checksum((uint16_t*)header, sizeof(header)));
+
+    /* All supported kernels must return the same checksum. */
+    for(i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = i * 7;
+    }
+    for(len = 0; len <= (int)sizeof(buf); len += 37) {
+        checksum_kernel_set(CHECKSUM_KERNEL_GENERIC);
+        expected = checksum((uint16_t*)buf, len);
+        for(kernel = CHECKSUM_KERNEL_SSE2; kernel <= CHECKSUM_KERNEL_AVX2; kernel++) {
+            if(checksum_kernel_set(kernel)) {
+                assert_int_equal(checksum((uint16_t*)buf, len), expected);
+            }
+        }
+    }
+    checksum_kernel_set(CHECKSUM_KERNEL_AUTO);
+}
+
+/*
+ * Encode a BBL session traffic frame with two VLANs,
+ * optionally in PPPoE, as sent by the BNG Blaster.
+ */
+static uint16_t
+test_protocols_encode_bbl(uint8_t *buf, bool pppoe, uint16_t type, bbl_bbl_t *bbl) {
+    uint8_t mac1[ETH_ADDR_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    uint8_t mac2[ETH_ADDR_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+    uint8_t ip6_src[IPV6_ADDR_LEN] = {0xfc, 0x66, 0x10, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+    uint8_t ip6_dst[IPV6_ADDR_LEN] = {0xfc, 0x66, 0x10, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2};
+    bbl_ethernet_header_t eth = {0};
+    bbl_pppoe_session_t pppoes = {0};
+    bbl_ipv4_t ipv4 = {0};
+    bbl_ipv6_t ipv6 = {0};
+    bbl_udp_t udp = {0};
+    uint16_t len = 0;
+    void *ip;
+
+    udp.src = BBL_UDP_PORT;
+    udp.dst = BBL_UDP_PORT;
+    udp.protocol = UDP_PROTOCOL_BBL;
+    udp.next = bbl;
+    if(type == ETH_TYPE_IPV4) {
+        inet_pton(AF_INET, "10.100.0.1", &ipv4.src);
+        inet_pton(AF_INET, "10.0.0.1", &ipv4.dst);
+        ipv4.ttl = 64;
+        ipv4.protocol = PROTOCOL_IPV4_UDP;
+        ipv4.next = &udp;
+        ip = &ipv4;
+    } else {
+        ipv6.src = ip6_src;
+        ipv6.dst = ip6_dst;
+        ipv6.ttl = 64;
+        ipv6.protocol = IPV6_NEXT_HEADER_UDP;
+        ipv6.next = &udp;
+        ip = &ipv6;
+    }
+    eth.dst = mac1;
+    eth.src = mac2;
+    eth.vlan_outer = 128;
+    eth.vlan_inner = 7;
+    if(pppoe) {
+        eth.type = ETH_TYPE_PPPOE_SESSION;
+        eth.next = &pppoes;
+        pppoes.session_id = 1;
+        pppoes.protocol = type == ETH_TYPE_IPV4 ? PROTOCOL_IPV4 : PROTOCOL_IPV6;
+        pppoes.next = ip;
+    } else {
+        eth.type = type;
+        eth.next = ip;
+    }
+    assert_int_equal(encode_ethernet(buf, &len, &eth), PROTOCOL_SUCCESS);
+    return len;
+}
+
+/*
+ * The fast path classifier must return the same
+ * result as the full decoder for BBL frames.
+ */
+static void
+test_protocols_classify_bbl_compare(uint8_t *buf, uint16_t len) {
+    uint8_t *sp = calloc(1, SCRATCHPAD_LEN);
+    bbl_ethernet_header_t *eth;
+    bbl_pppoe_session_t *pppoes;
+    bbl_ipv4_t *ipv4 = NULL;
+    bbl_ipv6_t *ipv6;
+    bbl_udp_t *udp;
+    bbl_bbl_t *bbl;
+    bbl_classify_t classify;
+    uint16_t type;
+    void *next;
+
+    assert_int_equal(decode_ethernet(buf, len, sp, SCRATCHPAD_LEN, &eth), PROTOCOL_SUCCESS);
+    assert_int_equal(classify_bbl(buf, len, &classify), PROTOCOL_SUCCESS);
+
+    assert_int_equal(classify.vlan_outer, eth->vlan_outer);
+    assert_int_equal(classify.vlan_inner, eth->vlan_inner);
+    type = eth->type;
+    next = eth->next;
+    assert_int_equal(classify.pppoe, type == ETH_TYPE_PPPOE_SESSION);
+    if(type == ETH_TYPE_PPPOE_SESSION) {
+        pppoes = next;
+        type = pppoes->protocol == PROTOCOL_IPV4 ? ETH_TYPE_IPV4 : ETH_TYPE_IPV6;
+        next = pppoes->next;
+    }
+    assert_int_equal(classify.type, type);
+    if(type == ETH_TYPE_IPV4) {
+        ipv4 = next;
+        assert_int_equal(classify.ipv4_dst, ipv4->dst);
+        udp = ipv4->next;
+    } else {
+        ipv6 = next;
+        udp = ipv6->next;
+    }
+    bbl = udp->next;
+    assert_non_null(bbl);
+    assert_int_equal(classify.bbl.type, bbl->type);
+    assert_int_equal(classify.bbl.sub_type, bbl->sub_type);
+    assert_int_equal(classify.bbl.direction, bbl->direction);
+    assert_int_equal(classify.bbl.tos, bbl->tos);
+    if(bbl->type == BBL_TYPE_UNICAST_SESSION) {
+        assert_int_equal(classify.bbl.ifindex, bbl->ifindex);
+        assert_int_equal(classify.bbl.outer_vlan_id, bbl->outer_vlan_id);
+        assert_int_equal(classify.bbl.inner_vlan_id, bbl->inner_vlan_id);
+    } else {
+        assert_int_equal(classify.bbl.mc_source, bbl->mc_source);
+        assert_int_equal(classify.bbl.mc_group, bbl->mc_group);
+    }
+    assert_int_equal(classify.bbl.flow_id, bbl->flow_id);
+    assert_int_equal(classify.bbl.flow_seq, bbl->flow_seq);
+    assert_int_equal(classify.bbl.timestamp, bbl->timestamp);
+    free(sp);
+}
+
+static void
+test_protocols_classify_bbl(void **unused) {
+    (void) unused;
+
+    uint8_t buf[256];
+    uint8_t arp[] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x06,
+        0x00, 0x01, 0x08, 0x00, 0x06, 0x04, 0x00, 0x01
+    };
+    bbl_classify_t classify;
+    bbl_bbl_t bbl = {0};
+    uint16_t len;
+    uint16_t i;
+
+    bbl.type = BBL_TYPE_UNICAST_SESSION;
+    bbl.sub_type = BBL_SUB_TYPE_IPV4;
+    bbl.direction = BBL_DIRECTION_DOWN;
+    bbl.ifindex = 3;
+    bbl.outer_vlan_id = 128;
+    bbl.inner_vlan_id = 7;
+    bbl.flow_id = 42;
+    bbl.flow_seq = 1000;
+    bbl.timestamp = 0x1234567800000001;
+
+    /* IPoE and PPPoE session traffic */
+    len = test_protocols_encode_bbl(buf, false, ETH_TYPE_IPV4, &bbl);
+    test_protocols_classify_bbl_compare(buf, len);
+    len = test_protocols_encode_bbl(buf, true, ETH_TYPE_IPV4, &bbl);
+    test_protocols_classify_bbl_compare(buf, len);
+    bbl.sub_type = BBL_SUB_TYPE_IPV6;
+    len = test_protocols_encode_bbl(buf, false, ETH_TYPE_IPV6, &bbl);
+    test_protocols_classify_bbl_compare(buf, len);
+    len = test_protocols_encode_bbl(buf, true, ETH_TYPE_IPV6, &bbl);
+    test_protocols_classify_bbl_compare(buf, len);
+
+    /* Multicast */
+    bbl.type = BBL_TYPE_MULTICAST;
+    bbl.sub_type = BBL_SUB_TYPE_IPV4;
+    inet_pton(AF_INET, "10.0.0.1", &bbl.mc_source);
+    inet_pton(AF_INET, "239.0.0.1", &bbl.mc_group);
+    len = test_protocols_encode_bbl(buf, false, ETH_TYPE_IPV4, &bbl);
+    test_protocols_classify_bbl_compare(buf, len);
+
+    /* Truncated frames fall back to the full decoder. */
+    len = test_protocols_encode_bbl(buf, true, ETH_TYPE_IPV4, &bbl);
+    for(i = 0; i < len; i++) {
+        assert_int_equal(classify_bbl(buf, i, &classify), UNKNOWN_PROTOCOL);
+    }
+    len = test_protocols_encode_bbl(buf, false, ETH_TYPE_IPV6, &bbl);
+    for(i = 0; i < len; i++) {
+        assert_int_equal(classify_bbl(buf, i, &classify), UNKNOWN_PROTOCOL);
+    }
+
+    /* Malformed or other frames */
+    assert_int_equal(classify_bbl(arp, sizeof(arp), &classify), UNKNOWN_PROTOCOL);
+    len = test_protocols_encode_bbl(buf, false, ETH_TYPE_IPV4, &bbl);
+    buf[len - 48]++; /* BBL magic number */
+    assert_int_equal(classify_bbl(buf, len, &classify), UNKNOWN_PROTOCOL);
+    len = test_protocols_encode_bbl(buf, false, ETH_TYPE_IPV4, &bbl);
+    buf[len - 54]++; /* UDP destination port */
+    assert_int_equal(classify_bbl(buf, len, &classify), UNKNOWN_PROTOCOL);
+    len = test_protocols_encode_bbl(buf, false, ETH_TYPE_IPV4, &bbl);
+    buf[22] = 0x65; /* IP version 6 in IPv4 header */
+    assert_int_equal(classify_bbl(buf, len, &classify), UNKNOWN_PROTOCOL);
+    len = test_protocols_encode_bbl(buf, false, ETH_TYPE_IPV4, &bbl);
+    buf[22] = 0x44; /* IPv4 header length below 20 bytes */
+    assert_int_equal(classify_bbl(buf, len, &classify), UNKNOWN_PROTOCOL);
+    len = test_protocols_encode_bbl(buf, true, ETH_TYPE_IPV4, &bbl);
+    buf[28] = 0xc0; /* PPP protocol LCP */
+    assert_int_equal(classify_bbl(buf, len, &classify), UNKNOWN_PROTOCOL);
+    len = test_protocols_encode_bbl(buf, true, ETH_TYPE_IPV4, &bbl);
+    buf[26] = 0xff; /* PPPoE payload length beyond the frame */
+    assert_int_equal(classify_bbl(buf, len, &classify), UNKNOWN_PROTOCOL);
+}
+
+static void
+test_protocols_ipv4_multicast_mac(void **unused) {
+    (void) unused;
+
+    uint8_t expected1[ETH_ADDR_LEN] = {0x01, 0x00, 0x5e, 0x01, 0x02, 0x03};
+    uint8_t expected2[ETH_ADDR_LEN] = {0x01, 0x00, 0x5e, 0x7f, 0xff, 0xfe};
+    uint8_t mac[ETH_ADDR_LEN];
+    uint32_t group;
+
+    inet_pton(AF_INET, "239.1.2.3", &group);
+    ipv4_multicast_mac(group, mac);
+    assert_memory_equal(mac, expected1, ETH_ADDR_LEN);
+    /* The high bit of the second group byte is not mapped. */
+    inet_pton(AF_INET, "224.129.2.3", &group);
+    ipv4_multicast_mac(group, mac);
+    assert_memory_equal(mac, expected1, ETH_ADDR_LEN);
+    inet_pton(AF_INET, "239.255.255.254", &group);
+    ipv4_multicast_mac(group, mac);
+    assert_memory_equal(mac, expected2, ETH_ADDR_LEN);
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_protocols_decode_pppoe_ipcp_conf_request),
+        cmocka_unit_test(test_protocols_decode_pppoe_ipcp_invalid_option),
+        cmocka_unit_test(test_protocols_checksum),
+        cmocka_unit_test(test_protocols_classify_bbl),
+        cmocka_unit_test(test_protocols_ipv4_multicast_mac),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }